@@ -0,0 +1,138 @@
+import argparse
+import json
+import os
+import re
+import subprocess
+import tempfile
+import time
+
+
+def conv_layer(layer_type, depth, kernel_size):
+    return {
+        "type": layer_type,
+        "depth": depth,
+        "kernelSize": kernel_size,
+        "learnRate": 0.01,
+        "learnRateDecay": 1.0,
+        "dropoutRate": 0.0
+    }
+
+
+# The cat/dog network from the top-level README, with its convolutional layers of the given type
+def network_config(epochs, layer_type):
+    return {
+        "data": {
+            "classes": ["cat", "dog"],
+            "shape": [100, 100, 3],
+            "normalization": {
+                "min": 0,
+                "max": 255
+            }
+        },
+        "dataLoader": {
+            "fetchSize": 512
+        },
+        "classifier": {
+            "network": {
+                "hyperparams": {
+                    "epochs": epochs,
+                    "batchSize": 1024,
+                    "miniBatchSize": 32
+                },
+                "hiddenLayers": [
+                    conv_layer(layer_type, 32, [3, 3]),
+                    {
+                        "type": "maxPooling",
+                        "regionSize": [2, 2]
+                    },
+                    conv_layer(layer_type, 64, [4, 4]),
+                    {
+                        "type": "maxPooling",
+                        "regionSize": [2, 2]
+                    },
+                    {
+                        "type": "dense",
+                        "size": 64,
+                        "learnRate": 0.01,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    }
+                ],
+                "outputLayer": {
+                    "size": 2,
+                    "learnRate": 0.01,
+                    "learnRateDecay": 1.0
+                }
+            }
+        }
+    }
+
+
+LAYER_TYPES = ["convolutional", "depthwiseSeparable"]
+
+
+def train_and_eval(args, work_dir, epochs, layer_type):
+    config_file = os.path.join(work_dir, "config.json")
+    network_file = os.path.join(work_dir, "network")
+
+    with open(config_file, "w") as f:
+        json.dump(network_config(epochs, layer_type), f)
+
+    gpu_flag = ["--gpu"] if args.gpu else []
+
+    start = time.perf_counter()
+    subprocess.run([args.richardcli, "--train",
+        "--samples", os.path.join(args.data, "train"),
+        "--config", config_file,
+        "--network", network_file] + gpu_flag, check=True, stdout=subprocess.DEVNULL)
+    train_time = time.perf_counter() - start
+
+    start = time.perf_counter()
+    result = subprocess.run([args.richardcli, "--eval",
+        "--samples", os.path.join(args.data, "test"),
+        "--network", network_file] + gpu_flag, check=True, capture_output=True, text=True)
+    eval_time = time.perf_counter() - start
+
+    match = re.search(r"Correct classifications: .* = ([0-9.]+)%", result.stdout)
+    assert match, "Couldn't find accuracy in output of richardcli --eval"
+
+    return train_time, eval_time, float(match.group(1))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--richardcli", required=True, help="Path to the richardcli executable")
+    parser.add_argument("--data", required=True, help="Directory containing train and test")
+    parser.add_argument("--gpu", action="store_true", help="Train and evaluate on the GPU")
+    parser.add_argument("--target", type=float, default=70.0, help="Target accuracy in percent")
+    parser.add_argument("--epochs", type=int, nargs="+", default=[1, 2, 4, 8, 16])
+    args = parser.parse_args()
+
+    print(f"{'layers':<18} {'epochs':>6} {'train (s)':>9} {'eval (s)':>8} {'accuracy (%)':>12}")
+
+    time_to_target = {}
+
+    with tempfile.TemporaryDirectory() as work_dir:
+        for layer_type in LAYER_TYPES:
+            for epochs in args.epochs:
+                train_time, eval_time, accuracy = train_and_eval(args, work_dir, epochs,
+                    layer_type)
+
+                print(f"{layer_type:<18} {epochs:>6} {train_time:>9.2f} {eval_time:>8.2f} "
+                      f"{accuracy:>12.2f}")
+
+                if accuracy >= args.target:
+                    time_to_target[layer_type] = (train_time, epochs)
+                    break
+
+    print()
+    print(f"Time to {args.target}% accuracy")
+
+    for layer_type in LAYER_TYPES:
+        t = time_to_target.get(layer_type)
+        result = f"{t[0]:.2f}s ({t[1]} epochs)" if t is not None else "not reached"
+        print(f"  {layer_type}: {result}")
+
+
+if __name__ == "__main__":
+    main()
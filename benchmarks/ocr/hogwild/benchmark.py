@@ -0,0 +1,124 @@
+import argparse
+import json
+import os
+import re
+import subprocess
+import tempfile
+import time
+
+
+def network_config(epochs, threads, training_mode):
+    return {
+        "data": {
+            "classes": ["0", "1", "2", "3", "4", "5", "6", "7", "8", "9"],
+            "shape": [784, 1, 1],
+            "normalization": {
+                "min": 0,
+                "max": 255
+            }
+        },
+        "dataLoader": {
+            "fetchSize": 512
+        },
+        "classifier": {
+            "network": {
+                "hyperparams": {
+                    "epochs": epochs,
+                    "batchSize": 1024,
+                    "miniBatchSize": 32,
+                    "threads": threads,
+                    "trainingMode": training_mode
+                },
+                "hiddenLayers": [
+                    {
+                        "type": "dense",
+                        "size": 320,
+                        "learnRate": 0.1,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    },
+                    {
+                        "type": "dense",
+                        "size": 64,
+                        "learnRate": 0.1,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    }
+                ],
+                "outputLayer": {
+                    "size": 10,
+                    "learnRate": 0.1,
+                    "learnRateDecay": 1.0
+                }
+            }
+        }
+    }
+
+
+def train_and_eval(args, work_dir, epochs, threads, training_mode):
+    config_file = os.path.join(work_dir, "config.json")
+    network_file = os.path.join(work_dir, "network")
+
+    with open(config_file, "w") as f:
+        json.dump(network_config(epochs, threads, training_mode), f)
+
+    start = time.perf_counter()
+    subprocess.run([args.richardcli, "--train",
+        "--samples", os.path.join(args.data, "train.csv"),
+        "--config", config_file,
+        "--network", network_file], check=True, stdout=subprocess.DEVNULL)
+    train_time = time.perf_counter() - start
+
+    result = subprocess.run([args.richardcli, "--eval",
+        "--samples", os.path.join(args.data, "test.csv"),
+        "--network", network_file], check=True, capture_output=True, text=True)
+
+    match = re.search(r"Correct classifications: .* = ([0-9.]+)%", result.stdout)
+    assert match, "Couldn't find accuracy in output of richardcli --eval"
+
+    return train_time, float(match.group(1))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--richardcli", required=True, help="Path to the richardcli executable")
+    parser.add_argument("--data", required=True, help="Directory containing train.csv and test.csv")
+    parser.add_argument("--threads", type=int, default=os.cpu_count())
+    parser.add_argument("--target", type=float, default=90.0, help="Target accuracy in percent")
+    parser.add_argument("--epochs", type=int, nargs="+", default=[1, 2, 4, 8, 16, 32])
+    args = parser.parse_args()
+
+    modes = [
+        ("synchronous", 1),
+        ("synchronous", args.threads),
+        ("hogwild", args.threads)
+    ]
+
+    print(f"{'mode':<12} {'threads':>7} {'epochs':>6} {'time (s)':>9} {'accuracy (%)':>12}")
+
+    time_to_target = {}
+
+    with tempfile.TemporaryDirectory() as work_dir:
+        for training_mode, threads in modes:
+            for epochs in args.epochs:
+                train_time, accuracy = train_and_eval(args, work_dir, epochs, threads,
+                    training_mode)
+
+                print(f"{training_mode:<12} {threads:>7} {epochs:>6} {train_time:>9.2f} "
+                      f"{accuracy:>12.2f}")
+
+                if accuracy >= args.target:
+                    time_to_target[(training_mode, threads)] = train_time
+                    break
+
+    print()
+    print(f"Time to {args.target}% accuracy")
+
+    for training_mode, threads in modes:
+        t = time_to_target.get((training_mode, threads))
+        result = f"{t:.2f}s" if t is not None else "not reached"
+        print(f"  {training_mode} ({threads} threads): {result}")
+
+
+if __name__ == "__main__":
+    main()
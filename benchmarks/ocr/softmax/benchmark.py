@@ -0,0 +1,181 @@
+import argparse
+import json
+import os
+import re
+import subprocess
+import tempfile
+import time
+
+
+def dense_network(epochs, cost):
+    return {
+        "data": {
+            "classes": ["0", "1", "2", "3", "4", "5", "6", "7", "8", "9"],
+            "shape": [784, 1, 1],
+            "normalization": {
+                "min": 0,
+                "max": 255
+            }
+        },
+        "dataLoader": {
+            "fetchSize": 512
+        },
+        "classifier": {
+            "network": {
+                "hyperparams": {
+                    "epochs": epochs,
+                    "batchSize": 1024,
+                    "miniBatchSize": 32
+                },
+                "hiddenLayers": [
+                    {
+                        "type": "dense",
+                        "size": 320,
+                        "learnRate": 0.1,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    },
+                    {
+                        "type": "dense",
+                        "size": 64,
+                        "learnRate": 0.1,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    }
+                ],
+                "outputLayer": {
+                    "size": 10,
+                    "learnRate": 0.1,
+                    "learnRateDecay": 1.0,
+                    "cost": cost
+                }
+            }
+        }
+    }
+
+
+def convnet_network(epochs, cost):
+    return {
+        "data": {
+            "classes": ["0", "1", "2", "3", "4", "5", "6", "7", "8", "9"],
+            "shape": [28, 28, 1],
+            "normalization": {
+                "min": 0,
+                "max": 255
+            }
+        },
+        "dataLoader": {
+            "fetchSize": 512
+        },
+        "classifier": {
+            "network": {
+                "hyperparams": {
+                    "epochs": epochs,
+                    "batchSize": 1024,
+                    "miniBatchSize": 32
+                },
+                "hiddenLayers": [
+                    {
+                        "type": "convolutional",
+                        "depth": 16,
+                        "kernelSize": [5, 5],
+                        "learnRate": 0.01,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    },
+                    {
+                        "type": "maxPooling",
+                        "regionSize": [2, 2]
+                    },
+                    {
+                        "type": "dense",
+                        "size": 64,
+                        "learnRate": 0.01,
+                        "learnRateDecay": 1.0,
+                        "dropoutRate": 0.0
+                    }
+                ],
+                "outputLayer": {
+                    "size": 10,
+                    "learnRate": 0.01,
+                    "learnRateDecay": 1.0,
+                    "cost": cost
+                }
+            }
+        }
+    }
+
+
+NETWORKS = {
+    "dense": dense_network,
+    "convnet": convnet_network
+}
+
+COSTS = ["quadratic", "crossEntropy"]
+
+
+def train_and_eval(args, work_dir, network, epochs, cost):
+    config_file = os.path.join(work_dir, "config.json")
+    network_file = os.path.join(work_dir, "network")
+
+    with open(config_file, "w") as f:
+        json.dump(NETWORKS[network](epochs, cost), f)
+
+    gpu_flag = ["--gpu"] if args.gpu else []
+
+    start = time.perf_counter()
+    subprocess.run([args.richardcli, "--train",
+        "--samples", os.path.join(args.data, "train.csv"),
+        "--config", config_file,
+        "--network", network_file] + gpu_flag, check=True, stdout=subprocess.DEVNULL)
+    train_time = time.perf_counter() - start
+
+    result = subprocess.run([args.richardcli, "--eval",
+        "--samples", os.path.join(args.data, "test.csv"),
+        "--network", network_file] + gpu_flag, check=True, capture_output=True, text=True)
+
+    match = re.search(r"Correct classifications: .* = ([0-9.]+)%", result.stdout)
+    assert match, "Couldn't find accuracy in output of richardcli --eval"
+
+    return train_time, float(match.group(1))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--richardcli", required=True, help="Path to the richardcli executable")
+    parser.add_argument("--data", required=True, help="Directory containing train.csv and test.csv")
+    parser.add_argument("--gpu", action="store_true", help="Train and evaluate on the GPU")
+    parser.add_argument("--target", type=float, default=95.0, help="Target accuracy in percent")
+    parser.add_argument("--epochs", type=int, nargs="+", default=[1, 2, 4, 8, 16, 32])
+    parser.add_argument("--networks", nargs="+", choices=NETWORKS.keys(), default=NETWORKS.keys())
+    args = parser.parse_args()
+
+    print(f"{'network':<8} {'cost':<12} {'epochs':>6} {'time (s)':>9} {'accuracy (%)':>12}")
+
+    time_to_target = {}
+
+    with tempfile.TemporaryDirectory() as work_dir:
+        for network in args.networks:
+            for cost in COSTS:
+                for epochs in args.epochs:
+                    train_time, accuracy = train_and_eval(args, work_dir, network, epochs, cost)
+
+                    print(f"{network:<8} {cost:<12} {epochs:>6} {train_time:>9.2f} "
+                          f"{accuracy:>12.2f}")
+
+                    if accuracy >= args.target:
+                        time_to_target[(network, cost)] = (train_time, epochs)
+                        break
+
+    print()
+    print(f"Time to {args.target}% accuracy")
+
+    for network in args.networks:
+        for cost in COSTS:
+            t = time_to_target.get((network, cost))
+            result = f"{t[0]:.2f}s ({t[1]} epochs)" if t is not None else "not reached"
+            print(f"  {network} {cost}: {result}")
+
+
+if __name__ == "__main__":
+    main()
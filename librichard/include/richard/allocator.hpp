@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// Aligned allocations for numeric buffers. Freed blocks are kept in per-thread free lists bucketed
+// by size class, so repeatedly allocating arrays of the same size (as happens for every temporary
+// on the training hot path) doesn't go to the system allocator.
+
+namespace richard {
+namespace memory {
+
+const size_t ALIGNMENT = 64;
+
+// Returns nullptr if bytes is 0
+void* allocate(size_t bytes);
+
+// bytes must be the value passed to allocate. The block may be freed on any thread.
+void deallocate(void* ptr, size_t bytes);
+
+// Exposed for testing
+size_t test_sizeClassBytes(size_t bytes);
+// Number of calls to allocate made by the calling thread
+size_t test_allocationCount();
+
+}
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "richard/math.hpp"
+#include "richard/types.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace richard {
+namespace cpu {
+
+enum class Activation {
+  sigmoid,
+  relu
+};
+
+// Maps a float to an integer with the same ordering. Clamping with integer min and max can be
+// vectorised, whereas float comparisons are kept as branches unless -ffast-math is given.
+inline int32_t orderedBits(float x) {
+  int32_t i;
+  memcpy(&i, &x, sizeof(i));
+  return i ^ ((i >> 31) & 0x7fffffff);
+}
+
+inline float fromOrderedBits(int32_t i) {
+  i ^= (i >> 31) & 0x7fffffff;
+  float x;
+  memcpy(&x, &i, sizeof(x));
+  return x;
+}
+
+// Approximates exp(x) by writing it as 2^n * e^r, where n is the nearest integer to x / ln(2) and
+// r lies in [-ln(2)/2, ln(2)/2]. e^r is evaluated with a polynomial and n is added to the exponent
+// bits. The relative error is below 5e-7 for x in [-87, 88]; inputs outside that range are clamped.
+// There are no branches or table lookups, so loops over it vectorise.
+inline netfloat_t fastExp(netfloat_t x) {
+  const float log2e = 1.44269504f;
+  // ln(2) split so that n * ln2Hi is exact
+  const float ln2Hi = 0.693359375f;
+  const float ln2Lo = -2.12194440e-4f;
+  // Adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+  const float roundingConstant = 12582912.f;
+
+  x = fromOrderedBits(std::min(std::max(orderedBits(x), orderedBits(-87.f)), orderedBits(88.f)));
+  float n = (x * log2e + roundingConstant) - roundingConstant;
+  float r = (x - n * ln2Hi) - n * ln2Lo;
+
+  // Taylor series of e^r
+  float p = 1.f / 720.f;
+  p = p * r + 1.f / 120.f;
+  p = p * r + 1.f / 24.f;
+  p = p * r + 1.f / 6.f;
+  p = p * r + 0.5f;
+  p = p * r + 1.f;
+  p = p * r + 1.f;
+
+  int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(scale));
+
+  return p * scale;
+}
+
+struct Sigmoid {
+  netfloat_t operator()(netfloat_t x) const {
+    return 1.f / (1.f + fastExp(-x));
+  }
+};
+
+struct SigmoidPrime {
+  netfloat_t operator()(netfloat_t x) const {
+    netfloat_t sigX = Sigmoid{}(x);
+    return sigX * (1.f - sigX);
+  }
+};
+
+struct Relu {
+  netfloat_t operator()(netfloat_t x) const {
+    return x < 0.f ? 0.f : x;
+  }
+};
+
+struct ReluPrime {
+  netfloat_t operator()(netfloat_t x) const {
+    return x < 0.f ? 0.f : 1.f;
+  }
+};
+
+inline netfloat_t biasAt(netfloat_t bias, size_t) {
+  return bias;
+}
+
+inline netfloat_t biasAt(const netfloat_t* bias, size_t i) {
+  return bias[i];
+}
+
+// Z[i] += bias, A[i] = f(Z[i]) in a single pass. bias is either one value for every element or an
+// array with one value per element. A may alias Z.
+template<class F, class B>
+void biasAndActivate(F f, netfloat_t* Z, B bias, netfloat_t* A, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    netfloat_t z = Z[i] + biasAt(bias, i);
+    Z[i] = z;
+    A[i] = f(z);
+  }
+}
+
+// Z[i] += bias[i], then A = softmax(Z). The largest element is subtracted before exponentiating,
+// so no exponent exceeds zero and the sum can't overflow. A may alias Z.
+inline void biasAndSoftmax(netfloat_t* Z, const netfloat_t* bias, netfloat_t* A, size_t size) {
+  netfloat_t largest = std::numeric_limits<netfloat_t>::lowest();
+  for (size_t i = 0; i < size; ++i) {
+    netfloat_t z = Z[i] + bias[i];
+    Z[i] = z;
+    largest = std::max(largest, z);
+  }
+
+  netfloat_t sum = 0.0;
+  for (size_t i = 0; i < size; ++i) {
+    netfloat_t e = fastExp(Z[i] - largest);
+    A[i] = e;
+    sum += e;
+  }
+
+  const netfloat_t scale = 1.f / sum;
+  for (size_t i = 0; i < size; ++i) {
+    A[i] *= scale;
+  }
+}
+
+// Calls f with the functor for the activation function, or its derivative if derivative is true,
+// so the transform is instantiated for each one rather than going through an indirect call
+template<class F>
+void dispatchActivation(Activation activation, bool derivative, F&& f) {
+  switch (activation) {
+    case Activation::sigmoid:
+      if (derivative) {
+        f(SigmoidPrime{});
+      }
+      else {
+        f(Sigmoid{});
+      }
+      break;
+    case Activation::relu:
+      if (derivative) {
+        f(ReluPrime{});
+      }
+      else {
+        f(Relu{});
+      }
+      break;
+  }
+}
+
+template<class T>
+void applyActivation(Activation activation, T& x) {
+  dispatchActivation(activation, false, [&x](auto fn) { x.transformInPlace(fn); });
+}
+
+template<class T>
+void applyActivationPrime(Activation activation, T& x) {
+  dispatchActivation(activation, true, [&x](auto fn) { x.transformInPlace(fn); });
+}
+
+}
+}
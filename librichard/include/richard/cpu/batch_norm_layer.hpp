@@ -0,0 +1,104 @@
+#pragma once
+
+#include "richard/cpu/layer.hpp"
+#include "richard/cpu/optimizer.hpp"
+
+namespace richard {
+
+class Config;
+
+namespace cpu {
+
+// Normalises each channel of its inputs to zero mean and unit variance over the mini-batch, then
+// applies a learned scale (gamma) and shift (beta). A channel is a feature map of a 3D input, or a
+// single element of a 1D input. Inference uses running averages of the mini-batch statistics,
+// which reduces the layer to an elementwise affine transform.
+class BatchNormLayer : public Layer {
+  public:
+    BatchNormLayer(const Config& config, const Size3& inputShape);
+    BatchNormLayer(const Config& config, std::istream& stream, const Size3& inputShape);
+
+    Size3 outputSize() const override;
+    const DataArray& activations() const override;
+    const DataArray& inputDelta() const override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
+    void updateParams(size_t epoch) override;
+    void writeToStream(std::ostream& stream) const override;
+    void mergeDeltas(Layer& replica) override;
+    void copyParams(const Layer& source) override;
+    void shareParams(Layer& owner) override;
+
+    // The inference-time normalisation as scale * x + shift, with one value per input element
+    void inferenceTransform(DataArray& scale, DataArray& shift) const;
+
+    // For data-parallel training, where each replica holds a shard of the mini-batch but has to
+    // normalise with the statistics of the whole of it. In place of trainForward, every replica
+    // runs sumInputs, then sumSquaredDeviations, then normalise, and in place of updateDeltas,
+    // sumOutputDeltas then updateInputDelta. Between steps the per-channel sums are added up over
+    // all replicas. totalBatchSize is the size of the whole mini-batch.
+    void sumInputs(const DataArray& inputs, size_t batchSize, Vector& sums) const;
+    void sumSquaredDeviations(const DataArray& inputs, size_t batchSize, const Vector& sums,
+      size_t totalBatchSize, Vector& squaredDeviations) const;
+    void normalise(const DataArray& inputs, size_t batchSize, const Vector& sums,
+      const Vector& squaredDeviations, size_t totalBatchSize);
+    // Also adds the shard's parameter gradients to the layer's
+    void sumOutputDeltas(const DataArray& outputDelta, size_t batchSize, Vector& sumDy,
+      Vector& sumDyXhat);
+    void updateInputDelta(const DataArray& outputDelta, size_t batchSize, const Vector& sumDy,
+      const Vector& sumDyXhat, size_t totalBatchSize);
+
+    // Exposed for testing
+    //
+    void test_setGamma(const DataArray& gamma);
+    void test_setBeta(const DataArray& beta);
+    void test_setStatistics(const DataArray& mean, const DataArray& variance);
+    const Vector& test_gamma() const;
+    const Vector& test_beta() const;
+    const Vector& test_mean() const;
+    const Vector& test_variance() const;
+    const Vector& test_deltaGamma() const;
+    const Vector& test_deltaBeta() const;
+
+  private:
+    void initialize(const Config& config, const Size3& inputShape);
+    // The parameters and running statistics used for training, which belong to m_paramsOwner if
+    // set
+    BatchNormLayer& owner();
+    const BatchNormLayer& owner() const;
+
+    Size3 m_inputShape;
+    size_t m_channels;
+    size_t m_channelSize;
+    Vector m_gamma;
+    Vector m_beta;
+    Vector m_mean;
+    Vector m_variance;
+    // Normalised inputs and per-channel reciprocal standard deviations of the last batch
+    Vector m_Xhat;
+    Vector m_invStd;
+    Vector m_Y;
+    Vector m_inputDelta;
+    Vector m_deltaGamma;
+    Vector m_deltaBeta;
+    // Per-channel sums over the batch, used by trainForward and updateDeltas
+    Vector m_sums;
+    Vector m_secondSums;
+    netfloat_t m_learnRate;
+    netfloat_t m_learnRateDecay;
+    // Weight of the old value in the running averages
+    netfloat_t m_momentum;
+    netfloat_t m_epsilon;
+    Optimizer m_optimizerGamma;
+    Optimizer m_optimizerBeta;
+    // Set by shareParams. The owner's running statistics are updated by every replica's
+    // trainForward, racing like the other shared parameters (see Layer::shareParams).
+    BatchNormLayer* m_paramsOwner;
+};
+
+}
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "richard/cpu/layer.hpp"
+#include "richard/cpu/dropout.hpp"
+#include "richard/cpu/optimizer.hpp"
+#include "richard/winograd.hpp"
 #include <vector>
 
 namespace richard {
@@ -22,11 +25,20 @@ class ConvolutionalLayer : public Layer {
     Size3 outputSize() const override;
     const DataArray& activations() const override;
     const DataArray& inputDelta() const override;
-    void trainForward(const DataArray& inputs) override;
-    DataArray evalForward(const DataArray& inputs) const override;
-    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta) override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    size_t evalScratchSize(size_t batchSize = 1) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
     void updateParams(size_t epoch) override;
     void writeToStream(std::ostream& stream) const override;
+    void mergeDeltas(Layer& replica) override;
+    void copyParams(const Layer& source) override;
+    void shareParams(Layer& owner) override;
+    bool absorbInputTransform(const DataArray& scale, const DataArray& shift) override;
+    void setDropoutStream(uint64_t stream) override;
 
     // Exposed for testing
     //
@@ -35,11 +47,49 @@ class ConvolutionalLayer : public Layer {
     const std::vector<Filter> test_filterDeltas() const;
 
   private:
+    enum class Engine {
+      direct,
+      gemm,
+      winograd
+    };
+
     void initialize(const Config& config, const Size3& inputShape);
     size_t numOutputs() const;
-    void forwardPass(const Array3& inputs, Array3& Z) const;
+    void packFilters();
+    // Copies a single sample into the interior of padded, whose border is left as it was
+    void padInput(const netfloat_t* input, netfloat_t* padded) const;
+    // Computes the cross-correlation of each sample with each filter, without the biases. scratch
+    // is as in evalInto.
+    void forwardPass(const netfloat_t* inputs, netfloat_t* Z, size_t batchSize,
+      netfloat_t* scratch = nullptr) const;
+    // The single sample functions below take the input as passed in, which for all but the gemm
+    // engine is the padded copy
+    void forwardPassDirect(const netfloat_t* inputs, const Size3& inputShape,
+      netfloat_t* Z) const;
+    // X is room for one (padded) sample in m_layout
+    void forwardPassLayout(const netfloat_t* inputs, const Size3& inputShape, netfloat_t* Z,
+      netfloat_t* X) const;
+    // scratch is room for the lowered input
+    void forwardPassGemm(const netfloat_t* inputs, netfloat_t* Z, netfloat_t* scratch) const;
+    // scratch is room for the lowered batch and the product
+    void forwardPassGemmBatch(const netfloat_t* inputs, netfloat_t* Z, size_t batchSize,
+      netfloat_t* scratch) const;
+    // scratch is room for the Winograd tiles
+    void forwardPassWinograd(const netfloat_t* inputs, const Size3& inputShape, netfloat_t* Z,
+      netfloat_t* scratch) const;
+    void updateDeltasGemm(const DataArray& inputs, const DataArray& delta, size_t batchSize);
 
+    Engine m_engine;
+    // The memory order the direct engine's forward pass works in. Inputs and outputs are always
+    // nchw, so the input is reordered on entry.
+    Layout m_layout;
     std::vector<Filter> m_filters;
+    // One filter per row, used by the gemm engine's forward pass and every engine's backward pass
+    Matrix m_filterMatrix;
+    // Only maintained by the winograd engine
+    WinogradFilters m_winogradFilters;
+    // The filters reordered to m_layout, only maintained when that isn't nchw
+    DataArray m_layoutFilters;
     Array3 m_Z;
     Array3 m_A;
     Array3 m_inputDelta;
@@ -47,9 +97,15 @@ class ConvolutionalLayer : public Layer {
     size_t m_inputW;
     size_t m_inputH;
     size_t m_inputDepth;
+    size_t m_stride;
+    // Zeros added to each side of the input
+    size_t m_padding;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
-    netfloat_t m_dropoutRate;
+    // The kernels are treated as one array, in filter order
+    Optimizer m_optimizerK;
+    Optimizer m_optimizerB;
+    Dropout m_dropout;
 };
 
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "richard/cpu/layer.hpp"
+#include "richard/cpu/optimizer.hpp"
+#include "richard/cpu/dropout.hpp"
+#include "richard/precision.hpp"
 
 namespace richard {
 
@@ -16,17 +19,25 @@ class DenseLayer : public Layer {
     Size3 outputSize() const override;
     const DataArray& activations() const override;
     const DataArray& inputDelta() const override;
-    void trainForward(const DataArray& inputs) override;
-    DataArray evalForward(const DataArray& inputs) const override;
-    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta) override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
     void updateParams(size_t epoch) override;
     void writeToStream(std::ostream& stream) const override;
+    void mergeDeltas(Layer& replica) override;
+    void copyParams(const Layer& source) override;
+    void shareParams(Layer& owner) override;
+    bool absorbInputTransform(const DataArray& scale, const DataArray& shift) override;
+    void setDropoutStream(uint64_t stream) override;
 
     // Exposed for testing
     //
     void test_setWeights(const DataArray& W);
     void test_setBiases(const DataArray& B);
-    void test_setActivationFn(ActivationFn f, ActivationFn fPrime);
+    void test_setActivation(Activation activation);
     const Matrix& test_deltaW() const;
     const Vector& test_deltaB() const;
     const Matrix& test_W() const;
@@ -34,6 +45,12 @@ class DenseLayer : public Layer {
 
   private:
     void initialize(const Config& config, size_t inputSize);
+    // The parameters used for training, which belong to m_paramsOwner if set
+    Matrix& weights();
+    const Matrix& weights() const;
+    Vector& biases();
+    void multiplyWeights(const netfloat_t* X, netfloat_t* Z, size_t batchSize) const;
+    void packWeights();
 
     Matrix m_W;
     Vector m_B;
@@ -44,9 +61,19 @@ class DenseLayer : public Layer {
     Matrix m_deltaW;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
-    netfloat_t m_dropoutRate;
-    ActivationFn m_activationFn;
-    ActivationFn m_activationFnPrime;
+    Optimizer m_optimizerW;
+    Optimizer m_optimizerB;
+    Dropout m_dropout;
+    Activation m_activation;
+    // Set by shareParams. Reads and updates go straight to the owner's weights and biases, so
+    // several threads can train the same parameters without synchronisation. The SIMD kernels
+    // read them with vector loads, so plain floats are racing here on purpose; see
+    // Layer::shareParams.
+    DenseLayer* m_paramsOwner;
+    StorageType m_storageType;
+    // Copy of m_W in the storage format, used by the forward passes. m_W keeps full precision so
+    // small updates aren't lost to rounding.
+    PackedArray m_packedW;
 };
 
 }
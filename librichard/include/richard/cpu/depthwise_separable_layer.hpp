@@ -0,0 +1,79 @@
+#pragma once
+
+#include "richard/cpu/layer.hpp"
+#include "richard/cpu/convolutional_layer.hpp"
+#include "richard/cpu/optimizer.hpp"
+#include <memory>
+
+namespace richard {
+
+class Config;
+
+namespace cpu {
+
+// A depthwise convolution, which filters each input channel with its own kW x kH kernel, followed
+// by a pointwise (1x1) convolution that mixes the channels into depth feature maps. The stride and
+// padding apply to the depthwise stage. The depthwise stage has no bias or activation, as both
+// would be absorbed by the pointwise stage, which is an ordinary convolutional layer with ReLU and
+// dropout. Costs kW * kH + depth multiplies per input channel and output position, against
+// kW * kH * depth for a convolutional layer.
+class DepthwiseSeparableLayer : public Layer {
+  public:
+    DepthwiseSeparableLayer(const Config& config, const Size3& inputShape);
+    DepthwiseSeparableLayer(const Config& config, std::istream& stream, const Size3& inputShape);
+
+    Size3 outputSize() const override;
+    const DataArray& activations() const override;
+    const DataArray& inputDelta() const override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    size_t evalScratchSize(size_t batchSize = 1) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
+    void updateParams(size_t epoch) override;
+    void writeToStream(std::ostream& stream) const override;
+    void mergeDeltas(Layer& replica) override;
+    void copyParams(const Layer& source) override;
+    void shareParams(Layer& owner) override;
+    void setThreadPool(ThreadPool* pool) override;
+    void setDropoutStream(uint64_t stream) override;
+
+    // Exposed for testing
+    //
+    void test_setDepthwiseKernels(const DataArray& kernels);
+    const Kernel& test_depthwiseKernels() const;
+    const Kernel& test_depthwiseDeltas() const;
+    ConvolutionalLayer& test_pointwise();
+
+  private:
+    void initialize(const Config& config, const Size3& inputShape);
+    Size3 depthwiseOutputSize() const;
+    // Computes the depthwise stage of batchSize samples into Z. With padding, padded is either
+    // null or room for a padded copy of every input channel of the batch.
+    void depthwiseForward(const netfloat_t* inputs, netfloat_t* Z, size_t batchSize,
+      netfloat_t* padded = nullptr) const;
+    size_t paddedSliceSize() const;
+    // Copies one input channel into the interior of padded and zeros the border
+    void padSlice(const netfloat_t* slice, netfloat_t* padded) const;
+
+    size_t m_inputW;
+    size_t m_inputH;
+    size_t m_inputDepth;
+    size_t m_stride;
+    size_t m_padding;
+    netfloat_t m_learnRate;
+    netfloat_t m_learnRateDecay;
+    // One kernel slice per input channel
+    Kernel m_depthwise;
+    Kernel m_depthwiseDelta;
+    Optimizer m_optimizer;
+    // Output of the depthwise stage, and the input of the pointwise stage
+    Array3 m_depthwiseZ;
+    Array3 m_inputDelta;
+    std::unique_ptr<ConvolutionalLayer> m_pointwise;
+};
+
+}
+}
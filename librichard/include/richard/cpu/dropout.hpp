@@ -0,0 +1,72 @@
+#pragma once
+
+#include "richard/cpu/activation.hpp"
+#include "richard/random.hpp"
+#include "richard/types.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace richard {
+namespace cpu {
+
+// Inverted dropout. Each training pass draws a new mask from the layer's own Philox stream and
+// scales kept activations by 1 / (1 - rate), so nothing needs rescaling at inference time. The mask
+// is stored as bits and reused by the backward pass.
+class Dropout {
+  public:
+    // stream is the Philox key, so the masks depend only on it and the number drawn so far
+    explicit Dropout(netfloat_t rate = 0.0, uint64_t stream = 0);
+
+    // A distinct key for each layer of each data-parallel worker, from the network's seed
+    static uint64_t streamKey(uint32_t seed, size_t layerIndex, size_t worker);
+
+    netfloat_t rate() const;
+
+    void generateMask(size_t size);
+
+    // 0 for dropped elements and 1 / (1 - rate) for kept ones
+    inline netfloat_t multiplier(size_t i) const;
+
+    // Z[i] += bias, A[i] = multiplier(offset + i) * f(Z[i]) in a single pass
+    template<class F, class B>
+    void forward(F f, netfloat_t* Z, B bias, netfloat_t* A, size_t size, size_t offset = 0) const;
+
+    // delta[i] = multiplier(offset + i) * fPrime(Z[i]) * deltaA[i]
+    template<class F>
+    void backward(F fPrime, const netfloat_t* Z, const netfloat_t* deltaA, netfloat_t* delta,
+      size_t size, size_t offset = 0) const;
+
+  private:
+    netfloat_t m_rate;
+    netfloat_t m_scale;
+    uint32_t m_threshold;
+    Philox m_rng;
+    std::vector<uint32_t> m_mask;
+};
+
+netfloat_t Dropout::multiplier(size_t i) const {
+  return m_scale * static_cast<netfloat_t>((m_mask[i / 32] >> (i % 32)) & 1);
+}
+
+template<class F, class B>
+void Dropout::forward(F f, netfloat_t* Z, B bias, netfloat_t* A, size_t size,
+  size_t offset) const {
+
+  for (size_t i = 0; i < size; ++i) {
+    netfloat_t z = Z[i] + biasAt(bias, i);
+    Z[i] = z;
+    A[i] = multiplier(offset + i) * f(z);
+  }
+}
+
+template<class F>
+void Dropout::backward(F fPrime, const netfloat_t* Z, const netfloat_t* deltaA, netfloat_t* delta,
+  size_t size, size_t offset) const {
+
+  for (size_t i = 0; i < size; ++i) {
+    delta[i] = multiplier(offset + i) * fPrime(Z[i]) * deltaA[i];
+  }
+}
+
+}
+}
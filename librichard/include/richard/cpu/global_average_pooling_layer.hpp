@@ -0,0 +1,40 @@
+#pragma once
+
+#include "richard/cpu/layer.hpp"
+
+namespace richard {
+
+class Config;
+
+namespace cpu {
+
+// Reduces each feature map of its input to its mean, so a W x H x D input becomes 1 x 1 x D
+class GlobalAveragePoolingLayer : public Layer {
+  public:
+    GlobalAveragePoolingLayer(const Config& config, const Size3& inputShape);
+
+    Size3 outputSize() const override;
+    const DataArray& activations() const override;
+    const DataArray& inputDelta() const override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
+    void updateParams(size_t) override {}
+    void writeToStream(std::ostream&) const override {}
+    void mergeDeltas(Layer&) override {}
+    void copyParams(const Layer&) override {}
+    void shareParams(Layer&) override {}
+
+  private:
+    Vector m_A;
+    Array3 m_inputDelta;
+    size_t m_inputW;
+    size_t m_inputH;
+    size_t m_inputDepth;
+};
+
+}
+}
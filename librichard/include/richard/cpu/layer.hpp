@@ -1,7 +1,9 @@
 #pragma once
 
+#include "richard/cpu/activation.hpp"
 #include "richard/math.hpp"
 #include "richard/types.hpp"
+#include "richard/thread_pool.hpp"
 #include <array>
 #include <functional>
 #include <cmath>
@@ -9,26 +11,8 @@
 namespace richard {
 namespace cpu {
 
-using ActivationFn = std::function<netfloat_t(netfloat_t)>;
 using CostDerivativesFn = std::function<Vector(const Vector&, const Vector&)>;
 
-const ActivationFn sigmoid = [](netfloat_t x) {
-  return static_cast<netfloat_t>(1.0 / (1.0 + exp(-x)));
-};
-
-const ActivationFn sigmoidPrime = [](netfloat_t x) {
-  netfloat_t sigX = sigmoid(x);
-  return static_cast<netfloat_t>(sigX * (1.0 - sigX));
-};
-
-const ActivationFn relu = [](netfloat_t x) {
-  return x < 0.f ? 0.f : x;
-};
-
-const ActivationFn reluPrime = [](netfloat_t x) {
-  return x < 0.f ? 0.f : 1.f;
-};
-
 // Partial derivatives of quadraticCost with respect to the activations
 const CostDerivativesFn quadraticCostDerivatives = [](const Vector& actual,
   const Vector& expected) {
@@ -37,18 +21,78 @@ const CostDerivativesFn quadraticCostDerivatives = [](const Vector& actual,
   return actual - expected;
 };
 
+// Layers process a mini-batch at a time. Inputs, activations and deltas hold batchSize samples one
+// after another, i.e. a batchSize x features block. A single sample is the batchSize = 1 case.
 class Layer {
   public:
     virtual Size3 outputSize() const = 0;
+    // Of the batch most recently passed to trainForward and updateDeltas respectively
     virtual const DataArray& activations() const = 0;
     virtual const DataArray& inputDelta() const = 0;
-    virtual void trainForward(const DataArray& inputs) = 0;
-    virtual DataArray evalForward(const DataArray& inputs) const = 0;
-    virtual void updateDeltas(const DataArray& inputs, const DataArray& outputDelta) = 0;
+    virtual void trainForward(const DataArray& inputs, size_t batchSize = 1) = 0;
+    virtual DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const = 0;
+    // As evalForward, but writes to a buffer of batchSize * calcProduct(outputSize()) elements.
+    // scratch is either null or evalScratchSize(batchSize) elements of working memory, which the
+    // layer otherwise allocates itself. With scratch, doesn't allocate for a single sample.
+    virtual void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const = 0;
+    virtual size_t evalScratchSize(size_t = 1) const {
+      return 0;
+    }
+    // Parameter gradients are summed over the batch
+    virtual void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) = 0;
     virtual void updateParams(size_t epoch) = 0;
     virtual void writeToStream(std::ostream& stream) const = 0;
+    // For data-parallel training, where each worker thread trains its own replica of the layer,
+    // constructed from the same config. mergeDeltas moves the parameter gradients accumulated by
+    // replica into this layer, and copyParams overwrites this layer's parameters with source's.
+    virtual void mergeDeltas(Layer& replica) = 0;
+    virtual void copyParams(const Layer& source) = 0;
+    // For asynchronous (Hogwild) training. From now on this layer trains owner's parameters in
+    // place of its own, with no synchronisation between the two. Reads and updates of the shared
+    // parameters from different threads are therefore data races, which are undefined behaviour in
+    // C++17 and which Hogwild accepts deliberately: on the platforms we target an aligned float is
+    // never torn, so a race only costs a stale read. ThreadSanitizer builds should run with
+    // test/tsan_suppressions.txt.
+    virtual void shareParams(Layer& owner) = 0;
+    // For inference. Rewrites the parameters so that the layer computes from inputs x what it
+    // previously computed from scale * x + shift, elementwise. Returns false, leaving the layer
+    // unchanged, if the transform can't be absorbed exactly.
+    virtual bool absorbInputTransform(const DataArray&, const DataArray&) {
+      return false;
+    }
+
+    // Pool used to parallelise work within the layer. The layer runs single-threaded without one.
+    virtual void setThreadPool(ThreadPool* pool) {
+      m_threadPool = pool;
+    }
+
+    // Keys the layer's dropout masks. See Dropout::streamKey. Layers without dropout ignore it.
+    virtual void setDropoutStream(uint64_t) {}
 
     virtual ~Layer() {}
+
+  protected:
+    // Null if the layer runs single-threaded
+    ThreadPool* threadPool() const {
+      return m_threadPool;
+    }
+
+    template<class F>
+    void parallelFor(size_t begin, size_t end, F&& fn) const {
+      if (m_threadPool && m_threadPool->numThreads() > 1) {
+        richard::parallelFor(*m_threadPool, begin, end, std::ref(fn));
+      }
+      else {
+        for (size_t i = begin; i < end; ++i) {
+          fn(i);
+        }
+      }
+    }
+
+  private:
+    ThreadPool* m_threadPool = nullptr;
 };
 
 using LayerPtr = std::unique_ptr<Layer>;
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "richard/cpu/layer.hpp"
-#include "richard/cpu/convolutional_layer.hpp"
 
 namespace richard {
 
@@ -16,31 +15,40 @@ class MaxPoolingLayer : public Layer {
     Size3 outputSize() const override;
     const DataArray& activations() const override;
     const DataArray& inputDelta() const override;
-    void trainForward(const DataArray& inputs) override;
-    DataArray evalForward(const DataArray& inputs) const override;
-    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta) override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize = 1) override;
     void updateParams(size_t) override {}
     void writeToStream(std::ostream&) const override {}
+    void mergeDeltas(Layer&) override {}
+    void copyParams(const Layer&) override {}
+    void shareParams(Layer&) override {}
 
     // Exposed for testing
     //
-    void test_setMask(const Array3& mask);
-    const Array3& test_mask() const;
+    void test_setArgmax(const std::vector<uint32_t>& argmax);
+    const std::vector<uint32_t>& test_argmax() const;
 
   private:
-    void padDelta(const Array3& delta, const Array3& mask, Array3& paddedDelta) const;
-    void backpropFromDenseLayer(const Layer& nextLayer, Array3& delta);
-    void backpropFromConvLayer(const std::vector<ConvolutionalLayer::Filter>& filters,
-      const DataArray& convDelta, Array3& delta);
+    // Returns the offset within image, a single input slice, of the largest value in the region
+    // pooled into output (x, y). Ties go to the first in row-major order.
+    size_t regionMax(const netfloat_t* image, size_t x, size_t y) const;
 
     Array3 m_Z;
     Array3 m_inputDelta;
     size_t m_regionW;
     size_t m_regionH;
+    size_t m_strideX;
+    size_t m_strideY;
     size_t m_inputW;
     size_t m_inputH;
     size_t m_inputDepth;
-    Array3 m_mask;
+    // For each output, the offset within its input slice of the value it took. Overlapping regions
+    // can share a winner, so backprop accumulates rather than assigns.
+    std::vector<uint32_t> m_argmax;
 };
 
 }
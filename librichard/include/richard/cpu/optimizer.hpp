@@ -0,0 +1,34 @@
+#pragma once
+
+#include "richard/optimizer.hpp"
+
+namespace richard {
+namespace cpu {
+
+// Applies gradients to one parameter array. Each update is a single pass that reads the
+// parameters, gradients and optimizer state once, writes them back and zeroes the gradients.
+class Optimizer {
+  public:
+    Optimizer();
+    Optimizer(const OptimizerParams& params, size_t size);
+
+    // Call once per parameter update, before update
+    void nextStep(netfloat_t learnRate);
+
+    // Updates params[0, size) using the state from offset onwards, so arrays that are stored in
+    // pieces can be updated a piece at a time
+    void update(netfloat_t* params, netfloat_t* gradients, size_t size, size_t offset = 0);
+
+    void read(std::istream& stream);
+    void write(std::ostream& stream) const;
+
+  private:
+    OptimizerParams m_params;
+    OptimizerState m_state;
+    // For the current step, with Adam's bias correction folded in
+    netfloat_t m_learnRate;
+    netfloat_t m_epsilon;
+};
+
+}
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "richard/cpu/layer.hpp"
+#include "richard/cpu/optimizer.hpp"
+#include "richard/neural_net.hpp"
 
 namespace richard {
 
@@ -16,17 +18,26 @@ class OutputLayer : public Layer {
     Size3 outputSize() const override;
     const DataArray& activations() const override;
     const DataArray& inputDelta() const override;
-    void trainForward(const DataArray& inputs) override;
-    DataArray evalForward(const DataArray& inputs) const override;
-    void updateDeltas(const DataArray& inputs, const DataArray& outputs) override;
+    void trainForward(const DataArray& inputs, size_t batchSize = 1) override;
+    DataArray evalForward(const DataArray& inputs, size_t batchSize = 1) const override;
+    void evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize = 1,
+      netfloat_t* scratch = nullptr) const override;
+    void updateDeltas(const DataArray& inputs, const DataArray& outputs,
+      size_t batchSize = 1) override;
     void updateParams(size_t epoch) override;
     void writeToStream(std::ostream& stream) const override;
+    void mergeDeltas(Layer& replica) override;
+    void copyParams(const Layer& source) override;
+    void shareParams(Layer& owner) override;
+    bool absorbInputTransform(const DataArray& scale, const DataArray& shift) override;
+
+    CostType costType() const;
 
     // Exposed for testing
     //
     void test_setWeights(const DataArray& W);
     void test_setBiases(const DataArray& B);
-    void test_setActivationFn(ActivationFn f, ActivationFn fPrime);
+    void test_setActivation(Activation activation);
     const Matrix& test_deltaW() const;
     const Vector& test_deltaB() const;
     const Matrix& test_W() const;
@@ -34,6 +45,13 @@ class OutputLayer : public Layer {
 
   private:
     void initialize(const Config& config, size_t inputSize);
+    // The parameters used for training, which belong to m_paramsOwner if set
+    Matrix& weights();
+    const Matrix& weights() const;
+    Vector& biases();
+    void multiplyWeights(const netfloat_t* X, netfloat_t* Z, size_t batchSize) const;
+    // Adds the biases to each sample's weighted inputs Z and writes the activations to A
+    void activate(netfloat_t* Z, const netfloat_t* B, netfloat_t* A, size_t batchSize) const;
 
     Matrix m_W;
     Vector m_B;
@@ -44,8 +62,15 @@ class OutputLayer : public Layer {
     Matrix m_deltaW;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
-    ActivationFn m_activationFn;
-    ActivationFn m_activationFnPrime;
+    Optimizer m_optimizerW;
+    Optimizer m_optimizerB;
+    CostType m_costType;
+    // Unused for cross-entropy, which always uses softmax
+    Activation m_activation;
+    // Set by shareParams. Reads and updates go straight to the owner's weights and biases, so
+    // several threads can train the same parameters without synchronisation, racing by design as
+    // described at Layer::shareParams.
+    OutputLayer* m_paramsOwner;
 };
 
 }
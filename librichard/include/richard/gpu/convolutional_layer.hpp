@@ -3,6 +3,7 @@
 #include "richard/math.hpp"
 #include "richard/gpu/layer.hpp"
 #include "richard/gpu/gpu.hpp"
+#include "richard/gpu/optimizer.hpp"
 
 namespace richard {
 
@@ -61,8 +62,12 @@ class ConvolutionalLayer : public Layer {
     size_t m_inputDepth;
     std::array<size_t, 2> m_kernelSize;
     size_t m_depth;
+    size_t m_stride;
+    size_t m_padding;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
+    Optimizer m_optimizerK;
+    Optimizer m_optimizerB;
     netfloat_t m_dropoutRate;
     bool m_isFirstLayer;
     Vector m_kernelData;
@@ -3,6 +3,7 @@
 #include "richard/math.hpp"
 #include "richard/gpu/layer.hpp"
 #include "richard/gpu/gpu.hpp"
+#include "richard/gpu/optimizer.hpp"
 
 namespace richard {
 
@@ -58,12 +59,16 @@ class DenseLayer : public Layer {
     const PlatformPaths& m_platformPaths;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
+    Optimizer m_optimizerB;
+    Optimizer m_optimizerW;
     netfloat_t m_dropoutRate;
     size_t m_inputSize;
     bool m_isFirstLayer;
     size_t m_size;
     Vector m_B;
     Matrix m_W;
+    // The format of the weights in the model file. They're always trained and evaluated as fp32.
+    StorageType m_storageType;
     GpuBuffer m_bufferB;
     GpuBuffer m_bufferW;
     GpuBuffer m_bufferZ;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "richard/math.hpp"
+#include "richard/gpu/layer.hpp"
+#include "richard/gpu/gpu.hpp"
+#include "richard/gpu/optimizer.hpp"
+#include "richard/gpu/convolutional_layer.hpp"
+#include <memory>
+
+namespace richard {
+
+class FileSystem;
+class PlatformPaths;
+class Config;
+
+namespace gpu {
+
+// As cpu::DepthwiseSeparableLayer, and reads and writes the same format. The pointwise stage is a
+// ConvolutionalLayer with 1x1 kernels whose input is the depthwise stage's output buffer.
+class DepthwiseSeparableLayer : public Layer {
+  public:
+    DepthwiseSeparableLayer(Gpu& gpu, FileSystem& fileSystem, const PlatformPaths& platformPaths,
+      const Config& config, const Size3& inputShape, bool isFirstLayer);
+    DepthwiseSeparableLayer(Gpu& gpu, FileSystem& fileSystem, const PlatformPaths& platformPaths,
+      const Config& config, std::istream& stream, const Size3& inputShape, bool isFirstLayer);
+
+    void allocateGpuBuffers() override;
+    void createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle statusBuffer,
+      const Layer* nextLayer, GpuBufferHandle sampleYBuffer) override;
+    size_t size() const override;
+    GpuBufferHandle outputBuffer() const override;
+    GpuBufferHandle weightsBuffer() const override;
+    GpuBufferHandle deltaBuffer() const override;
+    GpuBufferHandle inputDeltaBuffer() const override;
+    void retrieveBuffers() override;
+    Size3 outputSize() const override;
+    void evalForward() override;
+    void trainForward() override;
+    void backprop() override;
+    void updateParams() override;
+    void writeToStream(std::ostream& stream) const override;
+
+    // Exposed for testing
+    //
+    void test_setDepthwiseKernels(const DataArray& kernels);
+    const Vector& test_depthwiseKernels() const;
+    GpuBufferHandle test_deltaKBuffer() const;
+    ConvolutionalLayer& test_pointwise();
+
+  private:
+    void initialize(const Config& config, const Size3& inputShape, bool isFirstLayer);
+    Size3 depthwiseOutputSize() const;
+    ShaderHandle createForwardShader(GpuBufferHandle statusBuffer, GpuBufferHandle inputBuffer,
+      bool isFirstLayer);
+    void createBackpropInputDeltaShader();
+    void createBackpropParamDeltasShader(GpuBufferHandle statusBuffer, GpuBufferHandle inputBuffer);
+    void createUpdateParamsShader(GpuBufferHandle statusBuffer);
+
+    Gpu& m_gpu;
+    FileSystem& m_fileSystem;
+    const PlatformPaths& m_platformPaths;
+    size_t m_inputW;
+    size_t m_inputH;
+    size_t m_inputDepth;
+    std::array<size_t, 2> m_kernelSize;
+    size_t m_stride;
+    size_t m_padding;
+    netfloat_t m_learnRate;
+    netfloat_t m_learnRateDecay;
+    bool m_isFirstLayer;
+    Optimizer m_optimizer;
+    // One kernel slice per input channel
+    Vector m_depthwiseData;
+    GpuBuffer m_bufferK;
+    GpuBuffer m_bufferDeltaK;
+    // Output of the depthwise stage, and the input of the pointwise stage
+    GpuBuffer m_bufferZ;
+    GpuBuffer m_bufferInputDelta;
+    ShaderHandle m_evalForwardShader;
+    ShaderHandle m_trainForwardShader;
+    ShaderHandle m_backpropInputDeltaShader;
+    ShaderHandle m_backpropParamDeltasShader;
+    ShaderHandle m_updateParamsShader;
+    std::unique_ptr<ConvolutionalLayer> m_pointwise;
+};
+
+}
+}
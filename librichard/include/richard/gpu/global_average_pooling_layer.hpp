@@ -0,0 +1,55 @@
+#pragma once
+
+#include "richard/math.hpp"
+#include "richard/gpu/layer.hpp"
+#include "richard/gpu/gpu.hpp"
+
+namespace richard {
+
+class FileSystem;
+class PlatformPaths;
+class Config;
+
+namespace gpu {
+
+// As cpu::GlobalAveragePoolingLayer
+class GlobalAveragePoolingLayer : public Layer {
+  public:
+    GlobalAveragePoolingLayer(Gpu& gpu, FileSystem& fileSystem,
+      const PlatformPaths& platformPaths, const Config& config, const Size3& inputShape);
+
+    void allocateGpuBuffers() override;
+    void createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle statusBuffer,
+      const Layer* nextLayer, GpuBufferHandle sampleYBuffer) override;
+    size_t size() const override;
+    GpuBufferHandle outputBuffer() const override;
+    GpuBufferHandle weightsBuffer() const override;
+    GpuBufferHandle deltaBuffer() const override;
+    GpuBufferHandle inputDeltaBuffer() const override;
+    void retrieveBuffers() override;
+    Size3 outputSize() const override;
+    void evalForward() override;
+    void trainForward() override;
+    void backprop() override;
+    void updateParams() override;
+    void writeToStream(std::ostream& stream) const override;
+
+  private:
+    void createForwardShader(GpuBufferHandle inputBuffer);
+    void createBackpropShader(const Layer* nextLayer);
+
+    Gpu& m_gpu;
+    FileSystem& m_fileSystem;
+    const PlatformPaths& m_platformPaths;
+    size_t m_inputW;
+    size_t m_inputH;
+    size_t m_inputDepth;
+    GpuBuffer m_bufferA;
+    GpuBuffer m_bufferInputDelta;
+    // Training and evaluation compute the same thing
+    ShaderHandle m_forwardShader;
+    ShaderHandle m_backpropShader;
+};
+
+}
+}
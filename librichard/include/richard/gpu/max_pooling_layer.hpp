@@ -35,23 +35,27 @@ class MaxPoolingLayer : public Layer {
 
     // Exposed for testing
     //
-    GpuBufferHandle test_maskBuffer() const;
+    GpuBufferHandle test_argmaxBuffer() const;
 
   private:
     void createEvalForwardShader(GpuBufferHandle inputBuffer);
     void createTrainForwardShader(GpuBufferHandle inputBuffer);
     void createBackpropShader(const Layer* nextLayer);
+    SpecializationConstants regionConstants() const;
 
     Gpu& m_gpu;
     FileSystem& m_fileSystem;
     const PlatformPaths& m_platformPaths;
     size_t m_regionW;
     size_t m_regionH;
+    size_t m_strideX;
+    size_t m_strideY;
     size_t m_inputW;
     size_t m_inputH;
     size_t m_inputDepth;
     GpuBuffer m_bufferZ;
-    GpuBuffer m_bufferMask;
+    // As cpu::MaxPoolingLayer, one offset within the input slice per output
+    GpuBuffer m_bufferArgmax;
     GpuBuffer m_bufferInputDelta;
     ShaderHandle m_evalForwardShader;
     ShaderHandle m_trainForwardShader;
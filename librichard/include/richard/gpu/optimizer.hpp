@@ -0,0 +1,45 @@
+#pragma once
+
+#include "richard/optimizer.hpp"
+#include "richard/gpu/gpu.hpp"
+
+namespace richard {
+namespace gpu {
+
+// Push constants of the update params shaders
+struct OptimizerConstants {
+  // Multiplies the decayed learn rate. Only differs from 1 for Adam's bias correction.
+  netfloat_t learnRateScale;
+  netfloat_t epsilon;
+};
+
+// Optimizer state for one parameter array, held in GPU buffers during training and copied back
+// with the parameters
+class Optimizer {
+  public:
+    Optimizer();
+    Optimizer(const OptimizerParams& params, size_t size);
+
+    const OptimizerParams& params() const;
+
+    void allocateGpuBuffers(Gpu& gpu);
+    // Buffers the optimizer doesn't use hold a single unused element
+    GpuBufferHandle firstMomentBuffer() const;
+    GpuBufferHandle secondMomentBuffer() const;
+    void retrieveBuffers(Gpu& gpu);
+
+    // Call once per parameter update
+    OptimizerConstants nextStep();
+
+    void read(std::istream& stream);
+    void write(std::ostream& stream) const;
+
+  private:
+    OptimizerParams m_params;
+    OptimizerState m_state;
+    GpuBuffer m_bufferFirst;
+    GpuBuffer m_bufferSecond;
+};
+
+}
+}
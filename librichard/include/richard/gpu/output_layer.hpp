@@ -3,6 +3,8 @@
 #include "richard/math.hpp"
 #include "richard/gpu/layer.hpp"
 #include "richard/gpu/gpu.hpp"
+#include "richard/gpu/optimizer.hpp"
+#include "richard/neural_net.hpp"
 
 namespace richard {
 
@@ -35,6 +37,7 @@ class OutputLayer : public Layer {
     void updateParams() override;
     void writeToStream(std::ostream& stream) const override;
     const Vector& activations() const;
+    CostType costType() const;
 
     // Exposed for testing
     //
@@ -53,12 +56,16 @@ class OutputLayer : public Layer {
       GpuBufferHandle sampleYBuffer);
     void createBackpropInputDeltaShader();
     void createUpdateParamsShader(GpuBufferHandle statusBuffer);
+    void createSoftmaxShader();
 
     Gpu& m_gpu;
     FileSystem& m_fileSystem;
     const PlatformPaths& m_platformPaths;
     netfloat_t m_learnRate;
     netfloat_t m_learnRateDecay;
+    CostType m_costType;
+    Optimizer m_optimizerB;
+    Optimizer m_optimizerW;
     size_t m_inputSize;
     size_t m_size;
     Vector m_B;
@@ -77,6 +84,8 @@ class OutputLayer : public Layer {
     ShaderHandle m_backpropDeltaShader;
     ShaderHandle m_backpropInputDeltaShader;
     ShaderHandle m_updateParamsShader;
+    // Only used for cross-entropy
+    ShaderHandle m_softmaxShader;
 };
 
 }
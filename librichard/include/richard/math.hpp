@@ -6,19 +6,36 @@
 #include <initializer_list>
 #include <stdexcept>
 #include <functional>
+#include <type_traits>
 
 namespace richard {
 
+class ThreadPool;
+
+namespace expr {
+
+template<class T, class E>
+class Expression;
+
+}
+
+// Passed to constructors to skip zero-initialisation when every element is about to be overwritten
+struct Uninitialised {};
+
+// 64-byte aligned storage from the pool in allocator.hpp
 class DataArray {
   public:
     DataArray();
     explicit DataArray(size_t size);
+    DataArray(size_t size, Uninitialised);
 
     DataArray(const DataArray& cpy);
     DataArray(DataArray&& mv);
     DataArray& operator=(const DataArray& cpy);
     DataArray& operator=(DataArray&& mv);
 
+    ~DataArray();
+
     inline netfloat_t* data();
     inline const netfloat_t* data() const;
 
@@ -32,16 +49,16 @@ class DataArray {
     friend std::ostream& operator<<(std::ostream& os, const DataArray& v);
 
   private:
-    std::unique_ptr<netfloat_t[]> m_data;
+    netfloat_t* m_data;
     size_t m_size;
 };
 
 netfloat_t* DataArray::data() {
-  return m_data.get();
+  return m_data;
 }
 
 const netfloat_t* DataArray::data() const {
-  return m_data.get();
+  return m_data;
 }
 
 size_t DataArray::size() const {
@@ -49,11 +66,11 @@ size_t DataArray::size() const {
 }
 
 netfloat_t& DataArray::operator[](size_t i) {
-  return m_data.get()[i];
+  return m_data[i];
 }
 
 const netfloat_t& DataArray::operator[](size_t i) const {
-  return m_data.get()[i];
+  return m_data[i];
 }
 
 class Vector;
@@ -68,10 +85,13 @@ class Vector {
     explicit Vector();
     explicit Vector(std::initializer_list<netfloat_t> data);
     explicit Vector(size_t length);
+    Vector(size_t length, Uninitialised);
     Vector(const DataArray& data);
     Vector(DataArray&& data);
     Vector(const Vector& cpy);
     Vector(Vector&& mv);
+    template<class E>
+    Vector(const expr::Expression<Vector, E>& e);
 
     inline bool isShallow() const;
     inline const DataArray& storage() const;
@@ -82,6 +102,8 @@ class Vector {
 
     Vector& operator=(const Vector& rhs);
     Vector& operator=(Vector&& rhs);
+    template<class E>
+    Vector& operator=(const expr::Expression<Vector, E>& e);
 
     inline netfloat_t& operator[](size_t i);
     inline const netfloat_t& operator[](size_t i) const;
@@ -101,26 +123,24 @@ class Vector {
     netfloat_t squareMagnitude() const;
     netfloat_t dot(const Vector& rhs) const;
 
-    Vector operator+(const Vector& rhs) const;
-    Vector operator-(const Vector& rhs) const;
     Vector hadamard(const Vector& rhs) const;
-    Vector operator/(const Vector& rhs) const;
-
-    Vector operator+(netfloat_t x) const;
-    Vector operator-(netfloat_t x) const;
-    Vector operator*(netfloat_t x) const;
-    Vector operator/(netfloat_t x) const;
 
     Vector& operator+=(const Vector& rhs);
     Vector& operator-=(const Vector& rhs);
+    template<class E>
+    Vector& operator+=(const expr::Expression<Vector, E>& e);
+    template<class E>
+    Vector& operator-=(const expr::Expression<Vector, E>& e);
 
     Vector& operator+=(netfloat_t x);
     Vector& operator-=(netfloat_t x);
     Vector& operator*=(netfloat_t x);
     Vector& operator/=(netfloat_t x);
 
-    Vector computeTransform(const std::function<netfloat_t(netfloat_t)>& f) const;
-    void transformInPlace(const std::function<netfloat_t(netfloat_t)>& f);
+    template<class F>
+    Vector computeTransform(F f) const;
+    template<class F>
+    void transformInPlace(F f);
 
     // Returns shallow Vector
     inline VectorPtr subvector(size_t from, size_t size);
@@ -133,6 +153,10 @@ class Vector {
 
     friend std::ostream& operator<<(std::ostream& os, const Vector& v);
 
+    // Shallow views are created all over the hot paths, so objects come from the pooled allocator
+    static void* operator new(size_t bytes);
+    static void operator delete(void* ptr, size_t bytes);
+
   private:
     // Creates a shallow Vector
     Vector(netfloat_t* data, size_t size);
@@ -200,10 +224,13 @@ class Matrix {
     explicit Matrix();
     explicit Matrix(std::initializer_list<std::initializer_list<netfloat_t>> data);
     explicit Matrix(size_t cols, size_t rows);
+    Matrix(size_t cols, size_t rows, Uninitialised);
     Matrix(const DataArray& data, size_t cols, size_t rows);
     Matrix(DataArray&& data, size_t cols, size_t rows);
     Matrix(const Matrix& cpy);
     Matrix(Matrix&& mv);
+    template<class E>
+    Matrix(const expr::Expression<Matrix, E>& e);
 
     inline bool isShallow() const;
     inline const DataArray& storage() const;
@@ -224,16 +251,11 @@ class Matrix {
 
     Matrix& operator=(const Matrix& rhs);
     Matrix& operator=(Matrix&& rhs);
+    template<class E>
+    Matrix& operator=(const expr::Expression<Matrix, E>& e);
 
     Vector operator*(const Vector& rhs) const;
-
-    Matrix operator+(const Matrix& rhs) const;
-    Matrix operator-(const Matrix& rhs) const;
-
-    Matrix operator+(netfloat_t x) const;
-    Matrix operator-(netfloat_t x) const;
-    Matrix operator*(netfloat_t x) const;
-    Matrix operator/(netfloat_t x) const;
+    Matrix operator*(const Matrix& rhs) const;
 
     Matrix& operator+=(netfloat_t x);
     Matrix& operator-=(netfloat_t x);
@@ -242,6 +264,10 @@ class Matrix {
 
     Matrix& operator+=(const Matrix& rhs);
     Matrix& operator-=(const Matrix& rhs);
+    template<class E>
+    Matrix& operator+=(const expr::Expression<Matrix, E>& e);
+    template<class E>
+    Matrix& operator-=(const expr::Expression<Matrix, E>& e);
 
     Matrix hadamard(const Matrix& rhs) const;
 
@@ -254,8 +280,10 @@ class Matrix {
     netfloat_t sum() const;
     Matrix transpose() const;
 
-    Matrix computeTransform(const std::function<netfloat_t(netfloat_t)>& f) const;
-    void transformInPlace(const std::function<netfloat_t(netfloat_t)>& f);
+    template<class F>
+    Matrix computeTransform(F f) const;
+    template<class F>
+    void transformInPlace(F f);
 
     // Returns shallow Vector
     inline VectorPtr slice(size_t row);
@@ -271,6 +299,10 @@ class Matrix {
 
     friend std::ostream& operator<<(std::ostream& os, const Matrix& m);
 
+    // See Vector
+    static void* operator new(size_t bytes);
+    static void operator delete(void* ptr, size_t bytes);
+
   private:
     // Creates a shallow Matrix
     Matrix(netfloat_t* data, size_t cols, size_t rows);
@@ -357,6 +389,8 @@ class Kernel {
       std::initializer_list<std::initializer_list<std::initializer_list<netfloat_t>>> data);
     explicit Kernel(size_t W, size_t H, size_t D);
     explicit Kernel(const Size3& shape);
+    Kernel(size_t W, size_t H, size_t D, Uninitialised);
+    Kernel(const Size3& shape, Uninitialised);
     Kernel(const DataArray& data, size_t W, size_t H, size_t D);
     Kernel(const DataArray& data, const Size3& shape);
     Kernel(DataArray& data, size_t W, size_t H, size_t D);
@@ -365,6 +399,8 @@ class Kernel {
     Kernel(DataArray&& data, const Size3& shape);
     Kernel(const Kernel& cpy);
     Kernel(Kernel&& mv);
+    template<class E>
+    Kernel(const expr::Expression<Kernel, E>& e);
 
     inline void setData(DataArray&& data);
 
@@ -387,6 +423,8 @@ class Kernel {
 
     Kernel& operator=(const Kernel& rhs);
     Kernel& operator=(Kernel&& rhs);
+    template<class E>
+    Kernel& operator=(const expr::Expression<Kernel, E>& e);
 
     void zero();
     void fill(netfloat_t x);
@@ -394,14 +432,6 @@ class Kernel {
 
     Kernel hadamard(const Kernel& rhs) const;
 
-    Kernel operator+(const Kernel& rhs) const;
-    Kernel operator-(const Kernel& rhs) const;
-
-    Kernel operator+(netfloat_t x) const;
-    Kernel operator-(netfloat_t x) const;
-    Kernel operator*(netfloat_t x) const;
-    Kernel operator/(netfloat_t x) const;
-
     Kernel& operator+=(netfloat_t x);
     Kernel& operator-=(netfloat_t x);
     Kernel& operator*=(netfloat_t x);
@@ -409,9 +439,15 @@ class Kernel {
 
     Kernel& operator+=(const Kernel& rhs);
     Kernel& operator-=(const Kernel& rhs);
+    template<class E>
+    Kernel& operator+=(const expr::Expression<Kernel, E>& e);
+    template<class E>
+    Kernel& operator-=(const expr::Expression<Kernel, E>& e);
 
-    Kernel computeTransform(const std::function<netfloat_t(netfloat_t)>& f) const;
-    void transformInPlace(const std::function<netfloat_t(netfloat_t)>& f);
+    template<class F>
+    Kernel computeTransform(F f) const;
+    template<class F>
+    void transformInPlace(F f);
 
     inline MatrixPtr slice(size_t z);
     inline ConstMatrixPtr slice(size_t z) const;
@@ -430,6 +466,10 @@ class Kernel {
 
     friend std::ostream& operator<<(std::ostream& os, const Kernel& k);
 
+    // See Vector
+    static void* operator new(size_t bytes);
+    static void operator delete(void* ptr, size_t bytes);
+
   private:
     // Creates a shallow Kernel
     Kernel(netfloat_t* data, size_t W, size_t H, size_t D);
@@ -526,8 +566,398 @@ bool Kernel::operator!=(const Kernel& rhs) const {
   return !(*this == rhs);
 }
 
+// Element-wise arithmetic on Vectors, Matrices and Kernels builds lazy expressions. Nothing is
+// computed until the expression is assigned to (or used to construct) a container, at which point
+// the whole expression is evaluated in a single pass with no temporaries. Because every operation
+// is element-wise, an expression may safely be assigned to one of its own operands.
+namespace expr {
+
+template<class X>
+struct IsContainer : std::false_type {};
+
+template<> struct IsContainer<Vector> : std::true_type {};
+template<> struct IsContainer<Matrix> : std::true_type {};
+template<> struct IsContainer<Kernel> : std::true_type {};
+
+struct ExpressionBase {};
+
+template<class X>
+constexpr bool isOperand = IsContainer<std::decay_t<X>>::value
+  || std::is_base_of_v<ExpressionBase, std::decay_t<X>>;
+
+template<class X, class = void>
+struct ResultOf {
+  using type = std::decay_t<X>;
+};
+
+template<class X>
+struct ResultOf<X, std::enable_if_t<std::is_base_of_v<ExpressionBase, std::decay_t<X>>>> {
+  using type = typename std::decay_t<X>::ResultType;
+};
+
+template<class X>
+using ResultOf_t = typename ResultOf<X>::type;
+
+// Containers passed as lvalues are held by reference. Temporaries, such as the result of a
+// matrix-vector product, are moved into the expression so it remains valid when stored in an auto.
+template<class X>
+using Operand = std::conditional_t<IsContainer<std::decay_t<X>>::value
+  && std::is_lvalue_reference_v<X>, const std::decay_t<X>&, std::decay_t<X>>;
+
+inline Size3 shapeOf(const Vector& v) {
+  return { v.size(), 1, 1 };
+}
+
+inline Size3 shapeOf(const Matrix& m) {
+  return { m.cols(), m.rows(), 1 };
+}
+
+inline Size3 shapeOf(const Kernel& k) {
+  return k.shape();
+}
+
+template<class E>
+Size3 shapeOf(const E& e) {
+  return e.shape();
+}
+
+template<class X>
+netfloat_t element(const X& x, size_t i) {
+  if constexpr (IsContainer<X>::value) {
+    return x.data()[i];
+  }
+  else {
+    return x[i];
+  }
+}
+
+struct Add {
+  static netfloat_t apply(netfloat_t a, netfloat_t b) { return a + b; }
+};
+
+struct Subtract {
+  static netfloat_t apply(netfloat_t a, netfloat_t b) { return a - b; }
+};
+
+struct Multiply {
+  static netfloat_t apply(netfloat_t a, netfloat_t b) { return a * b; }
+};
+
+struct Divide {
+  static netfloat_t apply(netfloat_t a, netfloat_t b) { return a / b; }
+};
+
+template<class T, class E>
+class Expression : public ExpressionBase {
+  public:
+    using ResultType = T;
+
+    netfloat_t operator[](size_t i) const {
+      return static_cast<const E&>(*this).at(i);
+    }
+
+    Size3 shape() const {
+      return static_cast<const E&>(*this).shapeSource();
+    }
+
+    size_t size() const {
+      Size3 s = shape();
+      return s[0] * s[1] * s[2];
+    }
+
+    netfloat_t sum() const {
+      netfloat_t total = 0.0;
+      const size_t n = size();
+      for (size_t i = 0; i < n; ++i) {
+        total += (*this)[i];
+      }
+      return total;
+    }
+
+    netfloat_t squareMagnitude() const {
+      netfloat_t total = 0.0;
+      const size_t n = size();
+      for (size_t i = 0; i < n; ++i) {
+        netfloat_t x = (*this)[i];
+        total += x * x;
+      }
+      return total;
+    }
+
+    void evaluateInto(netfloat_t* result) const {
+      const size_t n = size();
+      for (size_t i = 0; i < n; ++i) {
+        result[i] = (*this)[i];
+      }
+    }
+};
+
+template<class T, class Op, class L, class R>
+class BinaryExpression : public Expression<T, BinaryExpression<T, Op, L, R>> {
+  public:
+    template<class A, class B>
+    BinaryExpression(A&& lhs, B&& rhs)
+      : m_lhs(std::forward<A>(lhs))
+      , m_rhs(std::forward<B>(rhs)) {
+
+      DBG_ASSERT(shapeOf(m_lhs) == shapeOf(m_rhs));
+    }
+
+    netfloat_t at(size_t i) const {
+      return Op::apply(element(m_lhs, i), element(m_rhs, i));
+    }
+
+    Size3 shapeSource() const {
+      return shapeOf(m_lhs);
+    }
+
+  private:
+    L m_lhs;
+    R m_rhs;
+};
+
+template<class T, class Op, class L>
+class ScalarExpression : public Expression<T, ScalarExpression<T, Op, L>> {
+  public:
+    template<class A>
+    ScalarExpression(A&& lhs, netfloat_t x)
+      : m_lhs(std::forward<A>(lhs))
+      , m_x(x) {}
+
+    netfloat_t at(size_t i) const {
+      return Op::apply(element(m_lhs, i), m_x);
+    }
+
+    Size3 shapeSource() const {
+      return shapeOf(m_lhs);
+    }
+
+  private:
+    L m_lhs;
+    netfloat_t m_x;
+};
+
+template<class Op, class L, class R>
+using BinaryExpressionOf = BinaryExpression<ResultOf_t<L>, Op, Operand<L>, Operand<R>>;
+
+template<class Op, class L>
+using ScalarExpressionOf = ScalarExpression<ResultOf_t<L>, Op, Operand<L>>;
+
+template<class L, class R>
+using EnableIfCompatible = std::enable_if_t<isOperand<L> && isOperand<R>
+  && std::is_same_v<ResultOf_t<L>, ResultOf_t<R>>>;
+
+template<class L>
+using EnableIfOperand = std::enable_if_t<isOperand<L>>;
+
+}
+
+template<class L, class R, class = expr::EnableIfCompatible<L, R>>
+expr::BinaryExpressionOf<expr::Add, L, R> operator+(L&& lhs, R&& rhs) {
+  return { std::forward<L>(lhs), std::forward<R>(rhs) };
+}
+
+template<class L, class R, class = expr::EnableIfCompatible<L, R>>
+expr::BinaryExpressionOf<expr::Subtract, L, R> operator-(L&& lhs, R&& rhs) {
+  return { std::forward<L>(lhs), std::forward<R>(rhs) };
+}
+
+template<class L, class = expr::EnableIfOperand<L>>
+expr::ScalarExpressionOf<expr::Add, L> operator+(L&& lhs, netfloat_t x) {
+  return { std::forward<L>(lhs), x };
+}
+
+template<class L, class = expr::EnableIfOperand<L>>
+expr::ScalarExpressionOf<expr::Subtract, L> operator-(L&& lhs, netfloat_t x) {
+  return { std::forward<L>(lhs), x };
+}
+
+template<class L, class = expr::EnableIfOperand<L>>
+expr::ScalarExpressionOf<expr::Multiply, L> operator*(L&& lhs, netfloat_t x) {
+  return { std::forward<L>(lhs), x };
+}
+
+template<class L, class = expr::EnableIfOperand<L>>
+expr::ScalarExpressionOf<expr::Divide, L> operator/(L&& lhs, netfloat_t x) {
+  return { std::forward<L>(lhs), x };
+}
+
+template<class E>
+Vector::Vector(const expr::Expression<Vector, E>& e)
+  : Vector(e.size(), Uninitialised{}) {
+
+  e.evaluateInto(m_data);
+}
+
+template<class E>
+Vector& Vector::operator=(const expr::Expression<Vector, E>& e) {
+  if (e.size() == m_size) {
+    e.evaluateInto(m_data);
+  }
+  else {
+    DBG_ASSERT(!isShallow());
+    *this = Vector(e);
+  }
+
+  return *this;
+}
+
+template<class E>
+Vector& Vector::operator+=(const expr::Expression<Vector, E>& e) {
+  DBG_ASSERT(e.size() == m_size);
+
+  for (size_t i = 0; i < m_size; ++i) {
+    m_data[i] += e[i];
+  }
+  return *this;
+}
+
+template<class E>
+Vector& Vector::operator-=(const expr::Expression<Vector, E>& e) {
+  DBG_ASSERT(e.size() == m_size);
+
+  for (size_t i = 0; i < m_size; ++i) {
+    m_data[i] -= e[i];
+  }
+  return *this;
+}
+
+template<class E>
+Matrix::Matrix(const expr::Expression<Matrix, E>& e)
+  : Matrix(e.shape()[0], e.shape()[1], Uninitialised{}) {
+
+  e.evaluateInto(m_data);
+}
+
+template<class E>
+Matrix& Matrix::operator=(const expr::Expression<Matrix, E>& e) {
+  if (e.shape() == expr::shapeOf(*this)) {
+    e.evaluateInto(m_data);
+  }
+  else {
+    DBG_ASSERT(!isShallow());
+    *this = Matrix(e);
+  }
+
+  return *this;
+}
+
+template<class E>
+Matrix& Matrix::operator+=(const expr::Expression<Matrix, E>& e) {
+  DBG_ASSERT(e.shape() == expr::shapeOf(*this));
+
+  for (size_t i = 0; i < size(); ++i) {
+    m_data[i] += e[i];
+  }
+  return *this;
+}
+
+template<class E>
+Matrix& Matrix::operator-=(const expr::Expression<Matrix, E>& e) {
+  DBG_ASSERT(e.shape() == expr::shapeOf(*this));
+
+  for (size_t i = 0; i < size(); ++i) {
+    m_data[i] -= e[i];
+  }
+  return *this;
+}
+
+template<class E>
+Kernel::Kernel(const expr::Expression<Kernel, E>& e)
+  : Kernel(e.shape(), Uninitialised{}) {
+
+  e.evaluateInto(m_data);
+}
+
+template<class E>
+Kernel& Kernel::operator=(const expr::Expression<Kernel, E>& e) {
+  if (e.shape() == shape()) {
+    e.evaluateInto(m_data);
+  }
+  else {
+    DBG_ASSERT(!isShallow());
+    *this = Kernel(e);
+  }
+
+  return *this;
+}
+
+template<class E>
+Kernel& Kernel::operator+=(const expr::Expression<Kernel, E>& e) {
+  DBG_ASSERT(e.shape() == shape());
+
+  for (size_t i = 0; i < size(); ++i) {
+    m_data[i] += e[i];
+  }
+  return *this;
+}
+
+template<class E>
+Kernel& Kernel::operator-=(const expr::Expression<Kernel, E>& e) {
+  DBG_ASSERT(e.shape() == shape());
+
+  for (size_t i = 0; i < size(); ++i) {
+    m_data[i] -= e[i];
+  }
+  return *this;
+}
+
+template<class F>
+Vector Vector::computeTransform(F f) const {
+  Vector result(*this);
+  result.transformInPlace(f);
+  return result;
+}
+
+template<class F>
+void Vector::transformInPlace(F f) {
+  const size_t n = size();
+  for (size_t i = 0; i < n; ++i) {
+    m_data[i] = f(m_data[i]);
+  }
+}
+
+template<class F>
+Matrix Matrix::computeTransform(F f) const {
+  Matrix result(*this);
+  result.transformInPlace(f);
+  return result;
+}
+
+template<class F>
+void Matrix::transformInPlace(F f) {
+  const size_t n = size();
+  for (size_t i = 0; i < n; ++i) {
+    m_data[i] = f(m_data[i]);
+  }
+}
+
+template<class F>
+Kernel Kernel::computeTransform(F f) const {
+  Kernel result(*this);
+  result.transformInPlace(f);
+  return result;
+}
+
+template<class F>
+void Kernel::transformInPlace(F f) {
+  const size_t n = size();
+  for (size_t i = 0; i < n; ++i) {
+    m_data[i] = f(m_data[i]);
+  }
+}
+
+// The kernel is moved stride pixels at a time, so result is (image - kernel) / stride + 1 wide.
+// 1x1, 3x3 and 5x5 kernels use implementations specialised for their size.
 void computeCrossCorrelation(const Array3& image, const Kernel& kernel, Array2& result,
-  bool flipKernel = false);
+  bool flipKernel = false, size_t stride = 1);
+// Exposed for testing. As above, but always with the loop that handles any kernel size.
+void test_computeCrossCorrelationGeneric(const Array3& image, const Kernel& kernel,
+  Array2& result, bool flipKernel = false, size_t stride = 1);
+// As above without flipping, on raw buffers, so there are no Array3, Kernel or Array2 objects to
+// allocate. The kernel has imageShape[2] channels of kernelW * kernelH.
+void computeCrossCorrelation(const netfloat_t* image, const Size3& imageShape,
+  const netfloat_t* kernel, size_t kernelW, size_t kernelH, netfloat_t* result, size_t stride = 1);
 
 void computeFullCrossCorrelation(const Array3& image, const Kernel& kernel, Array2& result,
   bool flipKernel = false);
@@ -566,4 +996,75 @@ inline void computeFullConvolution(const Array2& image, const Matrix& kernel, Ar
 
 Matrix outerProduct(const Vector& A, const Vector& B);
 
+// result += scale * A * B^T without forming the outer product. Given a pool, rows of result are
+// split across its threads.
+void accumulateOuterProduct(const Vector& A, const Vector& B, Matrix& result,
+  netfloat_t scale = 1.0, ThreadPool* pool = nullptr);
+
+// Memory orders for a W x H x D array. Array3 and Kernel are always nchw, which is planar: element
+// (x, y, z) is at z * W * H + y * W + x. In nhwc the channels of each pixel are contiguous, at
+// (y * W + x) * D + z. The blocked layouts split the channels into groups of 8 or 16, each stored
+// nhwc, with the last group padded with zeros.
+enum class Layout {
+  nchw,
+  nhwc,
+  nchw8c,
+  nchw16c
+};
+
+// The number of contiguous channels per pixel. For nhwc this is the whole depth.
+inline size_t layoutBlockSize(Layout layout, size_t D) {
+  switch (layout) {
+    case Layout::nchw: return 1;
+    case Layout::nhwc: return D;
+    case Layout::nchw8c: return 8;
+    case Layout::nchw16c: return 16;
+  }
+  return 1;
+}
+
+// The number of elements, including any padding channels
+inline size_t layoutSize(Layout layout, const Size3& shape) {
+  const size_t block = layoutBlockSize(layout, shape[2]);
+  return shape[0] * shape[1] * ((shape[2] + block - 1) / block) * block;
+}
+
+inline size_t layoutIndex(Layout layout, const Size3& shape, size_t x, size_t y, size_t z) {
+  const size_t block = layoutBlockSize(layout, shape[2]);
+  return ((z / block * shape[1] + y) * shape[0] + x) * block + z % block;
+}
+
+// Copies a W x H x D array between layouts. Any padding channels in dst are zeroed.
+void reorder(const netfloat_t* src, Layout srcLayout, netfloat_t* dst, Layout dstLayout,
+  const Size3& shape);
+
+// Lowers image to a matrix with one column per output position of a kernelW x kernelH
+// cross-correlation. Rows are ordered like the elements of a Kernel, so a cross-correlation becomes
+// a product of the flattened kernel with this matrix. The image is read as if surrounded by
+// padding zeros, with the kernel moved stride pixels at a time.
+void im2col(const Array3& image, size_t kernelW, size_t kernelH, Matrix& columns,
+  size_t stride = 1, size_t padding = 0);
+// As above for batchSize images stored one after another. The columns for image n start at column
+// n * fmW * fmH.
+void im2col(const netfloat_t* images, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, Matrix& columns, size_t stride = 1, size_t padding = 0);
+// As above, writing the kernelW * kernelH * imageShape[2] rows of columns to a raw buffer
+void im2col(const netfloat_t* images, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, netfloat_t* columns, size_t stride = 1, size_t padding = 0);
+// The adjoint of im2col. Overwrites batchSize images with the sums of the column entries that
+// im2col would have copied from each pixel. Entries that came from the padding are dropped.
+void col2im(const Matrix& columns, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, netfloat_t* images, size_t stride = 1, size_t padding = 0);
+
+// Computes op(A) * op(B), where op(X) is X or its transpose, either overwriting or accumulating
+// into result. Given a pool, large products are split across its threads.
+void computeMatrixProduct(const Matrix& A, const Matrix& B, Matrix& result,
+  bool transposeA = false, bool transposeB = false, bool accumulate = false,
+  ThreadPool* pool = nullptr);
+// As above on raw buffers, so there are no Matrix objects to allocate. op(A) is M x K, op(B) is
+// K x N and result is M x N, all stored row by row.
+void computeMatrixProduct(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t M,
+  size_t K, size_t N, bool transposeA = false, bool transposeB = false, bool accumulate = false,
+  ThreadPool* pool = nullptr);
+
 }
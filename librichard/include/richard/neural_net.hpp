@@ -4,12 +4,34 @@
 #include "richard/types.hpp"
 #include "richard/event_system.hpp"
 #include <vector>
+#include <string>
 
 namespace richard {
 
 class Config;
 class LabelledDataSet;
 
+enum class TrainingMode {
+  // Each mini-batch is split across the worker threads and its gradients are combined before the
+  // parameters are updated
+  synchronous,
+  // Worker threads take mini-batches from a shared queue and update the shared parameters as soon
+  // as they're done, without waiting for each other. Gradients may be computed from stale weights.
+  hogwild
+};
+
+// Set by the output layer's "cost" key
+enum class CostType {
+  // Sigmoid activations and half the squared error
+  quadratic,
+  // Softmax activations and the cross-entropy of the expected class. The gradient of the cost
+  // with respect to the weighted inputs is just the activations minus the expected outputs, so it
+  // doesn't vanish when the sigmoid saturates.
+  crossEntropy
+};
+
+CostType parseCostType(const std::string& name);
+
 struct Hyperparams {
   Hyperparams();
   explicit Hyperparams(const Config& obj);
@@ -17,6 +39,13 @@ struct Hyperparams {
   uint32_t epochs;
   uint32_t batchSize;
   uint32_t miniBatchSize;
+  // Size of the CPU thread pool, including the calling thread. Training runs this many workers,
+  // and layers split their own loops across whichever threads are free. Testing evaluates this
+  // many samples at once.
+  uint32_t threads;
+  TrainingMode trainingMode;
+  // Keys the CPU layers' dropout masks, together with each layer's index and worker
+  uint32_t seed;
 
   static const Config& exampleConfig();
 };
@@ -70,6 +99,11 @@ class NeuralNet {
     virtual void writeToStream(std::ostream& stream) const = 0;
     virtual void train(LabelledDataSet& data) = 0;
     virtual Vector evaluate(const Array3& inputs) const = 0;
+    // Number of threads that may call evaluate at once
+    virtual size_t evaluationThreads() const = 0;
+    // Calls fn(i) for each i in [0, n), which may call evaluate. The calls are spread over the
+    // net's own threads, up to evaluationThreads() at once, so callers needn't start their own.
+    virtual void parallelEvaluate(size_t n, const std::function<void(size_t)>& fn) const = 0;
     virtual ModelDetails modelDetails() const = 0;
 
     // Called from another thread
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "richard/types.hpp"
+#include "richard/math.hpp"
+#include <iostream>
+#include <cstdint>
+
+namespace richard {
+
+class Config;
+
+enum class OptimizerType {
+  // w -= lr * g
+  sgd,
+  // v = beta1 * v + g, w -= lr * v
+  momentum,
+  // v = beta1 * v + g, w -= lr * (g + beta1 * v)
+  nesterov,
+  // s = beta2 * s + (1 - beta2) * g^2, w -= lr * g / (sqrt(s) + epsilon)
+  rmsProp,
+  // Bias-corrected first and second moment estimates, with decay rates beta1 and beta2
+  adam
+};
+
+OptimizerType parseOptimizerType(const std::string& name);
+const char* optimizerTypeName(OptimizerType type);
+
+// Read from a layer's optional "optimizer" object. Layers without one use plain SGD.
+struct OptimizerParams {
+  OptimizerParams();
+  explicit OptimizerParams(const Config& config);
+
+  OptimizerType type;
+  netfloat_t beta1;
+  netfloat_t beta2;
+  netfloat_t epsilon;
+
+  static const Config& exampleConfig();
+};
+
+// The running averages kept for one parameter array. Arrays the optimizer doesn't use are empty.
+struct OptimizerState {
+  OptimizerState();
+  OptimizerState(OptimizerType type, size_t size);
+
+  // Number of updates applied so far, for Adam's bias correction
+  uint32_t step;
+  // Velocity for momentum and Nesterov, first moment for Adam
+  DataArray first;
+  // Mean square gradient for RMSProp, second moment for Adam
+  DataArray second;
+
+  // Nothing is stored for SGD, so models trained without an optimizer keep their format
+  void read(std::istream& stream);
+  void write(std::ostream& stream) const;
+};
+
+// Adam's bias correction folded into the learn rate and epsilon for the given step, starting from 1
+void adamCorrection(const OptimizerParams& params, uint32_t step, netfloat_t& learnRateScale,
+  netfloat_t& epsilon);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "richard/types.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace richard {
+
+StorageType parseStorageType(const std::string& name);
+const char* storageTypeName(StorageType storageType);
+
+// Values held in one of the 16-bit storage formats. They're widened to netfloat_t when read.
+class PackedArray {
+  public:
+    PackedArray();
+    PackedArray(StorageType storageType, size_t size);
+
+    inline StorageType storageType() const;
+    inline size_t size() const;
+    inline const uint16_t* data() const;
+
+    // Rounds src to the storage format. src must hold size() values.
+    void pack(const netfloat_t* src);
+    void unpack(netfloat_t* dst) const;
+
+    void read(std::istream& stream);
+    void write(std::ostream& stream) const;
+
+  private:
+    StorageType m_storageType;
+    std::vector<uint16_t> m_data;
+};
+
+StorageType PackedArray::storageType() const {
+  return m_storageType;
+}
+
+size_t PackedArray::size() const {
+  return m_data.size();
+}
+
+const uint16_t* PackedArray::data() const {
+  return m_data.data();
+}
+
+}
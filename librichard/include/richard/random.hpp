@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace richard {
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"). Each output block is a pure function of a 128-bit counter and a 64-bit key, so independent
+// streams only need distinct keys and there is no shared state to lock.
+class Philox {
+  public:
+    using Block = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    explicit Philox(uint64_t key = 0, uint64_t counter = 0);
+
+    // Returns the block for the current counter and increments the counter
+    Block next();
+
+    static Block generate(Block counter, Key key);
+
+  private:
+    Key m_key;
+    uint64_t m_counter;
+};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "richard/types.hpp"
+#include <cstdint>
+
+// Vectorised kernels for the hot loops in math.cpp. The best implementation supported by the host
+// CPU is selected once at startup; a scalar fallback is always available.
+
+namespace richard {
+namespace simd {
+
+enum class InstructionSet {
+  scalar,
+  avx2,
+  avx512
+};
+
+InstructionSet instructionSet();
+const char* instructionSetName(InstructionSet instructionSet);
+bool isSupported(InstructionSet instructionSet);
+
+netfloat_t dot(const netfloat_t* A, const netfloat_t* B, size_t n);
+netfloat_t squareSum(const netfloat_t* A, size_t n);
+netfloat_t sum(const netfloat_t* A, size_t n);
+
+// result may alias either operand
+void add(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n);
+void subtract(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n);
+void multiply(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n);
+
+// Y += a * X
+void axpy(netfloat_t a, const netfloat_t* X, netfloat_t* Y, size_t n);
+
+// M is row-major with the given number of columns and rows. result must not alias V.
+void matrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows);
+void transposeMatrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows);
+
+// Conversions to and from the 16-bit storage formats, rounding to nearest even. F16C and AVX-512
+// BF16 instructions are used when the CPU has them.
+void floatToBf16(const netfloat_t* src, uint16_t* dst, size_t n);
+void bf16ToFloat(const uint16_t* src, netfloat_t* dst, size_t n);
+void floatToHalf(const netfloat_t* src, uint16_t* dst, size_t n);
+void halfToFloat(const uint16_t* src, netfloat_t* dst, size_t n);
+
+// As above, but M is held in a 16-bit storage format. Products are accumulated in fp32.
+void matrixVectorMultiply(const uint16_t* M, StorageType storageType, const netfloat_t* V,
+  netfloat_t* result, size_t cols, size_t rows);
+
+// Register tile computed by gemmMicroKernel. Depends on the selected instruction set.
+struct GemmTile {
+  size_t rows;
+  size_t cols;
+};
+
+GemmTile gemmTile();
+
+// Computes a tile of C from a packed panel of A (k columns of tile.rows values) and a packed panel
+// of B (k rows of tile.cols values). Only the top-left rows x cols of the tile is written, either
+// overwriting or accumulating into C.
+void gemmMicroKernel(size_t k, const netfloat_t* packedA, const netfloat_t* packedB, netfloat_t* C,
+  size_t ldc, size_t rows, size_t cols, bool accumulate);
+
+// Exposed for testing
+void test_setInstructionSet(InstructionSet instructionSet);
+
+}
+}
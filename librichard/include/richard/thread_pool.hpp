@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <cstdint>
+
+namespace richard {
+
+struct WorkerStats {
+  uint64_t tasksRun;
+  // Tasks taken from another thread's queue
+  uint64_t tasksStolen;
+  uint64_t busyNanoseconds;
+  uint64_t idleNanoseconds;
+};
+
+// A work-stealing pool. Each worker has its own task queue, taking tasks from the back and, when
+// it runs dry, stealing from the front of the other queues. Threads that wait on tasks run queued
+// tasks in the meantime, so tasks can wait on nested work without deadlocking, and no more than
+// numThreads() threads are ever busy, however deeply parallel sections are nested.
+class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+    // Including the thread that waits on the work
+    virtual size_t numThreads() const = 0;
+    // pending is incremented now and decremented once the task has run
+    virtual void submit(Task task, std::atomic<size_t>& pending) = 0;
+    // Runs queued tasks until pending reaches zero
+    virtual void wait(const std::atomic<size_t>& pending) = 0;
+    // One entry per background worker
+    virtual std::vector<WorkerStats> workerStats() const = 0;
+
+    virtual ~ThreadPool() {}
+};
+
+using ThreadPoolPtr = std::unique_ptr<ThreadPool>;
+
+// Spawns numThreads - 1 background workers
+ThreadPoolPtr createThreadPool(size_t numThreads);
+
+// Tasks that are waited on together. If any throw, wait rethrows the first exception.
+class TaskGroup {
+  public:
+    explicit TaskGroup(ThreadPool& pool);
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(ThreadPool::Task task);
+    void wait();
+
+    ~TaskGroup();
+
+  private:
+    ThreadPool& m_pool;
+    std::atomic<size_t> m_pending;
+    std::mutex m_mutex;
+    std::exception_ptr m_exception;
+};
+
+// Calls fn(i) for each i in [begin, end), split into chunks of at least grainSize indices, and
+// returns once every call has returned
+void parallelFor(ThreadPool& pool, size_t begin, size_t end,
+  const std::function<void(size_t)>& fn, size_t grainSize = 1);
+
+}
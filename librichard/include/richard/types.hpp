@@ -8,4 +8,11 @@ namespace richard {
 using netfloat_t = float;
 using Size3 = std::array<size_t, 3>;
 
+// Format in which parameters are held in memory. Arithmetic is always done in netfloat_t.
+enum class StorageType {
+  fp32,
+  bf16,
+  fp16
+};
+
 }
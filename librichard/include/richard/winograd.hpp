@@ -0,0 +1,67 @@
+#pragma once
+
+#include "richard/math.hpp"
+#include <vector>
+
+// Winograd F(2x2, 3x3) minimal filtering. Each 2x2 block of outputs is computed from a 4x4 input
+// tile with 16 multiplications instead of 36. The element-wise products are batched over all tiles
+// and all filters as 16 matrix products.
+
+namespace richard {
+
+// A set of 3x3xD kernels transformed into the 4x4 Winograd domain
+class WinogradFilters {
+  public:
+    WinogradFilters();
+    WinogradFilters(size_t numFilters, size_t depth);
+
+    inline size_t numFilters() const;
+    inline size_t depth() const;
+
+    void setKernel(size_t index, const Kernel& kernel);
+
+    // One numFilters x depth matrix for each of the 16 positions in a transformed tile
+    inline const netfloat_t* data() const;
+
+  private:
+    size_t m_numFilters;
+    size_t m_depth;
+    DataArray m_data;
+};
+
+size_t WinogradFilters::numFilters() const {
+  return m_numFilters;
+}
+
+size_t WinogradFilters::depth() const {
+  return m_depth;
+}
+
+const netfloat_t* WinogradFilters::data() const {
+  return m_data.data();
+}
+
+// The working memory computeWinogradCrossCorrelation needs for a resultW x resultH result
+size_t winogradScratchSize(size_t resultW, size_t resultH, size_t depth, size_t numFilters);
+
+// Slice f of result is the cross-correlation of image with kernel f. The optional pool is passed to
+// the matrix products, as are those of the functions below. scratch is either null or
+// winogradScratchSize elements for the transformed tiles, which are otherwise allocated.
+void computeWinogradCrossCorrelation(const Array3& image, const WinogradFilters& filters,
+  Array3& result, ThreadPool* pool = nullptr, netfloat_t* scratch = nullptr);
+// As above on raw buffers, so there are no Array3 or Matrix objects to allocate
+void computeWinogradCrossCorrelation(const netfloat_t* image, const Size3& imageShape,
+  const WinogradFilters& filters, netfloat_t* result, ThreadPool* pool = nullptr,
+  netfloat_t* scratch = nullptr);
+
+// Slice z of result is the sum over f of the full convolution of slice f of delta with slice z of
+// kernel f. This is the gradient of computeWinogradCrossCorrelation with respect to its input.
+void computeWinogradFullConvolution(const Array3& delta, const WinogradFilters& filters,
+  Array3& result, ThreadPool* pool = nullptr);
+
+// Slice z of gradients[f] is the cross-correlation of slice z of image with slice f of delta. This
+// is the gradient of computeWinogradCrossCorrelation with respect to kernel f.
+void computeWinogradKernelGradients(const Array3& image, const Array3& delta,
+  std::vector<Kernel>& gradients, ThreadPool* pool = nullptr);
+
+}
@@ -0,0 +1,140 @@
+#include "richard/allocator.hpp"
+#include <new>
+#include <array>
+#include <vector>
+
+namespace richard {
+namespace memory {
+namespace {
+
+// Size classes start at 64 bytes. Above that, each power of two is split into 4 classes, so at most
+// 25% of a block is wasted. Blocks larger than 32MB aren't pooled.
+const size_t MIN_CLASS_SHIFT = 6;
+const size_t MAX_CLASS_SHIFT = 25;
+const size_t SUBCLASSES = 4;
+const size_t NUM_SIZE_CLASSES = 1 + (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT) * SUBCLASSES;
+
+// Limits on how much freed memory each thread holds on to
+const size_t MAX_CACHED_PER_CLASS = 32;
+const size_t MAX_CACHED_BYTES = 64 * 1024 * 1024;
+
+struct SizeClass {
+  size_t index;
+  size_t bytes;
+};
+
+SizeClass sizeClass(size_t bytes) {
+  if (bytes <= (size_t(1) << MIN_CLASS_SHIFT)) {
+    return { 0, size_t(1) << MIN_CLASS_SHIFT };
+  }
+
+  // 2^shift < bytes <= 2^(shift + 1)
+  size_t shift = MIN_CLASS_SHIFT;
+  while ((size_t(1) << (shift + 1)) < bytes) {
+    ++shift;
+  }
+
+  if (shift >= MAX_CLASS_SHIFT) {
+    return { NUM_SIZE_CLASSES, ((bytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT };
+  }
+
+  size_t base = size_t(1) << shift;
+  size_t step = base / SUBCLASSES;
+  size_t k = (bytes - base + step - 1) / step;
+
+  return { 1 + (shift - MIN_CLASS_SHIFT) * SUBCLASSES + k - 1, base + k * step };
+}
+
+void* systemAllocate(size_t bytes) {
+  return ::operator new(bytes, std::align_val_t(ALIGNMENT));
+}
+
+void systemFree(void* ptr) {
+  ::operator delete(ptr, std::align_val_t(ALIGNMENT));
+}
+
+// Set once the calling thread's cache has been destroyed, after which blocks go straight to the
+// system allocator. Objects with static storage duration can be freed after this point.
+thread_local bool t_cacheDestroyed = false;
+
+struct ThreadCache {
+  std::array<std::vector<void*>, NUM_SIZE_CLASSES> freeLists;
+  size_t cachedBytes = 0;
+
+  ~ThreadCache() {
+    for (auto& freeList : freeLists) {
+      for (void* ptr : freeList) {
+        systemFree(ptr);
+      }
+    }
+    t_cacheDestroyed = true;
+  }
+};
+
+thread_local size_t t_allocationCount = 0;
+
+ThreadCache& threadCache() {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+}
+
+void* allocate(size_t bytes) {
+  if (bytes == 0) {
+    return nullptr;
+  }
+
+  ++t_allocationCount;
+
+  SizeClass sc = sizeClass(bytes);
+
+  if (sc.index < NUM_SIZE_CLASSES && !t_cacheDestroyed) {
+    ThreadCache& cache = threadCache();
+    auto& freeList = cache.freeLists[sc.index];
+
+    if (!freeList.empty()) {
+      void* ptr = freeList.back();
+      freeList.pop_back();
+      cache.cachedBytes -= sc.bytes;
+      return ptr;
+    }
+  }
+
+  return systemAllocate(sc.bytes);
+}
+
+void deallocate(void* ptr, size_t bytes) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  SizeClass sc = sizeClass(bytes);
+
+  if (sc.index < NUM_SIZE_CLASSES && !t_cacheDestroyed) {
+    ThreadCache& cache = threadCache();
+    auto& freeList = cache.freeLists[sc.index];
+
+    bool hasRoom = freeList.size() < MAX_CACHED_PER_CLASS
+      && cache.cachedBytes + sc.bytes <= MAX_CACHED_BYTES;
+
+    if (hasRoom) {
+      freeList.push_back(ptr);
+      cache.cachedBytes += sc.bytes;
+      return;
+    }
+  }
+
+  systemFree(ptr);
+}
+
+size_t test_sizeClassBytes(size_t bytes) {
+  return sizeClass(bytes).bytes;
+}
+
+size_t test_allocationCount() {
+  return t_allocationCount;
+}
+
+}
+}
@@ -89,6 +89,19 @@ Classifier::Results Classifier::test(LabelledDataSet& testData) const {
 
   [[maybe_unused]] size_t netInputSize = calcProduct(m_neuralNet->inputSize());
 
+  const size_t numShards = m_neuralNet->evaluationThreads();
+
+  // Totals for one contiguous shard of a batch
+  struct ShardResults {
+    size_t good = 0;
+    size_t bad = 0;
+    netfloat_t cost = 0.0;
+  };
+
+  std::vector<ShardResults> shardResults(numShards);
+  // Indexed by sample, as threads can't write to neighbouring elements of a std::vector<bool>
+  std::vector<uint8_t> guesses;
+
   auto pendingSamples = std::async([&]() { return testData.loadSamples(); });
   std::vector<Sample> samples = pendingSamples.get();
 
@@ -97,26 +110,47 @@ Classifier::Results Classifier::test(LabelledDataSet& testData) const {
   while (samples.size() > 0) {
     pendingSamples = std::async([&]() { return testData.loadSamples(); });
 
-    for (const auto& sample : samples) {
-      DBG_ASSERT_MSG(sample.data.size() == netInputSize,
-        "Expected sample of size " << netInputSize << ", got " << sample.data.size());
+    guesses.resize(samples.size());
 
-      Vector actual = m_neuralNet->evaluate(sample.data);
-      Vector expected = testData.classOutputVector(sample.label);
+    m_neuralNet->parallelEvaluate(numShards, [&](size_t shard) {
+      ShardResults& shardResult = shardResults[shard];
+      shardResult = ShardResults{};
 
-      if (outputsMatch(actual, expected)) {
-        ++results.good;
-        results.guesses.push_back(true);
-      }
-      else {
-        ++results.bad;
-        results.guesses.push_back(false);
+      size_t begin = samples.size() * shard / numShards;
+      size_t end = samples.size() * (shard + 1) / numShards;
+
+      for (size_t i = begin; i < end; ++i) {
+        const Sample& sample = samples[i];
+
+        DBG_ASSERT_MSG(sample.data.size() == netInputSize,
+          "Expected sample of size " << netInputSize << ", got " << sample.data.size());
+
+        Vector actual = m_neuralNet->evaluate(sample.data);
+        const Vector& expected = testData.classOutputVector(sample.label);
+
+        if (outputsMatch(actual, expected)) {
+          ++shardResult.good;
+          guesses[i] = true;
+        }
+        else {
+          ++shardResult.bad;
+          guesses[i] = false;
+        }
+
+        shardResult.cost += costFn(actual, expected);
       }
+    });
 
-      totalCost += costFn(actual, expected);
-      ++totalSamples;
+    // Merged in shard order, so the totals don't depend on which threads ran which shards
+    for (const ShardResults& shardResult : shardResults) {
+      results.good += shardResult.good;
+      results.bad += shardResult.bad;
+      totalCost += shardResult.cost;
     }
 
+    results.guesses.insert(results.guesses.end(), guesses.begin(), guesses.end());
+    totalSamples += samples.size();
+
     samples = pendingSamples.get();
   }
 
@@ -0,0 +1,387 @@
+#include "richard/cpu/batch_norm_layer.hpp"
+#include "richard/exception.hpp"
+#include "richard/utils.hpp"
+#include "richard/config.hpp"
+#include <cmath>
+
+namespace richard {
+namespace cpu {
+
+BatchNormLayer::BatchNormLayer(const Config& config, const Size3& inputShape) {
+  initialize(config, inputShape);
+}
+
+BatchNormLayer::BatchNormLayer(const Config& config, std::istream& stream,
+  const Size3& inputShape) {
+
+  initialize(config, inputShape);
+
+  stream.read(reinterpret_cast<char*>(m_gamma.data()), m_channels * sizeof(netfloat_t));
+  stream.read(reinterpret_cast<char*>(m_beta.data()), m_channels * sizeof(netfloat_t));
+  stream.read(reinterpret_cast<char*>(m_mean.data()), m_channels * sizeof(netfloat_t));
+  stream.read(reinterpret_cast<char*>(m_variance.data()), m_channels * sizeof(netfloat_t));
+
+  m_optimizerGamma.read(stream);
+  m_optimizerBeta.read(stream);
+}
+
+void BatchNormLayer::initialize(const Config& config, const Size3& inputShape) {
+  m_paramsOwner = nullptr;
+  m_inputShape = inputShape;
+
+  if (inputShape[1] == 1 && inputShape[2] == 1) {
+    m_channels = inputShape[0];
+    m_channelSize = 1;
+  }
+  else {
+    m_channels = inputShape[2];
+    m_channelSize = inputShape[0] * inputShape[1];
+  }
+
+  m_learnRate = config.getNumber<netfloat_t>("learnRate");
+  m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  m_momentum = config.contains("momentum") ? config.getNumber<netfloat_t>("momentum") : 0.9f;
+  m_epsilon = config.contains("epsilon") ? config.getNumber<netfloat_t>("epsilon") : 1e-5f;
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
+
+  ASSERT_MSG(m_momentum >= 0.0 && m_momentum < 1.0, "Momentum must be in [0, 1)");
+  ASSERT_MSG(m_epsilon > 0.0, "Epsilon must be positive");
+
+  m_gamma = Vector(m_channels);
+  m_gamma.fill(1.0);
+  m_beta = Vector(m_channels);
+  m_mean = Vector(m_channels);
+  m_variance = Vector(m_channels);
+  m_variance.fill(1.0);
+
+  m_invStd = Vector(m_channels);
+  m_deltaGamma = Vector(m_channels);
+  m_deltaBeta = Vector(m_channels);
+
+  const size_t inputSize = calcProduct(inputShape);
+  m_Xhat = Vector(inputSize);
+  m_Y = Vector(inputSize);
+  m_inputDelta = Vector(inputSize);
+
+  m_optimizerGamma = Optimizer(optimizer, m_channels);
+  m_optimizerBeta = Optimizer(optimizer, m_channels);
+}
+
+Size3 BatchNormLayer::outputSize() const {
+  return m_inputShape;
+}
+
+const DataArray& BatchNormLayer::activations() const {
+  return m_Y.storage();
+}
+
+const DataArray& BatchNormLayer::inputDelta() const {
+  return m_inputDelta.storage();
+}
+
+void BatchNormLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  sumInputs(inputs, batchSize, m_sums);
+  sumSquaredDeviations(inputs, batchSize, m_sums, batchSize, m_secondSums);
+  normalise(inputs, batchSize, m_sums, m_secondSums, batchSize);
+}
+
+void BatchNormLayer::sumInputs(const DataArray& inputs, size_t batchSize, Vector& sums) const {
+  const size_t inputSize = m_channels * m_channelSize;
+  DBG_ASSERT(inputs.size() == batchSize * inputSize);
+
+  if (sums.size() != m_channels) {
+    sums = Vector(m_channels, Uninitialised{});
+  }
+
+  parallelFor(0, m_channels, [&](size_t c) {
+    netfloat_t sum = 0.0;
+    for (size_t n = 0; n < batchSize; ++n) {
+      const netfloat_t* x = inputs.data() + n * inputSize + c * m_channelSize;
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        sum += x[i];
+      }
+    }
+    sums[c] = sum;
+  });
+}
+
+void BatchNormLayer::sumSquaredDeviations(const DataArray& inputs, size_t batchSize,
+  const Vector& sums, size_t totalBatchSize, Vector& squaredDeviations) const {
+
+  const size_t inputSize = m_channels * m_channelSize;
+  DBG_ASSERT(inputs.size() == batchSize * inputSize);
+  DBG_ASSERT(sums.size() == m_channels);
+
+  if (squaredDeviations.size() != m_channels) {
+    squaredDeviations = Vector(m_channels, Uninitialised{});
+  }
+
+  const netfloat_t m = static_cast<netfloat_t>(totalBatchSize * m_channelSize);
+
+  parallelFor(0, m_channels, [&](size_t c) {
+    const netfloat_t mean = sums[c] / m;
+
+    netfloat_t sumSq = 0.0;
+    for (size_t n = 0; n < batchSize; ++n) {
+      const netfloat_t* x = inputs.data() + n * inputSize + c * m_channelSize;
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        sumSq += (x[i] - mean) * (x[i] - mean);
+      }
+    }
+    squaredDeviations[c] = sumSq;
+  });
+}
+
+void BatchNormLayer::normalise(const DataArray& inputs, size_t batchSize, const Vector& sums,
+  const Vector& squaredDeviations, size_t totalBatchSize) {
+
+  const size_t inputSize = m_channels * m_channelSize;
+  DBG_ASSERT(inputs.size() == batchSize * inputSize);
+  DBG_ASSERT(sums.size() == m_channels);
+  DBG_ASSERT(squaredDeviations.size() == m_channels);
+
+  if (m_Y.size() != batchSize * inputSize) {
+    m_Xhat = Vector(batchSize * inputSize, Uninitialised{});
+    m_Y = Vector(batchSize * inputSize, Uninitialised{});
+  }
+
+  BatchNormLayer& params = owner();
+  const netfloat_t m = static_cast<netfloat_t>(totalBatchSize * m_channelSize);
+  // Unbiased estimate of the population variance for the running average
+  const netfloat_t bessel = m > 1 ? m / (m - 1) : 1.f;
+
+  parallelFor(0, m_channels, [&](size_t c) {
+    const netfloat_t mean = sums[c] / m;
+    const netfloat_t variance = squaredDeviations[c] / m;
+    const netfloat_t invStd = 1.f / std::sqrt(variance + m_epsilon);
+    const netfloat_t gamma = params.m_gamma[c];
+    const netfloat_t beta = params.m_beta[c];
+
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t offset = n * inputSize + c * m_channelSize;
+      const netfloat_t* x = inputs.data() + offset;
+      netfloat_t* xhat = m_Xhat.data() + offset;
+      netfloat_t* y = m_Y.data() + offset;
+
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        xhat[i] = (x[i] - mean) * invStd;
+        y[i] = gamma * xhat[i] + beta;
+      }
+    }
+
+    m_invStd[c] = invStd;
+    params.m_mean[c] = m_momentum * params.m_mean[c] + (1.f - m_momentum) * mean;
+    params.m_variance[c] = m_momentum * params.m_variance[c]
+      + (1.f - m_momentum) * variance * bessel;
+  });
+}
+
+DataArray BatchNormLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * calcProduct(m_inputShape));
+
+  DataArray Y(inputs.size(), Uninitialised{});
+  evalInto(inputs.data(), Y.data(), batchSize);
+
+  return Y;
+}
+
+void BatchNormLayer::evalInto(const netfloat_t* inputs, netfloat_t* outputs,
+  size_t batchSize, netfloat_t*) const {
+
+  const size_t inputSize = m_channels * m_channelSize;
+
+  for (size_t c = 0; c < m_channels; ++c) {
+    const netfloat_t scale = m_gamma[c] / std::sqrt(m_variance[c] + m_epsilon);
+    const netfloat_t shift = m_beta[c] - m_mean[c] * scale;
+
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t offset = n * inputSize + c * m_channelSize;
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        outputs[offset + i] = scale * inputs[offset + i] + shift;
+      }
+    }
+  }
+}
+
+void BatchNormLayer::inferenceTransform(DataArray& scale, DataArray& shift) const {
+  scale = DataArray(m_channels * m_channelSize, Uninitialised{});
+  shift = DataArray(m_channels * m_channelSize, Uninitialised{});
+
+  for (size_t c = 0; c < m_channels; ++c) {
+    const netfloat_t s = m_gamma[c] / std::sqrt(m_variance[c] + m_epsilon);
+    const netfloat_t t = m_beta[c] - m_mean[c] * s;
+
+    std::fill(scale.data() + c * m_channelSize, scale.data() + (c + 1) * m_channelSize, s);
+    std::fill(shift.data() + c * m_channelSize, shift.data() + (c + 1) * m_channelSize, t);
+  }
+}
+
+void BatchNormLayer::updateDeltas(const DataArray&, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  sumOutputDeltas(outputDelta, batchSize, m_sums, m_secondSums);
+  updateInputDelta(outputDelta, batchSize, m_sums, m_secondSums, batchSize);
+}
+
+void BatchNormLayer::sumOutputDeltas(const DataArray& outputDelta, size_t batchSize,
+  Vector& sumDy, Vector& sumDyXhat) {
+
+  const size_t inputSize = m_channels * m_channelSize;
+  DBG_ASSERT(outputDelta.size() == batchSize * inputSize);
+  DBG_ASSERT(m_Xhat.size() == batchSize * inputSize);
+
+  if (sumDy.size() != m_channels) {
+    sumDy = Vector(m_channels, Uninitialised{});
+  }
+  if (sumDyXhat.size() != m_channels) {
+    sumDyXhat = Vector(m_channels, Uninitialised{});
+  }
+
+  parallelFor(0, m_channels, [&](size_t c) {
+    netfloat_t dyTotal = 0.0;
+    netfloat_t dyXhatTotal = 0.0;
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t offset = n * inputSize + c * m_channelSize;
+      const netfloat_t* dy = outputDelta.data() + offset;
+      const netfloat_t* xhat = m_Xhat.data() + offset;
+
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        dyTotal += dy[i];
+        dyXhatTotal += dy[i] * xhat[i];
+      }
+    }
+
+    sumDy[c] = dyTotal;
+    sumDyXhat[c] = dyXhatTotal;
+    m_deltaBeta[c] += dyTotal;
+    m_deltaGamma[c] += dyXhatTotal;
+  });
+}
+
+void BatchNormLayer::updateInputDelta(const DataArray& outputDelta, size_t batchSize,
+  const Vector& sumDy, const Vector& sumDyXhat, size_t totalBatchSize) {
+
+  const size_t inputSize = m_channels * m_channelSize;
+  DBG_ASSERT(outputDelta.size() == batchSize * inputSize);
+  DBG_ASSERT(m_Xhat.size() == batchSize * inputSize);
+
+  if (m_inputDelta.size() != batchSize * inputSize) {
+    m_inputDelta = Vector(batchSize * inputSize, Uninitialised{});
+  }
+
+  const BatchNormLayer& params = owner();
+  const netfloat_t m = static_cast<netfloat_t>(totalBatchSize * m_channelSize);
+
+  parallelFor(0, m_channels, [&](size_t c) {
+    // The batch mean and variance depend on every input in the channel, which contributes the
+    // two correction terms
+    const netfloat_t k = params.m_gamma[c] * m_invStd[c] / m;
+
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t offset = n * inputSize + c * m_channelSize;
+      const netfloat_t* dy = outputDelta.data() + offset;
+      const netfloat_t* xhat = m_Xhat.data() + offset;
+      netfloat_t* dx = m_inputDelta.data() + offset;
+
+      for (size_t i = 0; i < m_channelSize; ++i) {
+        dx[i] = k * (m * dy[i] - sumDy[c] - xhat[i] * sumDyXhat[c]);
+      }
+    }
+  });
+}
+
+void BatchNormLayer::updateParams(size_t epoch) {
+  netfloat_t learnRate = m_learnRate * static_cast<netfloat_t>(pow(m_learnRateDecay, epoch));
+
+  BatchNormLayer& params = owner();
+
+  m_optimizerGamma.nextStep(learnRate);
+  m_optimizerGamma.update(params.m_gamma.data(), m_deltaGamma.data(), m_channels);
+
+  m_optimizerBeta.nextStep(learnRate);
+  m_optimizerBeta.update(params.m_beta.data(), m_deltaBeta.data(), m_channels);
+}
+
+void BatchNormLayer::writeToStream(std::ostream& stream) const {
+  stream.write(reinterpret_cast<const char*>(m_gamma.data()), m_channels * sizeof(netfloat_t));
+  stream.write(reinterpret_cast<const char*>(m_beta.data()), m_channels * sizeof(netfloat_t));
+  stream.write(reinterpret_cast<const char*>(m_mean.data()), m_channels * sizeof(netfloat_t));
+  stream.write(reinterpret_cast<const char*>(m_variance.data()), m_channels * sizeof(netfloat_t));
+
+  m_optimizerGamma.write(stream);
+  m_optimizerBeta.write(stream);
+}
+
+void BatchNormLayer::mergeDeltas(Layer& replica) {
+  auto& layer = dynamic_cast<BatchNormLayer&>(replica);
+
+  m_deltaGamma += layer.m_deltaGamma;
+  m_deltaBeta += layer.m_deltaBeta;
+
+  layer.m_deltaGamma.zero();
+  layer.m_deltaBeta.zero();
+}
+
+// The running statistics are copied too. In data-parallel training every replica normalises with
+// the statistics of the whole mini-batch, so they all make the same update to them.
+void BatchNormLayer::copyParams(const Layer& source) {
+  auto& layer = dynamic_cast<const BatchNormLayer&>(source);
+
+  m_gamma = layer.m_gamma;
+  m_beta = layer.m_beta;
+  m_mean = layer.m_mean;
+  m_variance = layer.m_variance;
+}
+
+void BatchNormLayer::shareParams(Layer& owner) {
+  m_paramsOwner = &dynamic_cast<BatchNormLayer&>(owner);
+}
+
+BatchNormLayer& BatchNormLayer::owner() {
+  return m_paramsOwner ? *m_paramsOwner : *this;
+}
+
+const BatchNormLayer& BatchNormLayer::owner() const {
+  return m_paramsOwner ? *m_paramsOwner : *this;
+}
+
+void BatchNormLayer::test_setGamma(const DataArray& gamma) {
+  m_gamma = gamma;
+}
+
+void BatchNormLayer::test_setBeta(const DataArray& beta) {
+  m_beta = beta;
+}
+
+void BatchNormLayer::test_setStatistics(const DataArray& mean, const DataArray& variance) {
+  m_mean = mean;
+  m_variance = variance;
+}
+
+const Vector& BatchNormLayer::test_gamma() const {
+  return m_gamma;
+}
+
+const Vector& BatchNormLayer::test_beta() const {
+  return m_beta;
+}
+
+const Vector& BatchNormLayer::test_mean() const {
+  return m_mean;
+}
+
+const Vector& BatchNormLayer::test_variance() const {
+  return m_variance;
+}
+
+const Vector& BatchNormLayer::test_deltaGamma() const {
+  return m_deltaGamma;
+}
+
+const Vector& BatchNormLayer::test_deltaBeta() const {
+  return m_deltaBeta;
+}
+
+}
+}
@@ -1,6 +1,7 @@
 #include "richard/cpu/convolutional_layer.hpp"
 #include "richard/cpu/max_pooling_layer.hpp"
 #include "richard/exception.hpp"
+#include "richard/simd.hpp"
 #include "richard/utils.hpp"
 #include "richard/config.hpp"
 #include <random>
@@ -22,6 +23,11 @@ ConvolutionalLayer::ConvolutionalLayer(const Config& config, std::istream& strea
     stream.read(reinterpret_cast<char*>(filter.K.data()),
       filter.K.W() * filter.K.H() * filter.K.D() * sizeof(netfloat_t));
   }
+
+  m_optimizerB.read(stream);
+  m_optimizerK.read(stream);
+
+  packFilters();
 }
 
 void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShape) {
@@ -33,13 +39,65 @@ void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShap
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
   size_t depth = config.getNumber<size_t>("depth");
-  m_dropoutRate = config.getNumber<netfloat_t>("dropoutRate");
+  m_dropout = Dropout(config.getNumber<netfloat_t>("dropoutRate"));
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
+  m_stride = config.contains("stride") ? config.getNumber<size_t>("stride") : 1;
+  m_padding = config.contains("padding") ? config.getNumber<size_t>("padding") : 0;
+
+  ASSERT_MSG(m_stride > 0, "Convolution stride must be at least 1");
 
-  ASSERT_MSG(kernelSize[0] <= m_inputW,
-    "Kernel width " << kernelSize[0] << " is larger than input width " << m_inputW);
+  const bool winogradCompatible = kernelSize[0] == 3 && kernelSize[1] == 3 && m_stride == 1;
+
+  m_engine = winogradCompatible ? Engine::winograd : Engine::direct;
+  if (config.contains("engine")) {
+    const std::string& engine = config.getString("engine");
+    if (engine == "direct") {
+      m_engine = Engine::direct;
+    }
+    else if (engine == "gemm") {
+      m_engine = Engine::gemm;
+    }
+    else if (engine == "winograd") {
+      ASSERT_MSG(winogradCompatible, "The winograd engine requires 3x3 kernels and stride 1");
+      m_engine = Engine::winograd;
+    }
+    else {
+      EXCEPTION("Unrecognised convolution engine '" << engine << "'");
+    }
+  }
+
+  m_layout = Layout::nchw;
+  if (config.contains("layout")) {
+    const std::string& layout = config.getString("layout");
+    if (layout == "nhwc") {
+      m_layout = Layout::nhwc;
+    }
+    else if (layout == "nchw8c") {
+      m_layout = Layout::nchw8c;
+    }
+    else if (layout == "nchw16c") {
+      m_layout = Layout::nchw16c;
+    }
+    else if (layout != "nchw") {
+      EXCEPTION("Unrecognised convolution layout '" << layout << "'");
+    }
+  }
+
+  // Only the direct engine has kernels for the other layouts
+  if (m_layout != Layout::nchw) {
+    ASSERT_MSG(!config.contains("engine") || m_engine == Engine::direct,
+      "Convolution layouts other than nchw require the direct engine");
+    m_engine = Engine::direct;
+  }
 
-  ASSERT_MSG(kernelSize[1] <= m_inputH,
-    "Kernel height " << kernelSize[1] << " is larger than input height " << m_inputH);
+  ASSERT_MSG(kernelSize[0] <= m_inputW + 2 * m_padding,
+    "Kernel width " << kernelSize[0] << " is larger than padded input width "
+    << m_inputW + 2 * m_padding);
+
+  ASSERT_MSG(kernelSize[1] <= m_inputH + 2 * m_padding,
+    "Kernel height " << kernelSize[1] << " is larger than padded input height "
+    << m_inputH + 2 * m_padding);
 
   for (size_t i = 0; i < depth; ++i) {
     m_filters.push_back(Filter{ Kernel(kernelSize[0], kernelSize[1], m_inputDepth), 0.f });
@@ -48,10 +106,66 @@ void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShap
     m_paramDeltas.push_back(Filter{ Kernel(kernelSize[0], kernelSize[1], m_inputDepth), 0.f });
   }
 
+  m_optimizerB = Optimizer(optimizer, depth);
+  m_optimizerK = Optimizer(optimizer, depth * kernelSize[0] * kernelSize[1] * m_inputDepth);
+
   auto sz = outputSize();
   m_Z = Array3(sz[0], sz[1], sz[2]);
   m_A = Array3(sz[0], sz[1], sz[2]);
   m_inputDelta = Array3(m_inputW, m_inputH, m_inputDepth);
+
+  packFilters();
+}
+
+// Every engine's backward pass works on the filter matrix, so it is always kept up to date
+void ConvolutionalLayer::packFilters() {
+  DBG_ASSERT(!m_filters.empty());
+  const size_t kernelSize = m_filters[0].K.size();
+
+  if (m_filterMatrix.rows() != m_filters.size() || m_filterMatrix.cols() != kernelSize) {
+    m_filterMatrix = Matrix(kernelSize, m_filters.size());
+  }
+
+  for (size_t i = 0; i < m_filters.size(); ++i) {
+    const Kernel& K = m_filters[i].K;
+    std::copy(K.data(), K.data() + kernelSize, m_filterMatrix.data() + i * kernelSize);
+  }
+
+  if (m_engine == Engine::winograd) {
+    if (m_winogradFilters.numFilters() != m_filters.size()) {
+      m_winogradFilters = WinogradFilters(m_filters.size(), m_inputDepth);
+    }
+    for (size_t i = 0; i < m_filters.size(); ++i) {
+      m_winogradFilters.setKernel(i, m_filters[i].K);
+    }
+  }
+
+  if (m_layout != Layout::nchw) {
+    const Size3 kernelShape = m_filters[0].K.shape();
+    const size_t layoutKernelSize = layoutSize(m_layout, kernelShape);
+
+    if (m_layoutFilters.size() != m_filters.size() * layoutKernelSize) {
+      m_layoutFilters = DataArray(m_filters.size() * layoutKernelSize);
+    }
+
+    for (size_t i = 0; i < m_filters.size(); ++i) {
+      reorder(m_filters[i].K.data(), Layout::nchw, m_layoutFilters.data() + i * layoutKernelSize,
+        m_layout, kernelShape);
+    }
+  }
+}
+
+void ConvolutionalLayer::padInput(const netfloat_t* input, netfloat_t* padded) const {
+  const size_t paddedW = m_inputW + 2 * m_padding;
+  const size_t paddedH = m_inputH + 2 * m_padding;
+
+  for (size_t z = 0; z < m_inputDepth; ++z) {
+    for (size_t y = 0; y < m_inputH; ++y) {
+      const netfloat_t* src = input + (z * m_inputH + y) * m_inputW;
+      netfloat_t* dst = padded + (z * paddedH + y + m_padding) * paddedW + m_padding;
+      std::copy(src, src + m_inputW, dst);
+    }
+  }
 }
 
 const DataArray& ConvolutionalLayer::activations() const {
@@ -65,8 +179,8 @@ const DataArray& ConvolutionalLayer::inputDelta() const {
 Size3 ConvolutionalLayer::outputSize() const {
   DBG_ASSERT(!m_filters.empty());
   return {
-    m_inputW - m_filters[0].K.W() + 1,
-    m_inputH - m_filters[0].K.H() + 1,
+    (m_inputW + 2 * m_padding - m_filters[0].K.W()) / m_stride + 1,
+    (m_inputH + 2 * m_padding - m_filters[0].K.H()) / m_stride + 1,
     m_filters.size()
   };
 }
@@ -76,113 +190,327 @@ size_t ConvolutionalLayer::numOutputs() const {
   return os[0] * os[1] * os[2];
 }
 
-void ConvolutionalLayer::forwardPass(const Array3& inputs, Array3& Z) const {
-  size_t depth = m_filters.size();
+void ConvolutionalLayer::forwardPass(const netfloat_t* inputs, netfloat_t* Z,
+  size_t batchSize, netfloat_t* scratch) const {
 
-  for (size_t slice = 0; slice < depth; ++slice) {
-    Array2Ptr featureMap = Z.slice(slice);
+  DataArray ownScratch;
+  if (scratch == nullptr && evalScratchSize(batchSize) > 0) {
+    ownScratch = DataArray(evalScratchSize(batchSize), Uninitialised{});
+    scratch = ownScratch.data();
+  }
+
+  if (m_engine == Engine::gemm && batchSize > 1) {
+    forwardPassGemmBatch(inputs, Z, batchSize, scratch);
+    return;
+  }
 
-    const Kernel& K = m_filters[slice].K;
-    netfloat_t b = m_filters[slice].b;
+  const size_t inputSize = m_inputW * m_inputH * m_inputDepth;
+  const size_t outputs = numOutputs();
+
+  // The gemm engine pads the input as it lowers it, the others work on a padded copy. Every sample
+  // is padded into the same buffer, so only the interior is rewritten.
+  const bool padCopy = m_padding > 0 && m_engine != Engine::gemm;
+  const Size3 shape = padCopy ?
+    Size3{ m_inputW + 2 * m_padding, m_inputH + 2 * m_padding, m_inputDepth } :
+    Size3{ m_inputW, m_inputH, m_inputDepth };
+
+  netfloat_t* padded = scratch;
+  netfloat_t* engineScratch = scratch;
+  if (padCopy) {
+    std::fill(padded, padded + calcProduct(shape), 0.f);
+    engineScratch += calcProduct(shape);
+  }
 
-    computeCrossCorrelation(inputs, K, *featureMap);
+  for (size_t n = 0; n < batchSize; ++n) {
+    const netfloat_t* X = inputs + n * inputSize;
+    if (padCopy) {
+      padInput(X, padded);
+      X = padded;
+    }
 
-    *featureMap += b;
+    netfloat_t* sampleZ = Z + n * outputs;
+
+    switch (m_engine) {
+      case Engine::direct:
+        if (m_layout != Layout::nchw) {
+          forwardPassLayout(X, shape, sampleZ, engineScratch);
+        }
+        else {
+          forwardPassDirect(X, shape, sampleZ);
+        }
+        break;
+      case Engine::gemm:
+        forwardPassGemm(X, sampleZ, engineScratch);
+        break;
+      case Engine::winograd:
+        forwardPassWinograd(X, shape, sampleZ, engineScratch);
+        break;
+    }
   }
 }
 
-void ConvolutionalLayer::trainForward(const DataArray& inputs) {
-  auto shouldDrop = [this]() {
-    return rand() / (RAND_MAX + 1.0) < m_dropoutRate;
-  };
-  
-  auto reluWithDropout = [&](netfloat_t x) -> netfloat_t {
-    return shouldDrop() ? 0.f : relu(x); 
-  };
+void ConvolutionalLayer::forwardPassDirect(const netfloat_t* inputs, const Size3& inputShape,
+  netfloat_t* Z) const {
 
-  ConstArray3Ptr pX = Array3::createShallow(inputs, m_inputW, m_inputH, m_inputDepth);
-  const Array3& X = *pX;
+  const Size3 outputShape = outputSize();
+  const size_t fmSize = outputShape[0] * outputShape[1];
+  const size_t kW = m_filters[0].K.W();
+  const size_t kH = m_filters[0].K.H();
 
-  forwardPass(X, m_Z);
+  parallelFor(0, m_filters.size(), [&](size_t slice) {
+    computeCrossCorrelation(inputs, inputShape, m_filters[slice].K.data(), kW, kH,
+      Z + slice * fmSize, m_stride);
+  });
+}
 
-  m_A = m_Z.computeTransform(reluWithDropout);
+// The input is reordered to match the packed filters, so that within a block of channels each
+// kernel row and the pixels under it are contiguous. Each output is then a sum of one dot product
+// of length kW * block per kernel row and channel block, rather than a sweep over the channels
+// with a plane-sized stride.
+void ConvolutionalLayer::forwardPassLayout(const netfloat_t* inputs, const Size3& inputShape,
+  netfloat_t* Z, netfloat_t* X) const {
+
+  const Size3 outputShape = outputSize();
+  const size_t fmW = outputShape[0];
+  const size_t fmH = outputShape[1];
+  const Size3 kernelShape = m_filters[0].K.shape();
+  const size_t kW = kernelShape[0];
+  const size_t kH = kernelShape[1];
+  const size_t block = layoutBlockSize(m_layout, m_inputDepth);
+  const size_t numBlocks = (m_inputDepth + block - 1) / block;
+  const size_t imageW = inputShape[0];
+  const size_t imageH = inputShape[1];
+  const size_t kernelSize = layoutSize(m_layout, kernelShape);
+  const size_t rowSize = kW * block;
+
+  reorder(inputs, Layout::nchw, X, m_layout, inputShape);
+
+  parallelFor(0, m_filters.size(), [&](size_t slice) {
+    const netfloat_t* K = m_layoutFilters.data() + slice * kernelSize;
+    netfloat_t* featureMap = Z + slice * fmW * fmH;
+
+    for (size_t y = 0; y < fmH; ++y) {
+      for (size_t x = 0; x < fmW; ++x) {
+        netfloat_t sum = 0.f;
+        for (size_t b = 0; b < numBlocks; ++b) {
+          for (size_t j = 0; j < kH; ++j) {
+            const netfloat_t* pixels = X
+              + ((b * imageH + y * m_stride + j) * imageW + x * m_stride) * block;
+            const netfloat_t* kernelRow = K + (b * kH + j) * rowSize;
+
+            sum += simd::dot(pixels, kernelRow, rowSize);
+          }
+        }
+        featureMap[y * fmW + x] = sum;
+      }
+    }
+  });
 }
 
-DataArray ConvolutionalLayer::evalForward(const DataArray& inputs) const {
-  ConstArray3Ptr pX = Array3::createShallow(inputs, m_inputW, m_inputH, m_inputDepth);
-  const Array3& X = *pX;
+void ConvolutionalLayer::forwardPassGemm(const netfloat_t* inputs, netfloat_t* Z,
+  netfloat_t* scratch) const {
 
-  auto sz = outputSize();
-  Array3 Z(sz[0], sz[1], sz[2]);
+  const size_t kW = m_filters[0].K.W();
+  const size_t kH = m_filters[0].K.H();
+  const size_t kernelSize = kW * kH * m_inputDepth;
+  const Size3 outputShape = outputSize();
+  const size_t fmSize = outputShape[0] * outputShape[1];
+
+  im2col(inputs, { m_inputW, m_inputH, m_inputDepth }, 1, kW, kH, scratch, m_stride, m_padding);
+  computeMatrixProduct(m_filterMatrix.data(), scratch, Z, m_filters.size(), kernelSize, fmSize,
+    false, false, false, threadPool());
+}
+
+// Lowers the whole batch into one matrix so a single product covers every sample, then scatters
+// the result, which is ordered by filter first, into per-sample feature maps
+void ConvolutionalLayer::forwardPassGemmBatch(const netfloat_t* inputs, netfloat_t* Z,
+  size_t batchSize, netfloat_t* scratch) const {
+
+  const size_t kW = m_filters[0].K.W();
+  const size_t kH = m_filters[0].K.H();
+  const size_t kernelSize = kW * kH * m_inputDepth;
+  const Size3 outputShape = outputSize();
+  const size_t fmSize = outputShape[0] * outputShape[1];
+  const size_t depth = m_filters.size();
 
-  forwardPass(X, Z);
+  netfloat_t* columns = scratch;
+  im2col(inputs, { m_inputW, m_inputH, m_inputDepth }, batchSize, kW, kH, columns, m_stride,
+    m_padding);
 
-  Z.transformInPlace(relu);
+  netfloat_t* product = columns + batchSize * fmSize * kernelSize;
+  computeMatrixProduct(m_filterMatrix.data(), columns, product, depth, kernelSize,
+    batchSize * fmSize, false, false, false, threadPool());
 
-  return Z.storage();
+  for (size_t slice = 0; slice < depth; ++slice) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      const netfloat_t* src = product + slice * batchSize * fmSize + n * fmSize;
+      std::copy(src, src + fmSize, Z + (n * depth + slice) * fmSize);
+    }
+  }
+}
+
+void ConvolutionalLayer::forwardPassWinograd(const netfloat_t* inputs, const Size3& inputShape,
+  netfloat_t* Z, netfloat_t* scratch) const {
+
+  computeWinogradCrossCorrelation(inputs, inputShape, m_winogradFilters, Z, threadPool(),
+    scratch);
 }
 
-void ConvolutionalLayer::updateDeltas(const DataArray& layerInputs, const DataArray& outputDelta) {
-  size_t fmW = outputSize()[0];
-  size_t fmH = outputSize()[1];
-  size_t depth = m_filters.size();
+void ConvolutionalLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
 
-  ConstArray3Ptr pDeltaA = Array3::createShallow(outputDelta, fmW, fmH, depth);
-  const Array3& deltaA = *pDeltaA;
+  const Size3 outputShape = outputSize();
+  const size_t outputs = numOutputs();
+  const size_t fmSize = outputShape[0] * outputShape[1];
 
-  ConstArray3Ptr pInputs3 = Array3::createShallow(layerInputs, m_inputW, m_inputH, m_inputDepth);
-  const Array3& inputs3 = *pInputs3;
+  if (m_Z.D() != batchSize * outputShape[2]) {
+    m_Z = Array3(outputShape[0], outputShape[1], batchSize * outputShape[2], Uninitialised{});
+    m_A = Array3(outputShape[0], outputShape[1], batchSize * outputShape[2], Uninitialised{});
+  }
 
-  Array3 delta3 = deltaA.hadamard(m_Z.computeTransform(reluPrime));
-  m_inputDelta.zero();
+  forwardPass(inputs.data(), m_Z.data(), batchSize);
 
-  Array2 dInputDelta(m_inputDelta.W(), m_inputDelta.H());
-  DBG_ASSERT(m_filters.size() > 0);
-  Array2 dDeltaK(m_filters[0].K.W(), m_filters[0].K.H());
+  m_dropout.generateMask(m_Z.size());
 
-  for (size_t slice = 0; slice < depth; ++slice) {
-    const Kernel& K = m_filters[slice].K;
-    Kernel& deltaK3 = m_paramDeltas[slice].K;
-    netfloat_t& db = m_paramDeltas[slice].b;
+  for (size_t n = 0; n < batchSize; ++n) {
+    for (size_t slice = 0; slice < m_filters.size(); ++slice) {
+      const size_t offset = n * outputs + slice * fmSize;
+      m_dropout.forward(Relu{}, m_Z.data() + offset, m_filters[slice].b, m_A.data() + offset,
+        fmSize, offset);
+    }
+  }
+}
 
-    ConstArray2Ptr pDelta = delta3.slice(slice);
-    const Array2& delta = *pDelta;
+DataArray ConvolutionalLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
 
-    for (size_t z = 0; z < K.D(); ++z) {
-      ConstArray2Ptr pW = K.slice(z);
-      const Array2& W = *pW;
+  DataArray Z(batchSize * numOutputs(), Uninitialised{});
+  evalInto(inputs.data(), Z.data(), batchSize);
 
-      Array2Ptr pInputDelta = m_inputDelta.slice(z);
-      Array2& inputDelta = *pInputDelta;
+  return Z;
+}
 
-      computeFullConvolution(W, delta, dInputDelta);
+// The gemm engine lowers the whole batch into scratch, along with the product when that has to be
+// scattered into per-sample feature maps. The other engines work one sample at a time on a padded
+// copy of the input, followed by the reordered input or the Winograd tiles.
+size_t ConvolutionalLayer::evalScratchSize(size_t batchSize) const {
+  const Size3 outputShape = outputSize();
+  const size_t fmSize = outputShape[0] * outputShape[1];
 
-      inputDelta += dInputDelta;
+  if (m_engine == Engine::gemm) {
+    const size_t columns = batchSize * fmSize * m_filters[0].K.size();
+    return batchSize > 1 ? columns + batchSize * fmSize * m_filters.size() : columns;
+  }
 
-      ConstArray2Ptr pInputs = inputs3.slice(z);
-      const Array2& inputs = *pInputs;
+  const Size3 paddedShape{ m_inputW + 2 * m_padding, m_inputH + 2 * m_padding, m_inputDepth };
+  size_t size = m_padding > 0 ? calcProduct(paddedShape) : 0;
 
-      Array2Ptr pDeltaK = deltaK3.slice(z);
-      Array2& deltaK = *pDeltaK;
+  if (m_engine == Engine::winograd) {
+    size += winogradScratchSize(outputShape[0], outputShape[1], m_inputDepth, m_filters.size());
+  }
+  else if (m_layout != Layout::nchw) {
+    size += layoutSize(m_layout, paddedShape);
+  }
+
+  return size;
+}
 
-      computeCrossCorrelation(inputs, delta, dDeltaK);
-      deltaK += dDeltaK;
+void ConvolutionalLayer::evalInto(const netfloat_t* inputs, netfloat_t* Z,
+  size_t batchSize, netfloat_t* scratch) const {
+
+  const Size3 outputShape = outputSize();
+  const size_t outputs = numOutputs();
+  const size_t fmSize = outputShape[0] * outputShape[1];
+
+  forwardPass(inputs, Z, batchSize, scratch);
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    for (size_t slice = 0; slice < m_filters.size(); ++slice) {
+      netfloat_t* featureMap = Z + n * outputs + slice * fmSize;
+      biasAndActivate(Relu{}, featureMap, m_filters[slice].b, featureMap, fmSize);
     }
+  }
+}
+
+void ConvolutionalLayer::updateDeltas(const DataArray& layerInputs, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  const size_t inputSize = m_inputW * m_inputH * m_inputDepth;
+  const size_t outputs = numOutputs();
+
+  DBG_ASSERT(layerInputs.size() == batchSize * inputSize);
+  DBG_ASSERT(outputDelta.size() == batchSize * outputs);
+  DBG_ASSERT(m_Z.size() == batchSize * outputs);
 
-    db += delta.sum();
+  DataArray delta(batchSize * outputs, Uninitialised{});
+  m_dropout.backward(ReluPrime{}, m_Z.data(), outputDelta.data(), delta.data(), delta.size());
+
+  if (m_inputDelta.D() != batchSize * m_inputDepth) {
+    m_inputDelta = Array3(m_inputW, m_inputH, batchSize * m_inputDepth, Uninitialised{});
+  }
+
+  // The backward pass doesn't depend on the forward engine. The batched products were measured to
+  // match or beat the Winograd backward pass and to be far faster than direct loops, from a single
+  // sample up, so every engine uses them.
+  updateDeltasGemm(layerInputs, delta, batchSize);
+}
+
+// The whole batch is lowered as in forwardPassGemmBatch. With the delta gathered into a matrix D
+// with one row per filter, the kernel gradients are D * columns^T and the input delta is the col2im
+// of W^T * D, so both are a single product over the batch.
+void ConvolutionalLayer::updateDeltasGemm(const DataArray& inputs, const DataArray& delta,
+  size_t batchSize) {
+
+  const size_t kW = m_filters[0].K.W();
+  const size_t kH = m_filters[0].K.H();
+  const size_t kernelSize = kW * kH * m_inputDepth;
+  const Size3 inputShape{ m_inputW, m_inputH, m_inputDepth };
+  const Size3 outputShape = outputSize();
+  const size_t fmSize = outputShape[0] * outputShape[1];
+  const size_t depth = m_filters.size();
+  const size_t positions = batchSize * fmSize;
+
+  Matrix D(positions, depth, Uninitialised{});
+
+  for (size_t slice = 0; slice < depth; ++slice) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      const netfloat_t* src = delta.data() + (n * depth + slice) * fmSize;
+      std::copy(src, src + fmSize, D.data() + slice * positions + n * fmSize);
+    }
   }
+
+  Matrix columns(positions, kernelSize, Uninitialised{});
+  im2col(inputs.data(), inputShape, batchSize, kW, kH, columns, m_stride, m_padding);
+
+  Matrix deltaK(kernelSize, depth, Uninitialised{});
+  computeMatrixProduct(D, columns, deltaK, false, true, false, threadPool());
+
+  parallelFor(0, depth, [&](size_t slice) {
+    netfloat_t* dK = m_paramDeltas[slice].K.data();
+    simd::add(dK, deltaK.data() + slice * kernelSize, dK, kernelSize);
+    m_paramDeltas[slice].b += simd::sum(D.data() + slice * positions, positions);
+  });
+
+  // The lowered inputs are no longer needed, so their memory is reused for the input delta
+  computeMatrixProduct(m_filterMatrix, D, columns, true, false, false, threadPool());
+  col2im(columns, inputShape, batchSize, kW, kH, m_inputDelta.data(), m_stride, m_padding);
 }
 
 void ConvolutionalLayer::updateParams(size_t epoch) {
   netfloat_t learnRate = m_learnRate * static_cast<netfloat_t>(pow(m_learnRateDecay, epoch));
 
-  for (size_t slice = 0; slice < m_filters.size(); ++slice) {
-    m_filters[slice].K -= m_paramDeltas[slice].K * learnRate;
-    m_filters[slice].b -= m_paramDeltas[slice].b * learnRate;
+  m_optimizerK.nextStep(learnRate);
+  m_optimizerB.nextStep(learnRate);
 
-    m_paramDeltas[slice].K.zero();
-    m_paramDeltas[slice].b = 0.0;
-  }
+  parallelFor(0, m_filters.size(), [&](size_t slice) {
+    Kernel& K = m_filters[slice].K;
+    const size_t kernelSize = K.size();
+
+    m_optimizerK.update(K.data(), m_paramDeltas[slice].K.data(), kernelSize, slice * kernelSize);
+    m_optimizerB.update(&m_filters[slice].b, &m_paramDeltas[slice].b, 1, slice);
+  });
+
+  packFilters();
 }
 
 void ConvolutionalLayer::writeToStream(std::ostream& stream) const {
@@ -191,10 +519,91 @@ void ConvolutionalLayer::writeToStream(std::ostream& stream) const {
     stream.write(reinterpret_cast<const char*>(filter.K.data()),
       filter.K.size() * sizeof(netfloat_t));
   }
+
+  m_optimizerB.write(stream);
+  m_optimizerK.write(stream);
+}
+
+void ConvolutionalLayer::mergeDeltas(Layer& replica) {
+  auto& layer = dynamic_cast<ConvolutionalLayer&>(replica);
+
+  for (size_t slice = 0; slice < m_paramDeltas.size(); ++slice) {
+    m_paramDeltas[slice].K += layer.m_paramDeltas[slice].K;
+    m_paramDeltas[slice].b += layer.m_paramDeltas[slice].b;
+
+    layer.m_paramDeltas[slice].K.zero();
+    layer.m_paramDeltas[slice].b = 0.0;
+  }
+}
+
+void ConvolutionalLayer::copyParams(const Layer& source) {
+  auto& layer = dynamic_cast<const ConvolutionalLayer&>(source);
+
+  for (size_t slice = 0; slice < m_filters.size(); ++slice) {
+    m_filters[slice].K = layer.m_filters[slice].K;
+    m_filters[slice].b = layer.m_filters[slice].b;
+  }
+
+  m_filterMatrix = layer.m_filterMatrix;
+  m_winogradFilters = layer.m_winogradFilters;
+  m_layoutFilters = layer.m_layoutFilters;
+}
+
+void ConvolutionalLayer::shareParams(Layer&) {
+  EXCEPTION("Convolutional layers don't support asynchronous training");
+}
+
+void ConvolutionalLayer::setDropoutStream(uint64_t stream) {
+  m_dropout = Dropout(m_dropout.rate(), stream);
+}
+
+// Every output reads a full kernel-sized window of the input, so a transform that is constant over
+// each input channel can be moved into the kernels and biases
+bool ConvolutionalLayer::absorbInputTransform(const DataArray& scale, const DataArray& shift) {
+  // The padding zeros aren't transformed, so windows that overlap them would be shifted wrongly
+  if (m_padding > 0) {
+    return false;
+  }
+
+  const size_t channelSize = m_inputW * m_inputH;
+
+  DBG_ASSERT(scale.size() == channelSize * m_inputDepth);
+  DBG_ASSERT(shift.size() == channelSize * m_inputDepth);
+
+  for (size_t z = 0; z < m_inputDepth; ++z) {
+    for (size_t i = 1; i < channelSize; ++i) {
+      if (scale[z * channelSize + i] != scale[z * channelSize] ||
+        shift[z * channelSize + i] != shift[z * channelSize]) {
+
+        return false;
+      }
+    }
+  }
+
+  for (Filter& filter : m_filters) {
+    Kernel& K = filter.K;
+    const size_t sliceSize = K.W() * K.H();
+
+    for (size_t z = 0; z < m_inputDepth; ++z) {
+      const netfloat_t s = scale[z * channelSize];
+      const netfloat_t t = shift[z * channelSize];
+      netfloat_t* k = K.data() + z * sliceSize;
+
+      for (size_t i = 0; i < sliceSize; ++i) {
+        filter.b += k[i] * t;
+        k[i] *= s;
+      }
+    }
+  }
+
+  packFilters();
+
+  return true;
 }
 
 void ConvolutionalLayer::test_setFilters(const std::vector<Filter>& filters) {
   m_filters = filters;
+  packFilters();
 }
 
 const std::vector<ConvolutionalLayer::Filter> ConvolutionalLayer::test_filters() const {
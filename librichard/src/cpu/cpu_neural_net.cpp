@@ -2,17 +2,25 @@
 #include "richard/cpu/max_pooling_layer.hpp"
 #include "richard/cpu/convolutional_layer.hpp"
 #include "richard/cpu/output_layer.hpp"
+#include "richard/cpu/batch_norm_layer.hpp"
+#include "richard/cpu/global_average_pooling_layer.hpp"
+#include "richard/cpu/depthwise_separable_layer.hpp"
+#include "richard/cpu/dropout.hpp"
 #include "richard/cpu/cpu_neural_net.hpp"
 #include "richard/exception.hpp"
 #include "richard/labelled_data_set.hpp"
 #include "richard/config.hpp"
 #include "richard/event_system.hpp"
+#include "richard/utils.hpp"
+#include "richard/thread_pool.hpp"
 #include <cmath>
 #include <fstream>
 #include <algorithm>
 #include <sstream>
 #include <future>
 #include <atomic>
+#include <mutex>
+#include <limits>
 
 namespace richard {
 namespace cpu {
@@ -23,6 +31,80 @@ const NeuralNet::CostFn quadraticCost = [](const Vector& actual, const Vector& e
   return (expected - actual).squareMagnitude() * netfloat_t(0.5);
 };
 
+const NeuralNet::CostFn crossEntropyCost = [](const Vector& actual, const Vector& expected) {
+  DBG_ASSERT(actual.size() == expected.size());
+
+  netfloat_t cost = 0.0;
+  for (size_t i = 0; i < actual.size(); ++i) {
+    if (expected[i] != 0.0) {
+      // Softmax outputs underflow to zero for very unlikely classes
+      cost -= expected[i] * std::log(std::max(actual[i], std::numeric_limits<netfloat_t>::min()));
+    }
+  }
+
+  return cost;
+};
+
+// The size elements of array starting at offset
+DataArray slice(const DataArray& array, size_t offset, size_t size) {
+  DBG_ASSERT(offset + size <= array.size());
+
+  DataArray result(size, Uninitialised{});
+  std::copy(array.data() + offset, array.data() + offset + size, result.data());
+  return result;
+}
+
+using LayerStack = std::vector<LayerPtr>;
+using ConstLayerList = std::vector<const Layer*>;
+
+// Evaluates one sample at a time without allocating. Each layer reads the previous layer's
+// outputs from one buffer and writes its own to the other, so two buffers sized for the largest
+// layer are enough. The layers share one buffer of working memory. Not thread-safe; each
+// concurrent evaluation needs its own plan.
+class InferencePlan {
+  public:
+    explicit InferencePlan(const ConstLayerList& layers);
+
+    // Returns the outputs of the last layer, which are valid until the next call
+    const netfloat_t* evaluate(const netfloat_t* inputs);
+
+  private:
+    const ConstLayerList& m_layers;
+    std::array<DataArray, 2> m_buffers;
+    DataArray m_scratch;
+};
+
+InferencePlan::InferencePlan(const ConstLayerList& layers)
+  : m_layers(layers) {
+
+  size_t largest = 0;
+  size_t scratchSize = 0;
+  for (const auto& layer : m_layers) {
+    largest = std::max(largest, calcProduct(layer->outputSize()));
+    scratchSize = std::max(scratchSize, layer->evalScratchSize());
+  }
+
+  for (auto& buffer : m_buffers) {
+    buffer = DataArray(largest, Uninitialised{});
+  }
+
+  m_scratch = DataArray(scratchSize, Uninitialised{});
+}
+
+const netfloat_t* InferencePlan::evaluate(const netfloat_t* inputs) {
+  const netfloat_t* X = inputs;
+
+  for (size_t i = 0; i < m_layers.size(); ++i) {
+    netfloat_t* Y = m_buffers[i % 2].data();
+    m_layers[i]->evalInto(X, Y, 1, m_scratch.data());
+    X = Y;
+  }
+
+  return X;
+}
+
+using InferencePlanPtr = std::unique_ptr<InferencePlan>;
+
 class CpuNeuralNetImpl : public CpuNeuralNet {
   public:
     using CostFn = std::function<netfloat_t(const Vector&, const Vector&)>;
@@ -36,6 +118,8 @@ class CpuNeuralNetImpl : public CpuNeuralNet {
     void writeToStream(std::ostream& s) const override;
     void train(LabelledDataSet& data) override;
     Vector evaluate(const Array3& inputs) const override;
+    size_t evaluationThreads() const override;
+    void parallelEvaluate(size_t n, const std::function<void(size_t)>& fn) const override;
     ModelDetails modelDetails() const override;
 
     void abort() override;
@@ -48,15 +132,46 @@ class CpuNeuralNetImpl : public CpuNeuralNet {
     void initialize(const Size3& inputShape, const Config& config, std::istream* stream);
     LayerPtr constructLayer(const Config& obj, const Size3& prevLayerSize,
       std::istream* stream) const;
-    netfloat_t feedForward(const Array3& x, const Vector& y);
-    void backPropagate(const Array3& x, const Vector& y);
+    const OutputLayer& outputLayer() const;
+    void compileInferenceLayers();
+    void createReplicas();
+    LayerStack& workerLayers(size_t worker);
+    netfloat_t feedForward(LayerStack& layers, const DataArray& X, const DataArray& Y,
+      size_t batchSize);
+    void backPropagate(LayerStack& layers, const DataArray& X, const DataArray& Y,
+      size_t batchSize);
+    size_t nextBatchNorm(size_t begin) const;
+    void feedForwardShards(const std::vector<DataArray>& shardX,
+      const std::vector<size_t>& shardStart);
+    void backPropagateShards(const std::vector<DataArray>& shardX,
+      const std::vector<DataArray>& shardY, const std::vector<size_t>& shardStart);
+    void reduceDeltas(size_t numWorkers);
     void updateParams(size_t epoch);
+    netfloat_t trainMiniBatch(const DataArray& X, const DataArray& Y, size_t batchSize,
+      size_t epoch);
+    void trainSynchronous(LabelledDataSet& data);
+    void trainHogwild(LabelledDataSet& data);
 
     EventSystem& m_eventSystem;
     bool m_isTrained;
     Size3 m_inputShape;
     Hyperparams m_params;
-    std::vector<LayerPtr> m_layers;
+    std::vector<Config> m_layerConfigs;
+    LayerStack m_layers;
+    // The layers evaluate runs. Each batch norm layer is folded into a copy of the layer after it
+    // where possible, and the copy replaces both.
+    ConstLayerList m_inferenceLayers;
+    LayerStack m_foldedLayers;
+    // Copies of m_layers for worker threads 1 to threads - 1. Worker 0 trains m_layers itself. In
+    // hogwild mode the replicas share m_layers' parameters.
+    std::vector<LayerStack> m_replicas;
+    // Runs the data-parallel workers and the layers' own parallel loops, so nested parallelism
+    // never uses more than m_params.threads threads
+    ThreadPoolPtr m_threadPool;
+    // Plans not currently in use by evaluate. There's one to begin with, and more are compiled if
+    // several threads evaluate at once.
+    mutable std::mutex m_plansMutex;
+    mutable std::vector<InferencePlanPtr> m_plans;
     std::atomic<bool> m_abort;
 };
 
@@ -81,28 +196,100 @@ void CpuNeuralNetImpl::initialize(const Size3& inputShape, const Config& config,
   m_isTrained = false;
   m_inputShape = inputShape;
   m_params = Hyperparams(config.getObject("hyperparams"));
+  m_threadPool = createThreadPool(m_params.threads);
 
   Size3 prevLayerSize = m_inputShape;
 
   if (config.contains("hiddenLayers")) {
     auto layersConfig = config.getObjectArray("hiddenLayers");
 
-    for (auto layerConfig : layersConfig) {
-      m_layers.push_back(constructLayer(layerConfig, prevLayerSize, stream));
-      prevLayerSize = m_layers.back()->outputSize();
-    }
+    m_layerConfigs = layersConfig;
   }
 
   auto outLayerConfig = config.getObject("outputLayer");
   outLayerConfig.setString("type", "output");
-  m_layers.push_back(constructLayer(outLayerConfig, prevLayerSize, stream));
+  m_layerConfigs.push_back(outLayerConfig);
+
+  for (const auto& layerConfig : m_layerConfigs) {
+    m_layers.push_back(constructLayer(layerConfig, prevLayerSize, stream));
+    m_layers.back()->setThreadPool(m_threadPool.get());
+    m_layers.back()->setDropoutStream(Dropout::streamKey(m_params.seed, m_layers.size() - 1, 0));
+    prevLayerSize = m_layers.back()->outputSize();
+  }
+
+  compileInferenceLayers();
+  m_plans.push_back(std::make_unique<InferencePlan>(m_inferenceLayers));
+}
+
+// Rebuilt in place, as the inference plans refer to m_inferenceLayers. Folding never adds a layer
+// or changes an output size, so the plans' buffers stay large enough.
+void CpuNeuralNetImpl::compileInferenceLayers() {
+  m_inferenceLayers.clear();
+  m_foldedLayers.clear();
+
+  for (size_t i = 0; i < m_layers.size(); ++i) {
+    auto batchNorm = dynamic_cast<const BatchNormLayer*>(m_layers[i].get());
+
+    if (batchNorm != nullptr && i + 1 < m_layers.size()) {
+      DataArray scale;
+      DataArray shift;
+      batchNorm->inferenceTransform(scale, shift);
+
+      LayerPtr folded = constructLayer(m_layerConfigs[i + 1], batchNorm->outputSize(), nullptr);
+      folded->copyParams(*m_layers[i + 1]);
+
+      if (folded->absorbInputTransform(scale, shift)) {
+        folded->setThreadPool(m_threadPool.get());
+        m_inferenceLayers.push_back(folded.get());
+        m_foldedLayers.push_back(std::move(folded));
+        ++i;
+        continue;
+      }
+    }
+
+    m_inferenceLayers.push_back(m_layers[i].get());
+  }
+}
+
+void CpuNeuralNetImpl::createReplicas() {
+  while (m_replicas.size() + 1 < m_params.threads) {
+    LayerStack layers;
+    Size3 prevLayerSize = m_inputShape;
+
+    const size_t worker = m_replicas.size() + 1;
+
+    for (const auto& layerConfig : m_layerConfigs) {
+      layers.push_back(constructLayer(layerConfig, prevLayerSize, nullptr));
+      layers.back()->setThreadPool(m_threadPool.get());
+      layers.back()->setDropoutStream(Dropout::streamKey(m_params.seed, layers.size() - 1,
+        worker));
+      prevLayerSize = layers.back()->outputSize();
+    }
+
+    if (m_params.trainingMode == TrainingMode::hogwild) {
+      for (size_t i = 0; i < layers.size(); ++i) {
+        layers[i]->shareParams(*m_layers[i]);
+      }
+    }
+
+    m_replicas.push_back(std::move(layers));
+  }
+}
+
+LayerStack& CpuNeuralNetImpl::workerLayers(size_t worker) {
+  return worker == 0 ? m_layers : m_replicas[worker - 1];
 }
 
 ModelDetails CpuNeuralNetImpl::modelDetails() const {
   return ModelDetails{
     { "Batch size", std::to_string(m_params.batchSize) },
     { "Mini-batch size", std::to_string(m_params.miniBatchSize) },
-    { "Epochs", std::to_string(m_params.epochs) }
+    { "Epochs", std::to_string(m_params.epochs) },
+    { "Threads", std::to_string(m_params.threads) },
+    { "Cost",
+      outputLayer().costType() == CostType::crossEntropy ? "cross-entropy" : "quadratic" },
+    { "Training mode",
+      m_params.trainingMode == TrainingMode::hogwild ? "hogwild" : "synchronous" }
   };
 }
 
@@ -121,9 +308,22 @@ LayerPtr CpuNeuralNetImpl::constructLayer(const Config& obj, const Size3& prevLa
       std::make_unique<ConvolutionalLayer>(obj, *stream, prevLayerSize) :
       std::make_unique<ConvolutionalLayer>(obj, prevLayerSize);
   }
+  else if (type == "depthwiseSeparable") {
+    return stream ?
+      std::make_unique<DepthwiseSeparableLayer>(obj, *stream, prevLayerSize) :
+      std::make_unique<DepthwiseSeparableLayer>(obj, prevLayerSize);
+  }
   else if (type == "maxPooling") {
     return std::make_unique<MaxPoolingLayer>(obj, prevLayerSize);
   }
+  else if (type == "globalAveragePooling") {
+    return std::make_unique<GlobalAveragePoolingLayer>(obj, prevLayerSize);
+  }
+  else if (type == "batchNorm") {
+    return stream ?
+      std::make_unique<BatchNormLayer>(obj, *stream, prevLayerSize) :
+      std::make_unique<BatchNormLayer>(obj, prevLayerSize);
+  }
   else if (type == "output") {
     return stream ?
       std::make_unique<OutputLayer>(obj, *stream, calcProduct(prevLayerSize)) :
@@ -139,7 +339,12 @@ void CpuNeuralNetImpl::abort() {
 }
 
 NeuralNet::CostFn CpuNeuralNetImpl::costFn() const {
-  return quadraticCost;
+  return outputLayer().costType() == CostType::crossEntropy ? crossEntropyCost : quadraticCost;
+}
+
+const OutputLayer& CpuNeuralNetImpl::outputLayer() const {
+  ASSERT_MSG(!m_layers.empty(), "No output layer");
+  return dynamic_cast<const OutputLayer&>(*m_layers.back());
 }
 
 void CpuNeuralNetImpl::writeToStream(std::ostream& stream) const {
@@ -154,31 +359,186 @@ Size3 CpuNeuralNetImpl::inputSize() const {
   return m_inputShape;
 }
 
-netfloat_t CpuNeuralNetImpl::feedForward(const Array3& x, const Vector& y) {
-  const DataArray* A = &x.storage();
-  for (auto& layer : m_layers) {
-    layer->trainForward(*A);
+// Returns the cost summed over the batch
+netfloat_t CpuNeuralNetImpl::feedForward(LayerStack& layers, const DataArray& X,
+  const DataArray& Y, size_t batchSize) {
+
+  const DataArray* A = &X;
+  for (auto& layer : layers) {
+    layer->trainForward(*A, batchSize);
     A = &layer->activations();
   }
 
   ConstVectorPtr outputs = Vector::createShallow(*A);
 
-  return quadraticCost(*outputs, y);
+  // Summed over the batch, as each sample's cost is a sum over its own outputs
+  return costFn()(*outputs, *Vector::createShallow(Y));
 }
 
-void CpuNeuralNetImpl::backPropagate(const Array3& x, const Vector& y) {
-  int numLayers = static_cast<int>(m_layers.size());
+void CpuNeuralNetImpl::backPropagate(LayerStack& layers, const DataArray& X, const DataArray& Y,
+  size_t batchSize) {
+
+  int numLayers = static_cast<int>(layers.size());
 
   for (int i = numLayers - 1; i >= 0; --i) {
-    if (i == numLayers - 1) {
-      m_layers[i]->updateDeltas(m_layers[i - 1]->activations(), y.storage());
+    const DataArray& inputs = i == 0 ? X : layers[i - 1]->activations();
+    const DataArray& outputDelta = i == numLayers - 1 ? Y : layers[i + 1]->inputDelta();
+
+    layers[i]->updateDeltas(inputs, outputDelta, batchSize);
+  }
+}
+
+// Index of the first batch norm layer from begin on, or the number of layers if there isn't one
+size_t CpuNeuralNetImpl::nextBatchNorm(size_t begin) const {
+  for (size_t i = begin; i < m_layers.size(); ++i) {
+    if (dynamic_cast<const BatchNormLayer*>(m_layers[i].get()) != nullptr) {
+      return i;
     }
-    else if (i == 0) {
-      m_layers[i]->updateDeltas(x.storage(), m_layers[i + 1]->inputDelta());
+  }
+  return m_layers.size();
+}
+
+// Each worker runs its layers on its own shard of the mini-batch, shardStart[w] to
+// shardStart[w + 1]. The workers proceed in step through batch norm layers, whose statistics are
+// summed over all the shards, so every shard is normalised as part of the whole mini-batch.
+void CpuNeuralNetImpl::feedForwardShards(const std::vector<DataArray>& shardX,
+  const std::vector<size_t>& shardStart) {
+
+  const size_t numWorkers = shardX.size();
+  const size_t batchSize = shardStart.back();
+
+  auto shardSize = [&](size_t w) {
+    return shardStart[w + 1] - shardStart[w];
+  };
+  auto layerInputs = [&](size_t w, size_t i) -> const DataArray& {
+    return i == 0 ? shardX[w] : workerLayers(w)[i - 1]->activations();
+  };
+
+  std::vector<Vector> sums(numWorkers);
+  std::vector<Vector> squaredDeviations(numWorkers);
+
+  size_t begin = 0;
+  while (begin < m_layers.size()) {
+    size_t end = nextBatchNorm(begin);
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      LayerStack& layers = workerLayers(w);
+      for (size_t i = begin; i < end; ++i) {
+        layers[i]->trainForward(layerInputs(w, i), shardSize(w));
+      }
+    });
+
+    if (end == m_layers.size()) {
+      break;
     }
-    else {
-      m_layers[i]->updateDeltas(m_layers[i - 1]->activations(), m_layers[i + 1]->inputDelta());
+
+    auto batchNorm = [&](size_t w) -> BatchNormLayer& {
+      return dynamic_cast<BatchNormLayer&>(*workerLayers(w)[end]);
+    };
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      batchNorm(w).sumInputs(layerInputs(w, end), shardSize(w), sums[w]);
+    });
+    for (size_t w = 1; w < numWorkers; ++w) {
+      sums[0] += sums[w];
     }
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      batchNorm(w).sumSquaredDeviations(layerInputs(w, end), shardSize(w), sums[0], batchSize,
+        squaredDeviations[w]);
+    });
+    for (size_t w = 1; w < numWorkers; ++w) {
+      squaredDeviations[0] += squaredDeviations[w];
+    }
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      batchNorm(w).normalise(layerInputs(w, end), shardSize(w), sums[0], squaredDeviations[0],
+        batchSize);
+    });
+
+    begin = end + 1;
+  }
+}
+
+// The reverse of feedForwardShards, in step through batch norm layers in the same way
+void CpuNeuralNetImpl::backPropagateShards(const std::vector<DataArray>& shardX,
+  const std::vector<DataArray>& shardY, const std::vector<size_t>& shardStart) {
+
+  const size_t numWorkers = shardX.size();
+  const size_t batchSize = shardStart.back();
+  const size_t numLayers = m_layers.size();
+
+  auto shardSize = [&](size_t w) {
+    return shardStart[w + 1] - shardStart[w];
+  };
+  auto layerInputs = [&](size_t w, size_t i) -> const DataArray& {
+    return i == 0 ? shardX[w] : workerLayers(w)[i - 1]->activations();
+  };
+  auto outputDelta = [&](size_t w, size_t i) -> const DataArray& {
+    return i == numLayers - 1 ? shardY[w] : workerLayers(w)[i + 1]->inputDelta();
+  };
+
+  std::vector<size_t> batchNorms;
+  for (size_t i = nextBatchNorm(0); i < numLayers; i = nextBatchNorm(i + 1)) {
+    batchNorms.push_back(i);
+  }
+
+  std::vector<Vector> sumDy(numWorkers);
+  std::vector<Vector> sumDyXhat(numWorkers);
+
+  size_t end = numLayers;
+  for (size_t b = batchNorms.size(); ; --b) {
+    // The layers after the b-th batch norm layer, or all that remain once there are none left
+    size_t begin = b > 0 ? batchNorms[b - 1] + 1 : 0;
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      LayerStack& layers = workerLayers(w);
+      for (size_t i = end; i > begin; --i) {
+        layers[i - 1]->updateDeltas(layerInputs(w, i - 1), outputDelta(w, i - 1), shardSize(w));
+      }
+    });
+
+    if (b == 0) {
+      break;
+    }
+
+    const size_t index = batchNorms[b - 1];
+
+    auto batchNorm = [&](size_t w) -> BatchNormLayer& {
+      return dynamic_cast<BatchNormLayer&>(*workerLayers(w)[index]);
+    };
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      batchNorm(w).sumOutputDeltas(outputDelta(w, index), shardSize(w), sumDy[w], sumDyXhat[w]);
+    });
+    for (size_t w = 1; w < numWorkers; ++w) {
+      sumDy[0] += sumDy[w];
+      sumDyXhat[0] += sumDyXhat[w];
+    }
+
+    parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+      batchNorm(w).updateInputDelta(outputDelta(w, index), shardSize(w), sumDy[0], sumDyXhat[0],
+        batchSize);
+    });
+
+    end = index;
+  }
+}
+
+// Sums the gradients of all workers into worker 0's layers. Pairs are always combined in the same
+// order, so for a given thread count the result doesn't depend on thread scheduling.
+void CpuNeuralNetImpl::reduceDeltas(size_t numWorkers) {
+  for (size_t stride = 1; stride < numWorkers; stride *= 2) {
+    size_t numPairs = (numWorkers - stride + 2 * stride - 1) / (2 * stride);
+
+    parallelFor(*m_threadPool, 0, numPairs, [&, stride](size_t pair) {
+      LayerStack& dst = workerLayers(2 * stride * pair);
+      LayerStack& src = workerLayers(2 * stride * pair + stride);
+
+      for (size_t i = 0; i < dst.size(); ++i) {
+        dst[i]->mergeDeltas(*src[i]);
+      }
+    });
   }
 }
 
@@ -188,7 +548,81 @@ void CpuNeuralNetImpl::updateParams(size_t epoch) {
   }
 }
 
+netfloat_t CpuNeuralNetImpl::trainMiniBatch(const DataArray& X, const DataArray& Y,
+  size_t batchSize, size_t epoch) {
+
+  size_t numWorkers = std::min<size_t>(m_params.threads, batchSize);
+
+  if (numWorkers == 1) {
+    netfloat_t cost = feedForward(m_layers, X, Y, batchSize);
+    backPropagate(m_layers, X, Y, batchSize);
+    updateParams(epoch);
+
+    return cost;
+  }
+
+  const size_t inputSize = X.size() / batchSize;
+  const size_t outputSize = Y.size() / batchSize;
+
+  // Each worker takes a contiguous shard of the mini-batch
+  std::vector<size_t> shardStart(numWorkers + 1);
+  std::vector<DataArray> shardX(numWorkers);
+  std::vector<DataArray> shardY(numWorkers);
+  for (size_t w = 0; w <= numWorkers; ++w) {
+    shardStart[w] = w * batchSize / numWorkers;
+  }
+  for (size_t w = 0; w < numWorkers; ++w) {
+    size_t shardSize = shardStart[w + 1] - shardStart[w];
+    shardX[w] = slice(X, shardStart[w] * inputSize, shardSize * inputSize);
+    shardY[w] = slice(Y, shardStart[w] * outputSize, shardSize * outputSize);
+  }
+
+  // The parameters of worker 0's layers don't change until every worker has finished
+  parallelFor(*m_threadPool, 1, numWorkers, [&](size_t w) {
+    LayerStack& layers = workerLayers(w);
+    for (size_t i = 0; i < layers.size(); ++i) {
+      layers[i]->copyParams(*m_layers[i]);
+    }
+  });
+
+  feedForwardShards(shardX, shardStart);
+
+  netfloat_t cost = 0.0;
+  for (size_t w = 0; w < numWorkers; ++w) {
+    ConstVectorPtr outputs = Vector::createShallow(workerLayers(w).back()->activations());
+    cost += costFn()(*outputs, *Vector::createShallow(shardY[w]));
+  }
+
+  backPropagateShards(shardX, shardY, shardStart);
+  reduceDeltas(numWorkers);
+  updateParams(epoch);
+
+  return cost;
+}
+
 void CpuNeuralNetImpl::train(LabelledDataSet& trainingData) {
+  createReplicas();
+
+  if (m_params.trainingMode == TrainingMode::hogwild) {
+    trainHogwild(trainingData);
+  }
+  else {
+    trainSynchronous(trainingData);
+  }
+
+  compileInferenceLayers();
+  m_isTrained = true;
+}
+
+void CpuNeuralNetImpl::trainSynchronous(LabelledDataSet& trainingData) {
+  const size_t inputSize = calcProduct(m_inputShape);
+  const size_t outputSize = calcProduct(m_layers.back()->outputSize());
+  const size_t miniBatchSize = m_params.miniBatchSize;
+
+  // The current mini-batch, one sample per row
+  DataArray X(miniBatchSize * inputSize, Uninitialised{});
+  DataArray Y(miniBatchSize * outputSize, Uninitialised{});
+
   m_abort = false;
   for (uint32_t epoch = 0; epoch < m_params.epochs; ++epoch) {
     if (m_abort) {
@@ -199,6 +633,24 @@ void CpuNeuralNetImpl::train(LabelledDataSet& trainingData) {
 
     netfloat_t cost = 0.0;
     uint32_t samplesProcessed = 0;
+    size_t batchFill = 0;
+
+    auto flushBatch = [&]() {
+      if (batchFill == miniBatchSize) {
+        cost += trainMiniBatch(X, Y, batchFill, epoch);
+      }
+      else {
+        // Only the last mini-batch of an epoch can be partially filled
+        cost += trainMiniBatch(slice(X, 0, batchFill * inputSize),
+          slice(Y, 0, batchFill * outputSize), batchFill, epoch);
+      }
+
+      for (size_t i = samplesProcessed - batchFill; i < samplesProcessed; ++i) {
+        m_eventSystem.raise(ESampleProcessed{static_cast<uint32_t>(i), m_params.batchSize});
+      }
+
+      batchFill = 0;
+    };
 
     auto pendingSamples = std::async([&]() { return trainingData.loadSamples(); });
     std::vector<Sample> samples = pendingSamples.get();
@@ -206,26 +658,23 @@ void CpuNeuralNetImpl::train(LabelledDataSet& trainingData) {
     while (samples.size() > 0) {
       pendingSamples = std::async([&]() { return trainingData.loadSamples(); });
 
-      DBG_ASSERT_MSG(samples[0].data.size() == calcProduct(m_inputShape),
-        "Sample size is " << samples[0].data.size() << ", expected " << calcProduct(m_inputShape));
+      DBG_ASSERT_MSG(samples[0].data.size() == inputSize,
+        "Sample size is " << samples[0].data.size() << ", expected " << inputSize);
 
       for (size_t i = 0; i < samples.size(); ++i) {
         const auto& sample = samples[i];
         const Array3& x = sample.data;
         const Vector& y = trainingData.classOutputVector(sample.label);
 
-        cost += feedForward(x, y);
-        backPropagate(x, y);
+        std::copy(x.data(), x.data() + inputSize, X.data() + batchFill * inputSize);
+        std::copy(y.data(), y.data() + outputSize, Y.data() + batchFill * outputSize);
+        ++batchFill;
+        ++samplesProcessed;
 
-        bool lastSample = (samplesProcessed + 1) == m_params.batchSize;
-        if (((samplesProcessed + 1) % m_params.miniBatchSize == 0) || lastSample) {
-          updateParams(epoch);
+        if (batchFill == miniBatchSize || samplesProcessed >= m_params.batchSize) {
+          flushBatch();
         }
 
-        m_eventSystem.raise(ESampleProcessed{samplesProcessed, m_params.batchSize});
-
-        ++samplesProcessed;
-
         if (samplesProcessed >= m_params.batchSize) {
           break;
         }
@@ -238,23 +687,144 @@ void CpuNeuralNetImpl::train(LabelledDataSet& trainingData) {
       samples = pendingSamples.get();
     }
 
+    if (batchFill > 0) {
+      flushBatch();
+    }
+
     cost /= samplesProcessed;
     m_eventSystem.raise(EEpochCompleted{epoch, m_params.epochs, cost});
 
     trainingData.seekToBeginning();
   }
+}
 
-  m_isTrained = true;
+void CpuNeuralNetImpl::trainHogwild(LabelledDataSet& trainingData) {
+  const size_t inputSize = calcProduct(m_inputShape);
+  const size_t outputSize = calcProduct(m_layers.back()->outputSize());
+  const size_t miniBatchSize = m_params.miniBatchSize;
+  const size_t numWorkers = m_params.threads;
+
+  // Each worker's current mini-batch
+  std::vector<DataArray> X(numWorkers, DataArray(miniBatchSize * inputSize, Uninitialised{}));
+  std::vector<DataArray> Y(numWorkers, DataArray(miniBatchSize * outputSize, Uninitialised{}));
+
+  m_abort = false;
+  for (uint32_t epoch = 0; epoch < m_params.epochs; ++epoch) {
+    if (m_abort) {
+      break;
+    }
+
+    m_eventSystem.raise(EEpochStarted{epoch, m_params.epochs});
+
+    std::vector<netfloat_t> costs(numWorkers, 0.0);
+    uint32_t samplesProcessed = 0;
+
+    auto pendingSamples = std::async([&]() { return trainingData.loadSamples(); });
+    std::vector<Sample> samples = pendingSamples.get();
+
+    while (samples.size() > 0 && samplesProcessed < m_params.batchSize) {
+      pendingSamples = std::async([&]() { return trainingData.loadSamples(); });
+
+      DBG_ASSERT_MSG(samples[0].data.size() == inputSize,
+        "Sample size is " << samples[0].data.size() << ", expected " << inputSize);
+
+      const size_t numSamples = std::min<size_t>(samples.size(),
+        m_params.batchSize - samplesProcessed);
+      std::atomic<size_t> nextSample = 0;
+
+      // The workers only wait for each other once the loaded samples have been used up
+      parallelFor(*m_threadPool, 0, numWorkers, [&](size_t w) {
+        LayerStack& layers = workerLayers(w);
+
+        while (true) {
+          const size_t first = nextSample.fetch_add(miniBatchSize);
+          if (first >= numSamples) {
+            break;
+          }
+          const size_t batchSize = std::min(miniBatchSize, numSamples - first);
+
+          for (size_t i = 0; i < batchSize; ++i) {
+            const Sample& sample = samples[first + i];
+            const Array3& x = sample.data;
+            const Vector& y = trainingData.classOutputVector(sample.label);
+
+            std::copy(x.data(), x.data() + inputSize, X[w].data() + i * inputSize);
+            std::copy(y.data(), y.data() + outputSize, Y[w].data() + i * outputSize);
+          }
+
+          if (batchSize == miniBatchSize) {
+            costs[w] += feedForward(layers, X[w], Y[w], batchSize);
+            backPropagate(layers, X[w], Y[w], batchSize);
+          }
+          else {
+            DataArray partialX = slice(X[w], 0, batchSize * inputSize);
+            DataArray partialY = slice(Y[w], 0, batchSize * outputSize);
+
+            costs[w] += feedForward(layers, partialX, partialY, batchSize);
+            backPropagate(layers, partialX, partialY, batchSize);
+          }
+
+          // Writes straight to the shared parameters
+          for (auto& layer : layers) {
+            layer->updateParams(epoch);
+          }
+        }
+      });
+
+      for (size_t i = 0; i < numSamples; ++i) {
+        m_eventSystem.raise(ESampleProcessed{samplesProcessed, m_params.batchSize});
+        ++samplesProcessed;
+      }
+
+      samples = pendingSamples.get();
+    }
+
+    netfloat_t cost = 0.0;
+    for (netfloat_t workerCost : costs) {
+      cost += workerCost;
+    }
+    cost /= samplesProcessed;
+
+    m_eventSystem.raise(EEpochCompleted{epoch, m_params.epochs, cost});
+
+    trainingData.seekToBeginning();
+  }
 }
 
 Vector CpuNeuralNetImpl::evaluate(const Array3& x) const {
-  DataArray A;
+  DBG_ASSERT(x.size() == calcProduct(m_inputShape));
+
+  InferencePlanPtr plan;
+  {
+    std::lock_guard lock(m_plansMutex);
+    if (!m_plans.empty()) {
+      plan = std::move(m_plans.back());
+      m_plans.pop_back();
+    }
+  }
 
-  for (size_t i = 0; i < m_layers.size(); ++i) {
-    A = m_layers[i]->evalForward(i == 0 ? x.storage() : A);
+  if (!plan) {
+    plan = std::make_unique<InferencePlan>(m_inferenceLayers);
   }
 
-  return Vector(A);
+  const size_t outputSize = calcProduct(m_layers.back()->outputSize());
+  const netfloat_t* outputs = plan->evaluate(x.data());
+
+  Vector y(outputSize, Uninitialised{});
+  std::copy(outputs, outputs + outputSize, y.data());
+
+  std::lock_guard lock(m_plansMutex);
+  m_plans.push_back(std::move(plan));
+
+  return y;
+}
+
+size_t CpuNeuralNetImpl::evaluationThreads() const {
+  return m_params.threads;
+}
+
+void CpuNeuralNetImpl::parallelEvaluate(size_t n, const std::function<void(size_t)>& fn) const {
+  parallelFor(*m_threadPool, 0, n, fn);
 }
 
 }
@@ -1,6 +1,7 @@
 #include "richard/cpu/dense_layer.hpp"
 #include "richard/utils.hpp"
 #include "richard/config.hpp"
+#include "richard/simd.hpp"
 
 namespace richard {
 namespace cpu {
@@ -9,36 +10,102 @@ DenseLayer::DenseLayer(const Config& config, size_t inputSize) {
   initialize(config, inputSize);
 
   m_W.randomize(0.1f);
+  packWeights();
 }
 
 DenseLayer::DenseLayer(const Config& config, std::istream& stream, size_t inputSize) {
   initialize(config, inputSize);
 
   stream.read(reinterpret_cast<char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
-  stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  if (m_storageType == StorageType::fp32) {
+    stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+  }
+  else {
+    m_packedW.read(stream);
+    m_packedW.unpack(m_W.data());
+  }
+
+  m_optimizerB.read(stream);
+  m_optimizerW.read(stream);
 }
 
 void DenseLayer::initialize(const Config& config, size_t inputSize) {
-  m_activationFn = sigmoid;
-  m_activationFnPrime = sigmoidPrime;
+  m_paramsOwner = nullptr;
+  m_activation = Activation::sigmoid;
 
   size_t size = config.getNumber<size_t>("size");
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
-  m_dropoutRate = config.getNumber<netfloat_t>("dropoutRate");
+  m_dropout = Dropout(config.getNumber<netfloat_t>("dropoutRate"));
+  m_storageType = config.contains("storageType") ?
+    parseStorageType(config.getString("storageType")) : StorageType::fp32;
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
 
   m_B = Vector(size);
   m_W = Matrix(inputSize, size);
+  m_Z = Vector(size);
+  m_A = Vector(size);
 
   m_inputDelta = Vector(inputSize);
   m_deltaB = Vector(size);
   m_deltaW = Matrix(inputSize, size);
+
+  m_optimizerB = Optimizer(optimizer, size);
+  m_optimizerW = Optimizer(optimizer, inputSize * size);
+
+  if (m_storageType != StorageType::fp32) {
+    m_packedW = PackedArray(m_storageType, inputSize * size);
+  }
+}
+
+void DenseLayer::packWeights() {
+  if (m_storageType != StorageType::fp32) {
+    m_packedW.pack(m_W.data());
+  }
+}
+
+void DenseLayer::multiplyWeights(const netfloat_t* X, netfloat_t* Z, size_t batchSize) const {
+  const Matrix& W = weights();
+  const size_t inputSize = W.cols();
+  const size_t size = W.rows();
+
+  // Z = X * W^T. A single sample is a plain matrix-vector product, which avoids packing W.
+  if (m_storageType == StorageType::fp32 && batchSize > 1) {
+    ConstMatrixPtr pX = Matrix::createShallow(X, inputSize, batchSize);
+    MatrixPtr pZ = Matrix::createShallow(Z, size, batchSize);
+    computeMatrixProduct(*pX, W, *pZ, false, true, false, threadPool());
+    return;
+  }
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    const netfloat_t* x = X + n * inputSize;
+    netfloat_t* z = Z + n * size;
+
+    if (m_storageType == StorageType::fp32) {
+      simd::matrixVectorMultiply(W.data(), x, z, inputSize, size);
+    }
+    else {
+      simd::matrixVectorMultiply(m_packedW.data(), m_storageType, x, z, inputSize, size);
+    }
+  }
 }
 
 void DenseLayer::writeToStream(std::ostream& stream) const {
   stream.write(reinterpret_cast<const char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
-  stream.write(reinterpret_cast<const char*>(m_W.data()),
-    m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  // The storage type is recorded in the layer's config, which is saved alongside the model
+  if (m_storageType == StorageType::fp32) {
+    stream.write(reinterpret_cast<const char*>(m_W.data()),
+      m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+  }
+  else {
+    m_packedW.write(stream);
+  }
+
+  m_optimizerB.write(stream);
+  m_optimizerW.write(stream);
 }
 
 Size3 DenseLayer::outputSize() const {
@@ -53,56 +120,173 @@ const DataArray& DenseLayer::inputDelta() const {
   return m_inputDelta.storage();
 }
 
-DataArray DenseLayer::evalForward(const DataArray& inputs) const {
-  ConstVectorPtr pX = Vector::createShallow(inputs);
-  const Vector& x = *pX;
+DataArray DenseLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_W.cols());
 
-  Vector y = (m_W * x + m_B).computeTransform(m_activationFn);
+  DataArray y(batchSize * m_B.size(), Uninitialised{});
+  evalInto(inputs.data(), y.data(), batchSize);
 
-  return y.storage();
+  return y;
 }
 
-void DenseLayer::trainForward(const DataArray& inputs) {
-  auto shouldDrop = [this]() {
-    return rand() / (RAND_MAX + 1.0) < m_dropoutRate;
-  };
+void DenseLayer::evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize,
+  netfloat_t*) const {
 
-  ConstVectorPtr pX = Vector::createShallow(inputs);
-  const Vector& x = *pX;
+  const size_t size = m_B.size();
 
-  m_Z = m_W * x + m_B;
-  m_A = m_Z.computeTransform(m_activationFn);
+  multiplyWeights(inputs, outputs, batchSize);
 
-  for (size_t a = 0; a < m_A.size(); ++a) {
-    if (shouldDrop()) {
-      m_A[a] = 0.0;
+  dispatchActivation(m_activation, false, [&](auto f) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      netfloat_t* z = outputs + n * size;
+      biasAndActivate(f, z, m_B.data(), z, size);
     }
+  });
+}
+
+void DenseLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  DBG_ASSERT(inputs.size() == batchSize * m_W.cols());
+
+  const size_t size = m_B.size();
+
+  if (m_Z.size() != batchSize * size) {
+    m_Z = Vector(batchSize * size, Uninitialised{});
+    m_A = Vector(batchSize * size, Uninitialised{});
   }
+
+  multiplyWeights(inputs.data(), m_Z.data(), batchSize);
+  m_dropout.generateMask(m_Z.size());
+
+  dispatchActivation(m_activation, false, [&](auto f) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t offset = n * size;
+      m_dropout.forward(f, m_Z.data() + offset, biases().data(), m_A.data() + offset, size, offset);
+    }
+  });
 }
 
-void DenseLayer::updateDeltas(const DataArray& inputs, const DataArray& outputDelta) {
-  ConstVectorPtr pDeltaA = Vector::createShallow(outputDelta);
-  const Vector& deltaA = *pDeltaA;
+void DenseLayer::updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  const size_t inputSize = m_W.cols();
+  const size_t size = m_B.size();
 
-  Vector delta = deltaA.hadamard(m_Z.computeTransform(m_activationFnPrime));
-  m_inputDelta = m_W.transposeMultiply(delta);
+  DBG_ASSERT(inputs.size() == batchSize * inputSize);
+  DBG_ASSERT(outputDelta.size() == batchSize * size);
+  DBG_ASSERT(m_Z.size() == batchSize * size);
 
-  m_deltaW += outerProduct(delta, inputs);
-  m_deltaB += delta;
+  Vector delta(batchSize * size, Uninitialised{});
+  dispatchActivation(m_activation, true, [&](auto fPrime) {
+    m_dropout.backward(fPrime, m_Z.data(), outputDelta.data(), delta.data(), delta.size());
+  });
+
+  if (m_inputDelta.size() != batchSize * inputSize) {
+    m_inputDelta = Vector(batchSize * inputSize, Uninitialised{});
+  }
+
+  if (batchSize == 1) {
+    simd::transposeMatrixVectorMultiply(weights().data(), delta.data(), m_inputDelta.data(),
+      inputSize, size);
+    accumulateOuterProduct(delta, *Vector::createShallow(inputs), m_deltaW, 1.0, threadPool());
+  }
+  else {
+    ConstMatrixPtr pDelta = Matrix::createShallow(delta.data(), size, batchSize);
+    ConstMatrixPtr pX = Matrix::createShallow(inputs, inputSize, batchSize);
+    MatrixPtr pInputDelta = Matrix::createShallow(m_inputDelta.data(), inputSize, batchSize);
+
+    computeMatrixProduct(*pDelta, weights(), *pInputDelta, false, false, false,
+      threadPool());
+    computeMatrixProduct(*pDelta, *pX, m_deltaW, true, false, true, threadPool());
+  }
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    m_deltaB += *delta.subvector(n * size, size);
+  }
 }
 
 void DenseLayer::updateParams(size_t epoch) {
   netfloat_t learnRate = m_learnRate * static_cast<netfloat_t>(pow(m_learnRateDecay, epoch));
 
-  m_W -= m_deltaW * learnRate;
-  m_B -= m_deltaB * learnRate;
+  Matrix& W = weights();
+  Vector& B = biases();
+
+  m_optimizerW.nextStep(learnRate);
+  m_optimizerW.update(W.data(), m_deltaW.data(), W.rows() * W.cols());
+
+  m_optimizerB.nextStep(learnRate);
+  m_optimizerB.update(B.data(), m_deltaB.data(), B.size());
+
+  packWeights();
+}
+
+void DenseLayer::mergeDeltas(Layer& replica) {
+  auto& layer = dynamic_cast<DenseLayer&>(replica);
+
+  m_deltaW += layer.m_deltaW;
+  m_deltaB += layer.m_deltaB;
+
+  layer.m_deltaW.zero();
+  layer.m_deltaB.zero();
+}
+
+void DenseLayer::copyParams(const Layer& source) {
+  auto& layer = dynamic_cast<const DenseLayer&>(source);
+
+  m_W = layer.m_W;
+  m_B = layer.m_B;
+  m_packedW = layer.m_packedW;
+}
+
+void DenseLayer::shareParams(Layer& owner) {
+  auto& layer = dynamic_cast<DenseLayer&>(owner);
+
+  ASSERT_MSG(m_storageType == StorageType::fp32 && layer.m_storageType == StorageType::fp32,
+    "Shared parameters must be stored as fp32");
+
+  m_paramsOwner = &layer;
+}
+
+void DenseLayer::setDropoutStream(uint64_t stream) {
+  m_dropout = Dropout(m_dropout.rate(), stream);
+}
+
+// W(scale * x + shift) + B = (W diag(scale)) x + (W shift + B)
+bool DenseLayer::absorbInputTransform(const DataArray& scale, const DataArray& shift) {
+  const size_t inputSize = m_W.cols();
+  const size_t size = m_W.rows();
+
+  DBG_ASSERT(scale.size() == inputSize && shift.size() == inputSize);
+  DBG_ASSERT(m_paramsOwner == nullptr);
+
+  for (size_t j = 0; j < size; ++j) {
+    netfloat_t* w = m_W.data() + j * inputSize;
+
+    for (size_t i = 0; i < inputSize; ++i) {
+      m_B[j] += w[i] * shift[i];
+      w[i] *= scale[i];
+    }
+  }
+
+  packWeights();
+
+  return true;
+}
+
+Matrix& DenseLayer::weights() {
+  return m_paramsOwner ? m_paramsOwner->m_W : m_W;
+}
+
+const Matrix& DenseLayer::weights() const {
+  return m_paramsOwner ? m_paramsOwner->m_W : m_W;
+}
 
-  m_deltaB.zero();
-  m_deltaW.zero();
+Vector& DenseLayer::biases() {
+  return m_paramsOwner ? m_paramsOwner->m_B : m_B;
 }
 
 void DenseLayer::test_setWeights(const DataArray& W) {
   m_W = Matrix(W, m_W.cols(), m_W.rows());
+  packWeights();
 }
 
 void DenseLayer::test_setBiases(const DataArray& B) {
@@ -125,9 +309,8 @@ const Vector& DenseLayer::test_B() const {
   return m_B;
 }
 
-void DenseLayer::test_setActivationFn(ActivationFn f, ActivationFn fPrime) {
-  m_activationFn = f;
-  m_activationFnPrime = fPrime;
+void DenseLayer::test_setActivation(Activation activation) {
+  m_activation = activation;
 }
 
 }
@@ -0,0 +1,322 @@
+#include "richard/cpu/depthwise_separable_layer.hpp"
+#include "richard/exception.hpp"
+#include "richard/utils.hpp"
+#include "richard/config.hpp"
+
+namespace richard {
+namespace cpu {
+namespace {
+
+// The pointwise stage shares the layer's training settings, but has 1x1 kernels that step one
+// pixel at a time over the depthwise output, which is a plain matrix product. Only those settings
+// are copied, so convolution options such as layout, which the pointwise stage can't honour,
+// don't reach it.
+Config pointwiseConfig(const Config& config) {
+  Config pointwise;
+  pointwise.setNumber("depth", config.getNumber<size_t>("depth"));
+  pointwise.setNumber("learnRate", config.getNumber<netfloat_t>("learnRate"));
+  pointwise.setNumber("learnRateDecay", config.getNumber<netfloat_t>("learnRateDecay"));
+  pointwise.setNumber("dropoutRate", config.getNumber<netfloat_t>("dropoutRate"));
+  if (config.contains("optimizer")) {
+    pointwise.setObject("optimizer", config.getObject("optimizer"));
+  }
+  pointwise.setNumberArray<size_t>("kernelSize", { 1, 1 });
+  pointwise.setString("engine", "gemm");
+
+  return pointwise;
+}
+
+}
+
+DepthwiseSeparableLayer::DepthwiseSeparableLayer(const Config& config, const Size3& inputShape) {
+  initialize(config, inputShape);
+
+  m_pointwise = std::make_unique<ConvolutionalLayer>(pointwiseConfig(config),
+    depthwiseOutputSize());
+}
+
+DepthwiseSeparableLayer::DepthwiseSeparableLayer(const Config& config, std::istream& stream,
+  const Size3& inputShape) {
+
+  initialize(config, inputShape);
+
+  stream.read(reinterpret_cast<char*>(m_depthwise.data()), m_depthwise.size() * sizeof(netfloat_t));
+  m_optimizer.read(stream);
+
+  m_pointwise = std::make_unique<ConvolutionalLayer>(pointwiseConfig(config), stream,
+    depthwiseOutputSize());
+}
+
+void DepthwiseSeparableLayer::initialize(const Config& config, const Size3& inputShape) {
+  m_inputW = inputShape[0];
+  m_inputH = inputShape[1];
+  m_inputDepth = inputShape[2];
+
+  auto kernelSize = config.getNumberArray<size_t, 2>("kernelSize");
+  m_learnRate = config.getNumber<netfloat_t>("learnRate");
+  m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
+  m_stride = config.contains("stride") ? config.getNumber<size_t>("stride") : 1;
+  m_padding = config.contains("padding") ? config.getNumber<size_t>("padding") : 0;
+
+  ASSERT_MSG(m_stride > 0, "Convolution stride must be at least 1");
+
+  ASSERT_MSG(kernelSize[0] <= m_inputW + 2 * m_padding,
+    "Kernel width " << kernelSize[0] << " is larger than padded input width "
+    << m_inputW + 2 * m_padding);
+
+  ASSERT_MSG(kernelSize[1] <= m_inputH + 2 * m_padding,
+    "Kernel height " << kernelSize[1] << " is larger than padded input height "
+    << m_inputH + 2 * m_padding);
+
+  m_depthwise = Kernel(kernelSize[0], kernelSize[1], m_inputDepth);
+  m_depthwise.randomize(0.1f);
+  m_depthwiseDelta = Kernel(kernelSize[0], kernelSize[1], m_inputDepth);
+  m_optimizer = Optimizer(optimizer, m_depthwise.size());
+
+  const Size3 shape = depthwiseOutputSize();
+  m_depthwiseZ = Array3(shape[0], shape[1], shape[2]);
+  m_inputDelta = Array3(m_inputW, m_inputH, m_inputDepth);
+}
+
+Size3 DepthwiseSeparableLayer::depthwiseOutputSize() const {
+  return {
+    (m_inputW + 2 * m_padding - m_depthwise.W()) / m_stride + 1,
+    (m_inputH + 2 * m_padding - m_depthwise.H()) / m_stride + 1,
+    m_inputDepth
+  };
+}
+
+Size3 DepthwiseSeparableLayer::outputSize() const {
+  return m_pointwise->outputSize();
+}
+
+const DataArray& DepthwiseSeparableLayer::activations() const {
+  return m_pointwise->activations();
+}
+
+const DataArray& DepthwiseSeparableLayer::inputDelta() const {
+  return m_inputDelta.storage();
+}
+
+void DepthwiseSeparableLayer::setThreadPool(ThreadPool* pool) {
+  Layer::setThreadPool(pool);
+  m_pointwise->setThreadPool(pool);
+}
+
+void DepthwiseSeparableLayer::setDropoutStream(uint64_t stream) {
+  m_pointwise->setDropoutStream(stream);
+}
+
+size_t DepthwiseSeparableLayer::paddedSliceSize() const {
+  return m_padding > 0 ? (m_inputW + 2 * m_padding) * (m_inputH + 2 * m_padding) : 0;
+}
+
+void DepthwiseSeparableLayer::padSlice(const netfloat_t* slice, netfloat_t* padded) const {
+  const size_t paddedW = m_inputW + 2 * m_padding;
+
+  std::fill(padded, padded + paddedSliceSize(), 0.f);
+
+  for (size_t y = 0; y < m_inputH; ++y) {
+    const netfloat_t* src = slice + y * m_inputW;
+    std::copy(src, src + m_inputW, padded + (y + m_padding) * paddedW + m_padding);
+  }
+}
+
+// Each channel of each sample is independent, so they're all split across the thread pool
+void DepthwiseSeparableLayer::depthwiseForward(const netfloat_t* inputs, netfloat_t* Z,
+  size_t batchSize, netfloat_t* padded) const {
+
+  const size_t kW = m_depthwise.W();
+  const size_t kH = m_depthwise.H();
+  const Size3 shape = depthwiseOutputSize();
+  const size_t sliceSize = m_inputW * m_inputH;
+  const size_t fmSize = shape[0] * shape[1];
+
+  parallelFor(0, batchSize * m_inputDepth, [&](size_t i) {
+    const size_t z = i % m_inputDepth;
+    const netfloat_t* slice = inputs + i * sliceSize;
+
+    DataArray ownPadded;
+    if (m_padding > 0) {
+      netfloat_t* paddedSlice = nullptr;
+      if (padded != nullptr) {
+        paddedSlice = padded + i * paddedSliceSize();
+      }
+      else {
+        ownPadded = DataArray(paddedSliceSize(), Uninitialised{});
+        paddedSlice = ownPadded.data();
+      }
+
+      padSlice(slice, paddedSlice);
+      slice = paddedSlice;
+    }
+
+    const Size3 imageShape{ m_inputW + 2 * m_padding, m_inputH + 2 * m_padding, 1 };
+    computeCrossCorrelation(slice, imageShape, m_depthwise.data() + z * kW * kH, kW, kH,
+      Z + i * fmSize, m_stride);
+  });
+}
+
+void DepthwiseSeparableLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
+
+  const Size3 shape = depthwiseOutputSize();
+
+  if (m_depthwiseZ.D() != batchSize * m_inputDepth) {
+    m_depthwiseZ = Array3(shape[0], shape[1], batchSize * m_inputDepth, Uninitialised{});
+  }
+
+  depthwiseForward(inputs.data(), m_depthwiseZ.data(), batchSize);
+  m_pointwise->trainForward(m_depthwiseZ.storage(), batchSize);
+}
+
+DataArray DepthwiseSeparableLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
+
+  DataArray A(batchSize * calcProduct(outputSize()), Uninitialised{});
+  evalInto(inputs.data(), A.data(), batchSize);
+
+  return A;
+}
+
+// The scratch memory holds the depthwise output, then the padded input channels, then the
+// pointwise stage's own scratch memory
+size_t DepthwiseSeparableLayer::evalScratchSize(size_t batchSize) const {
+  return batchSize * (calcProduct(depthwiseOutputSize()) + m_inputDepth * paddedSliceSize())
+    + m_pointwise->evalScratchSize(batchSize);
+}
+
+void DepthwiseSeparableLayer::evalInto(const netfloat_t* inputs, netfloat_t* outputs,
+  size_t batchSize, netfloat_t* scratch) const {
+
+  DataArray ownScratch;
+  if (scratch == nullptr) {
+    ownScratch = DataArray(evalScratchSize(batchSize), Uninitialised{});
+    scratch = ownScratch.data();
+  }
+
+  netfloat_t* Z = scratch;
+  netfloat_t* padded = Z + batchSize * calcProduct(depthwiseOutputSize());
+  netfloat_t* pointwiseScratch = padded + batchSize * m_inputDepth * paddedSliceSize();
+
+  depthwiseForward(inputs, Z, batchSize, padded);
+  m_pointwise->evalInto(Z, outputs, batchSize, pointwiseScratch);
+}
+
+// The depthwise stage is linear, so the pointwise stage's input delta is its delta. As in
+// ConvolutionalLayer, stride and padding are handled by running the stride 1 backward pass on the
+// padded input with the delta spread out stride pixels apart.
+void DepthwiseSeparableLayer::updateDeltas(const DataArray& inputs, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
+
+  m_pointwise->updateDeltas(m_depthwiseZ.storage(), outputDelta, batchSize);
+  const DataArray& delta = m_pointwise->inputDelta();
+
+  if (m_inputDelta.D() != batchSize * m_inputDepth) {
+    m_inputDelta = Array3(m_inputW, m_inputH, batchSize * m_inputDepth, Uninitialised{});
+  }
+
+  const size_t kW = m_depthwise.W();
+  const size_t kH = m_depthwise.H();
+  const size_t paddedW = m_inputW + 2 * m_padding;
+  const size_t paddedH = m_inputH + 2 * m_padding;
+  const Size3 shape = depthwiseOutputSize();
+  const size_t sliceSize = m_inputW * m_inputH;
+  const size_t fmSize = shape[0] * shape[1];
+
+  // Samples are summed into each channel's kernel gradient in a fixed order
+  parallelFor(0, m_inputDepth, [&](size_t z) {
+    ConstMatrixPtr pKernel = m_depthwise.slice(z);
+    MatrixPtr pDeltaK = m_depthwiseDelta.slice(z);
+
+    Array2 padded(paddedW, paddedH);
+    Array2 paddedInputDelta(paddedW, paddedH, Uninitialised{});
+    Array2 dilatedDelta(paddedW - kW + 1, paddedH - kH + 1);
+    Array2 dDeltaK(kW, kH, Uninitialised{});
+
+    for (size_t n = 0; n < batchSize; ++n) {
+      const size_t i = n * m_inputDepth + z;
+      const netfloat_t* D = delta.data() + i * fmSize;
+
+      for (size_t y = 0; y < shape[1]; ++y) {
+        for (size_t x = 0; x < shape[0]; ++x) {
+          dilatedDelta.set(x * m_stride, y * m_stride, D[y * shape[0] + x]);
+        }
+      }
+
+      padSlice(inputs.data() + i * sliceSize, padded.data());
+
+      computeCrossCorrelation(padded, dilatedDelta, dDeltaK);
+      *pDeltaK += dDeltaK;
+
+      computeFullConvolution(*pKernel, dilatedDelta, paddedInputDelta);
+
+      netfloat_t* inputDelta = m_inputDelta.data() + i * sliceSize;
+      for (size_t y = 0; y < m_inputH; ++y) {
+        const netfloat_t* src = paddedInputDelta.data() + (y + m_padding) * paddedW + m_padding;
+        std::copy(src, src + m_inputW, inputDelta + y * m_inputW);
+      }
+    }
+  });
+}
+
+void DepthwiseSeparableLayer::updateParams(size_t epoch) {
+  netfloat_t learnRate = m_learnRate * static_cast<netfloat_t>(pow(m_learnRateDecay, epoch));
+
+  m_optimizer.nextStep(learnRate);
+  m_optimizer.update(m_depthwise.data(), m_depthwiseDelta.data(), m_depthwise.size());
+
+  m_pointwise->updateParams(epoch);
+}
+
+void DepthwiseSeparableLayer::writeToStream(std::ostream& stream) const {
+  stream.write(reinterpret_cast<const char*>(m_depthwise.data()),
+    m_depthwise.size() * sizeof(netfloat_t));
+  m_optimizer.write(stream);
+
+  m_pointwise->writeToStream(stream);
+}
+
+void DepthwiseSeparableLayer::mergeDeltas(Layer& replica) {
+  auto& layer = dynamic_cast<DepthwiseSeparableLayer&>(replica);
+
+  m_depthwiseDelta += layer.m_depthwiseDelta;
+  layer.m_depthwiseDelta.zero();
+
+  m_pointwise->mergeDeltas(*layer.m_pointwise);
+}
+
+void DepthwiseSeparableLayer::copyParams(const Layer& source) {
+  auto& layer = dynamic_cast<const DepthwiseSeparableLayer&>(source);
+
+  m_depthwise = layer.m_depthwise;
+  m_pointwise->copyParams(*layer.m_pointwise);
+}
+
+void DepthwiseSeparableLayer::shareParams(Layer&) {
+  EXCEPTION("Depthwise separable layers don't support asynchronous training");
+}
+
+void DepthwiseSeparableLayer::test_setDepthwiseKernels(const DataArray& kernels) {
+  DBG_ASSERT(kernels.size() == m_depthwise.size());
+  std::copy(kernels.data(), kernels.data() + kernels.size(), m_depthwise.data());
+}
+
+const Kernel& DepthwiseSeparableLayer::test_depthwiseKernels() const {
+  return m_depthwise;
+}
+
+const Kernel& DepthwiseSeparableLayer::test_depthwiseDeltas() const {
+  return m_depthwiseDelta;
+}
+
+ConvolutionalLayer& DepthwiseSeparableLayer::test_pointwise() {
+  return *m_pointwise;
+}
+
+}
+}
@@ -0,0 +1,58 @@
+#include "richard/cpu/dropout.hpp"
+#include "richard/exception.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace richard {
+namespace cpu {
+namespace {
+
+// Each draw is 16 bits, so a Philox block decides 8 elements
+const uint32_t DRAW_BITS = 16;
+const uint32_t DRAW_RANGE = 1 << DRAW_BITS;
+const uint32_t DRAWS_PER_BLOCK = 128 / DRAW_BITS;
+
+}
+
+Dropout::Dropout(netfloat_t rate, uint64_t stream)
+  : m_rate(rate)
+  , m_scale(rate < 1.f ? 1.f / (1.f - rate) : 0.f)
+  , m_threshold(static_cast<uint32_t>(std::round(rate * DRAW_RANGE)))
+  , m_rng(stream) {
+
+  ASSERT_MSG(rate >= 0.f && rate <= 1.f, "Dropout rate must be between 0 and 1");
+}
+
+uint64_t Dropout::streamKey(uint32_t seed, size_t layerIndex, size_t worker) {
+  ASSERT_MSG(layerIndex < 0x10000 && worker < 0x10000, "Too many layers or workers for dropout");
+  return (static_cast<uint64_t>(seed) << 32) | (worker << 16) | layerIndex;
+}
+
+netfloat_t Dropout::rate() const {
+  return m_rate;
+}
+
+void Dropout::generateMask(size_t size) {
+  m_mask.resize((size + 31) / 32);
+
+  if (m_threshold == 0) {
+    std::fill(m_mask.begin(), m_mask.end(), 0xffffffff);
+    return;
+  }
+
+  for (uint32_t& word : m_mask) {
+    word = 0;
+
+    for (uint32_t bit = 0; bit < 32; bit += DRAWS_PER_BLOCK) {
+      Philox::Block block = m_rng.next();
+
+      for (uint32_t k = 0; k < DRAWS_PER_BLOCK; ++k) {
+        uint32_t draw = (block[k / 2] >> (DRAW_BITS * (k % 2))) & (DRAW_RANGE - 1);
+        word |= static_cast<uint32_t>(draw >= m_threshold) << (bit + k);
+      }
+    }
+  }
+}
+
+}
+}
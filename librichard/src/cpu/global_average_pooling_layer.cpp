@@ -0,0 +1,79 @@
+#include "richard/cpu/global_average_pooling_layer.hpp"
+#include "richard/exception.hpp"
+#include "richard/simd.hpp"
+#include <algorithm>
+
+namespace richard {
+namespace cpu {
+
+GlobalAveragePoolingLayer::GlobalAveragePoolingLayer(const Config&, const Size3& inputShape)
+  : m_A(inputShape[2])
+  , m_inputDelta(inputShape[0], inputShape[1], inputShape[2])
+  , m_inputW(inputShape[0])
+  , m_inputH(inputShape[1])
+  , m_inputDepth(inputShape[2]) {}
+
+Size3 GlobalAveragePoolingLayer::outputSize() const {
+  return { 1, 1, m_inputDepth };
+}
+
+const DataArray& GlobalAveragePoolingLayer::activations() const {
+  return m_A.storage();
+}
+
+const DataArray& GlobalAveragePoolingLayer::inputDelta() const {
+  return m_inputDelta.storage();
+}
+
+// As with max pooling, a batch is treated as a single image whose depth is
+// batchSize * m_inputDepth
+void GlobalAveragePoolingLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  if (m_A.size() != batchSize * m_inputDepth) {
+    m_A = Vector(batchSize * m_inputDepth, Uninitialised{});
+  }
+
+  evalInto(inputs.data(), m_A.data(), batchSize);
+}
+
+DataArray GlobalAveragePoolingLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
+
+  DataArray A(batchSize * m_inputDepth, Uninitialised{});
+  evalInto(inputs.data(), A.data(), batchSize);
+
+  return A;
+}
+
+void GlobalAveragePoolingLayer::evalInto(const netfloat_t* inputs, netfloat_t* A,
+  size_t batchSize, netfloat_t*) const {
+
+  const size_t sliceSize = m_inputW * m_inputH;
+  const netfloat_t scale = 1.f / static_cast<netfloat_t>(sliceSize);
+
+  parallelFor(0, batchSize * m_inputDepth, [&](size_t z) {
+    A[z] = simd::sum(inputs + z * sliceSize, sliceSize) * scale;
+  });
+}
+
+// Every input contributes equally to its slice's mean
+void GlobalAveragePoolingLayer::updateDeltas(const DataArray&, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  const size_t depth = batchSize * m_inputDepth;
+  const size_t sliceSize = m_inputW * m_inputH;
+  const netfloat_t scale = 1.f / static_cast<netfloat_t>(sliceSize);
+
+  DBG_ASSERT(outputDelta.size() == depth);
+
+  if (m_inputDelta.D() != depth) {
+    m_inputDelta = Array3(m_inputW, m_inputH, depth, Uninitialised{});
+  }
+
+  parallelFor(0, depth, [&](size_t z) {
+    netfloat_t* slice = m_inputDelta.data() + z * sliceSize;
+    std::fill(slice, slice + sliceSize, outputDelta[z] * scale);
+  });
+}
+
+}
+}
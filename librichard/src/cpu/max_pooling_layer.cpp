@@ -10,25 +10,35 @@ MaxPoolingLayer::MaxPoolingLayer(const Config& config, const Size3& inputShape)
   : m_inputDelta(inputShape[0], inputShape[1], inputShape[2])
   , m_inputW(inputShape[0])
   , m_inputH(inputShape[1])
-  , m_inputDepth(inputShape[2])
-  , m_mask(m_inputW, m_inputH, m_inputDepth) {
+  , m_inputDepth(inputShape[2]) {
 
   auto regionSize = config.getNumberArray<size_t, 2>("regionSize");
   m_regionW = regionSize[0];
   m_regionH = regionSize[1];
 
-  ASSERT_MSG(m_inputW % m_regionW == 0,
-    "Region width " << m_regionW << " does not divide input width " << m_inputW);
-  ASSERT_MSG(m_inputH % m_regionH == 0,
-    "Region height " << m_regionH << " does not divide input height " << m_inputH);
-
-  m_Z = Array3(m_inputW / m_regionW, m_inputH / m_regionH, m_inputDepth);
+  // Regions are adjacent by default
+  auto stride = config.contains("stride") ? config.getNumberArray<size_t, 2>("stride") :
+    regionSize;
+  m_strideX = stride[0];
+  m_strideY = stride[1];
+
+  ASSERT_MSG(m_strideX > 0 && m_strideY > 0, "Pooling stride must be at least 1");
+  ASSERT_MSG(m_regionW <= m_inputW,
+    "Region width " << m_regionW << " is larger than input width " << m_inputW);
+  ASSERT_MSG(m_regionH <= m_inputH,
+    "Region height " << m_regionH << " is larger than input height " << m_inputH);
+  ASSERT_MSG(m_inputW * m_inputH <= std::numeric_limits<uint32_t>::max(),
+    "Input slices are too large to index with 32 bits");
+
+  Size3 shape = outputSize();
+  m_Z = Array3(shape[0], shape[1], shape[2]);
+  m_argmax.resize(m_Z.size());
 }
 
 Size3 MaxPoolingLayer::outputSize() const {
   return {
-    static_cast<size_t>(m_inputW / m_regionW),
-    static_cast<size_t>(m_inputH / m_regionH),
+    (m_inputW - m_regionW) / m_strideX + 1,
+    (m_inputH - m_regionH) / m_strideY + 1,
     m_inputDepth
   };
 }
@@ -41,111 +51,133 @@ const DataArray& MaxPoolingLayer::inputDelta() const {
   return m_inputDelta.storage();
 }
 
-void MaxPoolingLayer::trainForward(const DataArray& inputs) {
-  ConstArray3Ptr pImage = Array3::createShallow(inputs, m_inputW, m_inputH, m_inputDepth);
-  const Array3& image = *pImage;
-
-  size_t outputW = m_inputW / m_regionW;
-  size_t outputH = m_inputH / m_regionH;
-
-  for (size_t z = 0; z < m_inputDepth; ++z) {
-    for (size_t y = 0; y < outputH; ++y) {
-      for (size_t x = 0; x < outputW; ++x) {
-        netfloat_t largest = std::numeric_limits<netfloat_t>::lowest();
-        size_t largestInputX = 0;
-        size_t largestInputY = 0;
-
-        for (size_t j = 0; j < m_regionH; ++j) {
-          for (size_t i = 0; i < m_regionW; ++i) {
-            size_t imgX = x * m_regionW + i;
-            size_t imgY = y * m_regionH + j;
-            netfloat_t input = image.at(imgX, imgY, z);
-
-            if (input > largest) {
-              largest = input;
-              largestInputX = imgX;
-              largestInputY = imgY;
-            }
+size_t MaxPoolingLayer::regionMax(const netfloat_t* image, size_t x, size_t y) const {
+  netfloat_t largest = std::numeric_limits<netfloat_t>::lowest();
+  size_t largestOffset = (y * m_strideY) * m_inputW + x * m_strideX;
 
-            m_mask.set(imgX, imgY, z, 0.0);
-          }
-        }
+  for (size_t j = 0; j < m_regionH; ++j) {
+    const size_t rowOffset = (y * m_strideY + j) * m_inputW + x * m_strideX;
 
-        m_mask.set(largestInputX, largestInputY, z, 1.0);
-        m_Z.set(x, y, z, largest);
+    for (size_t i = 0; i < m_regionW; ++i) {
+      if (image[rowOffset + i] > largest) {
+        largest = image[rowOffset + i];
+        largestOffset = rowOffset + i;
       }
     }
   }
+
+  return largestOffset;
 }
 
-DataArray MaxPoolingLayer::evalForward(const DataArray& inputs) const {
-  ConstArray3Ptr pImage = Array3::createShallow(inputs, m_inputW, m_inputH, m_inputDepth);
-  const Array3& image = *pImage;
+// A batch is pooled as a single image whose depth is batchSize * m_inputDepth
+void MaxPoolingLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  const size_t depth = batchSize * m_inputDepth;
 
-  size_t outputW = m_inputW / m_regionW;
-  size_t outputH = m_inputH / m_regionH;
+  DBG_ASSERT(inputs.size() == depth * m_inputW * m_inputH);
 
-  Array3 Z(outputW, outputH, m_inputDepth);
+  const Size3 shape = outputSize();
+  const size_t outputW = shape[0];
+  const size_t outputH = shape[1];
 
-  for (size_t z = 0; z < m_inputDepth; ++z) {
-    for (size_t y = 0; y < outputH; ++y) {
-      for (size_t x = 0; x < outputW; ++x) {
-        netfloat_t largest = std::numeric_limits<netfloat_t>::lowest();
+  if (m_Z.D() != depth) {
+    m_Z = Array3(outputW, outputH, depth, Uninitialised{});
+    m_argmax.resize(m_Z.size());
+  }
 
-        for (size_t j = 0; j < m_regionH; ++j) {
-          for (size_t i = 0; i < m_regionW; ++i) {
-            size_t imgX = x * m_regionW + i;
-            size_t imgY = y * m_regionH + j;
-            netfloat_t input = image.at(imgX, imgY, z);
+  parallelFor(0, depth, [&](size_t z) {
+    const netfloat_t* image = inputs.data() + z * m_inputW * m_inputH;
+    netfloat_t* featureMap = m_Z.data() + z * outputW * outputH;
+    uint32_t* argmax = m_argmax.data() + z * outputW * outputH;
 
-            if (input > largest) {
-              largest = input;
-            }
-          }
-        }
+    for (size_t y = 0; y < outputH; ++y) {
+      for (size_t x = 0; x < outputW; ++x) {
+        const size_t offset = regionMax(image, x, y);
 
-        Z.set(x, y, z, largest);
+        featureMap[y * outputW + x] = image[offset];
+        argmax[y * outputW + x] = static_cast<uint32_t>(offset);
       }
     }
-  }
+  });
+}
 
-  return Z.storage();
+DataArray MaxPoolingLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_inputW * m_inputH * m_inputDepth);
+
+  DataArray Z(batchSize * calcProduct(outputSize()), Uninitialised{});
+  evalInto(inputs.data(), Z.data(), batchSize);
+
+  return Z;
 }
 
-void MaxPoolingLayer::updateDeltas(const DataArray&, const DataArray& outputDelta) {
-  ConstArray3Ptr pDelta = Array3::createShallow(outputDelta, m_Z.W(), m_Z.H(), m_Z.D());
-  const Array3& delta = *pDelta;
+void MaxPoolingLayer::evalInto(const netfloat_t* inputs, netfloat_t* Z, size_t batchSize,
+  netfloat_t*) const {
+
+  const size_t depth = batchSize * m_inputDepth;
 
-  size_t outputW = m_inputW / m_regionW;
-  size_t outputH = m_inputH / m_regionH;
+  const Size3 shape = outputSize();
+  const size_t outputW = shape[0];
+  const size_t outputH = shape[1];
+
+  parallelFor(0, depth, [&](size_t z) {
+    const netfloat_t* image = inputs + z * m_inputW * m_inputH;
+    netfloat_t* featureMap = Z + z * outputW * outputH;
 
-  for (size_t z = 0; z < m_inputDepth; ++z) {
     for (size_t y = 0; y < outputH; ++y) {
       for (size_t x = 0; x < outputW; ++x) {
+        netfloat_t largest = std::numeric_limits<netfloat_t>::lowest();
+
         for (size_t j = 0; j < m_regionH; ++j) {
-          for (size_t i = 0; i < m_regionW; ++i) {
-            size_t imgX = x * m_regionW + i;
-            size_t imgY = y * m_regionH + j;
+          const netfloat_t* row = image + (y * m_strideY + j) * m_inputW + x * m_strideX;
 
-            if (m_mask.at(imgX, imgY, z) != 0.0) {
-              m_inputDelta.set(imgX, imgY, z, delta.at(x, y, z));
-            }
-            else {
-              m_inputDelta.set(imgX, imgY, z, 0.0);
+          for (size_t i = 0; i < m_regionW; ++i) {
+            if (row[i] > largest) {
+              largest = row[i];
             }
           }
         }
+
+        featureMap[y * outputW + x] = largest;
       }
     }
+  });
+}
+
+// Inputs that no region covers get a zero delta, and an input that wins several overlapping
+// regions gets the sum of their deltas
+void MaxPoolingLayer::updateDeltas(const DataArray&, const DataArray& outputDelta,
+  size_t batchSize) {
+
+  const size_t depth = batchSize * m_inputDepth;
+
+  const Size3 shape = outputSize();
+  const size_t fmSize = shape[0] * shape[1];
+
+  DBG_ASSERT(m_argmax.size() == depth * fmSize);
+  DBG_ASSERT(outputDelta.size() == depth * fmSize);
+
+  if (m_inputDelta.D() != depth) {
+    m_inputDelta = Array3(m_inputW, m_inputH, depth, Uninitialised{});
   }
+
+  parallelFor(0, depth, [&](size_t z) {
+    netfloat_t* inputDelta = m_inputDelta.data() + z * m_inputW * m_inputH;
+    const netfloat_t* delta = outputDelta.data() + z * fmSize;
+    const uint32_t* argmax = m_argmax.data() + z * fmSize;
+
+    std::fill(inputDelta, inputDelta + m_inputW * m_inputH, 0.f);
+
+    for (size_t i = 0; i < fmSize; ++i) {
+      inputDelta[argmax[i]] += delta[i];
+    }
+  });
 }
 
-void MaxPoolingLayer::test_setMask(const Array3& mask) {
-  m_mask = mask;
+void MaxPoolingLayer::test_setArgmax(const std::vector<uint32_t>& argmax) {
+  m_argmax = argmax;
 }
 
-const Array3& MaxPoolingLayer::test_mask() const {
-  return m_mask;
+const std::vector<uint32_t>& MaxPoolingLayer::test_argmax() const {
+  return m_argmax;
 }
 
 }
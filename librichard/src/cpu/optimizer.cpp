@@ -0,0 +1,97 @@
+#include "richard/cpu/optimizer.hpp"
+#include "richard/exception.hpp"
+#include <cmath>
+
+namespace richard {
+namespace cpu {
+
+Optimizer::Optimizer()
+  : m_learnRate(0.0)
+  , m_epsilon(0.0) {}
+
+Optimizer::Optimizer(const OptimizerParams& params, size_t size)
+  : m_params(params)
+  , m_state(params.type, size)
+  , m_learnRate(0.0)
+  , m_epsilon(params.epsilon) {}
+
+void Optimizer::nextStep(netfloat_t learnRate) {
+  ++m_state.step;
+
+  m_learnRate = learnRate;
+  m_epsilon = m_params.epsilon;
+
+  if (m_params.type == OptimizerType::adam) {
+    netfloat_t scale = 1.0;
+    adamCorrection(m_params, m_state.step, scale, m_epsilon);
+    m_learnRate *= scale;
+  }
+}
+
+void Optimizer::update(netfloat_t* params, netfloat_t* gradients, size_t size, size_t offset) {
+  const netfloat_t lr = m_learnRate;
+  const netfloat_t beta1 = m_params.beta1;
+  const netfloat_t beta2 = m_params.beta2;
+  const netfloat_t epsilon = m_epsilon;
+  netfloat_t* v = m_state.first.data() + offset;
+  netfloat_t* s = m_state.second.data() + offset;
+
+  DBG_ASSERT(m_state.first.size() == 0 || offset + size <= m_state.first.size());
+  DBG_ASSERT(m_state.second.size() == 0 || offset + size <= m_state.second.size());
+
+  switch (m_params.type) {
+    case OptimizerType::sgd: {
+      for (size_t i = 0; i < size; ++i) {
+        params[i] -= lr * gradients[i];
+        gradients[i] = 0.0;
+      }
+      break;
+    }
+    case OptimizerType::momentum: {
+      for (size_t i = 0; i < size; ++i) {
+        v[i] = beta1 * v[i] + gradients[i];
+        params[i] -= lr * v[i];
+        gradients[i] = 0.0;
+      }
+      break;
+    }
+    case OptimizerType::nesterov: {
+      for (size_t i = 0; i < size; ++i) {
+        v[i] = beta1 * v[i] + gradients[i];
+        params[i] -= lr * (gradients[i] + beta1 * v[i]);
+        gradients[i] = 0.0;
+      }
+      break;
+    }
+    case OptimizerType::rmsProp: {
+      for (size_t i = 0; i < size; ++i) {
+        const netfloat_t g = gradients[i];
+        s[i] = beta2 * s[i] + (1.f - beta2) * g * g;
+        params[i] -= lr * g / (std::sqrt(s[i]) + epsilon);
+        gradients[i] = 0.0;
+      }
+      break;
+    }
+    case OptimizerType::adam: {
+      for (size_t i = 0; i < size; ++i) {
+        const netfloat_t g = gradients[i];
+        v[i] = beta1 * v[i] + (1.f - beta1) * g;
+        s[i] = beta2 * s[i] + (1.f - beta2) * g * g;
+        params[i] -= lr * v[i] / (std::sqrt(s[i]) + epsilon);
+        gradients[i] = 0.0;
+      }
+      break;
+    }
+  }
+}
+
+void Optimizer::read(std::istream& stream) {
+  m_state.read(stream);
+}
+
+void Optimizer::write(std::ostream& stream) const {
+  m_state.write(stream);
+}
+
+}
+}
@@ -1,6 +1,7 @@
 #include "richard/cpu/output_layer.hpp"
 #include "richard/utils.hpp"
 #include "richard/config.hpp"
+#include "richard/simd.hpp"
 
 namespace richard {
 namespace cpu {
@@ -16,28 +17,43 @@ OutputLayer::OutputLayer(const Config& config, std::istream& stream, size_t inpu
 
   stream.read(reinterpret_cast<char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
   stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  m_optimizerB.read(stream);
+  m_optimizerW.read(stream);
 }
 
 void OutputLayer::initialize(const Config& config, size_t inputSize) {
-  m_activationFn = sigmoid;
-  m_activationFnPrime = sigmoidPrime;
+  m_paramsOwner = nullptr;
+  m_activation = Activation::sigmoid;
 
   size_t size = config.getNumber<size_t>("size");
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  m_costType = config.contains("cost") ?
+    parseCostType(config.getString("cost")) : CostType::quadratic;
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
 
   m_B = Vector(size);
   m_W = Matrix(inputSize, size);
+  m_Z = Vector(size);
+  m_A = Vector(size);
 
   m_inputDelta = Vector(inputSize);
   m_deltaB = Vector(size);
   m_deltaW = Matrix(inputSize, size);
+
+  m_optimizerB = Optimizer(optimizer, size);
+  m_optimizerW = Optimizer(optimizer, inputSize * size);
 }
 
 void OutputLayer::writeToStream(std::ostream& stream) const {
   stream.write(reinterpret_cast<const char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
   stream.write(reinterpret_cast<const char*>(m_W.data()),
     m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  m_optimizerB.write(stream);
+  m_optimizerW.write(stream);
 }
 
 const DataArray& OutputLayer::activations() const {
@@ -48,48 +64,191 @@ const DataArray& OutputLayer::inputDelta() const {
   return m_inputDelta.storage();
 }
 
-DataArray OutputLayer::evalForward(const DataArray& inputs) const {
-  ConstVectorPtr pX = Vector::createShallow(inputs);
-  const Vector& x = *pX;
+void OutputLayer::multiplyWeights(const netfloat_t* X, netfloat_t* Z, size_t batchSize) const {
+  const Matrix& W = weights();
+  const size_t inputSize = W.cols();
+  const size_t size = W.rows();
+
+  // Z = X * W^T. A single sample is a plain matrix-vector product, which avoids packing W.
+  if (batchSize == 1) {
+    simd::matrixVectorMultiply(W.data(), X, Z, inputSize, size);
+    return;
+  }
+
+  ConstMatrixPtr pX = Matrix::createShallow(X, inputSize, batchSize);
+  MatrixPtr pZ = Matrix::createShallow(Z, size, batchSize);
+  computeMatrixProduct(*pX, W, *pZ, false, true, false, threadPool());
+}
+
+DataArray OutputLayer::evalForward(const DataArray& inputs, size_t batchSize) const {
+  DBG_ASSERT(inputs.size() == batchSize * m_W.cols());
+
+  DataArray y(batchSize * m_B.size(), Uninitialised{});
+  evalInto(inputs.data(), y.data(), batchSize);
+
+  return y;
+}
+
+void OutputLayer::evalInto(const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize,
+  netfloat_t*) const {
+
+  multiplyWeights(inputs, outputs, batchSize);
+  activate(outputs, m_B.data(), outputs, batchSize);
+}
+
+void OutputLayer::activate(netfloat_t* Z, const netfloat_t* B, netfloat_t* A,
+  size_t batchSize) const {
+
+  const size_t size = m_B.size();
 
-  Vector y = (m_W * x + m_B).computeTransform(m_activationFn);
+  if (m_costType == CostType::crossEntropy) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      biasAndSoftmax(Z + n * size, B, A + n * size, size);
+    }
+    return;
+  }
 
-  return y.storage();
+  dispatchActivation(m_activation, false, [&](auto f) {
+    for (size_t n = 0; n < batchSize; ++n) {
+      biasAndActivate(f, Z + n * size, B, A + n * size, size);
+    }
+  });
 }
 
 Size3 OutputLayer::outputSize() const {
   return { m_B.size(), 1, 1 };
 }
 
-void OutputLayer::trainForward(const DataArray& inputs) {
-  ConstVectorPtr pX = Vector::createShallow(inputs);
-  const Vector& x = *pX;
+void OutputLayer::trainForward(const DataArray& inputs, size_t batchSize) {
+  DBG_ASSERT(inputs.size() == batchSize * m_W.cols());
 
-  m_Z = m_W * x + m_B;
-  m_A = m_Z.computeTransform(m_activationFn);
+  const size_t size = m_B.size();
+
+  if (m_Z.size() != batchSize * size) {
+    m_Z = Vector(batchSize * size, Uninitialised{});
+    m_A = Vector(batchSize * size, Uninitialised{});
+  }
+
+  multiplyWeights(inputs.data(), m_Z.data(), batchSize);
+  activate(m_Z.data(), biases().data(), m_A.data(), batchSize);
 }
 
-void OutputLayer::updateDeltas(const DataArray& inputs, const DataArray& outputs) {
-  ConstVectorPtr pY = Vector::createShallow(outputs);
-  const Vector& y = *pY;
+void OutputLayer::updateDeltas(const DataArray& inputs, const DataArray& outputs,
+  size_t batchSize) {
+
+  const size_t inputSize = m_W.cols();
+  const size_t size = m_B.size();
 
-  Vector deltaC = quadraticCostDerivatives(m_A, y);
-  Vector delta = m_Z.computeTransform(m_activationFnPrime).hadamard(deltaC);
+  DBG_ASSERT(inputs.size() == batchSize * inputSize);
+  DBG_ASSERT(outputs.size() == batchSize * size);
+  DBG_ASSERT(m_Z.size() == batchSize * size);
 
-  m_inputDelta = m_W.transposeMultiply(delta);
+  ConstVectorPtr pY = Vector::createShallow(outputs);
+  const Vector& y = *pY;
 
-  m_deltaW += outerProduct(delta, inputs);
-  m_deltaB += delta;
+  // A - y, which for cross-entropy is already the gradient with respect to Z, as the softmax
+  // Jacobian cancels with the derivative of the log
+  Vector delta = quadraticCostDerivatives(m_A, y);
+  if (m_costType == CostType::quadratic) {
+    Vector activationPrime = m_Z;
+    applyActivationPrime(m_activation, activationPrime);
+    delta = activationPrime.hadamard(delta);
+  }
+
+  if (m_inputDelta.size() != batchSize * inputSize) {
+    m_inputDelta = Vector(batchSize * inputSize, Uninitialised{});
+  }
+
+  if (batchSize == 1) {
+    simd::transposeMatrixVectorMultiply(weights().data(), delta.data(), m_inputDelta.data(),
+      inputSize, size);
+    accumulateOuterProduct(delta, *Vector::createShallow(inputs), m_deltaW, 1.0, threadPool());
+  }
+  else {
+    ConstMatrixPtr pDelta = Matrix::createShallow(delta.data(), size, batchSize);
+    ConstMatrixPtr pX = Matrix::createShallow(inputs, inputSize, batchSize);
+    MatrixPtr pInputDelta = Matrix::createShallow(m_inputDelta.data(), inputSize, batchSize);
+
+    computeMatrixProduct(*pDelta, weights(), *pInputDelta, false, false, false,
+      threadPool());
+    computeMatrixProduct(*pDelta, *pX, m_deltaW, true, false, true, threadPool());
+  }
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    m_deltaB += *delta.subvector(n * size, size);
+  }
 }
 
 void OutputLayer::updateParams(size_t epoch) {
   netfloat_t learnRate = m_learnRate * static_cast<netfloat_t>(pow(m_learnRateDecay, epoch));
 
-  m_W -= m_deltaW * learnRate;
-  m_B -= m_deltaB * learnRate;
+  Matrix& W = weights();
+  Vector& B = biases();
+
+  m_optimizerW.nextStep(learnRate);
+  m_optimizerW.update(W.data(), m_deltaW.data(), W.rows() * W.cols());
+
+  m_optimizerB.nextStep(learnRate);
+  m_optimizerB.update(B.data(), m_deltaB.data(), B.size());
+}
+
+void OutputLayer::mergeDeltas(Layer& replica) {
+  auto& layer = dynamic_cast<OutputLayer&>(replica);
+
+  m_deltaW += layer.m_deltaW;
+  m_deltaB += layer.m_deltaB;
+
+  layer.m_deltaW.zero();
+  layer.m_deltaB.zero();
+}
+
+void OutputLayer::copyParams(const Layer& source) {
+  auto& layer = dynamic_cast<const OutputLayer&>(source);
+
+  m_W = layer.m_W;
+  m_B = layer.m_B;
+}
+
+void OutputLayer::shareParams(Layer& owner) {
+  auto& layer = dynamic_cast<OutputLayer&>(owner);
+
+  m_paramsOwner = &layer;
+}
+
+CostType OutputLayer::costType() const {
+  return m_costType;
+}
+
+// W(scale * x + shift) + B = (W diag(scale)) x + (W shift + B)
+bool OutputLayer::absorbInputTransform(const DataArray& scale, const DataArray& shift) {
+  const size_t inputSize = m_W.cols();
+  const size_t size = m_W.rows();
+
+  DBG_ASSERT(scale.size() == inputSize && shift.size() == inputSize);
+  DBG_ASSERT(m_paramsOwner == nullptr);
+
+  for (size_t j = 0; j < size; ++j) {
+    netfloat_t* w = m_W.data() + j * inputSize;
+
+    for (size_t i = 0; i < inputSize; ++i) {
+      m_B[j] += w[i] * shift[i];
+      w[i] *= scale[i];
+    }
+  }
+
+  return true;
+}
+
+Matrix& OutputLayer::weights() {
+  return m_paramsOwner ? m_paramsOwner->m_W : m_W;
+}
+
+const Matrix& OutputLayer::weights() const {
+  return m_paramsOwner ? m_paramsOwner->m_W : m_W;
+}
 
-  m_deltaB.zero();
-  m_deltaW.zero();
+Vector& OutputLayer::biases() {
+  return m_paramsOwner ? m_paramsOwner->m_B : m_B;
 }
 
 void OutputLayer::test_setWeights(const DataArray& W) {
@@ -116,9 +275,8 @@ const Vector& OutputLayer::test_B() const {
   return m_B;
 }
 
-void OutputLayer::test_setActivationFn(ActivationFn f, ActivationFn fPrime) {
-  m_activationFn = f;
-  m_activationFnPrime = fPrime;
+void OutputLayer::test_setActivation(Activation activation) {
+  m_activation = activation;
 }
 
 }
@@ -34,6 +34,9 @@ ConvolutionalLayer::ConvolutionalLayer(Gpu& gpu, FileSystem& fileSystem,
     stream.read(reinterpret_cast<char*>(m_kernelData.data() + i * kernelSize),
       kernelSize * sizeof(netfloat_t));
   }
+
+  m_optimizerB.read(stream);
+  m_optimizerK.read(stream);
 }
 
 void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShape,
@@ -44,12 +47,18 @@ void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShap
   m_inputDepth = inputShape[2];
   m_kernelSize = config.getNumberArray<size_t, 2>("kernelSize");
   m_depth = config.getNumber<size_t>("depth");
+  m_stride = config.contains("stride") ? config.getNumber<size_t>("stride") : 1;
+  m_padding = config.contains("padding") ? config.getNumber<size_t>("padding") : 0;
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
   m_dropoutRate = config.getNumber<netfloat_t>("dropoutRate");
   m_isFirstLayer = isFirstLayer;
   m_kernelData = Vector(m_kernelSize[0] * m_kernelSize[1] * m_inputDepth * m_depth);
   m_biasData = Vector(m_depth);
+  m_optimizerK = Optimizer(optimizer, m_kernelData.size());
+  m_optimizerB = Optimizer(optimizer, m_depth);
 
   Size3 kernelShape{ m_kernelSize[0], m_kernelSize[1], m_inputDepth };
   size_t kernelSize = calcProduct(kernelShape);
@@ -58,11 +67,15 @@ void ConvolutionalLayer::initialize(const Config& config, const Size3& inputShap
     kernel->randomize(0.1f);
   }
 
-  ASSERT_MSG(m_kernelSize[0] <= m_inputW,
-    "Kernel width " << m_kernelSize[0] << " is larger than input width " << m_inputW);
+  ASSERT_MSG(m_stride > 0, "Convolution stride must be at least 1");
+
+  ASSERT_MSG(m_kernelSize[0] <= m_inputW + 2 * m_padding,
+    "Kernel width " << m_kernelSize[0] << " is larger than padded input width "
+    << m_inputW + 2 * m_padding);
 
-  ASSERT_MSG(m_kernelSize[1] <= m_inputH,
-    "Kernel height " << m_kernelSize[1] << " is larger than input height " << m_inputH);
+  ASSERT_MSG(m_kernelSize[1] <= m_inputH + 2 * m_padding,
+    "Kernel height " << m_kernelSize[1] << " is larger than padded input height "
+    << m_inputH + 2 * m_padding);
 }
 
 void ConvolutionalLayer::allocateGpuBuffers() {
@@ -94,6 +107,9 @@ void ConvolutionalLayer::allocateGpuBuffers() {
   m_gpu.submitBufferData(m_bufferDeltaB.handle, deltaBData.data());
 
   m_gpu.submitBufferData(m_bufferB.handle, m_biasData.data());
+
+  m_optimizerK.allocateGpuBuffers(m_gpu);
+  m_optimizerB.allocateGpuBuffers(m_gpu);
 }
 
 void ConvolutionalLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle statusBuffer,
@@ -120,7 +136,11 @@ void ConvolutionalLayer::createEvalForwardShader(GpuBufferHandle inputBuffer) {
   SpecializationConstants constants{
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
   };
 
   std::string shaderName = "convolutional_eval_forward.spv";
@@ -148,7 +168,11 @@ void ConvolutionalLayer::createTrainForwardShader(GpuBufferHandle statusBuffer,
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
     { SpecializationConstant::Type::bool_type, m_isFirstLayer },
-    { SpecializationConstant::Type::float_type, m_dropoutRate }
+    { SpecializationConstant::Type::float_type, m_dropoutRate },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
   };
 
   std::string shaderName = "convolutional_train_forward.spv";
@@ -186,7 +210,11 @@ void ConvolutionalLayer::createBackpropInputDeltaShader() {
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_depth) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_depth) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(outputSize()[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(outputSize()[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
   };
 
   std::string shaderName = "convolutional_backprop_input_delta.spv";
@@ -215,7 +243,11 @@ void ConvolutionalLayer::createBackpropParamDeltasShader(GpuBufferHandle statusB
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
-    { SpecializationConstant::Type::bool_type, m_isFirstLayer }
+    { SpecializationConstant::Type::bool_type, m_isFirstLayer },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
   };
 
   std::string shaderName = "convolutional_backprop_param_deltas.spv";
@@ -233,15 +265,24 @@ void ConvolutionalLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer)
     { m_bufferK.handle, BufferAccessMode::write },
     { m_bufferB.handle, BufferAccessMode::write },
     { m_bufferDeltaK.handle, BufferAccessMode::write },
-    { m_bufferDeltaB.handle, BufferAccessMode::write }
+    { m_bufferDeltaB.handle, BufferAccessMode::write },
+    { m_optimizerK.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerB.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerK.secondMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerB.secondMomentBuffer(), BufferAccessMode::write }
   };
 
+  const OptimizerParams& optimizer = m_optimizerK.params();
+
   SpecializationConstants constants{
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
     { SpecializationConstant::Type::float_type, m_learnRate },
-    { SpecializationConstant::Type::float_type, m_learnRateDecay }
+    { SpecializationConstant::Type::float_type, m_learnRateDecay },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(optimizer.type) },
+    { SpecializationConstant::Type::float_type, optimizer.beta1 },
+    { SpecializationConstant::Type::float_type, optimizer.beta2 }
   };
 
   std::string shaderName = "convolutional_update_params.spv";
@@ -249,7 +290,8 @@ void ConvolutionalLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer)
 
   Size3 workSize{ m_kernelSize[0] * m_kernelSize[1], m_inputDepth, m_depth };
 
-  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
+  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants,
+    sizeof(OptimizerConstants), workSize);
 }
 
 size_t ConvolutionalLayer::size() const {
@@ -258,8 +300,8 @@ size_t ConvolutionalLayer::size() const {
 
 Size3 ConvolutionalLayer::outputSize() const {
   return {
-    m_inputW - m_kernelSize[0] + 1,
-    m_inputH - m_kernelSize[1] + 1,
+    (m_inputW + 2 * m_padding - m_kernelSize[0]) / m_stride + 1,
+    (m_inputH + 2 * m_padding - m_kernelSize[1]) / m_stride + 1,
     m_depth
   };
 }
@@ -280,7 +322,10 @@ void ConvolutionalLayer::backprop() {
 }
 
 void ConvolutionalLayer::updateParams() {
-  m_gpu.queueShader(m_updateParamsShader);
+  OptimizerConstants constants = m_optimizerK.nextStep();
+  m_optimizerB.nextStep();
+
+  m_gpu.queueShader(m_updateParamsShader, &constants);
 }
 
 GpuBufferHandle ConvolutionalLayer::outputBuffer() const {
@@ -302,6 +347,9 @@ GpuBufferHandle ConvolutionalLayer::inputDeltaBuffer() const {
 void ConvolutionalLayer::retrieveBuffers() {
   m_gpu.retrieveBuffer(m_bufferK.handle, m_kernelData.data());
   m_gpu.retrieveBuffer(m_bufferB.handle, m_biasData.data());
+
+  m_optimizerK.retrieveBuffers(m_gpu);
+  m_optimizerB.retrieveBuffers(m_gpu);
 }
 
 void ConvolutionalLayer::writeToStream(std::ostream& stream) const {
@@ -312,6 +360,9 @@ void ConvolutionalLayer::writeToStream(std::ostream& stream) const {
     stream.write(reinterpret_cast<const char*>(m_kernelData.data() + i * kernelSize),
       kernelSize * sizeof(netfloat_t));
   }
+
+  m_optimizerB.write(stream);
+  m_optimizerK.write(stream);
 }
 
 void ConvolutionalLayer::test_setKernels(const DataArray& kernelData) {
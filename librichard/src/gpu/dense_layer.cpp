@@ -3,6 +3,7 @@
 #include "richard/file_system.hpp"
 #include "richard/platform_paths.hpp"
 #include "richard/config.hpp"
+#include "richard/precision.hpp"
 
 namespace richard {
 namespace gpu {
@@ -25,7 +26,18 @@ DenseLayer::DenseLayer(Gpu& gpu, FileSystem& fileSystem, const PlatformPaths& pl
   initialize(config, inputSize, isFirstLayer);
 
   stream.read(reinterpret_cast<char*>(m_B.data()), m_size * sizeof(netfloat_t));
-  stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  if (m_storageType == StorageType::fp32) {
+    stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+  }
+  else {
+    PackedArray packedW(m_storageType, m_W.rows() * m_W.cols());
+    packedW.read(stream);
+    packedW.unpack(m_W.data());
+  }
+
+  m_optimizerB.read(stream);
+  m_optimizerW.read(stream);
 }
 
 void DenseLayer::initialize(const Config& config, size_t inputSize, bool isFirstLayer) {
@@ -35,11 +47,18 @@ void DenseLayer::initialize(const Config& config, size_t inputSize, bool isFirst
   m_size = config.getNumber<size_t>("size");
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
   m_dropoutRate = config.getNumber<netfloat_t>("dropoutRate");
+  m_storageType = config.contains("storageType") ?
+    parseStorageType(config.getString("storageType")) : StorageType::fp32;
 
   m_B = Vector(m_size);
   m_W = Matrix(m_inputSize, m_size);
 
+  m_optimizerB = Optimizer(optimizer, m_size);
+  m_optimizerW = Optimizer(optimizer, m_inputSize * m_size);
+
   m_W.randomize(0.1f);
 }
 
@@ -69,6 +88,9 @@ void DenseLayer::allocateGpuBuffers() {
 
   Vector deltaB(m_B.size());
   m_gpu.submitBufferData(m_bufferDeltaB.handle, deltaB.data());
+
+  m_optimizerB.allocateGpuBuffers(m_gpu);
+  m_optimizerW.allocateGpuBuffers(m_gpu);
 }
 
 void DenseLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle statusBuffer,
@@ -141,15 +163,13 @@ void DenseLayer::createBackpropDeltaShader(GpuBufferHandle statusBuffer,
     { m_bufferZ.handle, BufferAccessMode::read },
     { m_bufferA.handle, BufferAccessMode::read },
     { m_bufferD.handle, BufferAccessMode::write },
-    { nextLayer->weightsBuffer(), BufferAccessMode::read },
-    { nextLayer->deltaBuffer(), BufferAccessMode::read },
+    { nextLayer->inputDeltaBuffer(), BufferAccessMode::read },
     { m_bufferDeltaB.handle, BufferAccessMode::write },
     { m_bufferDeltaW.handle, BufferAccessMode::write }
   };
 
   SpecializationConstants constants{
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(nextLayer->size()) },
     { SpecializationConstant::Type::bool_type, m_isFirstLayer },
   };
 
@@ -188,13 +208,22 @@ void DenseLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer) {
     { m_bufferB.handle, BufferAccessMode::write },
     { m_bufferW.handle, BufferAccessMode::write },
     { m_bufferDeltaB.handle, BufferAccessMode::write },
-    { m_bufferDeltaW.handle, BufferAccessMode::write }
+    { m_bufferDeltaW.handle, BufferAccessMode::write },
+    { m_optimizerB.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerW.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerB.secondMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerW.secondMomentBuffer(), BufferAccessMode::write }
   };
 
+  const OptimizerParams& optimizer = m_optimizerW.params();
+
   SpecializationConstants constants{
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
     { SpecializationConstant::Type::float_type, m_learnRate },
     { SpecializationConstant::Type::float_type, m_learnRateDecay },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(optimizer.type) },
+    { SpecializationConstant::Type::float_type, optimizer.beta1 },
+    { SpecializationConstant::Type::float_type, optimizer.beta2 }
   };
 
   std::string shaderName = "dense_update_params.spv";
@@ -202,7 +231,8 @@ void DenseLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer) {
 
   Size3 workSize{ m_inputSize, m_size, 1 };
 
-  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
+  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants,
+    sizeof(OptimizerConstants), workSize);
 }
 
 size_t DenseLayer::size() const {
@@ -228,7 +258,10 @@ void DenseLayer::backprop() {
 }
 
 void DenseLayer::updateParams() {
-  m_gpu.queueShader(m_updateParamsShader);
+  OptimizerConstants constants = m_optimizerW.nextStep();
+  m_optimizerB.nextStep();
+
+  m_gpu.queueShader(m_updateParamsShader, &constants);
 }
 
 GpuBufferHandle DenseLayer::outputBuffer() const {
@@ -250,12 +283,26 @@ GpuBufferHandle DenseLayer::inputDeltaBuffer() const {
 void DenseLayer::retrieveBuffers() {
   m_gpu.retrieveBuffer(m_bufferB.handle, m_B.data());
   m_gpu.retrieveBuffer(m_bufferW.handle, m_W.data());
+
+  m_optimizerB.retrieveBuffers(m_gpu);
+  m_optimizerW.retrieveBuffers(m_gpu);
 }
 
 void DenseLayer::writeToStream(std::ostream& stream) const {
   stream.write(reinterpret_cast<const char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
-  stream.write(reinterpret_cast<const char*>(m_W.data()),
-    m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  if (m_storageType == StorageType::fp32) {
+    stream.write(reinterpret_cast<const char*>(m_W.data()),
+      m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+  }
+  else {
+    PackedArray packedW(m_storageType, m_W.rows() * m_W.cols());
+    packedW.pack(m_W.data());
+    packedW.write(stream);
+  }
+
+  m_optimizerB.write(stream);
+  m_optimizerW.write(stream);
 }
 
 void DenseLayer::test_setWeights(const DataArray& W) {
@@ -0,0 +1,336 @@
+#include "richard/gpu/depthwise_separable_layer.hpp"
+#include "richard/utils.hpp"
+#include "richard/file_system.hpp"
+#include "richard/platform_paths.hpp"
+#include "richard/config.hpp"
+
+namespace richard {
+namespace gpu {
+namespace {
+
+// The pointwise stage shares the layer's training settings, but has 1x1 kernels that step one
+// pixel at a time over the depthwise output, which is a plain matrix product. Only those settings
+// are copied, so convolution options such as layout, which the pointwise stage can't honour,
+// don't reach it.
+Config pointwiseConfig(const Config& config) {
+  Config pointwise;
+  pointwise.setNumber("depth", config.getNumber<size_t>("depth"));
+  pointwise.setNumber("learnRate", config.getNumber<netfloat_t>("learnRate"));
+  pointwise.setNumber("learnRateDecay", config.getNumber<netfloat_t>("learnRateDecay"));
+  pointwise.setNumber("dropoutRate", config.getNumber<netfloat_t>("dropoutRate"));
+  if (config.contains("optimizer")) {
+    pointwise.setObject("optimizer", config.getObject("optimizer"));
+  }
+  pointwise.setNumberArray<size_t>("kernelSize", { 1, 1 });
+
+  return pointwise;
+}
+
+}
+
+DepthwiseSeparableLayer::DepthwiseSeparableLayer(Gpu& gpu, FileSystem& fileSystem,
+  const PlatformPaths& platformPaths, const Config& config, const Size3& inputShape,
+  bool isFirstLayer)
+  : m_gpu(gpu)
+  , m_fileSystem(fileSystem)
+  , m_platformPaths(platformPaths) {
+
+  initialize(config, inputShape, isFirstLayer);
+
+  m_pointwise = std::make_unique<ConvolutionalLayer>(gpu, fileSystem, platformPaths,
+    pointwiseConfig(config), depthwiseOutputSize(), false);
+}
+
+DepthwiseSeparableLayer::DepthwiseSeparableLayer(Gpu& gpu, FileSystem& fileSystem,
+  const PlatformPaths& platformPaths, const Config& config, std::istream& stream,
+  const Size3& inputShape, bool isFirstLayer)
+  : m_gpu(gpu)
+  , m_fileSystem(fileSystem)
+  , m_platformPaths(platformPaths) {
+
+  initialize(config, inputShape, isFirstLayer);
+
+  stream.read(reinterpret_cast<char*>(m_depthwiseData.data()),
+    m_depthwiseData.size() * sizeof(netfloat_t));
+  m_optimizer.read(stream);
+
+  m_pointwise = std::make_unique<ConvolutionalLayer>(gpu, fileSystem, platformPaths,
+    pointwiseConfig(config), stream, depthwiseOutputSize(), false);
+}
+
+void DepthwiseSeparableLayer::initialize(const Config& config, const Size3& inputShape,
+  bool isFirstLayer) {
+
+  m_inputW = inputShape[0];
+  m_inputH = inputShape[1];
+  m_inputDepth = inputShape[2];
+  m_kernelSize = config.getNumberArray<size_t, 2>("kernelSize");
+  m_stride = config.contains("stride") ? config.getNumber<size_t>("stride") : 1;
+  m_padding = config.contains("padding") ? config.getNumber<size_t>("padding") : 0;
+  m_learnRate = config.getNumber<netfloat_t>("learnRate");
+  m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
+  m_isFirstLayer = isFirstLayer;
+
+  ASSERT_MSG(m_stride > 0, "Convolution stride must be at least 1");
+
+  ASSERT_MSG(m_kernelSize[0] <= m_inputW + 2 * m_padding,
+    "Kernel width " << m_kernelSize[0] << " is larger than padded input width "
+    << m_inputW + 2 * m_padding);
+
+  ASSERT_MSG(m_kernelSize[1] <= m_inputH + 2 * m_padding,
+    "Kernel height " << m_kernelSize[1] << " is larger than padded input height "
+    << m_inputH + 2 * m_padding);
+
+  m_depthwiseData = Vector(m_kernelSize[0] * m_kernelSize[1] * m_inputDepth);
+  m_depthwiseData.randomize(0.1f);
+  m_optimizer = Optimizer(optimizer, m_depthwiseData.size());
+}
+
+Size3 DepthwiseSeparableLayer::depthwiseOutputSize() const {
+  return {
+    (m_inputW + 2 * m_padding - m_kernelSize[0]) / m_stride + 1,
+    (m_inputH + 2 * m_padding - m_kernelSize[1]) / m_stride + 1,
+    m_inputDepth
+  };
+}
+
+void DepthwiseSeparableLayer::allocateGpuBuffers() {
+  size_t kernelSizeBytes = m_depthwiseData.size() * sizeof(netfloat_t);
+  size_t featureMapSizeBytes = calcProduct(depthwiseOutputSize()) * sizeof(netfloat_t);
+  size_t inputSizeBytes = m_inputW * m_inputH * m_inputDepth * sizeof(netfloat_t);
+
+  GpuBufferFlags paramBuffersFlags = GpuBufferFlags::large
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+
+  m_bufferK = m_gpu.allocateBuffer(kernelSizeBytes, paramBuffersFlags);
+  m_bufferDeltaK = m_gpu.allocateBuffer(kernelSizeBytes,
+    GpuBufferFlags::large | GpuBufferFlags::hostWriteAccess);
+  m_bufferZ = m_gpu.allocateBuffer(featureMapSizeBytes, GpuBufferFlags::large);
+  m_bufferInputDelta = m_gpu.allocateBuffer(inputSizeBytes, GpuBufferFlags::large);
+
+  m_gpu.submitBufferData(m_bufferK.handle, m_depthwiseData.data());
+
+  Vector deltaKData(m_depthwiseData.size());
+  m_gpu.submitBufferData(m_bufferDeltaK.handle, deltaKData.data());
+
+  m_optimizer.allocateGpuBuffers(m_gpu);
+
+  m_pointwise->allocateGpuBuffers();
+}
+
+void DepthwiseSeparableLayer::createGpuShaders(GpuBufferHandle inputBuffer,
+  GpuBufferHandle statusBuffer, const Layer* nextLayer, GpuBufferHandle sampleYBuffer) {
+
+  DBG_ASSERT(nextLayer != nullptr);
+
+  // The eval input buffer holds a single sample, even for the first layer
+  m_evalForwardShader = createForwardShader(statusBuffer, inputBuffer, false);
+  m_trainForwardShader = createForwardShader(statusBuffer, inputBuffer, m_isFirstLayer);
+
+  m_pointwise->createGpuShaders(m_bufferZ.handle, statusBuffer, nextLayer, sampleYBuffer);
+
+  createBackpropInputDeltaShader();
+  createBackpropParamDeltasShader(statusBuffer, inputBuffer);
+  createUpdateParamsShader(statusBuffer);
+}
+
+ShaderHandle DepthwiseSeparableLayer::createForwardShader(GpuBufferHandle statusBuffer,
+  GpuBufferHandle inputBuffer, bool isFirstLayer) {
+
+  GpuBufferBindings buffers{
+    { statusBuffer, BufferAccessMode::read },
+    { inputBuffer, BufferAccessMode::read },
+    { m_bufferK.handle, BufferAccessMode::read },
+    { m_bufferZ.handle, BufferAccessMode::write }
+  };
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
+    { SpecializationConstant::Type::bool_type, isFirstLayer },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
+  };
+
+  std::string shaderName = "depthwise_forward.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize = depthwiseOutputSize();
+
+  return m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
+}
+
+void DepthwiseSeparableLayer::createBackpropInputDeltaShader() {
+  GpuBufferBindings buffers{
+    { m_bufferK.handle, BufferAccessMode::read },
+    { m_pointwise->inputDeltaBuffer(), BufferAccessMode::read },
+    { m_bufferInputDelta.handle, BufferAccessMode::write }
+  };
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(depthwiseOutputSize()[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(depthwiseOutputSize()[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
+  };
+
+  std::string shaderName = "depthwise_backprop_input_delta.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize{ m_inputW, m_inputH, m_inputDepth };
+
+  m_backpropInputDeltaShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0,
+    workSize);
+}
+
+void DepthwiseSeparableLayer::createBackpropParamDeltasShader(GpuBufferHandle statusBuffer,
+  GpuBufferHandle inputBuffer) {
+
+  GpuBufferBindings buffers{
+    { statusBuffer, BufferAccessMode::read },
+    { inputBuffer, BufferAccessMode::read },
+    { m_pointwise->inputDeltaBuffer(), BufferAccessMode::read },
+    { m_bufferDeltaK.handle, BufferAccessMode::write }
+  };
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(depthwiseOutputSize()[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(depthwiseOutputSize()[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputDepth) },
+    { SpecializationConstant::Type::bool_type, m_isFirstLayer },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_stride) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_padding) }
+  };
+
+  std::string shaderName = "depthwise_backprop_param_deltas.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize{ m_kernelSize[0] * m_kernelSize[1], m_inputDepth, 1 };
+
+  m_backpropParamDeltasShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0,
+    workSize);
+}
+
+void DepthwiseSeparableLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer) {
+  GpuBufferBindings buffers{
+    { statusBuffer, BufferAccessMode::read },
+    { m_bufferK.handle, BufferAccessMode::write },
+    { m_bufferDeltaK.handle, BufferAccessMode::write },
+    { m_optimizer.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizer.secondMomentBuffer(), BufferAccessMode::write }
+  };
+
+  const OptimizerParams& optimizer = m_optimizer.params();
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[0]) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_kernelSize[1]) },
+    { SpecializationConstant::Type::float_type, m_learnRate },
+    { SpecializationConstant::Type::float_type, m_learnRateDecay },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(optimizer.type) },
+    { SpecializationConstant::Type::float_type, optimizer.beta1 },
+    { SpecializationConstant::Type::float_type, optimizer.beta2 }
+  };
+
+  std::string shaderName = "depthwise_update_params.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize{ m_kernelSize[0] * m_kernelSize[1], m_inputDepth, 1 };
+
+  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants,
+    sizeof(OptimizerConstants), workSize);
+}
+
+size_t DepthwiseSeparableLayer::size() const {
+  return m_pointwise->size();
+}
+
+Size3 DepthwiseSeparableLayer::outputSize() const {
+  return m_pointwise->outputSize();
+}
+
+void DepthwiseSeparableLayer::evalForward() {
+  m_gpu.queueShader(m_evalForwardShader);
+  m_pointwise->evalForward();
+}
+
+void DepthwiseSeparableLayer::trainForward() {
+  m_gpu.queueShader(m_trainForwardShader);
+  m_pointwise->trainForward();
+}
+
+// The depthwise stage is linear, so the pointwise stage's input delta is its delta
+void DepthwiseSeparableLayer::backprop() {
+  m_pointwise->backprop();
+  m_gpu.queueShader(m_backpropInputDeltaShader);
+  m_gpu.queueShader(m_backpropParamDeltasShader);
+}
+
+void DepthwiseSeparableLayer::updateParams() {
+  OptimizerConstants constants = m_optimizer.nextStep();
+  m_gpu.queueShader(m_updateParamsShader, &constants);
+
+  m_pointwise->updateParams();
+}
+
+GpuBufferHandle DepthwiseSeparableLayer::outputBuffer() const {
+  return m_pointwise->outputBuffer();
+}
+
+GpuBufferHandle DepthwiseSeparableLayer::weightsBuffer() const {
+  return m_pointwise->weightsBuffer();
+}
+
+GpuBufferHandle DepthwiseSeparableLayer::deltaBuffer() const {
+  return m_pointwise->deltaBuffer();
+}
+
+GpuBufferHandle DepthwiseSeparableLayer::inputDeltaBuffer() const {
+  return m_bufferInputDelta.handle;
+}
+
+void DepthwiseSeparableLayer::retrieveBuffers() {
+  m_gpu.retrieveBuffer(m_bufferK.handle, m_depthwiseData.data());
+  m_optimizer.retrieveBuffers(m_gpu);
+
+  m_pointwise->retrieveBuffers();
+}
+
+void DepthwiseSeparableLayer::writeToStream(std::ostream& stream) const {
+  stream.write(reinterpret_cast<const char*>(m_depthwiseData.data()),
+    m_depthwiseData.size() * sizeof(netfloat_t));
+  m_optimizer.write(stream);
+
+  m_pointwise->writeToStream(stream);
+}
+
+void DepthwiseSeparableLayer::test_setDepthwiseKernels(const DataArray& kernels) {
+  m_depthwiseData = kernels;
+}
+
+const Vector& DepthwiseSeparableLayer::test_depthwiseKernels() const {
+  return m_depthwiseData;
+}
+
+GpuBufferHandle DepthwiseSeparableLayer::test_deltaKBuffer() const {
+  return m_bufferDeltaK.handle;
+}
+
+ConvolutionalLayer& DepthwiseSeparableLayer::test_pointwise() {
+  return *m_pointwise;
+}
+
+}
+}
@@ -0,0 +1,111 @@
+#include "richard/gpu/global_average_pooling_layer.hpp"
+#include "richard/utils.hpp"
+#include "richard/file_system.hpp"
+#include "richard/platform_paths.hpp"
+#include "richard/config.hpp"
+
+namespace richard {
+namespace gpu {
+
+GlobalAveragePoolingLayer::GlobalAveragePoolingLayer(Gpu& gpu, FileSystem& fileSystem,
+  const PlatformPaths& platformPaths, const Config&, const Size3& inputShape)
+  : m_gpu(gpu)
+  , m_fileSystem(fileSystem)
+  , m_platformPaths(platformPaths)
+  , m_inputW(inputShape[0])
+  , m_inputH(inputShape[1])
+  , m_inputDepth(inputShape[2]) {}
+
+void GlobalAveragePoolingLayer::allocateGpuBuffers() {
+  size_t inputSize = m_inputW * m_inputH * m_inputDepth;
+
+  m_bufferA = m_gpu.allocateBuffer(size() * sizeof(netfloat_t), GpuBufferFlags::large);
+  m_bufferInputDelta = m_gpu.allocateBuffer(inputSize * sizeof(netfloat_t), GpuBufferFlags::large);
+}
+
+void GlobalAveragePoolingLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle,
+  const Layer* nextLayer, GpuBufferHandle) {
+
+  DBG_ASSERT(nextLayer != nullptr);
+
+  createForwardShader(inputBuffer);
+  createBackpropShader(nextLayer);
+}
+
+void GlobalAveragePoolingLayer::createForwardShader(GpuBufferHandle inputBuffer) {
+  GpuBufferBindings buffers{
+    { inputBuffer, BufferAccessMode::read },
+    { m_bufferA.handle, BufferAccessMode::write }
+  };
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) }
+  };
+
+  std::string shaderName = "global_average_pooling_forward.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize = outputSize();
+
+  m_forwardShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
+}
+
+void GlobalAveragePoolingLayer::createBackpropShader(const Layer* nextLayer) {
+  GpuBufferBindings buffers{
+    { nextLayer->inputDeltaBuffer(), BufferAccessMode::read },
+    { m_bufferInputDelta.handle, BufferAccessMode::write }
+  };
+
+  std::string shaderName = "global_average_pooling_backprop.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize{ m_inputW, m_inputH, m_inputDepth };
+
+  m_backpropShader = m_gpu.addShader(shaderName, shaderCode, buffers, {}, 0, workSize);
+}
+
+size_t GlobalAveragePoolingLayer::size() const {
+  return calcProduct(outputSize());
+}
+
+Size3 GlobalAveragePoolingLayer::outputSize() const {
+  return { 1, 1, m_inputDepth };
+}
+
+void GlobalAveragePoolingLayer::evalForward() {
+  m_gpu.queueShader(m_forwardShader);
+}
+
+void GlobalAveragePoolingLayer::trainForward() {
+  m_gpu.queueShader(m_forwardShader);
+}
+
+void GlobalAveragePoolingLayer::backprop() {
+  m_gpu.queueShader(m_backpropShader);
+}
+
+void GlobalAveragePoolingLayer::updateParams() {}
+
+GpuBufferHandle GlobalAveragePoolingLayer::outputBuffer() const {
+  return m_bufferA.handle;
+}
+
+GpuBufferHandle GlobalAveragePoolingLayer::weightsBuffer() const {
+  EXCEPTION("Global average pooling layer does not have a weights buffer");
+}
+
+GpuBufferHandle GlobalAveragePoolingLayer::deltaBuffer() const {
+  EXCEPTION("Global average pooling layer does not have a delta buffer");
+}
+
+GpuBufferHandle GlobalAveragePoolingLayer::inputDeltaBuffer() const {
+  return m_bufferInputDelta.handle;
+}
+
+void GlobalAveragePoolingLayer::retrieveBuffers() {}
+
+void GlobalAveragePoolingLayer::writeToStream(std::ostream&) const {}
+
+}
+}
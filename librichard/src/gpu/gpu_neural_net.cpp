@@ -3,7 +3,9 @@
 #include "richard/gpu/dense_layer.hpp"
 #include "richard/gpu/output_layer.hpp"
 #include "richard/gpu/convolutional_layer.hpp"
+#include "richard/gpu/depthwise_separable_layer.hpp"
 #include "richard/gpu/max_pooling_layer.hpp"
+#include "richard/gpu/global_average_pooling_layer.hpp"
 #include "richard/neural_net.hpp"
 #include "richard/event_system.hpp"
 #include "richard/exception.hpp"
@@ -14,6 +16,9 @@
 #include <atomic>
 #include <future>
 #include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 namespace richard {
 namespace gpu {
@@ -24,6 +29,19 @@ const NeuralNet::CostFn quadradicCost = [](const Vector& actual, const Vector& e
   return (expected - actual).squareMagnitude() * netfloat_t(0.5);
 };
 
+const NeuralNet::CostFn crossEntropyCost = [](const Vector& actual, const Vector& expected) {
+  DBG_ASSERT(actual.size() == expected.size());
+
+  netfloat_t cost = 0.0;
+  for (size_t i = 0; i < actual.size(); ++i) {
+    if (expected[i] != 0.0) {
+      cost -= expected[i] * std::log(std::max(actual[i], std::numeric_limits<netfloat_t>::min()));
+    }
+  }
+
+  return cost;
+};
+
 struct StatusBuffer {
   uint32_t epoch = 0;
   uint32_t sampleIndex = 0;
@@ -44,6 +62,8 @@ class GpuNeuralNet : public NeuralNet {
     void writeToStream(std::ostream& stream) const override;
     void train(LabelledDataSet& data) override;
     Vector evaluate(const Array3& inputs) const override;
+    size_t evaluationThreads() const override;
+    void parallelEvaluate(size_t n, const std::function<void(size_t)>& fn) const override;
     ModelDetails modelDetails() const override;
 
     void abort() override;
@@ -128,7 +148,9 @@ ModelDetails GpuNeuralNet::modelDetails() const {
   return ModelDetails{
     { "Batch size", std::to_string(m_params.batchSize) },
     { "Mini-batch size", std::to_string(m_params.miniBatchSize) },
-    { "Epochs", std::to_string(m_params.epochs) }
+    { "Epochs", std::to_string(m_params.epochs) },
+    { "Cost",
+      outputLayer().costType() == CostType::crossEntropy ? "cross-entropy" : "quadratic" }
   };
 }
 
@@ -155,10 +177,26 @@ LayerPtr GpuNeuralNet::constructLayer(const Config& config, const Size3& prevLay
       std::make_unique<ConvolutionalLayer>(*m_gpu, m_fileSystem, m_platformPaths, config,
         prevLayerSize, isFirstLayer);
   }
+  else if (type == "depthwiseSeparable") {
+    return stream ?
+      std::make_unique<DepthwiseSeparableLayer>(*m_gpu, m_fileSystem, m_platformPaths, config,
+        *stream, prevLayerSize, isFirstLayer) :
+      std::make_unique<DepthwiseSeparableLayer>(*m_gpu, m_fileSystem, m_platformPaths, config,
+        prevLayerSize, isFirstLayer);
+  }
   else if (type == "maxPooling") {
     return std::make_unique<MaxPoolingLayer>(*m_gpu, m_fileSystem, m_platformPaths, config,
       prevLayerSize);
   }
+  else if (type == "globalAveragePooling") {
+    return std::make_unique<GlobalAveragePoolingLayer>(*m_gpu, m_fileSystem, m_platformPaths,
+      config, prevLayerSize);
+  }
+  else if (type == "batchNorm") {
+    // Training runs each sample through every layer before starting the next, so there are no
+    // mini-batch statistics to normalise with
+    EXCEPTION("Batch normalization is not supported by the GPU backend");
+  }
   else if (type == "output") {
     return stream ?
       std::make_unique<OutputLayer>(*m_gpu, m_fileSystem, m_platformPaths, config, *stream,
@@ -177,7 +215,7 @@ OutputLayer& GpuNeuralNet::outputLayer() const {
 }
 
 NeuralNet::CostFn GpuNeuralNet::costFn() const {
-  return quadradicCost;
+  return outputLayer().costType() == CostType::crossEntropy ? crossEntropyCost : quadradicCost;
 }
 
 void GpuNeuralNet::writeToStream(std::ostream& stream) const {
@@ -239,7 +277,9 @@ void GpuNeuralNet::allocateGpuResources() {
   };
 
   SpecializationConstants computeCostsConstants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_params.miniBatchSize) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_params.miniBatchSize) },
+    { SpecializationConstant::Type::bool_type,
+      outputLayer().costType() == CostType::crossEntropy }
   };
 
   std::string computeCostsShaderName = "compute_costs.spv";
@@ -364,6 +404,17 @@ Vector GpuNeuralNet::evaluate(const Array3& sample) const {
   return outputLayer().activations();
 }
 
+size_t GpuNeuralNet::evaluationThreads() const {
+  // evaluate shares the input buffer and command queue
+  return 1;
+}
+
+void GpuNeuralNet::parallelEvaluate(size_t n, const std::function<void(size_t)>& fn) const {
+  for (size_t i = 0; i < n; ++i) {
+    fn(i);
+  }
+}
+
 }
 
 NeuralNetPtr createNeuralNet(const Size3& inputShape, const Config& config,
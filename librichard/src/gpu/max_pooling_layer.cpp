@@ -20,10 +20,16 @@ MaxPoolingLayer::MaxPoolingLayer(Gpu& gpu, FileSystem& fileSystem,
   m_regionW = regionSize[0];
   m_regionH = regionSize[1];
 
-  ASSERT_MSG(m_inputW % m_regionW == 0,
-    "Region width " << m_regionW << " does not divide input width " << m_inputW);
-  ASSERT_MSG(m_inputH % m_regionH == 0,
-    "Region height " << m_regionH << " does not divide input height " << m_inputH);
+  auto stride = config.contains("stride") ? config.getNumberArray<size_t, 2>("stride") :
+    regionSize;
+  m_strideX = stride[0];
+  m_strideY = stride[1];
+
+  ASSERT_MSG(m_strideX > 0 && m_strideY > 0, "Pooling stride must be at least 1");
+  ASSERT_MSG(m_regionW <= m_inputW,
+    "Region width " << m_regionW << " is larger than input width " << m_inputW);
+  ASSERT_MSG(m_regionH <= m_inputH,
+    "Region height " << m_regionH << " is larger than input height " << m_inputH);
 }
 
 void MaxPoolingLayer::allocateGpuBuffers() {
@@ -31,7 +37,7 @@ void MaxPoolingLayer::allocateGpuBuffers() {
 
   m_bufferZ = m_gpu.allocateBuffer(size() * sizeof(netfloat_t), GpuBufferFlags::large);
   m_bufferInputDelta = m_gpu.allocateBuffer(inputSize * sizeof(netfloat_t), GpuBufferFlags::large);
-  m_bufferMask = m_gpu.allocateBuffer(inputSize * sizeof(netfloat_t), GpuBufferFlags::large);
+  m_bufferArgmax = m_gpu.allocateBuffer(size() * sizeof(uint32_t), GpuBufferFlags::large);
 }
 
 void MaxPoolingLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle,
@@ -44,16 +50,24 @@ void MaxPoolingLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHan
   createBackpropShader(nextLayer);
 }
 
+SpecializationConstants MaxPoolingLayer::regionConstants() const {
+  return {
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionH) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_strideX) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_strideY) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputW) },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputH) }
+  };
+}
+
 void MaxPoolingLayer::createEvalForwardShader(GpuBufferHandle inputBuffer) {
   GpuBufferBindings buffers{
     { inputBuffer, BufferAccessMode::read },
     { m_bufferZ.handle, BufferAccessMode::write }
   };
 
-  SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionW) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionH) }
-  };
+  SpecializationConstants constants = regionConstants();
 
   std::string shaderName = "max_pooling_eval_forward.spv";
   auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
@@ -67,13 +81,10 @@ void MaxPoolingLayer::createTrainForwardShader(GpuBufferHandle inputBuffer) {
   GpuBufferBindings buffers{
     { inputBuffer, BufferAccessMode::read },
     { m_bufferZ.handle, BufferAccessMode::write },
-    { m_bufferMask.handle, BufferAccessMode::write }
+    { m_bufferArgmax.handle, BufferAccessMode::write }
   };
 
-  SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionW) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionH) }
-  };
+  SpecializationConstants constants = regionConstants();
 
   std::string shaderName = "max_pooling_train_forward.spv";
   auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
@@ -86,19 +97,18 @@ void MaxPoolingLayer::createTrainForwardShader(GpuBufferHandle inputBuffer) {
 void MaxPoolingLayer::createBackpropShader(const Layer* nextLayer) {
   GpuBufferBindings buffers{
     { nextLayer->inputDeltaBuffer(), BufferAccessMode::read },
-    { m_bufferMask.handle, BufferAccessMode::read },
+    { m_bufferArgmax.handle, BufferAccessMode::read },
     { m_bufferInputDelta.handle, BufferAccessMode::write }
   };
 
-  SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionW) },
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_regionH) }
-  };
+  SpecializationConstants constants = regionConstants();
 
   std::string shaderName = "max_pooling_backprop.spv";
   auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
 
-  Size3 workSize = outputSize();
+  // One invocation per input, so that inputs shared by overlapping regions, or outside every
+  // region, are written exactly once
+  Size3 workSize{ m_inputW, m_inputH, m_inputDepth };
 
   m_backpropShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
 }
@@ -108,7 +118,11 @@ size_t MaxPoolingLayer::size() const {
 }
 
 Size3 MaxPoolingLayer::outputSize() const {
-  return { m_inputW / m_regionW, m_inputH / m_regionH, m_inputDepth };
+  return {
+    (m_inputW - m_regionW) / m_strideX + 1,
+    (m_inputH - m_regionH) / m_strideY + 1,
+    m_inputDepth
+  };
 }
 
 void MaxPoolingLayer::evalForward() {
@@ -141,8 +155,8 @@ GpuBufferHandle MaxPoolingLayer::inputDeltaBuffer() const {
   return m_bufferInputDelta.handle;
 }
 
-GpuBufferHandle MaxPoolingLayer::test_maskBuffer() const {
-  return m_bufferMask.handle;
+GpuBufferHandle MaxPoolingLayer::test_argmaxBuffer() const {
+  return m_bufferArgmax.handle;
 }
 
 void MaxPoolingLayer::retrieveBuffers() {}
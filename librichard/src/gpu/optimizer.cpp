@@ -0,0 +1,73 @@
+#include "richard/gpu/optimizer.hpp"
+#include <algorithm>
+
+namespace richard {
+namespace gpu {
+namespace {
+
+GpuBuffer allocateStateBuffer(Gpu& gpu, const DataArray& data) {
+  GpuBuffer buffer = gpu.allocateBuffer(std::max<size_t>(data.size(), 1) * sizeof(netfloat_t),
+    GpuBufferFlags::large | GpuBufferFlags::hostReadAccess | GpuBufferFlags::hostWriteAccess);
+
+  if (data.size() > 0) {
+    gpu.submitBufferData(buffer.handle, data.data());
+  }
+
+  return buffer;
+}
+
+}
+
+Optimizer::Optimizer() {}
+
+Optimizer::Optimizer(const OptimizerParams& params, size_t size)
+  : m_params(params)
+  , m_state(params.type, size) {}
+
+const OptimizerParams& Optimizer::params() const {
+  return m_params;
+}
+
+void Optimizer::allocateGpuBuffers(Gpu& gpu) {
+  m_bufferFirst = allocateStateBuffer(gpu, m_state.first);
+  m_bufferSecond = allocateStateBuffer(gpu, m_state.second);
+}
+
+GpuBufferHandle Optimizer::firstMomentBuffer() const {
+  return m_bufferFirst.handle;
+}
+
+GpuBufferHandle Optimizer::secondMomentBuffer() const {
+  return m_bufferSecond.handle;
+}
+
+void Optimizer::retrieveBuffers(Gpu& gpu) {
+  if (m_state.first.size() > 0) {
+    gpu.retrieveBuffer(m_bufferFirst.handle, m_state.first.data());
+  }
+  if (m_state.second.size() > 0) {
+    gpu.retrieveBuffer(m_bufferSecond.handle, m_state.second.data());
+  }
+}
+
+OptimizerConstants Optimizer::nextStep() {
+  ++m_state.step;
+
+  OptimizerConstants constants{ 1.0, m_params.epsilon };
+  if (m_params.type == OptimizerType::adam) {
+    adamCorrection(m_params, m_state.step, constants.learnRateScale, constants.epsilon);
+  }
+
+  return constants;
+}
+
+void Optimizer::read(std::istream& stream) {
+  m_state.read(stream);
+}
+
+void Optimizer::write(std::ostream& stream) const {
+  m_state.write(stream);
+}
+
+}
+}
@@ -18,6 +18,9 @@ OutputLayer::OutputLayer(Gpu& gpu, FileSystem& fileSystem, const PlatformPaths&
 
   stream.read(reinterpret_cast<char*>(m_B.data()), m_size * sizeof(netfloat_t));
   stream.read(reinterpret_cast<char*>(m_W.data()), m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  m_optimizerB.read(stream);
+  m_optimizerW.read(stream);
 }
 
 OutputLayer::OutputLayer(Gpu& gpu, FileSystem& fileSystem, const PlatformPaths& platformPaths,
@@ -37,9 +40,16 @@ void OutputLayer::initialize(const Config& config, size_t inputSize) {
   m_size = config.getNumber<size_t>("size");
   m_learnRate = config.getNumber<netfloat_t>("learnRate");
   m_learnRateDecay = config.getNumber<netfloat_t>("learnRateDecay");
+  m_costType = config.contains("cost") ?
+    parseCostType(config.getString("cost")) : CostType::quadratic;
+  OptimizerParams optimizer = config.contains("optimizer") ?
+    OptimizerParams(config.getObject("optimizer")) : OptimizerParams();
 
   m_B = Vector(m_size);
   m_W = Matrix(m_inputSize, m_size);
+
+  m_optimizerB = Optimizer(optimizer, m_size);
+  m_optimizerW = Optimizer(optimizer, m_inputSize * m_size);
   m_A = Vector(m_size);
 }
 
@@ -72,6 +82,9 @@ void OutputLayer::allocateGpuBuffers() {
 
   Vector deltaB(m_B.size());
   m_gpu.submitBufferData(m_bufferDeltaB.handle, deltaB.data());
+
+  m_optimizerB.allocateGpuBuffers(m_gpu);
+  m_optimizerW.allocateGpuBuffers(m_gpu);
 }
 
 void OutputLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle statusBuffer,
@@ -82,6 +95,10 @@ void OutputLayer::createGpuShaders(GpuBufferHandle inputBuffer, GpuBufferHandle
   createBackpropDeltaShader(statusBuffer, inputBuffer, sampleYBuffer);
   createBackpropInputDeltaShader();
   createUpdateParamsShader(statusBuffer);
+
+  if (m_costType == CostType::crossEntropy) {
+    createSoftmaxShader();
+  }
 }
 
 void OutputLayer::createEvalForwardShader(GpuBufferHandle inputBuffer) {
@@ -93,7 +110,8 @@ void OutputLayer::createEvalForwardShader(GpuBufferHandle inputBuffer) {
   };
 
   SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
+    { SpecializationConstant::Type::bool_type, m_costType == CostType::crossEntropy }
   };
 
   std::string shaderName = "dense_eval_forward.spv";
@@ -114,7 +132,8 @@ void OutputLayer::createTrainForwardShader(GpuBufferHandle inputBuffer) {
   };
 
   SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
+    { SpecializationConstant::Type::bool_type, m_costType == CostType::crossEntropy }
   };
 
   std::string shaderName = "output_train_forward.spv";
@@ -142,7 +161,8 @@ void OutputLayer::createBackpropDeltaShader(GpuBufferHandle statusBuffer,
   };
 
   SpecializationConstants constants{
-    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) }
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
+    { SpecializationConstant::Type::bool_type, m_costType == CostType::crossEntropy }
   };
 
   std::string shaderName = "output_backprop_delta.spv";
@@ -180,13 +200,22 @@ void OutputLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer) {
     { m_bufferB.handle, BufferAccessMode::write },
     { m_bufferW.handle, BufferAccessMode::write },
     { m_bufferDeltaB.handle, BufferAccessMode::write },
-    { m_bufferDeltaW.handle, BufferAccessMode::write }
+    { m_bufferDeltaW.handle, BufferAccessMode::write },
+    { m_optimizerB.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerW.firstMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerB.secondMomentBuffer(), BufferAccessMode::write },
+    { m_optimizerW.secondMomentBuffer(), BufferAccessMode::write }
   };
 
+  const OptimizerParams& optimizer = m_optimizerW.params();
+
   SpecializationConstants constants{
     { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_inputSize) },
     { SpecializationConstant::Type::float_type, m_learnRate },
     { SpecializationConstant::Type::float_type, m_learnRateDecay },
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(optimizer.type) },
+    { SpecializationConstant::Type::float_type, optimizer.beta1 },
+    { SpecializationConstant::Type::float_type, optimizer.beta2 }
   };
 
   std::string shaderName = "dense_update_params.spv";
@@ -194,7 +223,25 @@ void OutputLayer::createUpdateParamsShader(GpuBufferHandle statusBuffer) {
 
   Size3 workSize{ m_inputSize, m_size, 1 };
 
-  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
+  m_updateParamsShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants,
+    sizeof(OptimizerConstants), workSize);
+}
+
+void OutputLayer::createSoftmaxShader() {
+  GpuBufferBindings buffers{
+    { m_bufferA.handle, BufferAccessMode::write }
+  };
+
+  SpecializationConstants constants{
+    { SpecializationConstant::Type::uint_type, static_cast<uint32_t>(m_size) }
+  };
+
+  std::string shaderName = "output_softmax.spv";
+  auto shaderCode = m_fileSystem.loadBinaryFile(m_platformPaths.get("shaders", shaderName));
+
+  Size3 workSize{ 1, 1, 1 };
+
+  m_softmaxShader = m_gpu.addShader(shaderName, shaderCode, buffers, constants, 0, workSize);
 }
 
 size_t OutputLayer::size() const {
@@ -212,10 +259,18 @@ const Vector& OutputLayer::activations() const {
 
 void OutputLayer::evalForward() {
   m_gpu.queueShader(m_evalForwardShader);
+
+  if (m_costType == CostType::crossEntropy) {
+    m_gpu.queueShader(m_softmaxShader);
+  }
 }
 
 void OutputLayer::trainForward() {
   m_gpu.queueShader(m_trainForwardShader);
+
+  if (m_costType == CostType::crossEntropy) {
+    m_gpu.queueShader(m_softmaxShader);
+  }
 }
 
 void OutputLayer::backprop() {
@@ -224,7 +279,14 @@ void OutputLayer::backprop() {
 }
 
 void OutputLayer::updateParams() {
-  m_gpu.queueShader(m_updateParamsShader);
+  OptimizerConstants constants = m_optimizerW.nextStep();
+  m_optimizerB.nextStep();
+
+  m_gpu.queueShader(m_updateParamsShader, &constants);
+}
+
+CostType OutputLayer::costType() const {
+  return m_costType;
 }
 
 GpuBufferHandle OutputLayer::outputBuffer() const {
@@ -246,12 +308,18 @@ GpuBufferHandle OutputLayer::inputDeltaBuffer() const {
 void OutputLayer::retrieveBuffers() {
   m_gpu.retrieveBuffer(m_bufferB.handle, m_B.data());
   m_gpu.retrieveBuffer(m_bufferW.handle, m_W.data());
+
+  m_optimizerB.retrieveBuffers(m_gpu);
+  m_optimizerW.retrieveBuffers(m_gpu);
 }
 
 void OutputLayer::writeToStream(std::ostream& stream) const {
   stream.write(reinterpret_cast<const char*>(m_B.data()), m_B.size() * sizeof(netfloat_t));
   stream.write(reinterpret_cast<const char*>(m_W.data()),
     m_W.rows() * m_W.cols() * sizeof(netfloat_t));
+
+  m_optimizerB.write(stream);
+  m_optimizerW.write(stream);
 }
 
 void OutputLayer::test_setWeights(const DataArray& W) {
@@ -12,6 +12,17 @@
     BUF[pos / 4][pos % 4] = val; \
   }
 
+// As above, for buffers declared as uvec4 arrays
+#define FN_READ_UINT(BUF) \
+  uint read##BUF(uint pos) { \
+    return BUF[pos / 4][pos % 4]; \
+  }
+
+#define FN_WRITE_UINT(BUF) \
+  void write##BUF(uint pos, uint val) { \
+    BUF[pos / 4][pos % 4] = val; \
+  }
+
 struct StatusBuffer {
   uint epoch;
   uint sampleIndex;
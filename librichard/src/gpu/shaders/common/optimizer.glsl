@@ -0,0 +1,41 @@
+// Values of OptimizerType
+#define OPTIMIZER_SGD 0
+#define OPTIMIZER_MOMENTUM 1
+#define OPTIMIZER_NESTEROV 2
+#define OPTIMIZER_RMS_PROP 3
+#define OPTIMIZER_ADAM 4
+
+// Returns the updated parameter w given its gradient g, updating the optimizer's first and second
+// moments v and s. For Adam, learnRate and epsilon must already include the bias correction.
+float optimizerStep(uint optimizer, float w, float g, inout float v, inout float s,
+  float learnRate, float beta1, float beta2, float epsilon) {
+
+  if (optimizer == OPTIMIZER_MOMENTUM) {
+    v = beta1 * v + g;
+    return w - learnRate * v;
+  }
+  else if (optimizer == OPTIMIZER_NESTEROV) {
+    v = beta1 * v + g;
+    return w - learnRate * (g + beta1 * v);
+  }
+  else if (optimizer == OPTIMIZER_RMS_PROP) {
+    s = beta2 * s + (1.0 - beta2) * g * g;
+    return w - learnRate * g / (sqrt(s) + epsilon);
+  }
+  else if (optimizer == OPTIMIZER_ADAM) {
+    v = beta1 * v + (1.0 - beta1) * g;
+    s = beta2 * s + (1.0 - beta2) * g * g;
+    return w - learnRate * v / (sqrt(s) + epsilon);
+  }
+
+  return w - learnRate * g;
+}
+
+bool optimizerUsesFirstMoment(uint optimizer) {
+  return optimizer == OPTIMIZER_MOMENTUM || optimizer == OPTIMIZER_NESTEROV ||
+    optimizer == OPTIMIZER_ADAM;
+}
+
+bool optimizerUsesSecondMoment(uint optimizer) {
+  return optimizer == OPTIMIZER_RMS_PROP || optimizer == OPTIMIZER_ADAM;
+}
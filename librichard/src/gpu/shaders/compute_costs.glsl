@@ -3,6 +3,7 @@
 #include "common/common.glsl"
 
 layout(constant_id = 3) const uint MINI_BATCH_SIZE = 1;
+layout(constant_id = 4) const bool CROSS_ENTROPY = false;
 
 layout(std140, binding = 0) buffer StatusSsbo {
   StatusBuffer Status;
@@ -33,8 +34,14 @@ void main() {
   const uint yOffset = Status.sampleIndex * networkOutputSize;
 
   float cost = readCosts(index);
-  float diff = readY(yOffset + index) - readOutputLayerActivations(index);
-  writeCosts(index, cost + 0.5 * diff * diff);
+  float y = readY(yOffset + index);
+  float a = readOutputLayerActivations(index);
+  if (CROSS_ENTROPY) {
+    writeCosts(index, cost - (y == 0.0 ? 0.0 : y * log(max(a, FLOAT_MIN))));
+  }
+  else {
+    writeCosts(index, cost + 0.5 * (y - a) * (y - a));
+  }
 
   if (index == 0) {
     barrier();
@@ -6,6 +6,10 @@ layout(constant_id = 3) const uint KERNEL_W = 1;
 layout(constant_id = 4) const uint KERNEL_H = 1;
 layout(constant_id = 5) const uint KERNEL_D = 1;
 layout(constant_id = 6) const uint NUM_FEATURE_MAPS = 1;
+layout(constant_id = 7) const uint FM_W = 1;
+layout(constant_id = 8) const uint FM_H = 1;
+layout(constant_id = 9) const uint STRIDE = 1;
+layout(constant_id = 10) const uint PADDING = 0;
 
 layout(std140, binding = 0) readonly buffer KSsbo {
   vec4 K[];
@@ -25,54 +29,46 @@ layout(std140, binding = 2) writeonly buffer InputDeltaSsbo {
 
 FN_WRITE(InputDelta)
 
-// Computes full convolution of every zIdx kernel slice with the delta, repeated for every
-// feature map / kernel, and accumulates the results in the input delta.
+// Each input element accumulates the delta of every output whose window covered it, weighted by
+// the zIdx slice of that feature map's kernel. With stride 1 and no padding this is the full
+// convolution of each kernel slice with the delta.
 void main() {
-  // One thread for each element of the convolution results
+  // One thread for each element of the input delta
   const uint xIdx = gl_GlobalInvocationID.x;
   const uint yIdx = gl_GlobalInvocationID.y;
   const uint zIdx = gl_GlobalInvocationID.z;
 
-  // The results of the convolutions are accumulated in the input delta
-  const uint resultW = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
-  const uint resultH = gl_WorkGroupSize.y * gl_NumWorkGroups.y;
+  const uint inputW = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
+  const uint inputH = gl_WorkGroupSize.y * gl_NumWorkGroups.y;
 
-  // The 'image' is the delta, which we're convolving with the kernel
-  const uint imW = resultW - KERNEL_W + 1;
-  const uint imH = resultH - KERNEL_H + 1;
+  const uint inDeltaIdx = arrayIndex3d(inputW, inputH, xIdx, yIdx, zIdx);
 
-  const uint inDeltaIdx = arrayIndex3d(resultW, resultH, xIdx, yIdx, zIdx);
-
-  const int xMin = -int(KERNEL_W) + 1;
-  const int yMin = -int(KERNEL_H) + 1;
-
-  const int jFrom = max(0, int(KERNEL_H) - int(yIdx) - 1);
-  const int jTo = min(int(KERNEL_H), int(resultH) - int(yIdx));
-
-  const int iFrom = max(0, int(KERNEL_W) - int(xIdx) - 1);
-  const int iTo = min(int(KERNEL_W), int(resultW) - int(xIdx));
+  // Position within the padded input
+  const int px = int(xIdx + PADDING);
+  const int py = int(yIdx + PADDING);
 
   float sum = 0.0;
   for (uint d = 0; d < NUM_FEATURE_MAPS; ++d) {
     const uint kernelOffset = d * KERNEL_W * KERNEL_H * KERNEL_D;
 
-    for (uint k = 0; k < KERNEL_D; ++k) {
-
-      // Compute a full 2D convolution between the d'th feature map delta and k'th slice of this
-      // feature map's associated kernel
-
-      for (int j = jFrom; j < jTo; ++j) {
-        const int y = yMin + int(yIdx + j);
+    for (uint j = 0; j < KERNEL_H; ++j) {
+      // The output whose window has this input at row j, if any
+      const int fy = py - int(j);
+      if (fy < 0 || fy % int(STRIDE) != 0 || fy / int(STRIDE) >= int(FM_H)) {
+        continue;
+      }
 
-        for (int i = iFrom; i < iTo; ++i) {
-          const int x = xMin + int(xIdx + i);
+      for (uint i = 0; i < KERNEL_W; ++i) {
+        const int fx = px - int(i);
+        if (fx < 0 || fx % int(STRIDE) != 0 || fx / int(STRIDE) >= int(FM_W)) {
+          continue;
+        }
 
-          const float pixel = readD(arrayIndex3d(imW, imH, x, y, d));
-          const uint kernelIdx = arrayIndex3d(KERNEL_W, KERNEL_H, KERNEL_W - i - 1,
-            KERNEL_H - j - 1, k);
+        const float delta = readD(arrayIndex3d(FM_W, FM_H, uint(fx) / STRIDE, uint(fy) / STRIDE,
+          d));
+        const uint kernelIdx = arrayIndex3d(KERNEL_W, KERNEL_H, i, j, zIdx);
 
-          sum += pixel * readK(kernelOffset + kernelIdx);
-        }
+        sum += delta * readK(kernelOffset + kernelIdx);
       }
     }
   }
@@ -8,6 +8,10 @@ layout(constant_id = 5) const uint IMAGE_W = 1;
 layout(constant_id = 6) const uint IMAGE_H = 1;
 layout(constant_id = 7) const uint IMAGE_D = 1;
 layout(constant_id = 8) const bool IS_FIRST_LAYER = false;
+layout(constant_id = 9) const uint KERNEL_W = 1;
+layout(constant_id = 10) const uint KERNEL_H = 1;
+layout(constant_id = 11) const uint STRIDE = 1;
+layout(constant_id = 12) const uint PADDING = 0;
 
 layout(std140, binding = 0) readonly buffer StatusSsbo {
   StatusBuffer Status;
@@ -40,13 +44,11 @@ FN_READ(DeltaB)
 FN_WRITE(DeltaB)
 
 // Compute a cross-correlation between each slice of the layer inputs and each slice of the layer
-// delta, accumulating the results in the kernel delta
+// delta, with the delta's elements stride pixels apart and the inputs padded with zeros,
+// accumulating the results in the kernel delta
 void main() {
-  const uint deltaKW = IMAGE_W - DELTA_W + 1;
-  const uint deltaKH = IMAGE_H - DELTA_H + 1;
-
-  const uint xIdx = gl_GlobalInvocationID.x % deltaKW;
-  const uint yIdx = gl_GlobalInvocationID.x / deltaKW;
+  const uint xIdx = gl_GlobalInvocationID.x % KERNEL_W;
+  const uint yIdx = gl_GlobalInvocationID.x / KERNEL_W;
   const uint zIdx = gl_GlobalInvocationID.y;
   const uint dIdx = gl_GlobalInvocationID.z;
 
@@ -56,22 +58,25 @@ void main() {
   float sum = 0.0;
 
   for (uint j = 0; j < DELTA_H; ++j) {
+    const int y = int(j * STRIDE + yIdx) - int(PADDING);
+
     for (uint i = 0; i < DELTA_W; ++i) {
-      const uint x = xIdx + i;
-      const uint y = yIdx + j;
+      const int x = int(i * STRIDE + xIdx) - int(PADDING);
 
       const uint deltaIdx = arrayIndex3d(DELTA_W, DELTA_H, i, j, dIdx);
-
-      const float pixel = readImage(imageOffset + arrayIndex3d(IMAGE_W, IMAGE_H, x, y, zIdx));
       const float deltaValue = readD(deltaIdx);
 
-      weightedSum += pixel * deltaValue;
+      if (x >= 0 && x < int(IMAGE_W) && y >= 0 && y < int(IMAGE_H)) {
+        const uint imageIdx = arrayIndex3d(IMAGE_W, IMAGE_H, uint(x), uint(y), zIdx);
+        weightedSum += readImage(imageOffset + imageIdx) * deltaValue;
+      }
+
       sum += deltaValue;
     }
   }
 
-  const uint deltaKOffset = dIdx * deltaKW * deltaKH * IMAGE_D;
-  const uint deltaKIdx = deltaKOffset + arrayIndex3d(deltaKW, deltaKH, xIdx, yIdx, zIdx);
+  const uint deltaKOffset = dIdx * KERNEL_W * KERNEL_H * IMAGE_D;
+  const uint deltaKIdx = deltaKOffset + arrayIndex3d(KERNEL_W, KERNEL_H, xIdx, yIdx, zIdx);
 
   const float dK = readDeltaK(deltaKIdx);
 
@@ -5,6 +5,10 @@
 layout(constant_id = 3) const uint KERNEL_W = 1;
 layout(constant_id = 4) const uint KERNEL_H = 1;
 layout(constant_id = 5) const uint KERNEL_D = 1;
+layout(constant_id = 6) const uint IMAGE_W = 1;
+layout(constant_id = 7) const uint IMAGE_H = 1;
+layout(constant_id = 8) const uint STRIDE = 1;
+layout(constant_id = 9) const uint PADDING = 0;
 
 layout(std140, binding = 0) readonly buffer ImageSsbo {
   vec4 Image[];
@@ -38,18 +42,22 @@ void main() {
   const uint fmW = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
   const uint fmH = gl_WorkGroupSize.y * gl_NumWorkGroups.y;
 
-  const uint imW = fmW + KERNEL_W - 1;
-  const uint imH = fmH + KERNEL_H - 1;
-
   float sum = 0.0;
   for (uint k = 0; k < KERNEL_D; ++k) {
     for (uint j = 0; j < KERNEL_H; ++j) {
+      // The padding reads as zeros, so contributes nothing
+      const int y = int(yIdx * STRIDE + j) - int(PADDING);
+      if (y < 0 || y >= int(IMAGE_H)) {
+        continue;
+      }
+
       for (uint i = 0; i < KERNEL_W; ++i) {
-        const uint x = xIdx + i;
-        const uint y = yIdx + j;
-        const uint z = k;
+        const int x = int(xIdx * STRIDE + i) - int(PADDING);
+        if (x < 0 || x >= int(IMAGE_W)) {
+          continue;
+        }
 
-        const float pixel = readImage(z * imW * imH + y * imW + x);
+        const float pixel = readImage(arrayIndex3d(IMAGE_W, IMAGE_H, uint(x), uint(y), k));
 
         const float kernelPixel = readK(
           KERNEL_W * KERNEL_H * KERNEL_D * zIdx +
@@ -1,12 +1,21 @@
 #version 430
 
 #include "common/common.glsl"
+#include "common/optimizer.glsl"
 
 layout(constant_id = 3) const uint KERNEL_W = 1;
 layout(constant_id = 4) const uint KERNEL_H = 1;
 layout(constant_id = 5) const uint KERNEL_D = 1;
 layout(constant_id = 6) const float LEARN_RATE = 0.001;
 layout(constant_id = 7) const float LEARN_RATE_DECAY = 1.0;
+layout(constant_id = 8) const uint OPTIMIZER = OPTIMIZER_SGD;
+layout(constant_id = 9) const float BETA1 = 0.9;
+layout(constant_id = 10) const float BETA2 = 0.999;
+
+layout(push_constant) uniform PushConstants {
+  float learnRateScale;
+  float epsilon;
+} constants;
 
 layout(std140, binding = 0) readonly buffer StatusSsbo {
   StatusBuffer Status;
@@ -40,21 +49,74 @@ layout(std140, binding = 4) buffer DeltaBSsbo {
 FN_READ(DeltaB)
 FN_WRITE(DeltaB)
 
+layout(std140, binding = 5) buffer FirstKSsbo {
+  vec4 FirstK[];
+};
+
+FN_READ(FirstK)
+FN_WRITE(FirstK)
+
+layout(std140, binding = 6) buffer FirstBSsbo {
+  vec4 FirstB[];
+};
+
+FN_READ(FirstB)
+FN_WRITE(FirstB)
+
+layout(std140, binding = 7) buffer SecondKSsbo {
+  vec4 SecondK[];
+};
+
+FN_READ(SecondK)
+FN_WRITE(SecondK)
+
+layout(std140, binding = 8) buffer SecondBSsbo {
+  vec4 SecondB[];
+};
+
+FN_READ(SecondB)
+FN_WRITE(SecondB)
+
 void main() {
   const uint xIdx = gl_GlobalInvocationID.x % KERNEL_W;
   const uint yIdx = gl_GlobalInvocationID.x / KERNEL_W;
   const uint zIdx = gl_GlobalInvocationID.y;
   const uint dIdx = gl_GlobalInvocationID.z;
 
-  const float learnRate = LEARN_RATE * pow(LEARN_RATE_DECAY, Status.epoch);
+  const float learnRate = LEARN_RATE * pow(LEARN_RATE_DECAY, Status.epoch)
+    * constants.learnRateScale;
+
+  const bool first = optimizerUsesFirstMoment(OPTIMIZER);
+  const bool second = optimizerUsesSecondMoment(OPTIMIZER);
 
   const uint kOffset = dIdx * KERNEL_W * KERNEL_H * KERNEL_D;
   const uint kIdx = kOffset + arrayIndex3d(KERNEL_W, KERNEL_H, xIdx, yIdx, zIdx);
-  writeK(kIdx, readK(kIdx) - readDeltaK(kIdx) * learnRate);
+
+  float v = first ? readFirstK(kIdx) : 0.0;
+  float s = second ? readSecondK(kIdx) : 0.0;
+  writeK(kIdx, optimizerStep(OPTIMIZER, readK(kIdx), readDeltaK(kIdx), v, s, learnRate, BETA1,
+    BETA2, constants.epsilon));
   writeDeltaK(kIdx, 0.0);
 
+  if (first) {
+    writeFirstK(kIdx, v);
+  }
+  if (second) {
+    writeSecondK(kIdx, s);
+  }
+
   if (xIdx == 0 && yIdx == 0 && zIdx == 0) {
-    writeB(dIdx, readB(dIdx) - readDeltaB(dIdx) * learnRate);
+    float v = first ? readFirstB(dIdx) : 0.0;
+    float s = second ? readSecondB(dIdx) : 0.0;
+    writeB(dIdx, optimizerStep(OPTIMIZER, readB(dIdx), readDeltaB(dIdx), v, s, learnRate, BETA1,
+      BETA2, constants.epsilon));
     writeDeltaB(dIdx, 0.0);
+
+    if (first) {
+      writeFirstB(dIdx, v);
+    }
+    if (second) {
+      writeSecondB(dIdx, s);
+    }
   }
 }
@@ -3,8 +3,7 @@
 #include "common/common.glsl"
 
 layout(constant_id = 3) const uint LAYER_NUM_INPUTS = 1;
-layout(constant_id = 4) const uint NEXT_LAYER_SIZE = 1;
-layout(constant_id = 5) const bool IS_FIRST_LAYER = false;
+layout(constant_id = 4) const bool IS_FIRST_LAYER = false;
 
 layout(std140, binding = 0) readonly buffer StatusSsbo {
   StatusBuffer Status;
@@ -46,26 +45,21 @@ layout(std140, binding = 6) writeonly buffer DSsbo {
 
 FN_WRITE(D)
 
-layout(std140, binding = 7) readonly buffer NextWSsbo {
-  vec4 NextW[];
+// The gradient of the cost with respect to this layer's activations, as computed by the next layer
+layout(std140, binding = 7) readonly buffer NextInputDeltaSsbo {
+  vec4 NextInputDelta[];
 };
 
-FN_READ(NextW)
+FN_READ(NextInputDelta)
 
-layout(std140, binding = 8) readonly buffer NextDSsbo {
-  vec4 NextD[];
-};
-
-FN_READ(NextD)
-
-layout(std140, binding = 9) buffer DeltaBSsbo {
+layout(std140, binding = 8) buffer DeltaBSsbo {
   vec4 DeltaB[];
 };
 
 FN_READ(DeltaB)
 FN_WRITE(DeltaB)
 
-layout(std140, binding = 10) buffer DeltaWSsbo {
+layout(std140, binding = 9) buffer DeltaWSsbo {
   vec4 DeltaW[];
 };
 
@@ -74,14 +68,8 @@ FN_WRITE(DeltaW)
 
 void main() {
   const uint index = gl_GlobalInvocationID.x;
-  const uint layerSize = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
-
-  float weightedSum = 0.0;
-  for (uint i = 0; i < NEXT_LAYER_SIZE; ++i) {
-    weightedSum += readNextW(i * layerSize + index) * readNextD(i);
-  }
 
-  const float delta = weightedSum * sigmoidPrime(readZ(index));
+  const float delta = readNextInputDelta(index) * sigmoidPrime(readZ(index));
   writeD(index, delta);
 
   const uint xOffset = IS_FIRST_LAYER ? Status.sampleIndex * LAYER_NUM_INPUTS : 0;
@@ -3,6 +3,8 @@
 #include "common/common.glsl"
 
 layout(constant_id = 3) const uint LAYER_NUM_INPUTS = 1;
+// If set, A is left holding the weighted inputs for output_softmax to normalise
+layout(constant_id = 4) const bool SOFTMAX = false;
 
 layout(std140, binding = 0) readonly buffer XSsbo {
   vec4 X[];
@@ -38,5 +40,5 @@ void main() {
     weightedSum += w * x;
   }
   weightedSum += readB(index);
-  writeA(index, sigmoid(weightedSum));
+  writeA(index, SOFTMAX ? weightedSum : sigmoid(weightedSum));
 }
@@ -1,10 +1,19 @@
 #version 430
 
 #include "common/common.glsl"
+#include "common/optimizer.glsl"
 
 layout(constant_id = 3) const uint LAYER_NUM_INPUTS = 1;
 layout(constant_id = 4) const float LEARN_RATE = 0.001;
 layout(constant_id = 5) const float LEARN_RATE_DECAY = 1.0;
+layout(constant_id = 6) const uint OPTIMIZER = OPTIMIZER_SGD;
+layout(constant_id = 7) const float BETA1 = 0.9;
+layout(constant_id = 8) const float BETA2 = 0.999;
+
+layout(push_constant) uniform PushConstants {
+  float learnRateScale;
+  float epsilon;
+} constants;
 
 layout(std140, binding = 0) readonly buffer StatusSsbo {
   StatusBuffer Status;
@@ -38,19 +47,71 @@ layout(std140, binding = 4) buffer DeltaWSsbo {
 FN_READ(DeltaW)
 FN_WRITE(DeltaW)
 
+layout(std140, binding = 5) buffer FirstBSsbo {
+  vec4 FirstB[];
+};
+
+FN_READ(FirstB)
+FN_WRITE(FirstB)
+
+layout(std140, binding = 6) buffer FirstWSsbo {
+  vec4 FirstW[];
+};
+
+FN_READ(FirstW)
+FN_WRITE(FirstW)
+
+layout(std140, binding = 7) buffer SecondBSsbo {
+  vec4 SecondB[];
+};
+
+FN_READ(SecondB)
+FN_WRITE(SecondB)
+
+layout(std140, binding = 8) buffer SecondWSsbo {
+  vec4 SecondW[];
+};
+
+FN_READ(SecondW)
+FN_WRITE(SecondW)
+
 void main() {
   const uint xIdx = gl_GlobalInvocationID.x;
   const uint yIdx = gl_GlobalInvocationID.y;
 
-  const float learnRate = LEARN_RATE * pow(LEARN_RATE_DECAY, Status.epoch);
+  const float learnRate = LEARN_RATE * pow(LEARN_RATE_DECAY, Status.epoch)
+    * constants.learnRateScale;
+
+  const bool first = optimizerUsesFirstMoment(OPTIMIZER);
+  const bool second = optimizerUsesSecondMoment(OPTIMIZER);
 
   const uint wIdx = yIdx * LAYER_NUM_INPUTS + xIdx;
 
-  writeW(wIdx, readW(wIdx) - readDeltaW(wIdx) * learnRate);
+  float v = first ? readFirstW(wIdx) : 0.0;
+  float s = second ? readSecondW(wIdx) : 0.0;
+  writeW(wIdx, optimizerStep(OPTIMIZER, readW(wIdx), readDeltaW(wIdx), v, s, learnRate, BETA1,
+    BETA2, constants.epsilon));
   writeDeltaW(wIdx, 0);
 
+  if (first) {
+    writeFirstW(wIdx, v);
+  }
+  if (second) {
+    writeSecondW(wIdx, s);
+  }
+
   if (xIdx == 0) {
-    writeB(yIdx, readB(yIdx) - readDeltaB(yIdx) * learnRate);
+    float v = first ? readFirstB(yIdx) : 0.0;
+    float s = second ? readSecondB(yIdx) : 0.0;
+    writeB(yIdx, optimizerStep(OPTIMIZER, readB(yIdx), readDeltaB(yIdx), v, s, learnRate, BETA1,
+      BETA2, constants.epsilon));
     writeDeltaB(yIdx, 0);
+
+    if (first) {
+      writeFirstB(yIdx, v);
+    }
+    if (second) {
+      writeSecondB(yIdx, s);
+    }
   }
 }
@@ -0,0 +1,67 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(constant_id = 3) const uint KERNEL_W = 1;
+layout(constant_id = 4) const uint KERNEL_H = 1;
+layout(constant_id = 5) const uint FM_W = 1;
+layout(constant_id = 6) const uint FM_H = 1;
+layout(constant_id = 7) const uint STRIDE = 1;
+layout(constant_id = 8) const uint PADDING = 0;
+
+layout(std140, binding = 0) readonly buffer KSsbo {
+  vec4 K[];
+};
+
+FN_READ(K)
+
+layout(std140, binding = 1) readonly buffer DSsbo {
+  vec4 D[];
+};
+
+FN_READ(D)
+
+layout(std140, binding = 2) writeonly buffer InputDeltaSsbo {
+  vec4 InputDelta[];
+};
+
+FN_WRITE(InputDelta)
+
+// As convolutional_backprop_input_delta, except that each input channel only feeds the depthwise
+// output of the same channel
+void main() {
+  // One thread for each element of the input delta
+  const uint xIdx = gl_GlobalInvocationID.x;
+  const uint yIdx = gl_GlobalInvocationID.y;
+  const uint zIdx = gl_GlobalInvocationID.z;
+
+  const uint inputW = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
+  const uint inputH = gl_WorkGroupSize.y * gl_NumWorkGroups.y;
+
+  // Position within the padded input
+  const int px = int(xIdx + PADDING);
+  const int py = int(yIdx + PADDING);
+
+  float sum = 0.0;
+  for (uint j = 0; j < KERNEL_H; ++j) {
+    // The output whose window has this input at row j, if any
+    const int fy = py - int(j);
+    if (fy < 0 || fy % int(STRIDE) != 0 || fy / int(STRIDE) >= int(FM_H)) {
+      continue;
+    }
+
+    for (uint i = 0; i < KERNEL_W; ++i) {
+      const int fx = px - int(i);
+      if (fx < 0 || fx % int(STRIDE) != 0 || fx / int(STRIDE) >= int(FM_W)) {
+        continue;
+      }
+
+      const float delta = readD(arrayIndex3d(FM_W, FM_H, uint(fx) / STRIDE, uint(fy) / STRIDE,
+        zIdx));
+
+      sum += delta * readK(arrayIndex3d(KERNEL_W, KERNEL_H, i, j, zIdx));
+    }
+  }
+
+  writeInputDelta(arrayIndex3d(inputW, inputH, xIdx, yIdx, zIdx), sum);
+}
@@ -0,0 +1,72 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(constant_id = 3) const uint DELTA_W = 1;
+layout(constant_id = 4) const uint DELTA_H = 1;
+layout(constant_id = 5) const uint IMAGE_W = 1;
+layout(constant_id = 6) const uint IMAGE_H = 1;
+layout(constant_id = 7) const uint IMAGE_D = 1;
+layout(constant_id = 8) const bool IS_FIRST_LAYER = false;
+layout(constant_id = 9) const uint KERNEL_W = 1;
+layout(constant_id = 10) const uint KERNEL_H = 1;
+layout(constant_id = 11) const uint STRIDE = 1;
+layout(constant_id = 12) const uint PADDING = 0;
+
+layout(std140, binding = 0) readonly buffer StatusSsbo {
+  StatusBuffer Status;
+};
+
+layout(std140, binding = 1) readonly buffer ImageSsbo {
+  vec4 Image[];
+};
+
+FN_READ(Image)
+
+layout(std140, binding = 2) readonly buffer DSsbo {
+  vec4 D[];
+};
+
+FN_READ(D)
+
+layout(std140, binding = 3) buffer DeltaKSsbo {
+  vec4 DeltaK[];
+};
+
+FN_READ(DeltaK)
+FN_WRITE(DeltaK)
+
+// Compute a cross-correlation between each slice of the layer inputs and the same slice of the
+// depthwise delta, with the delta's elements stride pixels apart and the inputs padded with zeros,
+// accumulating the results in the kernel delta
+void main() {
+  const uint xIdx = gl_GlobalInvocationID.x % KERNEL_W;
+  const uint yIdx = gl_GlobalInvocationID.x / KERNEL_W;
+  const uint zIdx = gl_GlobalInvocationID.y;
+
+  const uint imageOffset = IS_FIRST_LAYER ? Status.sampleIndex * IMAGE_W * IMAGE_H * IMAGE_D : 0;
+
+  float weightedSum = 0.0;
+
+  for (uint j = 0; j < DELTA_H; ++j) {
+    const int y = int(j * STRIDE + yIdx) - int(PADDING);
+    if (y < 0 || y >= int(IMAGE_H)) {
+      continue;
+    }
+
+    for (uint i = 0; i < DELTA_W; ++i) {
+      const int x = int(i * STRIDE + xIdx) - int(PADDING);
+      if (x < 0 || x >= int(IMAGE_W)) {
+        continue;
+      }
+
+      const uint imageIdx = arrayIndex3d(IMAGE_W, IMAGE_H, uint(x), uint(y), zIdx);
+      weightedSum += readImage(imageOffset + imageIdx)
+        * readD(arrayIndex3d(DELTA_W, DELTA_H, i, j, zIdx));
+    }
+  }
+
+  const uint deltaKIdx = arrayIndex3d(KERNEL_W, KERNEL_H, xIdx, yIdx, zIdx);
+
+  writeDeltaK(deltaKIdx, readDeltaK(deltaKIdx) + weightedSum);
+}
@@ -0,0 +1,70 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(constant_id = 3) const uint KERNEL_W = 1;
+layout(constant_id = 4) const uint KERNEL_H = 1;
+layout(constant_id = 5) const uint IMAGE_W = 1;
+layout(constant_id = 6) const uint IMAGE_H = 1;
+layout(constant_id = 7) const uint IMAGE_D = 1;
+layout(constant_id = 8) const bool IS_FIRST_LAYER = false;
+layout(constant_id = 9) const uint STRIDE = 1;
+layout(constant_id = 10) const uint PADDING = 0;
+
+layout(std140, binding = 0) readonly buffer StatusSsbo {
+  StatusBuffer Status;
+};
+
+layout(std140, binding = 1) readonly buffer ImageSsbo {
+  vec4 Image[];
+};
+
+FN_READ(Image)
+
+layout(std140, binding = 2) readonly buffer KSsbo {
+  vec4 K[];
+};
+
+FN_READ(K)
+
+layout(std140, binding = 3) writeonly buffer ZSsbo {
+  vec4 Z[];
+};
+
+FN_WRITE(Z)
+
+// Cross-correlates each input channel with its own kernel slice. There's no bias or activation;
+// the pointwise stage applies both.
+void main() {
+  const uint xIdx = gl_GlobalInvocationID.x;
+  const uint yIdx = gl_GlobalInvocationID.y;
+  const uint zIdx = gl_GlobalInvocationID.z;
+
+  const uint fmW = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
+  const uint fmH = gl_WorkGroupSize.y * gl_NumWorkGroups.y;
+
+  const uint imageOffset = IS_FIRST_LAYER ? Status.sampleIndex * IMAGE_W * IMAGE_H * IMAGE_D : 0;
+
+  float sum = 0.0;
+  for (uint j = 0; j < KERNEL_H; ++j) {
+    // The padding reads as zeros, so contributes nothing
+    const int y = int(yIdx * STRIDE + j) - int(PADDING);
+    if (y < 0 || y >= int(IMAGE_H)) {
+      continue;
+    }
+
+    for (uint i = 0; i < KERNEL_W; ++i) {
+      const int x = int(xIdx * STRIDE + i) - int(PADDING);
+      if (x < 0 || x >= int(IMAGE_W)) {
+        continue;
+      }
+
+      const float pixel = readImage(imageOffset
+        + arrayIndex3d(IMAGE_W, IMAGE_H, uint(x), uint(y), zIdx));
+
+      sum += pixel * readK(arrayIndex3d(KERNEL_W, KERNEL_H, i, j, zIdx));
+    }
+  }
+
+  writeZ(arrayIndex3d(fmW, fmH, xIdx, yIdx, zIdx), sum);
+}
@@ -0,0 +1,76 @@
+#version 430
+
+#include "common/common.glsl"
+#include "common/optimizer.glsl"
+
+layout(constant_id = 3) const uint KERNEL_W = 1;
+layout(constant_id = 4) const uint KERNEL_H = 1;
+layout(constant_id = 5) const float LEARN_RATE = 0.001;
+layout(constant_id = 6) const float LEARN_RATE_DECAY = 1.0;
+layout(constant_id = 7) const uint OPTIMIZER = OPTIMIZER_SGD;
+layout(constant_id = 8) const float BETA1 = 0.9;
+layout(constant_id = 9) const float BETA2 = 0.999;
+
+layout(push_constant) uniform PushConstants {
+  float learnRateScale;
+  float epsilon;
+} constants;
+
+layout(std140, binding = 0) readonly buffer StatusSsbo {
+  StatusBuffer Status;
+};
+
+layout(std140, binding = 1) buffer KSsbo {
+  vec4 K[];
+};
+
+FN_READ(K)
+FN_WRITE(K)
+
+layout(std140, binding = 2) buffer DeltaKSsbo {
+  vec4 DeltaK[];
+};
+
+FN_READ(DeltaK)
+FN_WRITE(DeltaK)
+
+layout(std140, binding = 3) buffer FirstKSsbo {
+  vec4 FirstK[];
+};
+
+FN_READ(FirstK)
+FN_WRITE(FirstK)
+
+layout(std140, binding = 4) buffer SecondKSsbo {
+  vec4 SecondK[];
+};
+
+FN_READ(SecondK)
+FN_WRITE(SecondK)
+
+void main() {
+  const uint xIdx = gl_GlobalInvocationID.x % KERNEL_W;
+  const uint yIdx = gl_GlobalInvocationID.x / KERNEL_W;
+  const uint zIdx = gl_GlobalInvocationID.y;
+
+  const float learnRate = LEARN_RATE * pow(LEARN_RATE_DECAY, Status.epoch)
+    * constants.learnRateScale;
+
+  const bool first = optimizerUsesFirstMoment(OPTIMIZER);
+  const bool second = optimizerUsesSecondMoment(OPTIMIZER);
+
+  const uint kIdx = arrayIndex3d(KERNEL_W, KERNEL_H, xIdx, yIdx, zIdx);
+
+  float v = first ? readFirstK(kIdx) : 0.0;
+  float s = second ? readSecondK(kIdx) : 0.0;
+  writeK(kIdx, optimizerStep(OPTIMIZER, readK(kIdx), readDeltaK(kIdx), v, s, learnRate, BETA1,
+    BETA2, constants.epsilon));
+  writeDeltaK(kIdx, 0.0);
+
+  if (first) {
+    writeFirstK(kIdx, v);
+  }
+  if (second) {
+    writeSecondK(kIdx, s);
+  }
+}
@@ -0,0 +1,29 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(std140, binding = 0) readonly buffer DeltaASsbo {
+  vec4 DeltaA[];
+};
+
+FN_READ(DeltaA)
+
+layout(std140, binding = 1) writeonly buffer InputDeltaSsbo {
+  vec4 InputDelta[];
+};
+
+FN_WRITE(InputDelta)
+
+// Every input contributes equally to its slice's mean
+void main() {
+  const uint xIdx = gl_GlobalInvocationID.x;
+  const uint yIdx = gl_GlobalInvocationID.y;
+  const uint zIdx = gl_GlobalInvocationID.z;
+
+  const uint imgW = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+  const uint imgH = gl_NumWorkGroups.y * gl_WorkGroupSize.y;
+
+  const uint imgOffset = arrayIndex3d(imgW, imgH, xIdx, yIdx, zIdx);
+
+  writeInputDelta(imgOffset, readDeltaA(zIdx) / float(imgW * imgH));
+}
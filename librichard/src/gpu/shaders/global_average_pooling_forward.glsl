@@ -0,0 +1,32 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(constant_id = 3) const uint IMAGE_W = 1;
+layout(constant_id = 4) const uint IMAGE_H = 1;
+
+layout(std140, binding = 0) readonly buffer XSsbo {
+  vec4 X[];
+};
+
+FN_READ(X)
+
+layout(std140, binding = 1) writeonly buffer ASsbo {
+  vec4 A[];
+};
+
+FN_WRITE(A)
+
+// One thread per input slice
+void main() {
+  const uint zIdx = gl_GlobalInvocationID.z;
+
+  float sum = 0.0;
+  for (uint y = 0; y < IMAGE_H; ++y) {
+    for (uint x = 0; x < IMAGE_W; ++x) {
+      sum += readX(arrayIndex3d(IMAGE_W, IMAGE_H, x, y, zIdx));
+    }
+  }
+
+  writeA(zIdx, sum / float(IMAGE_W * IMAGE_H));
+}
@@ -4,6 +4,13 @@
 
 layout(constant_id = 3) const uint REGION_W = 1;
 layout(constant_id = 4) const uint REGION_H = 1;
+layout(constant_id = 5) const uint STRIDE_X = 1;
+layout(constant_id = 6) const uint STRIDE_Y = 1;
+layout(constant_id = 7) const uint IMAGE_W = 1;
+layout(constant_id = 8) const uint IMAGE_H = 1;
+
+const uint OUTPUT_W = (IMAGE_W - REGION_W) / STRIDE_X + 1;
+const uint OUTPUT_H = (IMAGE_H - REGION_H) / STRIDE_Y + 1;
 
 layout(std140, binding = 0) readonly buffer DeltaASsbo {
   vec4 DeltaA[];
@@ -11,11 +18,11 @@ layout(std140, binding = 0) readonly buffer DeltaASsbo {
 
 FN_READ(DeltaA)
 
-layout(std140, binding = 1) readonly buffer MaskSsbo {
-  vec4 Mask[];
+layout(std140, binding = 1) readonly buffer ArgmaxSsbo {
+  uvec4 Argmax[];
 };
 
-FN_READ(Mask)
+FN_READ_UINT(Argmax)
 
 layout(std140, binding = 2) writeonly buffer InputDeltaSsbo {
   vec4 InputDelta[];
@@ -23,26 +30,32 @@ layout(std140, binding = 2) writeonly buffer InputDeltaSsbo {
 
 FN_WRITE(InputDelta)
 
+// Each input sums the deltas of the regions it won
 void main() {
   const uint xIdx = gl_GlobalInvocationID.x;
   const uint yIdx = gl_GlobalInvocationID.y;
   const uint zIdx = gl_GlobalInvocationID.z;
 
-  const uint outW = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
-  const uint outH = gl_NumWorkGroups.y * gl_WorkGroupSize.y;
+  const uint imgOffset = arrayIndex3d(IMAGE_W, IMAGE_H, xIdx, yIdx, zIdx);
+  const uint sliceOffset = yIdx * IMAGE_W + xIdx;
 
-  const uint imgW = outW * REGION_W;
-  const uint imgH = outH * REGION_H;
+  // The outputs whose regions cover this input
+  const uint outXFrom = xIdx < REGION_W ? 0 : (xIdx - REGION_W) / STRIDE_X + 1;
+  const uint outXTo = min(xIdx / STRIDE_X + 1, OUTPUT_W);
+  const uint outYFrom = yIdx < REGION_H ? 0 : (yIdx - REGION_H) / STRIDE_Y + 1;
+  const uint outYTo = min(yIdx / STRIDE_Y + 1, OUTPUT_H);
 
-  const uint outOffset = arrayIndex3d(outW, outH, xIdx, yIdx, zIdx);
+  float delta = 0.0;
 
-  for (uint j = 0; j < REGION_H; ++j) {
-    for (uint i = 0; i < REGION_W; ++i) {
-      const uint imgX = xIdx * REGION_W + i;
-      const uint imgY = yIdx * REGION_H + j;
-      const uint imgOffset = arrayIndex3d(imgW, imgH, imgX, imgY, zIdx);
+  for (uint outY = outYFrom; outY < outYTo; ++outY) {
+    for (uint outX = outXFrom; outX < outXTo; ++outX) {
+      const uint outOffset = arrayIndex3d(OUTPUT_W, OUTPUT_H, outX, outY, zIdx);
 
-      writeInputDelta(imgOffset, readDeltaA(outOffset) * readMask(imgOffset));
+      if (readArgmax(outOffset) == sliceOffset) {
+        delta += readDeltaA(outOffset);
+      }
     }
   }
+
+  writeInputDelta(imgOffset, delta);
 }
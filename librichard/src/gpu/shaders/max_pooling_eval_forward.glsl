@@ -4,6 +4,10 @@
 
 layout(constant_id = 3) const uint REGION_W = 1;
 layout(constant_id = 4) const uint REGION_H = 1;
+layout(constant_id = 5) const uint STRIDE_X = 1;
+layout(constant_id = 6) const uint STRIDE_Y = 1;
+layout(constant_id = 7) const uint IMAGE_W = 1;
+layout(constant_id = 8) const uint IMAGE_H = 1;
 
 layout(std140, binding = 0) readonly buffer XSsbo {
   vec4 X[];
@@ -25,26 +29,15 @@ void main() {
   const uint outW = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
   const uint outH = gl_NumWorkGroups.y * gl_WorkGroupSize.y;
 
-  const uint imgW = outW * REGION_W;
-  const uint imgH = outH * REGION_H;
-
   float largest = FLOAT_LOWEST;
-  uint largestX = 0;
-  uint largestY = 0;
 
   for (uint j = 0; j < REGION_H; ++j) {
     for (uint i = 0; i < REGION_W; ++i) {
-      const uint imgX = xIdx * REGION_W + i;
-      const uint imgY = yIdx * REGION_H + j;
-      const uint imgOffset = arrayIndex3d(imgW, imgH, imgX, imgY, zIdx);
-
-      const float px = readX(imgOffset);
+      const uint imgX = xIdx * STRIDE_X + i;
+      const uint imgY = yIdx * STRIDE_Y + j;
+      const uint imgOffset = arrayIndex3d(IMAGE_W, IMAGE_H, imgX, imgY, zIdx);
 
-      if (px > largest) {
-        largest = px;
-        largestX = imgX;
-        largestY = imgY;
-      }
+      largest = max(largest, readX(imgOffset));
     }
   }
 
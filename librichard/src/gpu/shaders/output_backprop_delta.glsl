@@ -3,6 +3,7 @@
 #include "common/common.glsl"
 
 layout(constant_id = 3) const uint LAYER_NUM_INPUTS = 1;
+layout(constant_id = 4) const bool SOFTMAX = false;
 
 layout(std140, binding = 0) readonly buffer StatusSsbo {
   StatusBuffer Status;
@@ -72,7 +73,8 @@ void main() {
   const uint yOffset = Status.sampleIndex * layerSize;
 
   const float deltaC = readA(index) - readY(yOffset + index);
-  writeD(index, deltaC * sigmoidPrime(readZ(index)));
+  // With softmax and cross-entropy, A - Y is already the gradient with respect to Z
+  writeD(index, SOFTMAX ? deltaC : deltaC * sigmoidPrime(readZ(index)));
 
   for (uint i = 0; i < LAYER_NUM_INPUTS; ++i) {
     const uint wIdx = index * LAYER_NUM_INPUTS + i;
@@ -0,0 +1,33 @@
+#version 430
+
+#include "common/common.glsl"
+
+layout(constant_id = 3) const uint LAYER_SIZE = 1;
+
+layout(std140, binding = 0) buffer ASsbo {
+  vec4 A[];
+};
+
+FN_READ(A)
+FN_WRITE(A)
+
+// Replaces the weighted inputs in A with their softmax. Runs as a single invocation, as the output
+// layer is small and every output depends on every other.
+void main() {
+  float largest = FLOAT_LOWEST;
+  for (uint i = 0; i < LAYER_SIZE; ++i) {
+    largest = max(largest, readA(i));
+  }
+
+  // Subtracting the largest input keeps the exponents at or below zero, so the sum can't overflow
+  float sum = 0.0;
+  for (uint i = 0; i < LAYER_SIZE; ++i) {
+    float e = exp(readA(i) - largest);
+    writeA(i, e);
+    sum += e;
+  }
+
+  for (uint i = 0; i < LAYER_SIZE; ++i) {
+    writeA(i, readA(i) / sum);
+  }
+}
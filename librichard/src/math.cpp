@@ -1,17 +1,25 @@
 #include "richard/math.hpp"
 #include "richard/exception.hpp"
 #include "richard/utils.hpp"
+#include "richard/simd.hpp"
+#include "richard/allocator.hpp"
+#include "richard/thread_pool.hpp"
 #include <ostream>
 #include <iomanip>
 #include <cstring>
 #include <random>
 #include <algorithm>
+#include <vector>
 
 namespace richard {
 namespace {
 
 const size_t FLOAT_PRECISION = 10;
 
+netfloat_t* allocateArray(size_t size) {
+  return static_cast<netfloat_t*>(memory::allocate(size * sizeof(netfloat_t)));
+}
+
 bool arraysEqual(const netfloat_t* A, const netfloat_t* B, size_t size) {
   for (size_t i = 0; i < size; ++i) {
     if (A[i] != B[i]) {
@@ -60,6 +68,212 @@ size_t count(std::initializer_list<std::initializer_list<std::initializer_list<n
   return numElements;
 }
 
+// Blocking parameters for computeMatrixProduct. A KC x NR panel of B stays in L1 and an MC x KC
+// block of A stays in L2.
+const size_t GEMM_KC = 256;
+const size_t GEMM_MC = 96;
+const size_t GEMM_NC = 2048;
+const size_t GEMM_MIN_WORK_PER_THREAD = 64 * 64 * 64;
+
+const size_t OUTER_MIN_WORK_PER_THREAD = 64 * 1024;
+
+size_t roundUp(size_t x, size_t multiple) {
+  return ((x + multiple - 1) / multiple) * multiple;
+}
+
+struct GemmOperand {
+  const netfloat_t* data;
+  size_t stride;
+  bool transposed;
+
+  netfloat_t at(size_t row, size_t col) const {
+    return transposed ? data[col * stride + row] : data[row * stride + col];
+  }
+};
+
+// Packs an mc x kc block of A into consecutive panels of tileRows rows, stored column by column
+void packA(const GemmOperand& A, size_t row0, size_t mc, size_t col0, size_t kc, size_t tileRows,
+  netfloat_t* packed) {
+
+  for (size_t i = 0; i < mc; i += tileRows) {
+    const size_t rows = std::min(tileRows, mc - i);
+    for (size_t p = 0; p < kc; ++p) {
+      for (size_t r = 0; r < rows; ++r) {
+        *packed++ = A.at(row0 + i + r, col0 + p);
+      }
+      for (size_t r = rows; r < tileRows; ++r) {
+        *packed++ = 0;
+      }
+    }
+  }
+}
+
+// Packs a kc x nc block of B into consecutive panels of tileCols columns, stored row by row
+void packB(const GemmOperand& B, size_t row0, size_t kc, size_t col0, size_t nc, size_t tileCols,
+  netfloat_t* packed) {
+
+  for (size_t j = 0; j < nc; j += tileCols) {
+    const size_t cols = std::min(tileCols, nc - j);
+    for (size_t p = 0; p < kc; ++p) {
+      if (!B.transposed) {
+        const netfloat_t* src = B.data + (row0 + p) * B.stride + col0 + j;
+        std::copy(src, src + cols, packed);
+        packed += cols;
+      }
+      else {
+        for (size_t c = 0; c < cols; ++c) {
+          *packed++ = B.at(row0 + p, col0 + j + c);
+        }
+      }
+      for (size_t c = cols; c < tileCols; ++c) {
+        *packed++ = 0;
+      }
+    }
+  }
+}
+
+// Computes rows [rowBegin, rowEnd) and columns [colBegin, colEnd) of C = A * B
+void computeMatrixProductRange(const GemmOperand& A, const GemmOperand& B, netfloat_t* C,
+  size_t ldc, size_t K, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd,
+  bool accumulate) {
+
+  const simd::GemmTile tile = simd::gemmTile();
+  const size_t MC = roundUp(GEMM_MC, tile.rows);
+  const size_t KC = std::min(GEMM_KC, K);
+  const size_t NC = std::min(GEMM_NC, roundUp(colEnd - colBegin, tile.cols));
+
+  std::vector<netfloat_t> packedA(std::min(MC, roundUp(rowEnd - rowBegin, tile.rows)) * KC);
+  std::vector<netfloat_t> packedB(KC * NC);
+
+  for (size_t jc = colBegin; jc < colEnd; jc += NC) {
+    const size_t nc = std::min(NC, colEnd - jc);
+
+    for (size_t pc = 0; pc < K; pc += KC) {
+      const size_t kc = std::min(KC, K - pc);
+      const bool accumulateBlock = accumulate || pc > 0;
+
+      packB(B, pc, kc, jc, nc, tile.cols, packedB.data());
+
+      for (size_t ic = rowBegin; ic < rowEnd; ic += MC) {
+        const size_t mc = std::min(MC, rowEnd - ic);
+
+        packA(A, ic, mc, pc, kc, tile.rows, packedA.data());
+
+        for (size_t jr = 0; jr < nc; jr += tile.cols) {
+          for (size_t ir = 0; ir < mc; ir += tile.rows) {
+            simd::gemmMicroKernel(kc, packedA.data() + ir * kc, packedB.data() + jr * kc,
+              C + (ic + ir) * ldc + jc + jr, ldc, std::min(tile.rows, mc - ir),
+              std::min(tile.cols, nc - jr), accumulateBlock);
+          }
+        }
+      }
+    }
+  }
+}
+
+// The number of adjacent outputs each specialised cross-correlation kernel computes together. Their
+// sums stay in registers, and each kernel element is loaded once for all of them.
+const size_t CONV_OUTPUT_BLOCK = 4;
+
+// Accumulates the window sums of the outputs starting at fmX in row fmY. The kernel's size is
+// known at compile time, so the loops over its window unroll completely.
+template<size_t KW, size_t KH, size_t N>
+void crossCorrelationOutputs(const netfloat_t* image, const Size3& imageShape,
+  const netfloat_t* kernel, size_t fmX, size_t fmY, size_t stride, netfloat_t* outputs) {
+
+  const size_t imW = imageShape[0];
+  const size_t planeSize = imageShape[0] * imageShape[1];
+
+  netfloat_t sums[N] = {};
+
+  for (size_t k = 0; k < imageShape[2]; ++k) {
+    const netfloat_t* window = image + k * planeSize + fmY * stride * imW + fmX * stride;
+    const netfloat_t* K = kernel + k * KW * KH;
+
+    for (size_t j = 0; j < KH; ++j) {
+      const netfloat_t* row = window + j * imW;
+
+      for (size_t i = 0; i < KW; ++i) {
+        const netfloat_t w = K[j * KW + i];
+
+        for (size_t b = 0; b < N; ++b) {
+          sums[b] += row[b * stride + i] * w;
+        }
+      }
+    }
+  }
+
+  std::copy(sums, sums + N, outputs);
+}
+
+template<size_t KW, size_t KH>
+void crossCorrelationFixed(const netfloat_t* image, const Size3& imageShape,
+  const netfloat_t* kernel, netfloat_t* result, size_t fmW, size_t fmH, size_t stride) {
+
+  for (size_t fmY = 0; fmY < fmH; ++fmY) {
+    netfloat_t* row = result + fmY * fmW;
+
+    size_t fmX = 0;
+    for (; fmX + CONV_OUTPUT_BLOCK <= fmW; fmX += CONV_OUTPUT_BLOCK) {
+      crossCorrelationOutputs<KW, KH, CONV_OUTPUT_BLOCK>(image, imageShape, kernel, fmX, fmY,
+        stride, row + fmX);
+    }
+    for (; fmX < fmW; ++fmX) {
+      crossCorrelationOutputs<KW, KH, 1>(image, imageShape, kernel, fmX, fmY, stride, row + fmX);
+    }
+  }
+}
+
+using CrossCorrelationFn = void (*)(const netfloat_t*, const Size3&, const netfloat_t*, netfloat_t*,
+  size_t, size_t, size_t);
+
+struct CrossCorrelationKernel {
+  size_t kernelW;
+  size_t kernelH;
+  CrossCorrelationFn fn;
+};
+
+// Kernel shapes with a specialised implementation. Anything else uses the generic loop.
+const CrossCorrelationKernel CROSS_CORRELATION_KERNELS[] = {
+  { 1, 1, crossCorrelationFixed<1, 1> },
+  { 3, 3, crossCorrelationFixed<3, 3> },
+  { 5, 5, crossCorrelationFixed<5, 5> }
+};
+
+CrossCorrelationFn findCrossCorrelationKernel(size_t kernelW, size_t kernelH) {
+  for (const CrossCorrelationKernel& entry : CROSS_CORRELATION_KERNELS) {
+    if (entry.kernelW == kernelW && entry.kernelH == kernelH) {
+      return entry.fn;
+    }
+  }
+  return nullptr;
+}
+
+void crossCorrelationGeneric(const Array3& image, const Kernel& kernel, Array2& result,
+  bool flipKernel, size_t stride) {
+
+  const size_t kD = kernel.D();
+  const size_t kH = kernel.H();
+  const size_t kW = kernel.W();
+
+  for (size_t fmY = 0; fmY < result.H(); ++fmY) {
+    for (size_t fmX = 0; fmX < result.W(); ++fmX) {
+      netfloat_t sum = 0.0;
+
+      for (size_t k = 0; k < kD; ++k) {
+        for (size_t j = 0; j < kH; ++j) {
+          for (size_t i = 0; i < kW; ++i) {
+            netfloat_t kPx = flipKernel ? kernel.at(kW - i - 1, kH - j - 1, k) : kernel.at(i, j, k);
+            sum += image.at(fmX * stride + i, fmY * stride + j, k) * kPx;
+          }
+        }
+      }
+
+      result.set(fmX, fmY, sum);
+    }
+  }
+}
+
 }
 
 DataArray::DataArray()
@@ -67,54 +281,78 @@ DataArray::DataArray()
   , m_size(0) {}
 
 DataArray::DataArray(size_t size)
-  : m_data(new netfloat_t[size])
+  : m_data(allocateArray(size))
   , m_size(size) {
 
-  memset(m_data.get(), 0, m_size * sizeof(netfloat_t));
+  memset(m_data, 0, m_size * sizeof(netfloat_t));
 }
 
+DataArray::DataArray(size_t size, Uninitialised)
+  : m_data(allocateArray(size))
+  , m_size(size) {}
+
 DataArray::DataArray(const DataArray& cpy)
-  : m_data(new netfloat_t[cpy.m_size])
+  : m_data(allocateArray(cpy.m_size))
   , m_size(cpy.m_size) {
 
-  memcpy(m_data.get(), cpy.m_data.get(), m_size * sizeof(netfloat_t));
+  memcpy(m_data, cpy.m_data, m_size * sizeof(netfloat_t));
 }
 
 DataArray::DataArray(DataArray&& mv)
-  : m_data(std::move(mv.m_data))
+  : m_data(mv.m_data)
   , m_size(mv.m_size) {
 
+  mv.m_data = nullptr;
   mv.m_size = 0;
 }
 
 DataArray& DataArray::operator=(const DataArray& rhs) {
-  m_size = rhs.m_size;
-  m_data.reset(new netfloat_t[m_size]);
-  memcpy(m_data.get(), rhs.m_data.get(), m_size * sizeof(netfloat_t));
+  if (this == &rhs) {
+    return *this;
+  }
+
+  if (m_size != rhs.m_size) {
+    memory::deallocate(m_data, m_size * sizeof(netfloat_t));
+    m_size = rhs.m_size;
+    m_data = allocateArray(m_size);
+  }
+
+  memcpy(m_data, rhs.m_data, m_size * sizeof(netfloat_t));
 
   return *this;
 }
 
 DataArray& DataArray::operator=(DataArray&& rhs) {
+  if (this == &rhs) {
+    return *this;
+  }
+
+  memory::deallocate(m_data, m_size * sizeof(netfloat_t));
+
   m_size = rhs.m_size;
-  m_data = std::move(rhs.m_data);
+  m_data = rhs.m_data;
 
+  rhs.m_data = nullptr;
   rhs.m_size = 0;
 
   return *this;
 }
 
+DataArray::~DataArray() {
+  memory::deallocate(m_data, m_size * sizeof(netfloat_t));
+}
+
 DataArray DataArray::concat(const std::vector<std::reference_wrapper<DataArray>>& arrays) {
   size_t totalSize = 0;
   for (auto array : arrays) {
     totalSize += array.get().size();
   }
 
-  DataArray result(totalSize);
+  DataArray result(totalSize, Uninitialised{});
 
-  netfloat_t* ptr = result.m_data.get();
+  netfloat_t* ptr = result.m_data;
   for (auto array : arrays) {
-    memcpy(ptr, array.get().m_data.get(), array.get().size() * sizeof(netfloat_t));
+    memcpy(ptr, array.get().m_data, array.get().size() * sizeof(netfloat_t));
     ptr += array.get().size();
   }
 
@@ -151,6 +389,11 @@ Vector::Vector(size_t length)
   , m_data(m_storage.data())
   , m_size(length) {}
 
+Vector::Vector(size_t length, Uninitialised)
+  : m_storage(length, Uninitialised{})
+  , m_data(m_storage.data())
+  , m_size(length) {}
+
 Vector::Vector(netfloat_t* data, size_t size)
   : m_data(data)
   , m_size(size) {}
@@ -166,7 +409,7 @@ Vector::Vector(DataArray&& data)
   , m_size(m_storage.size()) {}
 
 Vector::Vector(const Vector& cpy)
-  : m_storage(cpy.m_size)
+  : m_storage(cpy.m_size, Uninitialised{})
   , m_data(m_storage.data())
   , m_size(cpy.m_size) {
 
@@ -177,7 +420,7 @@ Vector::Vector(Vector&& mv) {
   m_size = mv.m_size;
 
   if (mv.isShallow()) {
-    m_storage = DataArray(m_size);
+    m_storage = DataArray(m_size, Uninitialised{});
     m_data = m_storage.data();
     memcpy(m_data, mv.m_data, m_size * sizeof(netfloat_t));
   }
@@ -194,9 +437,9 @@ Vector& Vector::operator=(const Vector& rhs) {
   if (isShallow()) {
     DBG_ASSERT(rhs.size() == m_size);
   }
-  else {
+  else if (rhs.m_size != m_size) {
     m_size = rhs.m_size;
-    m_storage = DataArray(m_size);
+    m_storage = DataArray(m_size, Uninitialised{});
     m_data = m_storage.data();
   }
 
@@ -233,12 +476,7 @@ netfloat_t Vector::magnitude() const {
 }
 
 netfloat_t Vector::squareMagnitude() const {
-  netfloat_t sqSum = 0.0;
-  for (size_t i = 0; i < m_size; ++i) {
-    netfloat_t x = m_data[i];
-    sqSum += x * x;
-  }
-  return sqSum;
+  return simd::squareSum(m_data, m_size);
 }
 
 void Vector::zero() {
@@ -272,78 +510,28 @@ void Vector::normalize() {
 netfloat_t Vector::dot(const Vector& rhs) const {
   DBG_ASSERT(rhs.m_size == m_size);
 
-  netfloat_t x = 0.0;
-  for (size_t i = 0; i < m_size; ++i) {
-    x += m_data[i] * rhs[i];
-  }
-  return x;
+  return simd::dot(m_data, rhs.m_data, m_size);
 }
 
 Vector Vector::hadamard(const Vector& rhs) const {
   DBG_ASSERT(rhs.m_size == m_size);
 
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] * rhs[i];
-  }
+  Vector v(m_size, Uninitialised{});
+  simd::multiply(m_data, rhs.m_data, v.m_data, m_size);
   return v;
 }
 
-Vector Vector::operator+(const Vector& rhs) const {
-  DBG_ASSERT(rhs.m_size == m_size);
-
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] + rhs[i];
-  }
-  return v;
-}
-
-Vector Vector::operator-(const Vector& rhs) const {
+Vector& Vector::operator+=(const Vector& rhs) {
   DBG_ASSERT(rhs.m_size == m_size);
 
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] - rhs[i];
-  }
-  return v;
-}
-
-Vector Vector::operator*(netfloat_t s) const {
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] * s;
-  }
-  return v;
-}
-
-Vector Vector::operator+(netfloat_t s) const {
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] + s;
-  }
-  return v;
-}
-
-Vector Vector::operator-(netfloat_t s) const {
-  Vector v(m_size);
-  for (size_t i = 0; i < m_size; ++i) {
-    v[i] = m_data[i] - s;
-  }
-  return v;
-}
-
-Vector& Vector::operator+=(const Vector& rhs) {
-  for (size_t i = 0; i < m_size; ++i) {
-    m_data[i] += rhs.m_data[i];
-  }
+  simd::add(m_data, rhs.m_data, m_data, m_size);
   return *this;
 }
 
 Vector& Vector::operator-=(const Vector& rhs) {
-  for (size_t i = 0; i < m_size; ++i) {
-    m_data[i] -= rhs.m_data[i];
-  }
+  DBG_ASSERT(rhs.m_size == m_size);
+
+  simd::subtract(m_data, rhs.m_data, m_data, m_size);
   return *this;
 }
 
@@ -376,29 +564,15 @@ Vector& Vector::operator/=(netfloat_t x) {
 }
 
 netfloat_t Vector::sum() const {
-  netfloat_t s = 0.0;
-
-  for (size_t i = 0; i < m_size; ++i) {
-    s += m_data[i];
-  }
-
-  return s;
+  return simd::sum(m_data, m_size);
 }
 
-Vector Vector::computeTransform(const std::function<netfloat_t(netfloat_t)>& f) const {
-  Vector v(m_size);
-
-  for (size_t i = 0; i < m_size; ++i) {
-    v.m_data[i] = f(m_data[i]);
-  }
-
-  return v;
+void* Vector::operator new(size_t bytes) {
+  return memory::allocate(bytes);
 }
 
-void Vector::transformInPlace(const std::function<netfloat_t(netfloat_t)>& f) {
-  for (size_t i = 0; i < m_size; ++i) {
-    m_data[i] = f(m_data[i]);
-  }
+void Vector::operator delete(void* ptr, size_t bytes) {
+  memory::deallocate(ptr, bytes);
 }
 
 VectorPtr Vector::createShallow(DataArray& data) {
@@ -455,6 +629,12 @@ Matrix::Matrix(size_t cols, size_t rows)
   , m_rows(rows)
   , m_cols(cols) {}
 
+Matrix::Matrix(size_t cols, size_t rows, Uninitialised)
+  : m_storage(cols * rows, Uninitialised{})
+  , m_data(m_storage.data())
+  , m_rows(rows)
+  , m_cols(cols) {}
+
 Matrix::Matrix(netfloat_t* data, size_t cols, size_t rows)
   : m_data(data)
   , m_rows(rows)
@@ -479,7 +659,7 @@ Matrix::Matrix(DataArray&& data, size_t cols, size_t rows)
 }
 
 Matrix::Matrix(const Matrix& cpy)
-  : m_storage(cpy.size())
+  : m_storage(cpy.size(), Uninitialised{})
   , m_data(m_storage.data())
   , m_rows(cpy.m_rows)
   , m_cols(cpy.m_cols) {
@@ -492,7 +672,7 @@ Matrix::Matrix(Matrix&& mv) {
   m_rows = mv.m_rows;
 
   if (mv.isShallow()) {
-    m_storage = DataArray(m_cols * m_rows);
+    m_storage = DataArray(m_cols * m_rows, Uninitialised{});
     m_data = m_storage.data();
     memcpy(m_data, mv.m_data, m_cols * m_rows * sizeof(netfloat_t));
   }
@@ -511,10 +691,12 @@ Matrix& Matrix::operator=(const Matrix& rhs) {
     DBG_ASSERT(rhs.m_cols == m_cols && rhs.m_rows == m_rows);
   }
   else {
+    if (rhs.size() != size()) {
+      m_storage = DataArray(rhs.size(), Uninitialised{});
+      m_data = m_storage.data();
+    }
     m_cols = rhs.m_cols;
     m_rows = rhs.m_rows;
-    m_storage = DataArray(m_cols * m_rows);
-    m_data = m_storage.data();
   }
 
   memcpy(m_data, rhs.m_data, m_cols * m_rows * sizeof(netfloat_t));
@@ -542,80 +724,16 @@ Matrix& Matrix::operator=(Matrix&& rhs) {
 Vector Matrix::operator*(const Vector& rhs) const {
   DBG_ASSERT(rhs.size() == m_cols);
 
-  Vector v(m_rows);
-  for (size_t r = 0; r < m_rows; ++r) {
-    netfloat_t sum = 0.0;
-    for (size_t c = 0; c < m_cols; ++c) {
-      sum += at(c, r) * rhs[c];
-    }
-    v[r] = sum;
-  }
+  Vector v(m_rows, Uninitialised{});
+  simd::matrixVectorMultiply(m_data, rhs.data(), v.data(), m_cols, m_rows);
   return v;
 }
 
-Matrix Matrix::operator+(const Matrix& rhs) const {
-  DBG_ASSERT(rhs.m_cols == m_cols);
-  DBG_ASSERT(rhs.m_rows == m_rows);
-
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] + rhs.m_data[i];
-  }
-
-  return m;
-}
-
-Matrix Matrix::operator-(const Matrix& rhs) const {
-  DBG_ASSERT(rhs.m_cols == m_cols);
-  DBG_ASSERT(rhs.m_rows == m_rows);
-
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] - rhs.m_data[i];
-  }
-
-  return m;
-}
-
-Matrix Matrix::operator+(netfloat_t x) const {
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] + x;
-  }
-
-  return m;
-}
-
-Matrix Matrix::operator-(netfloat_t x) const {
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] - x;
-  }
-
-  return m;
-}
-
-Matrix Matrix::operator*(netfloat_t x) const {
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] * x;
-  }
-
-  return m;
-}
-
-Matrix Matrix::operator/(netfloat_t x) const {
-  Matrix m(m_cols, m_rows);
-
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] / x;
-  }
+Matrix Matrix::operator*(const Matrix& rhs) const {
+  DBG_ASSERT(rhs.m_rows == m_cols);
 
+  Matrix m(rhs.m_cols, m_rows, Uninitialised{});
+  computeMatrixProduct(*this, rhs, m);
   return m;
 }
 
@@ -648,30 +766,24 @@ Matrix& Matrix::operator/=(netfloat_t x) {
 }
 
 Matrix& Matrix::operator+=(const Matrix& rhs) {
-  for (size_t i = 0; i < size(); ++i) {
-    m_data[i] += rhs.m_data[i];
-  }
+  DBG_ASSERT(rhs.size() == size());
+
+  simd::add(m_data, rhs.m_data, m_data, size());
   return *this;
 }
 
 Matrix& Matrix::operator-=(const Matrix& rhs) {
-  for (size_t i = 0; i < size(); ++i) {
-    m_data[i] -= rhs.m_data[i];
-  }
+  DBG_ASSERT(rhs.size() == size());
+
+  simd::subtract(m_data, rhs.m_data, m_data, size());
   return *this;
 }
 
 Vector Matrix::transposeMultiply(const Vector& rhs) const {
   DBG_ASSERT(rhs.size() == m_rows);
 
-  Vector v(m_cols);
-  for (size_t c = 0; c < m_cols; ++c) {
-    netfloat_t sum = 0.0;
-    for (size_t r = 0; r < m_rows; ++r) {
-      sum += at(c, r) * rhs[r];
-    }
-    v[c] = sum;
-  }
+  Vector v(m_cols, Uninitialised{});
+  simd::transposeMatrixVectorMultiply(m_data, rhs.data(), v.data(), m_cols, m_rows);
   return v;
 }
 
@@ -679,10 +791,8 @@ Matrix Matrix::hadamard(const Matrix& rhs) const {
   DBG_ASSERT(rhs.m_cols == m_cols);
   DBG_ASSERT(rhs.m_rows == m_rows);
 
-  Matrix m(m_cols, m_rows);
-  for (size_t i = 0; i < size(); ++i) {
-    m.m_data[i] = m_data[i] * rhs.m_data[i];
-  }
+  Matrix m(m_cols, m_rows, Uninitialised{});
+  simd::multiply(m_data, rhs.m_data, m.m_data, size());
   return m;
 }
 
@@ -708,17 +818,11 @@ Matrix& Matrix::randomize(netfloat_t standardDeviation) {
 }
 
 netfloat_t Matrix::sum() const {
-  netfloat_t s = 0.0;
-
-  for (size_t i = 0; i < size(); ++i) {
-    s += m_data[i];
-  }
-
-  return s;
+  return simd::sum(m_data, size());
 }
 
 Matrix Matrix::transpose() const {
-  Matrix m(m_rows, m_cols);
+  Matrix m(m_rows, m_cols, Uninitialised{});
   for (size_t c = 0; c < m_cols; ++c) {
     for (size_t r = 0; r < m_rows; ++r) {
       m.set(r, c, at(c, r));
@@ -735,6 +839,14 @@ bool Matrix::operator==(const Matrix& rhs) const {
   return arraysEqual(m_data, rhs.m_data, size());
 }
 
+void* Matrix::operator new(size_t bytes) {
+  return memory::allocate(bytes);
+}
+
+void Matrix::operator delete(void* ptr, size_t bytes) {
+  memory::deallocate(ptr, bytes);
+}
+
 MatrixPtr Matrix::createShallow(DataArray& data, size_t cols, size_t rows) {
   DBG_ASSERT(data.size() == cols * rows);
   return MatrixPtr(new Matrix(data.data(), cols, rows));
@@ -809,9 +921,19 @@ Kernel::Kernel(size_t W, size_t H, size_t D)
 Kernel::Kernel(const Size3& shape)
   : m_storage(shape[0] * shape[1] * shape[2])
   , m_data(m_storage.data())
-  , m_D(shape[0])
+  , m_D(shape[2])
   , m_H(shape[1])
-  , m_W(shape[2]) {}
+  , m_W(shape[0]) {}
+
+Kernel::Kernel(size_t W, size_t H, size_t D, Uninitialised)
+  : m_storage(W * H * D, Uninitialised{})
+  , m_data(m_storage.data())
+  , m_D(D)
+  , m_H(H)
+  , m_W(W) {}
+
+Kernel::Kernel(const Size3& shape, Uninitialised)
+  : Kernel(shape[0], shape[1], shape[2], Uninitialised{}) {}
 
 Kernel::Kernel(const DataArray& data, size_t W, size_t H, size_t D)
   : m_storage(data)
@@ -826,9 +948,9 @@ Kernel::Kernel(const DataArray& data, size_t W, size_t H, size_t D)
 Kernel::Kernel(const DataArray& data, const Size3& shape)
   : m_storage(data)
   , m_data(m_storage.data())
-  , m_D(shape[0])
+  , m_D(shape[2])
   , m_H(shape[1])
-  , m_W(shape[2]) {
+  , m_W(shape[0]) {
 
   DBG_ASSERT(m_storage.size() == size());    
 }
@@ -836,9 +958,9 @@ Kernel::Kernel(const DataArray& data, const Size3& shape)
 Kernel::Kernel(DataArray& data, const Size3& shape)
   : m_storage(data)
   , m_data(m_storage.data())
-  , m_D(shape[0])
+  , m_D(shape[2])
   , m_H(shape[1])
-  , m_W(shape[2]) {
+  , m_W(shape[0]) {
 
   DBG_ASSERT(m_storage.size() == size());    
 }
@@ -856,9 +978,9 @@ Kernel::Kernel(DataArray&& data, size_t W, size_t H, size_t D)
 Kernel::Kernel(DataArray&& data, const Size3& shape)
   : m_storage(std::move(data))
   , m_data(m_storage.data())
-  , m_D(shape[0])
+  , m_D(shape[2])
   , m_H(shape[1])
-  , m_W(shape[2]) {
+  , m_W(shape[0]) {
 
   DBG_ASSERT(m_storage.size() == size());    
 }
@@ -870,7 +992,7 @@ Kernel::Kernel(netfloat_t* data, size_t W, size_t H, size_t D)
   , m_W(W) {}
 
 Kernel::Kernel(const Kernel& cpy)
-  : m_storage(cpy.size())
+  : m_storage(cpy.size(), Uninitialised{})
   , m_data(m_storage.data())
   , m_D(cpy.m_D)
   , m_H(cpy.m_H)
@@ -885,7 +1007,7 @@ Kernel::Kernel(Kernel&& mv) {
   m_D = mv.m_D;
 
   if (mv.isShallow()) {
-    m_storage = DataArray(m_W * m_H * m_D);
+    m_storage = DataArray(m_W * m_H * m_D, Uninitialised{});
     m_data = m_storage.data();
     memcpy(m_data, mv.m_data, m_W * m_H * m_D * sizeof(netfloat_t));
   }
@@ -913,11 +1035,13 @@ Kernel& Kernel::operator=(const Kernel& rhs) {
     DBG_ASSERT(rhs.m_W == m_W && rhs.m_H == m_H && rhs.m_D == m_D);
   }
   else {
+    if (rhs.size() != size()) {
+      m_storage = DataArray(rhs.size(), Uninitialised{});
+      m_data = m_storage.data();
+    }
     m_W = rhs.m_W;
     m_H = rhs.m_H;
     m_D = rhs.m_D;
-    m_storage = DataArray(m_W * m_H * m_D);
-    m_data = m_storage.data();
   }
 
   memcpy(m_data, rhs.m_data, m_W * m_H * m_D * sizeof(netfloat_t));
@@ -965,63 +1089,13 @@ Kernel& Kernel::randomize(netfloat_t standardDeviation) {
   return *this;
 }
 
-Kernel Kernel::operator+(const Kernel& rhs) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] + rhs.m_data[i];
-  }
-  return K;
-}
-
-Kernel Kernel::operator-(const Kernel& rhs) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] - rhs.m_data[i];
-  }
-  return K;
-}
-
-Kernel Kernel::operator+(netfloat_t x) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] + x;
-  }
-  return K;
-}
-
-Kernel Kernel::operator-(netfloat_t x) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] - x;
-  }
-  return K;
-}
-
-Kernel Kernel::operator*(netfloat_t x) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] * x;
-  }
-  return K;
-}
-
-Kernel Kernel::operator/(netfloat_t x) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = m_data[i] / x;
-  }
-  return K;
-}
-
 Kernel Kernel::hadamard(const Kernel& rhs) const {
   DBG_ASSERT(rhs.m_W == m_W);
   DBG_ASSERT(rhs.m_H == m_H);
   DBG_ASSERT(rhs.m_D == m_D);
 
-  Kernel k(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    k.m_data[i] = m_data[i] * rhs.m_data[i];
-  }
+  Kernel k(m_W, m_H, m_D, Uninitialised{});
+  simd::multiply(m_data, rhs.m_data, k.m_data, size());
   return k;
 }
 
@@ -1054,31 +1128,25 @@ Kernel& Kernel::operator/=(netfloat_t x) {
 }
 
 Kernel& Kernel::operator+=(const Kernel& rhs) {
-  for (size_t i = 0; i < size(); ++i) {
-    m_data[i] += rhs.m_data[i];
-  }
+  DBG_ASSERT(rhs.size() == size());
+
+  simd::add(m_data, rhs.m_data, m_data, size());
   return *this;
 }
 
 Kernel& Kernel::operator-=(const Kernel& rhs) {
-  for (size_t i = 0; i < size(); ++i) {
-    m_data[i] -= rhs.m_data[i];
-  }
+  DBG_ASSERT(rhs.size() == size());
+
+  simd::subtract(m_data, rhs.m_data, m_data, size());
   return *this;
 }
 
-Kernel Kernel::computeTransform(const std::function<netfloat_t(netfloat_t)>& f) const {
-  Kernel K(m_W, m_H, m_D);
-  for (size_t i = 0; i < size(); ++i) {
-    K.m_data[i] = f(m_data[i]);
-  }
-  return K;
+void* Kernel::operator new(size_t bytes) {
+  return memory::allocate(bytes);
 }
 
-void Kernel::transformInPlace(const std::function<netfloat_t(netfloat_t)>& f) {
-  for (size_t i = 0; i < size(); ++i) {
-    m_data[i] = f(m_data[i]);
-  }
+void Kernel::operator delete(void* ptr, size_t bytes) {
+  memory::deallocate(ptr, bytes);
 }
 
 KernelPtr Kernel::createShallow(DataArray& data, size_t W, size_t H, size_t D) {
@@ -1100,7 +1168,7 @@ ConstKernelPtr Kernel::createShallow(const netfloat_t* data, size_t W, size_t H,
 }
 
 void computeCrossCorrelation(const Array3& image, const Kernel& kernel, Array2& result,
-  bool flipKernel) {
+  bool flipKernel, size_t stride) {
 
   const size_t kD = kernel.D();
   const size_t kH = kernel.H();
@@ -1109,31 +1177,79 @@ void computeCrossCorrelation(const Array3& image, const Kernel& kernel, Array2&
   DBG_ASSERT(image.W() >= kW);
   DBG_ASSERT(image.H() >= kH);
   DBG_ASSERT(image.D() == kD);
+  DBG_ASSERT(stride > 0);
+
+  DBG_ASSERT(result.W() == (image.W() - kW) / stride + 1);
+  DBG_ASSERT(result.H() == (image.H() - kH) / stride + 1);
+
+  CrossCorrelationFn fn = findCrossCorrelationKernel(kW, kH);
+  if (fn == nullptr) {
+    crossCorrelationGeneric(image, kernel, result, flipKernel, stride);
+    return;
+  }
+
+  if (!flipKernel) {
+    fn(image.data(), image.shape(), kernel.data(), result.data(), result.W(), result.H(), stride);
+    return;
+  }
+
+  DataArray flipped(kernel.size(), Uninitialised{});
+  for (size_t k = 0; k < kD; ++k) {
+    for (size_t j = 0; j < kH; ++j) {
+      for (size_t i = 0; i < kW; ++i) {
+        flipped[(k * kH + j) * kW + i] = kernel.at(kW - i - 1, kH - j - 1, k);
+      }
+    }
+  }
+
+  fn(image.data(), image.shape(), flipped.data(), result.data(), result.W(), result.H(), stride);
+}
 
-  const size_t fmW = image.W() - kW + 1;
-  const size_t fmH = image.H() - kH + 1;
+void computeCrossCorrelation(const netfloat_t* image, const Size3& imageShape,
+  const netfloat_t* kernel, size_t kernelW, size_t kernelH, netfloat_t* result, size_t stride) {
 
-  DBG_ASSERT(result.W() == fmW);
-  DBG_ASSERT(result.H() == fmH);
+  DBG_ASSERT(imageShape[0] >= kernelW);
+  DBG_ASSERT(imageShape[1] >= kernelH);
+  DBG_ASSERT(stride > 0);
+
+  const size_t fmW = (imageShape[0] - kernelW) / stride + 1;
+  const size_t fmH = (imageShape[1] - kernelH) / stride + 1;
+
+  CrossCorrelationFn fn = findCrossCorrelationKernel(kernelW, kernelH);
+  if (fn != nullptr) {
+    fn(image, imageShape, kernel, result, fmW, fmH, stride);
+    return;
+  }
+
+  const size_t planeSize = imageShape[0] * imageShape[1];
 
   for (size_t fmY = 0; fmY < fmH; ++fmY) {
     for (size_t fmX = 0; fmX < fmW; ++fmX) {
       netfloat_t sum = 0.0;
 
-      for (size_t k = 0; k < kD; ++k) {
-        for (size_t j = 0; j < kH; ++j) {
-          for (size_t i = 0; i < kW; ++i) {
-            netfloat_t kPx = flipKernel ? kernel.at(kW - i - 1, kH - j - 1, k) : kernel.at(i, j, k);
-            sum += image.at(fmX + i, fmY + j, k) * kPx;
+      for (size_t k = 0; k < imageShape[2]; ++k) {
+        const netfloat_t* window = image + k * planeSize + fmY * stride * imageShape[0]
+          + fmX * stride;
+        const netfloat_t* K = kernel + k * kernelW * kernelH;
+
+        for (size_t j = 0; j < kernelH; ++j) {
+          for (size_t i = 0; i < kernelW; ++i) {
+            sum += window[j * imageShape[0] + i] * K[j * kernelW + i];
           }
         }
       }
 
-      result.set(fmX, fmY, sum);
+      result[fmY * fmW + fmX] = sum;
     }
   }
 }
 
+void test_computeCrossCorrelationGeneric(const Array3& image, const Kernel& kernel,
+  Array2& result, bool flipKernel, size_t stride) {
+
+  crossCorrelationGeneric(image, kernel, result, flipKernel, stride);
+}
+
 void computeFullCrossCorrelation(const Array3& image, const Kernel& kernel, Array2& result,
   bool flipKernel) {
 
@@ -1177,7 +1293,7 @@ void computeFullCrossCorrelation(const Array3& image, const Kernel& kernel, Arra
 }
 
 Matrix outerProduct(const Vector& A, const Vector& B) {
-  Matrix M(B.size(), A.size());
+  Matrix M(B.size(), A.size(), Uninitialised{});
 
   for (size_t j = 0; j < A.size(); ++j) {
     for (size_t i = 0; i < B.size(); ++i) {
@@ -1188,6 +1304,255 @@ Matrix outerProduct(const Vector& A, const Vector& B) {
   return M;
 }
 
+void accumulateOuterProduct(const Vector& A, const Vector& B, Matrix& result, netfloat_t scale,
+  ThreadPool* pool) {
+
+  ASSERT_MSG(result.rows() == A.size() && result.cols() == B.size(),
+    "Result matrix has wrong dimensions");
+
+  const size_t rows = result.rows();
+  const size_t cols = result.cols();
+
+  auto accumulateRows = [&](size_t begin, size_t end) {
+    for (size_t j = begin; j < end; ++j) {
+      simd::axpy(scale * A[j], B.data(), result.data() + j * cols, cols);
+    }
+  };
+
+  size_t numParts = pool ? pool->numThreads() : 1;
+  numParts = std::min(numParts, std::max<size_t>(1, rows * cols / OUTER_MIN_WORK_PER_THREAD));
+  numParts = std::max<size_t>(1, std::min(numParts, rows));
+
+  if (numParts == 1) {
+    accumulateRows(0, rows);
+    return;
+  }
+
+  parallelFor(*pool, 0, numParts, [&](size_t part) {
+    accumulateRows(rows * part / numParts, rows * (part + 1) / numParts);
+  });
+}
+
+void reorder(const netfloat_t* src, Layout srcLayout, netfloat_t* dst, Layout dstLayout,
+  const Size3& shape) {
+
+  if (srcLayout == dstLayout) {
+    std::copy(src, src + layoutSize(srcLayout, shape), dst);
+    return;
+  }
+
+  const size_t dstBlock = layoutBlockSize(dstLayout, shape[2]);
+  if (shape[2] % dstBlock != 0) {
+    std::fill(dst, dst + layoutSize(dstLayout, shape), 0.f);
+  }
+
+  for (size_t z = 0; z < shape[2]; ++z) {
+    for (size_t y = 0; y < shape[1]; ++y) {
+      for (size_t x = 0; x < shape[0]; ++x) {
+        dst[layoutIndex(dstLayout, shape, x, y, z)] = src[layoutIndex(srcLayout, shape, x, y, z)];
+      }
+    }
+  }
+}
+
+void im2col(const Array3& image, size_t kernelW, size_t kernelH, Matrix& columns, size_t stride,
+  size_t padding) {
+
+  im2col(image.data(), image.shape(), 1, kernelW, kernelH, columns, stride, padding);
+}
+
+void im2col(const netfloat_t* images, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, Matrix& columns, size_t stride, size_t padding) {
+
+  DBG_ASSERT(columns.cols() == batchSize
+    * ((imageShape[0] + 2 * padding - kernelW) / stride + 1)
+    * ((imageShape[1] + 2 * padding - kernelH) / stride + 1));
+  DBG_ASSERT(columns.rows() == kernelW * kernelH * imageShape[2]);
+
+  im2col(images, imageShape, batchSize, kernelW, kernelH, columns.data(), stride, padding);
+}
+
+void im2col(const netfloat_t* images, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, netfloat_t* columns, size_t stride, size_t padding) {
+
+  const size_t imageW = imageShape[0];
+  const size_t imageH = imageShape[1];
+  const size_t imageD = imageShape[2];
+
+  DBG_ASSERT(imageW + 2 * padding >= kernelW);
+  DBG_ASSERT(imageH + 2 * padding >= kernelH);
+  DBG_ASSERT(stride > 0);
+
+  const size_t fmW = (imageW + 2 * padding - kernelW) / stride + 1;
+  const size_t fmH = (imageH + 2 * padding - kernelH) / stride + 1;
+  const size_t fmSize = fmW * fmH;
+  const size_t numCols = batchSize * fmSize;
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    const netfloat_t* src = images + n * imageW * imageH * imageD;
+    netfloat_t* dst = columns + n * fmSize;
+
+    for (size_t z = 0; z < imageD; ++z) {
+      const netfloat_t* plane = src + z * imageW * imageH;
+
+      for (size_t j = 0; j < kernelH; ++j) {
+        for (size_t i = 0; i < kernelW; ++i) {
+          netfloat_t* row = dst;
+
+          if (stride == 1 && padding == 0) {
+            for (size_t y = 0; y < fmH; ++y) {
+              const netfloat_t* imageRow = plane + (y + j) * imageW + i;
+              std::copy(imageRow, imageRow + fmW, row);
+              row += fmW;
+            }
+          }
+          else {
+            for (size_t y = 0; y < fmH; ++y) {
+              // Image coordinates are offset by the padding, so anything outside [0, imageW) or
+              // [0, imageH) reads as zero
+              const size_t imageY = y * stride + j;
+
+              if (imageY < padding || imageY - padding >= imageH) {
+                std::fill(row, row + fmW, 0.f);
+              }
+              else {
+                const netfloat_t* imageRow = plane + (imageY - padding) * imageW;
+
+                for (size_t x = 0; x < fmW; ++x) {
+                  const size_t imageX = x * stride + i;
+                  row[x] = imageX < padding || imageX - padding >= imageW ?
+                    0.f : imageRow[imageX - padding];
+                }
+              }
+
+              row += fmW;
+            }
+          }
+
+          dst += numCols;
+        }
+      }
+    }
+  }
+}
+
+void col2im(const Matrix& columns, const Size3& imageShape, size_t batchSize, size_t kernelW,
+  size_t kernelH, netfloat_t* images, size_t stride, size_t padding) {
+
+  const size_t imageW = imageShape[0];
+  const size_t imageH = imageShape[1];
+  const size_t imageD = imageShape[2];
+
+  DBG_ASSERT(imageW + 2 * padding >= kernelW);
+  DBG_ASSERT(imageH + 2 * padding >= kernelH);
+  DBG_ASSERT(stride > 0);
+
+  const size_t fmW = (imageW + 2 * padding - kernelW) / stride + 1;
+  const size_t fmH = (imageH + 2 * padding - kernelH) / stride + 1;
+  const size_t fmSize = fmW * fmH;
+
+  DBG_ASSERT(columns.cols() == batchSize * fmSize);
+  DBG_ASSERT(columns.rows() == kernelW * kernelH * imageD);
+
+  std::fill(images, images + batchSize * imageW * imageH * imageD, 0.f);
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    netfloat_t* dst = images + n * imageW * imageH * imageD;
+    const netfloat_t* src = columns.data() + n * fmSize;
+
+    for (size_t z = 0; z < imageD; ++z) {
+      netfloat_t* plane = dst + z * imageW * imageH;
+
+      for (size_t j = 0; j < kernelH; ++j) {
+        for (size_t i = 0; i < kernelW; ++i) {
+          const netfloat_t* row = src;
+
+          for (size_t y = 0; y < fmH; ++y) {
+            const size_t imageY = y * stride + j;
+
+            if (imageY >= padding && imageY - padding < imageH) {
+              netfloat_t* imageRow = plane + (imageY - padding) * imageW;
+
+              if (stride == 1 && padding == 0) {
+                simd::add(imageRow + i, row, imageRow + i, fmW);
+              }
+              else {
+                for (size_t x = 0; x < fmW; ++x) {
+                  const size_t imageX = x * stride + i;
+                  if (imageX >= padding && imageX - padding < imageW) {
+                    imageRow[imageX - padding] += row[x];
+                  }
+                }
+              }
+            }
+
+            row += fmW;
+          }
+
+          src += columns.cols();
+        }
+      }
+    }
+  }
+}
+
+void computeMatrixProduct(const Matrix& A, const Matrix& B, Matrix& result, bool transposeA,
+  bool transposeB, bool accumulate, ThreadPool* pool) {
+
+  const size_t M = transposeA ? A.cols() : A.rows();
+  const size_t K = transposeA ? A.rows() : A.cols();
+  const size_t N = transposeB ? B.rows() : B.cols();
+
+  ASSERT_MSG((transposeB ? B.cols() : B.rows()) == K, "Incompatible matrix dimensions");
+  ASSERT_MSG(result.rows() == M && result.cols() == N, "Result matrix has wrong dimensions");
+
+  computeMatrixProduct(A.data(), B.data(), result.data(), M, K, N, transposeA, transposeB,
+    accumulate, pool);
+}
+
+void computeMatrixProduct(const netfloat_t* A, const netfloat_t* B, netfloat_t* C, size_t M,
+  size_t K, size_t N, bool transposeA, bool transposeB, bool accumulate, ThreadPool* pool) {
+
+  if (K == 0) {
+    if (!accumulate) {
+      std::fill(C, C + M * N, 0.f);
+    }
+    return;
+  }
+
+  const GemmOperand opA{ A, transposeA ? M : K, transposeA };
+  const GemmOperand opB{ B, transposeB ? K : N, transposeB };
+
+  const simd::GemmTile tile = simd::gemmTile();
+  const bool splitRows = M >= N;
+  const size_t unit = splitRows ? tile.rows : tile.cols;
+  const size_t numUnits = (splitRows ? M + unit - 1 : N + unit - 1) / unit;
+
+  size_t numParts = pool ? pool->numThreads() : 1;
+  numParts = std::min(numParts, std::max<size_t>(1, M * N * K / GEMM_MIN_WORK_PER_THREAD));
+  numParts = std::max<size_t>(1, std::min(numParts, numUnits));
+
+  if (numParts == 1) {
+    computeMatrixProductRange(opA, opB, C, N, K, 0, M, 0, N, accumulate);
+    return;
+  }
+
+  auto runPart = [&](size_t part) {
+    const size_t extent = splitRows ? M : N;
+    const size_t begin = std::min(extent, (numUnits * part / numParts) * unit);
+    const size_t end = std::min(extent, (numUnits * (part + 1) / numParts) * unit);
+
+    if (splitRows) {
+      computeMatrixProductRange(opA, opB, C, N, K, begin, end, 0, N, accumulate);
+    }
+    else {
+      computeMatrixProductRange(opA, opB, C, N, K, 0, M, begin, end, accumulate);
+    }
+  };
+
+  parallelFor(*pool, 0, numParts, runPart);
+}
+
 std::ostream& operator<<(std::ostream& os, const Kernel& k) {
   os << "[" << std::endl;
 
@@ -1,8 +1,35 @@
 #include "richard/neural_net.hpp"
 #include "richard/utils.hpp"
+#include "richard/optimizer.hpp"
 #include "richard/config.hpp"
+#include "richard/exception.hpp"
 
 namespace richard {
+namespace {
+
+TrainingMode parseTrainingMode(const std::string& mode) {
+  if (mode == "synchronous") {
+    return TrainingMode::synchronous;
+  }
+  else if (mode == "hogwild") {
+    return TrainingMode::hogwild;
+  }
+
+  EXCEPTION("Unrecognised training mode '" << mode << "'");
+}
+
+}
+
+CostType parseCostType(const std::string& name) {
+  if (name == "quadratic") {
+    return CostType::quadratic;
+  }
+  else if (name == "crossEntropy") {
+    return CostType::crossEntropy;
+  }
+
+  EXCEPTION("Unrecognised cost function '" << name << "'");
+}
 
 const hashedString_t EEpochStarted::name = hashString("epochStarted");
 const hashedString_t EEpochCompleted::name = hashString("epochCompleted");
@@ -11,12 +38,21 @@ const hashedString_t ESampleProcessed::name = hashString("sampleProcessed");
 Hyperparams::Hyperparams()
   : epochs(0)
   , batchSize(1000)
-  , miniBatchSize(16) {}
+  , miniBatchSize(16)
+  , threads(1)
+  , trainingMode(TrainingMode::synchronous)
+  , seed(0) {}
 
 Hyperparams::Hyperparams(const Config& config) {
   epochs = config.getNumber<uint32_t>("epochs");
   batchSize = config.getNumber<uint32_t>("batchSize");
   miniBatchSize = config.getNumber<uint32_t>("miniBatchSize");
+  threads = config.contains("threads") ? config.getNumber<uint32_t>("threads") : 1;
+  trainingMode = config.contains("trainingMode") ?
+    parseTrainingMode(config.getString("trainingMode")) : TrainingMode::synchronous;
+  seed = config.contains("seed") ? config.getNumber<uint32_t>("seed") : 0;
+
+  ASSERT_MSG(threads > 0, "Thread count must be at least 1");
 }
 
 const Config& Hyperparams::exampleConfig() {
@@ -25,6 +61,9 @@ const Config& Hyperparams::exampleConfig() {
     c.setNumber("epochs", 10);
     c.setNumber("batchSize", 1000);
     c.setNumber("miniBatchSize", 16);
+    c.setNumber("threads", 1);
+    c.setString("trainingMode", "synchronous");
+    c.setNumber("seed", 0);
     return c;
   }();
 
@@ -36,16 +75,18 @@ const Config& NeuralNet::exampleConfig() {
     Config layer1;
     layer1.setString("type", "dense");
     layer1.setNumber("size", 300);
-    layer1.setNumber("learnRate", 0.7);
+    layer1.setNumber("learnRate", 0.001);
     layer1.setNumber("learnRateDecay", 1.0);
     layer1.setNumber("dropoutRate", 0.5);
+    layer1.setObject("optimizer", OptimizerParams::exampleConfig());
 
     Config layer2;
     layer2.setString("type", "dense");
     layer2.setNumber("size", 80);
-    layer2.setNumber("learnRate", 0.7);
+    layer2.setNumber("learnRate", 0.001);
     layer2.setNumber("learnRateDecay", 1.0);
     layer2.setNumber("dropoutRate", 0.5);
+    layer2.setObject("optimizer", OptimizerParams::exampleConfig());
 
     std::vector<Config> layersConfig{ layer1, layer2 };
 
@@ -56,8 +97,9 @@ const Config& NeuralNet::exampleConfig() {
     Config outLayer;
     outLayer.setString("type", "output");
     outLayer.setNumber("size", 10);
-    outLayer.setNumber("learnRate", 0.7);
+    outLayer.setNumber("learnRate", 0.001);
     outLayer.setNumber("learnRateDecay", 1.0);
+    outLayer.setObject("optimizer", OptimizerParams::exampleConfig());
 
     c.setObject("outputLayer", outLayer);
 
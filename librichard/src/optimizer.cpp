@@ -0,0 +1,123 @@
+#include "richard/optimizer.hpp"
+#include "richard/config.hpp"
+#include "richard/exception.hpp"
+#include <cmath>
+
+namespace richard {
+
+OptimizerType parseOptimizerType(const std::string& name) {
+  if (name == "sgd") {
+    return OptimizerType::sgd;
+  }
+  else if (name == "momentum") {
+    return OptimizerType::momentum;
+  }
+  else if (name == "nesterov") {
+    return OptimizerType::nesterov;
+  }
+  else if (name == "rmsProp") {
+    return OptimizerType::rmsProp;
+  }
+  else if (name == "adam") {
+    return OptimizerType::adam;
+  }
+
+  EXCEPTION("Unrecognised optimizer '" << name << "'");
+}
+
+const char* optimizerTypeName(OptimizerType type) {
+  switch (type) {
+    case OptimizerType::sgd: return "sgd";
+    case OptimizerType::momentum: return "momentum";
+    case OptimizerType::nesterov: return "nesterov";
+    case OptimizerType::rmsProp: return "rmsProp";
+    case OptimizerType::adam: return "adam";
+  }
+  EXCEPTION("Unrecognised optimizer");
+}
+
+OptimizerParams::OptimizerParams()
+  : type(OptimizerType::sgd)
+  , beta1(0.9)
+  , beta2(0.999)
+  , epsilon(1e-8) {}
+
+OptimizerParams::OptimizerParams(const Config& config)
+  : OptimizerParams() {
+
+  type = parseOptimizerType(config.getString("type"));
+
+  if (config.contains("beta1")) {
+    beta1 = config.getNumber<netfloat_t>("beta1");
+  }
+  if (config.contains("beta2")) {
+    beta2 = config.getNumber<netfloat_t>("beta2");
+  }
+  if (config.contains("epsilon")) {
+    epsilon = config.getNumber<netfloat_t>("epsilon");
+  }
+
+  ASSERT_MSG(beta1 >= 0.0 && beta1 < 1.0, "beta1 must be in the range [0, 1)");
+  ASSERT_MSG(beta2 >= 0.0 && beta2 < 1.0, "beta2 must be in the range [0, 1)");
+}
+
+const Config& OptimizerParams::exampleConfig() {
+  static Config config = []() {
+    Config c;
+    c.setString("type", "adam");
+    c.setNumber("beta1", 0.9);
+    c.setNumber("beta2", 0.999);
+    c.setNumber("epsilon", 1e-8);
+    return c;
+  }();
+
+  return config;
+}
+
+OptimizerState::OptimizerState()
+  : step(0) {}
+
+OptimizerState::OptimizerState(OptimizerType type, size_t size)
+  : step(0) {
+
+  if (type != OptimizerType::sgd && type != OptimizerType::rmsProp) {
+    first = DataArray(size);
+  }
+  if (type == OptimizerType::rmsProp || type == OptimizerType::adam) {
+    second = DataArray(size);
+  }
+}
+
+void OptimizerState::read(std::istream& stream) {
+  if (first.size() == 0 && second.size() == 0) {
+    return;
+  }
+
+  stream.read(reinterpret_cast<char*>(&step), sizeof(step));
+  stream.read(reinterpret_cast<char*>(first.data()), first.size() * sizeof(netfloat_t));
+  stream.read(reinterpret_cast<char*>(second.data()), second.size() * sizeof(netfloat_t));
+}
+
+void OptimizerState::write(std::ostream& stream) const {
+  if (first.size() == 0 && second.size() == 0) {
+    return;
+  }
+
+  stream.write(reinterpret_cast<const char*>(&step), sizeof(step));
+  stream.write(reinterpret_cast<const char*>(first.data()), first.size() * sizeof(netfloat_t));
+  stream.write(reinterpret_cast<const char*>(second.data()), second.size() * sizeof(netfloat_t));
+}
+
+void adamCorrection(const OptimizerParams& params, uint32_t step, netfloat_t& learnRateScale,
+  netfloat_t& epsilon) {
+
+  // lr * m_hat / (sqrt(v_hat) + eps) == lr * c * m / (sqrt(v) + eps * sqrt(1 - beta2^t)),
+  // where c = sqrt(1 - beta2^t) / (1 - beta1^t)
+  netfloat_t correction2 = static_cast<netfloat_t>(sqrt(1.0 - pow(params.beta2, step)));
+  netfloat_t correction1 = static_cast<netfloat_t>(1.0 - pow(params.beta1, step));
+
+  learnRateScale = correction2 / correction1;
+  epsilon = params.epsilon * correction2;
+}
+
+}
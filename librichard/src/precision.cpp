@@ -0,0 +1,66 @@
+#include "richard/precision.hpp"
+#include "richard/simd.hpp"
+#include "richard/exception.hpp"
+
+namespace richard {
+
+StorageType parseStorageType(const std::string& name) {
+  if (name == "fp32") {
+    return StorageType::fp32;
+  }
+  else if (name == "bf16") {
+    return StorageType::bf16;
+  }
+  else if (name == "fp16") {
+    return StorageType::fp16;
+  }
+
+  EXCEPTION("Unrecognised storage type '" << name << "'");
+}
+
+const char* storageTypeName(StorageType storageType) {
+  switch (storageType) {
+    case StorageType::fp32: return "fp32";
+    case StorageType::bf16: return "bf16";
+    case StorageType::fp16: return "fp16";
+  }
+  EXCEPTION("Unrecognised storage type");
+}
+
+PackedArray::PackedArray()
+  : m_storageType(StorageType::bf16) {}
+
+PackedArray::PackedArray(StorageType storageType, size_t size)
+  : m_storageType(storageType)
+  , m_data(size) {
+
+  ASSERT_MSG(storageType != StorageType::fp32, "PackedArray requires a 16-bit storage type");
+}
+
+void PackedArray::pack(const netfloat_t* src) {
+  if (m_storageType == StorageType::bf16) {
+    simd::floatToBf16(src, m_data.data(), m_data.size());
+  }
+  else {
+    simd::floatToHalf(src, m_data.data(), m_data.size());
+  }
+}
+
+void PackedArray::unpack(netfloat_t* dst) const {
+  if (m_storageType == StorageType::bf16) {
+    simd::bf16ToFloat(m_data.data(), dst, m_data.size());
+  }
+  else {
+    simd::halfToFloat(m_data.data(), dst, m_data.size());
+  }
+}
+
+void PackedArray::read(std::istream& stream) {
+  stream.read(reinterpret_cast<char*>(m_data.data()), m_data.size() * sizeof(uint16_t));
+}
+
+void PackedArray::write(std::ostream& stream) const {
+  stream.write(reinterpret_cast<const char*>(m_data.data()), m_data.size() * sizeof(uint16_t));
+}
+
+}
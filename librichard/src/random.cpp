@@ -0,0 +1,51 @@
+#include "richard/random.hpp"
+
+namespace richard {
+namespace {
+
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const size_t PHILOX_ROUNDS = 10;
+
+void mulHiLo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+  uint64_t product = static_cast<uint64_t>(a) * b;
+  hi = static_cast<uint32_t>(product >> 32);
+  lo = static_cast<uint32_t>(product);
+}
+
+}
+
+Philox::Philox(uint64_t key, uint64_t counter)
+  : m_key{ static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32) }
+  , m_counter(counter) {}
+
+Philox::Block Philox::next() {
+  Block counter{
+    static_cast<uint32_t>(m_counter),
+    static_cast<uint32_t>(m_counter >> 32),
+    0,
+    0
+  };
+  ++m_counter;
+
+  return generate(counter, m_key);
+}
+
+Philox::Block Philox::generate(Block counter, Key key) {
+  for (size_t round = 0; round < PHILOX_ROUNDS; ++round) {
+    uint32_t hi0, lo0, hi1, lo1;
+    mulHiLo(PHILOX_M0, counter[0], hi0, lo0);
+    mulHiLo(PHILOX_M1, counter[2], hi1, lo1);
+
+    counter = { hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0 };
+
+    key[0] += PHILOX_W0;
+    key[1] += PHILOX_W1;
+  }
+
+  return counter;
+}
+
+}
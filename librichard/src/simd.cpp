@@ -0,0 +1,1095 @@
+#include "richard/simd.hpp"
+#include "richard/exception.hpp"
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RICHARD_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET(x) __attribute__((target(x)))
+#else
+#define TARGET(x)
+#endif
+
+namespace richard {
+namespace simd {
+namespace {
+
+struct Kernels {
+  netfloat_t (*dot)(const netfloat_t*, const netfloat_t*, size_t);
+  netfloat_t (*squareSum)(const netfloat_t*, size_t);
+  netfloat_t (*sum)(const netfloat_t*, size_t);
+  void (*add)(const netfloat_t*, const netfloat_t*, netfloat_t*, size_t);
+  void (*subtract)(const netfloat_t*, const netfloat_t*, netfloat_t*, size_t);
+  void (*multiply)(const netfloat_t*, const netfloat_t*, netfloat_t*, size_t);
+  void (*axpy)(netfloat_t, const netfloat_t*, netfloat_t*, size_t);
+  void (*matrixVectorMultiply)(const netfloat_t*, const netfloat_t*, netfloat_t*, size_t, size_t);
+  void (*transposeMatrixVectorMultiply)(const netfloat_t*, const netfloat_t*, netfloat_t*, size_t,
+    size_t);
+  GemmTile gemmTile;
+  void (*gemmMicroKernel)(size_t, const netfloat_t*, const netfloat_t*, netfloat_t*, size_t, size_t,
+    size_t, bool);
+  void (*floatToBf16)(const netfloat_t*, uint16_t*, size_t);
+  void (*bf16ToFloat)(const uint16_t*, netfloat_t*, size_t);
+  void (*floatToHalf)(const netfloat_t*, uint16_t*, size_t);
+  void (*halfToFloat)(const uint16_t*, netfloat_t*, size_t);
+};
+
+// Rows of a 16-bit matrix are widened this many elements at a time into a buffer on the stack
+const size_t WIDEN_CHUNK = 256;
+
+// Writes a full tile held in a temporary buffer to the valid region of C
+void storeTile(const netfloat_t* tile, size_t tileCols, netfloat_t* C, size_t ldc, size_t rows,
+  size_t cols, bool accumulate) {
+
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      if (accumulate) {
+        C[i * ldc + j] += tile[i * tileCols + j];
+      }
+      else {
+        C[i * ldc + j] = tile[i * tileCols + j];
+      }
+    }
+  }
+}
+
+namespace scalar {
+
+netfloat_t dot(const netfloat_t* A, const netfloat_t* B, size_t n) {
+  netfloat_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += A[i] * B[i];
+    s1 += A[i + 1] * B[i + 1];
+    s2 += A[i + 2] * B[i + 2];
+    s3 += A[i + 3] * B[i + 3];
+  }
+  for (; i < n; ++i) {
+    s0 += A[i] * B[i];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+netfloat_t squareSum(const netfloat_t* A, size_t n) {
+  return dot(A, A, n);
+}
+
+netfloat_t sum(const netfloat_t* A, size_t n) {
+  netfloat_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += A[i];
+    s1 += A[i + 1];
+    s2 += A[i + 2];
+    s3 += A[i + 3];
+  }
+  for (; i < n; ++i) {
+    s0 += A[i];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+void add(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    result[i] = A[i] + B[i];
+  }
+}
+
+void subtract(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    result[i] = A[i] - B[i];
+  }
+}
+
+void multiply(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    result[i] = A[i] * B[i];
+  }
+}
+
+void axpy(netfloat_t a, const netfloat_t* X, netfloat_t* Y, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    Y[i] += a * X[i];
+  }
+}
+
+void matrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows) {
+
+  for (size_t r = 0; r < rows; ++r) {
+    result[r] = dot(M + r * cols, V, cols);
+  }
+}
+
+void transposeMatrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows) {
+
+  memset(result, 0, cols * sizeof(netfloat_t));
+  for (size_t r = 0; r < rows; ++r) {
+    axpy(V[r], M + r * cols, result, cols);
+  }
+}
+
+const size_t MR = 4;
+const size_t NR = 4;
+
+void gemmMicroKernel(size_t k, const netfloat_t* packedA, const netfloat_t* packedB, netfloat_t* C,
+  size_t ldc, size_t rows, size_t cols, bool accumulate) {
+
+  netfloat_t tile[MR * NR] = {};
+  for (size_t p = 0; p < k; ++p) {
+    for (size_t i = 0; i < MR; ++i) {
+      const netfloat_t a = packedA[p * MR + i];
+      for (size_t j = 0; j < NR; ++j) {
+        tile[i * NR + j] += a * packedB[p * NR + j];
+      }
+    }
+  }
+  storeTile(tile, NR, C, ldc, rows, cols, accumulate);
+}
+
+inline uint32_t floatBits(float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline float bitsToFloat(uint32_t bits) {
+  float x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+inline uint16_t floatToBf16(float x) {
+  uint32_t bits = floatBits(x);
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    // Keep NaNs quiet rather than letting the rounding carry turn them into infinity
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+inline float bf16ToFloat(uint16_t x) {
+  return bitsToFloat(static_cast<uint32_t>(x) << 16);
+}
+
+inline uint16_t floatToHalf(float x) {
+  const uint32_t F32_INFINITY = 255 << 23;
+  const uint32_t F16_OVERFLOW = (127 + 16) << 23;
+  const uint32_t F16_MIN_NORMAL = 113 << 23;
+  const float DENORMAL_MAGIC = bitsToFloat(((127 - 15) + (23 - 10) + 1) << 23);
+
+  uint32_t bits = floatBits(x);
+  const uint32_t sign = bits & 0x80000000;
+  bits ^= sign;
+
+  uint32_t result;
+  if (bits >= F16_OVERFLOW) {
+    result = bits > F32_INFINITY ? 0x7e00 : 0x7c00;
+  }
+  else if (bits < F16_MIN_NORMAL) {
+    // Adding the magic number lets the FPU do the denormal shift and rounding
+    result = floatBits(bitsToFloat(bits) + DENORMAL_MAGIC) - floatBits(DENORMAL_MAGIC);
+  }
+  else {
+    const uint32_t mantissaOdd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mantissaOdd;
+    result = bits >> 13;
+  }
+
+  return static_cast<uint16_t>(result | (sign >> 16));
+}
+
+inline float halfToFloat(uint16_t x) {
+  const uint32_t SHIFTED_EXP = 0x7c00 << 13;
+  const float DENORMAL_MAGIC = bitsToFloat(113 << 23);
+
+  uint32_t bits = (x & 0x7fffu) << 13;
+  const uint32_t exp = bits & SHIFTED_EXP;
+  bits += (127 - 15) << 23;
+
+  if (exp == SHIFTED_EXP) {
+    bits += (128 - 16) << 23;
+  }
+  else if (exp == 0) {
+    bits += 1 << 23;
+    bits = floatBits(bitsToFloat(bits) - DENORMAL_MAGIC);
+  }
+
+  return bitsToFloat(bits | (static_cast<uint32_t>(x & 0x8000) << 16));
+}
+
+void floatToBf16(const netfloat_t* src, uint16_t* dst, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = floatToBf16(src[i]);
+  }
+}
+
+void bf16ToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = bf16ToFloat(src[i]);
+  }
+}
+
+void floatToHalf(const netfloat_t* src, uint16_t* dst, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = floatToHalf(src[i]);
+  }
+}
+
+void halfToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = halfToFloat(src[i]);
+  }
+}
+
+}
+
+const Kernels scalarKernels{
+  scalar::dot,
+  scalar::squareSum,
+  scalar::sum,
+  scalar::add,
+  scalar::subtract,
+  scalar::multiply,
+  scalar::axpy,
+  scalar::matrixVectorMultiply,
+  scalar::transposeMatrixVectorMultiply,
+  { scalar::MR, scalar::NR },
+  scalar::gemmMicroKernel,
+  scalar::floatToBf16,
+  scalar::bf16ToFloat,
+  scalar::floatToHalf,
+  scalar::halfToFloat
+};
+
+#ifdef RICHARD_SIMD_X86
+
+static_assert(std::is_same_v<netfloat_t, float>, "SIMD kernels assume 32-bit floats");
+
+namespace avx2 {
+
+TARGET("avx2,fma")
+inline float horizontalSum(__m256 v) {
+  __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_movehdup_ps(x));
+  return _mm_cvtss_f32(x);
+}
+
+TARGET("avx2,fma")
+float dot(const float* A, const float* B, size_t n) {
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps();
+  __m256 s3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 8), _mm256_loadu_ps(B + i + 8), s1);
+    s2 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 16), _mm256_loadu_ps(B + i + 16), s2);
+    s3 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 24), _mm256_loadu_ps(B + i + 24), s3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i), s0);
+  }
+  float s = horizontalSum(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+  for (; i < n; ++i) {
+    s += A[i] * B[i];
+  }
+  return s;
+}
+
+TARGET("avx2,fma")
+float squareSum(const float* A, size_t n) {
+  return dot(A, A, n);
+}
+
+TARGET("avx2,fma")
+float sum(const float* A, size_t n) {
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps();
+  __m256 s3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm256_add_ps(_mm256_loadu_ps(A + i), s0);
+    s1 = _mm256_add_ps(_mm256_loadu_ps(A + i + 8), s1);
+    s2 = _mm256_add_ps(_mm256_loadu_ps(A + i + 16), s2);
+    s3 = _mm256_add_ps(_mm256_loadu_ps(A + i + 24), s3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm256_add_ps(_mm256_loadu_ps(A + i), s0);
+  }
+  float s = horizontalSum(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+  for (; i < n; ++i) {
+    s += A[i];
+  }
+  return s;
+}
+
+TARGET("avx2,fma")
+void add(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i)));
+  }
+  for (; i < n; ++i) {
+    result[i] = A[i] + B[i];
+  }
+}
+
+TARGET("avx2,fma")
+void subtract(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(result + i, _mm256_sub_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i)));
+  }
+  for (; i < n; ++i) {
+    result[i] = A[i] - B[i];
+  }
+}
+
+TARGET("avx2,fma")
+void multiply(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(result + i, _mm256_mul_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i)));
+  }
+  for (; i < n; ++i) {
+    result[i] = A[i] * B[i];
+  }
+}
+
+TARGET("avx2,fma")
+void axpy(float a, const float* X, float* Y, size_t n) {
+  const __m256 va = _mm256_set1_ps(a);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(Y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(X + i), _mm256_loadu_ps(Y + i)));
+  }
+  for (; i < n; ++i) {
+    Y[i] += a * X[i];
+  }
+}
+
+// Four rows at a time so each load of V is shared and the accumulators form independent chains
+TARGET("avx2,fma")
+void matrixVectorMultiply(const float* M, const float* V, float* result, size_t cols,
+  size_t rows) {
+
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    const float* M0 = M + r * cols;
+    const float* M1 = M0 + cols;
+    const float* M2 = M1 + cols;
+    const float* M3 = M2 + cols;
+
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    size_t c = 0;
+    for (; c + 8 <= cols; c += 8) {
+      const __m256 v = _mm256_loadu_ps(V + c);
+      s0 = _mm256_fmadd_ps(_mm256_loadu_ps(M0 + c), v, s0);
+      s1 = _mm256_fmadd_ps(_mm256_loadu_ps(M1 + c), v, s1);
+      s2 = _mm256_fmadd_ps(_mm256_loadu_ps(M2 + c), v, s2);
+      s3 = _mm256_fmadd_ps(_mm256_loadu_ps(M3 + c), v, s3);
+    }
+    float t0 = horizontalSum(s0);
+    float t1 = horizontalSum(s1);
+    float t2 = horizontalSum(s2);
+    float t3 = horizontalSum(s3);
+    for (; c < cols; ++c) {
+      t0 += M0[c] * V[c];
+      t1 += M1[c] * V[c];
+      t2 += M2[c] * V[c];
+      t3 += M3[c] * V[c];
+    }
+    result[r] = t0;
+    result[r + 1] = t1;
+    result[r + 2] = t2;
+    result[r + 3] = t3;
+  }
+  for (; r < rows; ++r) {
+    result[r] = dot(M + r * cols, V, cols);
+  }
+}
+
+TARGET("avx2,fma")
+void transposeMatrixVectorMultiply(const float* M, const float* V, float* result, size_t cols,
+  size_t rows) {
+
+  memset(result, 0, cols * sizeof(float));
+
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    const float* M0 = M + r * cols;
+    const float* M1 = M0 + cols;
+    const float* M2 = M1 + cols;
+    const float* M3 = M2 + cols;
+
+    const __m256 v0 = _mm256_set1_ps(V[r]);
+    const __m256 v1 = _mm256_set1_ps(V[r + 1]);
+    const __m256 v2 = _mm256_set1_ps(V[r + 2]);
+    const __m256 v3 = _mm256_set1_ps(V[r + 3]);
+    size_t c = 0;
+    for (; c + 8 <= cols; c += 8) {
+      __m256 x = _mm256_loadu_ps(result + c);
+      x = _mm256_fmadd_ps(v0, _mm256_loadu_ps(M0 + c), x);
+      x = _mm256_fmadd_ps(v1, _mm256_loadu_ps(M1 + c), x);
+      x = _mm256_fmadd_ps(v2, _mm256_loadu_ps(M2 + c), x);
+      x = _mm256_fmadd_ps(v3, _mm256_loadu_ps(M3 + c), x);
+      _mm256_storeu_ps(result + c, x);
+    }
+    for (; c < cols; ++c) {
+      result[c] += V[r] * M0[c] + V[r + 1] * M1[c] + V[r + 2] * M2[c] + V[r + 3] * M3[c];
+    }
+  }
+  for (; r < rows; ++r) {
+    axpy(V[r], M + r * cols, result, cols);
+  }
+}
+
+const size_t MR = 6;
+const size_t NR = 16;
+
+// 6x16 tile held in 12 ymm accumulators
+TARGET("avx2,fma")
+void gemmMicroKernel(size_t k, const float* packedA, const float* packedB, float* C, size_t ldc,
+  size_t rows, size_t cols, bool accumulate) {
+
+  __m256 c[MR][2];
+  for (size_t i = 0; i < MR; ++i) {
+    c[i][0] = _mm256_setzero_ps();
+    c[i][1] = _mm256_setzero_ps();
+  }
+
+  for (size_t p = 0; p < k; ++p) {
+    const __m256 b0 = _mm256_loadu_ps(packedB + p * NR);
+    const __m256 b1 = _mm256_loadu_ps(packedB + p * NR + 8);
+    for (size_t i = 0; i < MR; ++i) {
+      const __m256 a = _mm256_broadcast_ss(packedA + p * MR + i);
+      c[i][0] = _mm256_fmadd_ps(a, b0, c[i][0]);
+      c[i][1] = _mm256_fmadd_ps(a, b1, c[i][1]);
+    }
+  }
+
+  if (rows == MR && cols == NR) {
+    for (size_t i = 0; i < MR; ++i) {
+      float* row = C + i * ldc;
+      if (accumulate) {
+        c[i][0] = _mm256_add_ps(c[i][0], _mm256_loadu_ps(row));
+        c[i][1] = _mm256_add_ps(c[i][1], _mm256_loadu_ps(row + 8));
+      }
+      _mm256_storeu_ps(row, c[i][0]);
+      _mm256_storeu_ps(row + 8, c[i][1]);
+    }
+  }
+  else {
+    float tile[MR * NR];
+    for (size_t i = 0; i < MR; ++i) {
+      _mm256_storeu_ps(tile + i * NR, c[i][0]);
+      _mm256_storeu_ps(tile + i * NR + 8, c[i][1]);
+    }
+    storeTile(tile, NR, C, ldc, rows, cols, accumulate);
+  }
+}
+
+TARGET("avx2,fma")
+void floatToBf16(const netfloat_t* src, uint16_t* dst, size_t n) {
+  const __m256i roundingBias = _mm256_set1_epi32(0x7fff);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i quietBit = _mm256_set1_epi32(0x400000);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(src + i);
+    __m256i x = _mm256_castps_si256(v);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), one);
+    __m256i rounded = _mm256_add_epi32(x, _mm256_add_epi32(roundingBias, lsb));
+    __m256i isNan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+    __m256i r = _mm256_blendv_epi8(rounded, _mm256_or_si256(x, quietBit), isNan);
+    r = _mm256_srli_epi32(r, 16);
+    // packus works within 128-bit lanes, so gather the low halves of each lane
+    r = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(r));
+  }
+  scalar::floatToBf16(src + i, dst + i, n - i);
+}
+
+TARGET("avx2,fma")
+void bf16ToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m256i w = _mm256_slli_epi32(_mm256_cvtepu16_epi32(x), 16);
+    _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(w));
+  }
+  scalar::bf16ToFloat(src + i, dst + i, n - i);
+}
+
+TARGET("avx2,fma,f16c")
+void floatToHalf(const netfloat_t* src, uint16_t* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+  }
+  scalar::floatToHalf(src + i, dst + i, n - i);
+}
+
+TARGET("avx2,fma,f16c")
+void halfToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  scalar::halfToFloat(src + i, dst + i, n - i);
+}
+
+}
+
+const Kernels avx2Kernels{
+  avx2::dot,
+  avx2::squareSum,
+  avx2::sum,
+  avx2::add,
+  avx2::subtract,
+  avx2::multiply,
+  avx2::axpy,
+  avx2::matrixVectorMultiply,
+  avx2::transposeMatrixVectorMultiply,
+  { avx2::MR, avx2::NR },
+  avx2::gemmMicroKernel,
+  avx2::floatToBf16,
+  avx2::bf16ToFloat,
+  avx2::floatToHalf,
+  avx2::halfToFloat
+};
+
+bool cpuSupportsAvx512Bf16();
+
+// The AVX-512 kernels handle tails with masked loads and stores rather than scalar loops
+namespace avx512 {
+
+TARGET("avx512f")
+inline __mmask16 tailMask(size_t n) {
+  return static_cast<__mmask16>((1u << n) - 1u);
+}
+
+// The masked shuffle variants are used because the unmasked ones trip -Wuninitialized on some GCC
+// versions when compiled under a target attribute
+TARGET("avx512f")
+inline float horizontalSum(__m512 v) {
+  const __mmask16 all = 0xffff;
+  v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, all, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, all, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm512_add_ps(v, _mm512_mask_permute_ps(v, all, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm512_add_ps(v, _mm512_mask_permute_ps(v, all, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm512_cvtss_f32(v);
+}
+
+TARGET("avx512f")
+float dot(const float* A, const float* B, size_t n) {
+  __m512 s0 = _mm512_setzero_ps();
+  __m512 s1 = _mm512_setzero_ps();
+  __m512 s2 = _mm512_setzero_ps();
+  __m512 s3 = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i), s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 16), _mm512_loadu_ps(B + i + 16), s1);
+    s2 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 32), _mm512_loadu_ps(B + i + 32), s2);
+    s3 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 48), _mm512_loadu_ps(B + i + 48), s3);
+  }
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i), s0);
+  }
+  if (i < n) {
+    const __mmask16 mask = tailMask(n - i);
+    s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, A + i), _mm512_maskz_loadu_ps(mask, B + i),
+      s1);
+  }
+  return horizontalSum(_mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+}
+
+TARGET("avx512f")
+float squareSum(const float* A, size_t n) {
+  return dot(A, A, n);
+}
+
+TARGET("avx512f")
+float sum(const float* A, size_t n) {
+  __m512 s0 = _mm512_setzero_ps();
+  __m512 s1 = _mm512_setzero_ps();
+  __m512 s2 = _mm512_setzero_ps();
+  __m512 s3 = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    s0 = _mm512_add_ps(_mm512_loadu_ps(A + i), s0);
+    s1 = _mm512_add_ps(_mm512_loadu_ps(A + i + 16), s1);
+    s2 = _mm512_add_ps(_mm512_loadu_ps(A + i + 32), s2);
+    s3 = _mm512_add_ps(_mm512_loadu_ps(A + i + 48), s3);
+  }
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm512_add_ps(_mm512_loadu_ps(A + i), s0);
+  }
+  if (i < n) {
+    s1 = _mm512_add_ps(_mm512_maskz_loadu_ps(tailMask(n - i), A + i), s1);
+  }
+  return horizontalSum(_mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+}
+
+TARGET("avx512f")
+void add(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(result + i, _mm512_add_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i)));
+  }
+  if (i < n) {
+    const __mmask16 mask = tailMask(n - i);
+    _mm512_mask_storeu_ps(result + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, A + i),
+      _mm512_maskz_loadu_ps(mask, B + i)));
+  }
+}
+
+TARGET("avx512f")
+void subtract(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(result + i, _mm512_sub_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i)));
+  }
+  if (i < n) {
+    const __mmask16 mask = tailMask(n - i);
+    _mm512_mask_storeu_ps(result + i, mask, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, A + i),
+      _mm512_maskz_loadu_ps(mask, B + i)));
+  }
+}
+
+TARGET("avx512f")
+void multiply(const float* A, const float* B, float* result, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(result + i, _mm512_mul_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i)));
+  }
+  if (i < n) {
+    const __mmask16 mask = tailMask(n - i);
+    _mm512_mask_storeu_ps(result + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, A + i),
+      _mm512_maskz_loadu_ps(mask, B + i)));
+  }
+}
+
+TARGET("avx512f")
+void axpy(float a, const float* X, float* Y, size_t n) {
+  const __m512 va = _mm512_set1_ps(a);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(Y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(X + i), _mm512_loadu_ps(Y + i)));
+  }
+  if (i < n) {
+    const __mmask16 mask = tailMask(n - i);
+    _mm512_mask_storeu_ps(Y + i, mask, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(mask, X + i),
+      _mm512_maskz_loadu_ps(mask, Y + i)));
+  }
+}
+
+TARGET("avx512f")
+void matrixVectorMultiply(const float* M, const float* V, float* result, size_t cols,
+  size_t rows) {
+
+  const size_t tail = cols % 16;
+  const size_t bulk = cols - tail;
+  const __mmask16 mask = tailMask(tail);
+
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    const float* M0 = M + r * cols;
+    const float* M1 = M0 + cols;
+    const float* M2 = M1 + cols;
+    const float* M3 = M2 + cols;
+
+    __m512 s0 = _mm512_setzero_ps();
+    __m512 s1 = _mm512_setzero_ps();
+    __m512 s2 = _mm512_setzero_ps();
+    __m512 s3 = _mm512_setzero_ps();
+    for (size_t c = 0; c < bulk; c += 16) {
+      const __m512 v = _mm512_loadu_ps(V + c);
+      s0 = _mm512_fmadd_ps(_mm512_loadu_ps(M0 + c), v, s0);
+      s1 = _mm512_fmadd_ps(_mm512_loadu_ps(M1 + c), v, s1);
+      s2 = _mm512_fmadd_ps(_mm512_loadu_ps(M2 + c), v, s2);
+      s3 = _mm512_fmadd_ps(_mm512_loadu_ps(M3 + c), v, s3);
+    }
+    if (tail != 0) {
+      const __m512 v = _mm512_maskz_loadu_ps(mask, V + bulk);
+      s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, M0 + bulk), v, s0);
+      s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, M1 + bulk), v, s1);
+      s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, M2 + bulk), v, s2);
+      s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, M3 + bulk), v, s3);
+    }
+    result[r] = horizontalSum(s0);
+    result[r + 1] = horizontalSum(s1);
+    result[r + 2] = horizontalSum(s2);
+    result[r + 3] = horizontalSum(s3);
+  }
+  for (; r < rows; ++r) {
+    result[r] = dot(M + r * cols, V, cols);
+  }
+}
+
+TARGET("avx512f")
+void transposeMatrixVectorMultiply(const float* M, const float* V, float* result, size_t cols,
+  size_t rows) {
+
+  memset(result, 0, cols * sizeof(float));
+
+  const size_t tail = cols % 16;
+  const size_t bulk = cols - tail;
+  const __mmask16 mask = tailMask(tail);
+
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    const float* M0 = M + r * cols;
+    const float* M1 = M0 + cols;
+    const float* M2 = M1 + cols;
+    const float* M3 = M2 + cols;
+
+    const __m512 v0 = _mm512_set1_ps(V[r]);
+    const __m512 v1 = _mm512_set1_ps(V[r + 1]);
+    const __m512 v2 = _mm512_set1_ps(V[r + 2]);
+    const __m512 v3 = _mm512_set1_ps(V[r + 3]);
+    for (size_t c = 0; c < bulk; c += 16) {
+      __m512 x = _mm512_loadu_ps(result + c);
+      x = _mm512_fmadd_ps(v0, _mm512_loadu_ps(M0 + c), x);
+      x = _mm512_fmadd_ps(v1, _mm512_loadu_ps(M1 + c), x);
+      x = _mm512_fmadd_ps(v2, _mm512_loadu_ps(M2 + c), x);
+      x = _mm512_fmadd_ps(v3, _mm512_loadu_ps(M3 + c), x);
+      _mm512_storeu_ps(result + c, x);
+    }
+    if (tail != 0) {
+      __m512 x = _mm512_maskz_loadu_ps(mask, result + bulk);
+      x = _mm512_fmadd_ps(v0, _mm512_maskz_loadu_ps(mask, M0 + bulk), x);
+      x = _mm512_fmadd_ps(v1, _mm512_maskz_loadu_ps(mask, M1 + bulk), x);
+      x = _mm512_fmadd_ps(v2, _mm512_maskz_loadu_ps(mask, M2 + bulk), x);
+      x = _mm512_fmadd_ps(v3, _mm512_maskz_loadu_ps(mask, M3 + bulk), x);
+      _mm512_mask_storeu_ps(result + bulk, mask, x);
+    }
+  }
+  for (; r < rows; ++r) {
+    axpy(V[r], M + r * cols, result, cols);
+  }
+}
+
+const size_t MR = 8;
+const size_t NR = 32;
+
+// 8x32 tile held in 16 zmm accumulators
+TARGET("avx512f")
+void gemmMicroKernel(size_t k, const float* packedA, const float* packedB, float* C, size_t ldc,
+  size_t rows, size_t cols, bool accumulate) {
+
+  __m512 c[MR][2];
+  for (size_t i = 0; i < MR; ++i) {
+    c[i][0] = _mm512_setzero_ps();
+    c[i][1] = _mm512_setzero_ps();
+  }
+
+  for (size_t p = 0; p < k; ++p) {
+    const __m512 b0 = _mm512_loadu_ps(packedB + p * NR);
+    const __m512 b1 = _mm512_loadu_ps(packedB + p * NR + 16);
+    for (size_t i = 0; i < MR; ++i) {
+      const __m512 a = _mm512_set1_ps(packedA[p * MR + i]);
+      c[i][0] = _mm512_fmadd_ps(a, b0, c[i][0]);
+      c[i][1] = _mm512_fmadd_ps(a, b1, c[i][1]);
+    }
+  }
+
+  if (cols == NR) {
+    for (size_t i = 0; i < rows; ++i) {
+      float* row = C + i * ldc;
+      if (accumulate) {
+        c[i][0] = _mm512_add_ps(c[i][0], _mm512_loadu_ps(row));
+        c[i][1] = _mm512_add_ps(c[i][1], _mm512_loadu_ps(row + 16));
+      }
+      _mm512_storeu_ps(row, c[i][0]);
+      _mm512_storeu_ps(row + 16, c[i][1]);
+    }
+  }
+  else {
+    const __mmask16 mask0 = cols >= 16 ? __mmask16(0xffff) : tailMask(cols);
+    const __mmask16 mask1 = cols > 16 ? tailMask(cols - 16) : __mmask16(0);
+    for (size_t i = 0; i < rows; ++i) {
+      float* row = C + i * ldc;
+      if (accumulate) {
+        c[i][0] = _mm512_add_ps(c[i][0], _mm512_maskz_loadu_ps(mask0, row));
+        c[i][1] = _mm512_add_ps(c[i][1], _mm512_maskz_loadu_ps(mask1, row + 16));
+      }
+      _mm512_mask_storeu_ps(row, mask0, c[i][0]);
+      _mm512_mask_storeu_ps(row + 16, mask1, c[i][1]);
+    }
+  }
+}
+
+// The conversions are memory bound, so apart from the dedicated bf16 instruction the AVX2 versions
+// are used. vcvtneps2bf16 always rounds to nearest even, but flushes denormals to zero.
+TARGET("avx512f,avx512bf16")
+void floatToBf16Native(const netfloat_t* src, uint16_t* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256bh r = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), reinterpret_cast<__m256i&>(r));
+  }
+  scalar::floatToBf16(src + i, dst + i, n - i);
+}
+
+void floatToBf16(const netfloat_t* src, uint16_t* dst, size_t n) {
+  static const bool native = cpuSupportsAvx512Bf16();
+
+  if (native) {
+    floatToBf16Native(src, dst, n);
+  }
+  else {
+    avx2::floatToBf16(src, dst, n);
+  }
+}
+
+}
+
+const Kernels avx512Kernels{
+  avx512::dot,
+  avx512::squareSum,
+  avx512::sum,
+  avx512::add,
+  avx512::subtract,
+  avx512::multiply,
+  avx512::axpy,
+  avx512::matrixVectorMultiply,
+  avx512::transposeMatrixVectorMultiply,
+  { avx512::MR, avx512::NR },
+  avx512::gemmMicroKernel,
+  avx512::floatToBf16,
+  avx2::bf16ToFloat,
+  avx2::floatToHalf,
+  avx2::halfToFloat
+};
+
+#ifdef _MSC_VER
+
+bool osSupportsState(unsigned long long mask) {
+  int info[4];
+  __cpuid(info, 1);
+  const bool osxsave = info[2] & (1 << 27);
+  return osxsave && (_xgetbv(0) & mask) == mask;
+}
+
+bool cpuSupportsAvx2() {
+  int info[4];
+  __cpuid(info, 1);
+  const bool fma = info[2] & (1 << 12);
+  const bool f16c = info[2] & (1 << 29);
+  __cpuidex(info, 7, 0);
+  const bool avx2 = info[1] & (1 << 5);
+  return fma && f16c && avx2 && osSupportsState(0x6);
+}
+
+bool cpuSupportsAvx512() {
+  int info[4];
+  __cpuidex(info, 7, 0);
+  const bool avx512f = info[1] & (1 << 16);
+  return avx512f && osSupportsState(0xe6);
+}
+
+bool cpuSupportsAvx512Bf16() {
+  int info[4];
+  __cpuidex(info, 7, 1);
+  const bool avx512bf16 = info[0] & (1 << 5);
+  return avx512bf16 && cpuSupportsAvx512();
+}
+
+#else
+
+bool cpuSupportsAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+    && __builtin_cpu_supports("f16c");
+}
+
+bool cpuSupportsAvx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f");
+}
+
+bool cpuSupportsAvx512Bf16() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16");
+}
+
+#endif
+#endif
+
+InstructionSet detectInstructionSet() {
+#ifdef RICHARD_SIMD_X86
+  if (cpuSupportsAvx512()) {
+    return InstructionSet::avx512;
+  }
+  if (cpuSupportsAvx2()) {
+    return InstructionSet::avx2;
+  }
+#endif
+  return InstructionSet::scalar;
+}
+
+const Kernels& kernelsFor(InstructionSet instructionSet) {
+  switch (instructionSet) {
+#ifdef RICHARD_SIMD_X86
+    case InstructionSet::avx512: return avx512Kernels;
+    case InstructionSet::avx2: return avx2Kernels;
+#endif
+    default: return scalarKernels;
+  }
+}
+
+struct Dispatch {
+  Dispatch()
+    : instructionSet(detectInstructionSet())
+    , kernels(&kernelsFor(instructionSet)) {}
+
+  InstructionSet instructionSet;
+  const Kernels* kernels;
+};
+
+Dispatch& dispatch() {
+  static Dispatch instance;
+  return instance;
+}
+
+}
+
+InstructionSet instructionSet() {
+  return dispatch().instructionSet;
+}
+
+const char* instructionSetName(InstructionSet instructionSet) {
+  switch (instructionSet) {
+    case InstructionSet::scalar: return "scalar";
+    case InstructionSet::avx2: return "avx2";
+    case InstructionSet::avx512: return "avx512";
+  }
+  EXCEPTION("Unrecognised instruction set");
+}
+
+bool isSupported(InstructionSet instructionSet) {
+  static const InstructionSet best = detectInstructionSet();
+  return static_cast<int>(instructionSet) <= static_cast<int>(best);
+}
+
+netfloat_t dot(const netfloat_t* A, const netfloat_t* B, size_t n) {
+  return dispatch().kernels->dot(A, B, n);
+}
+
+netfloat_t squareSum(const netfloat_t* A, size_t n) {
+  return dispatch().kernels->squareSum(A, n);
+}
+
+netfloat_t sum(const netfloat_t* A, size_t n) {
+  return dispatch().kernels->sum(A, n);
+}
+
+void add(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  dispatch().kernels->add(A, B, result, n);
+}
+
+void subtract(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  dispatch().kernels->subtract(A, B, result, n);
+}
+
+void multiply(const netfloat_t* A, const netfloat_t* B, netfloat_t* result, size_t n) {
+  dispatch().kernels->multiply(A, B, result, n);
+}
+
+void axpy(netfloat_t a, const netfloat_t* X, netfloat_t* Y, size_t n) {
+  dispatch().kernels->axpy(a, X, Y, n);
+}
+
+void matrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows) {
+
+  dispatch().kernels->matrixVectorMultiply(M, V, result, cols, rows);
+}
+
+void transposeMatrixVectorMultiply(const netfloat_t* M, const netfloat_t* V, netfloat_t* result,
+  size_t cols, size_t rows) {
+
+  dispatch().kernels->transposeMatrixVectorMultiply(M, V, result, cols, rows);
+}
+
+void floatToBf16(const netfloat_t* src, uint16_t* dst, size_t n) {
+  dispatch().kernels->floatToBf16(src, dst, n);
+}
+
+void bf16ToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  dispatch().kernels->bf16ToFloat(src, dst, n);
+}
+
+void floatToHalf(const netfloat_t* src, uint16_t* dst, size_t n) {
+  dispatch().kernels->floatToHalf(src, dst, n);
+}
+
+void halfToFloat(const uint16_t* src, netfloat_t* dst, size_t n) {
+  dispatch().kernels->halfToFloat(src, dst, n);
+}
+
+void matrixVectorMultiply(const uint16_t* M, StorageType storageType, const netfloat_t* V,
+  netfloat_t* result, size_t cols, size_t rows) {
+
+  DBG_ASSERT(storageType != StorageType::fp32);
+
+  const Kernels& kernels = *dispatch().kernels;
+  auto widen = storageType == StorageType::bf16 ? kernels.bf16ToFloat : kernels.halfToFloat;
+
+  alignas(64) netfloat_t buffer[WIDEN_CHUNK];
+
+  for (size_t r = 0; r < rows; ++r) {
+    const uint16_t* row = M + r * cols;
+    netfloat_t sum = 0;
+
+    for (size_t j = 0; j < cols; j += WIDEN_CHUNK) {
+      size_t n = std::min(WIDEN_CHUNK, cols - j);
+      widen(row + j, buffer, n);
+      sum += kernels.dot(buffer, V + j, n);
+    }
+
+    result[r] = sum;
+  }
+}
+
+GemmTile gemmTile() {
+  return dispatch().kernels->gemmTile;
+}
+
+void gemmMicroKernel(size_t k, const netfloat_t* packedA, const netfloat_t* packedB, netfloat_t* C,
+  size_t ldc, size_t rows, size_t cols, bool accumulate) {
+
+  dispatch().kernels->gemmMicroKernel(k, packedA, packedB, C, ldc, rows, cols, accumulate);
+}
+
+void test_setInstructionSet(InstructionSet instructionSet) {
+  ASSERT_MSG(isSupported(instructionSet),
+    "Instruction set " << instructionSetName(instructionSet) << " not supported on this CPU");
+
+  dispatch().instructionSet = instructionSet;
+  dispatch().kernels = &kernelsFor(instructionSet);
+}
+
+}
+}
@@ -0,0 +1,297 @@
+#include "richard/thread_pool.hpp"
+#include "richard/exception.hpp"
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+namespace richard {
+namespace {
+
+// parallelFor splits a range into at most this many chunks per thread, so threads that finish
+// early can steal the remainder
+const size_t CHUNKS_PER_THREAD = 4;
+
+struct TaskEntry {
+  ThreadPool::Task task;
+  std::atomic<size_t>* pending;
+};
+
+struct TaskQueue {
+  std::mutex mutex;
+  std::deque<TaskEntry> tasks;
+};
+
+struct Worker {
+  std::thread thread;
+  std::atomic<uint64_t> tasksRun = 0;
+  std::atomic<uint64_t> tasksStolen = 0;
+  std::atomic<uint64_t> busyNanoseconds = 0;
+  std::atomic<uint64_t> idleNanoseconds = 0;
+};
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+class ThreadPoolImpl : public ThreadPool {
+  public:
+    explicit ThreadPoolImpl(size_t numThreads);
+
+    size_t numThreads() const override;
+    void submit(Task task, std::atomic<size_t>& pending) override;
+    void wait(const std::atomic<size_t>& pending) override;
+    std::vector<WorkerStats> workerStats() const override;
+
+    ~ThreadPoolImpl() override;
+
+  private:
+    void workerLoop(size_t index);
+    // Index of the calling thread's queue
+    size_t queueIndex() const;
+    bool takeTask(size_t index, TaskEntry& entry, bool& stolen);
+    void runTask(TaskEntry& entry);
+
+    // One queue per background worker, plus a final one for threads outside the pool
+    std::vector<TaskQueue> m_queues;
+    std::vector<Worker> m_workers;
+    std::atomic<size_t> m_queued;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    bool m_stop;
+};
+
+thread_local const ThreadPoolImpl* t_pool = nullptr;
+thread_local size_t t_queueIndex = 0;
+
+ThreadPoolImpl::ThreadPoolImpl(size_t numThreads)
+  : m_queues(numThreads)
+  , m_workers(numThreads - 1)
+  , m_queued(0)
+  , m_stop(false) {
+
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    m_workers[i].thread = std::thread([this, i]() { workerLoop(i); });
+  }
+}
+
+size_t ThreadPoolImpl::numThreads() const {
+  return m_workers.size() + 1;
+}
+
+size_t ThreadPoolImpl::queueIndex() const {
+  return t_pool == this ? t_queueIndex : m_workers.size();
+}
+
+void ThreadPoolImpl::submit(Task task, std::atomic<size_t>& pending) {
+  ++pending;
+
+  TaskQueue& queue = m_queues[queueIndex()];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back({ std::move(task), &pending });
+  }
+
+  ++m_queued;
+  {
+    // Taking the lock means a worker can't miss the notification between checking for tasks and
+    // going to sleep
+    std::lock_guard lock(m_sleepMutex);
+  }
+  m_wakeUp.notify_one();
+}
+
+// Own queue first, newest task first, then the oldest task from each of the others in turn
+bool ThreadPoolImpl::takeTask(size_t index, TaskEntry& entry, bool& stolen) {
+  if (m_queued == 0) {
+    return false;
+  }
+
+  {
+    TaskQueue& queue = m_queues[index];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      entry = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      --m_queued;
+      stolen = false;
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < m_queues.size(); ++i) {
+    TaskQueue& queue = m_queues[(index + i) % m_queues.size()];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      entry = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --m_queued;
+      stolen = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPoolImpl::runTask(TaskEntry& entry) {
+  entry.task();
+
+  if (--(*entry.pending) == 0) {
+    // Wake any thread waiting on this group
+    {
+      std::lock_guard lock(m_sleepMutex);
+    }
+    m_wakeUp.notify_all();
+  }
+}
+
+void ThreadPoolImpl::workerLoop(size_t index) {
+  t_pool = this;
+  t_queueIndex = index;
+
+  Worker& worker = m_workers[index];
+
+  while (true) {
+    auto start = std::chrono::steady_clock::now();
+
+    TaskEntry entry;
+    bool stolen = false;
+    if (takeTask(index, entry, stolen)) {
+      runTask(entry);
+
+      worker.busyNanoseconds += nanosecondsSince(start);
+      ++worker.tasksRun;
+      if (stolen) {
+        ++worker.tasksStolen;
+      }
+      continue;
+    }
+
+    std::unique_lock lock(m_sleepMutex);
+    m_wakeUp.wait(lock, [this]() { return m_stop || m_queued > 0; });
+    worker.idleNanoseconds += nanosecondsSince(start);
+
+    if (m_stop) {
+      break;
+    }
+  }
+}
+
+void ThreadPoolImpl::wait(const std::atomic<size_t>& pending) {
+  const size_t index = queueIndex();
+
+  while (pending > 0) {
+    TaskEntry entry;
+    bool stolen = false;
+    if (takeTask(index, entry, stolen)) {
+      runTask(entry);
+      continue;
+    }
+
+    // Nothing to help with, so sleep until a task is queued or the last of ours finishes
+    std::unique_lock lock(m_sleepMutex);
+    m_wakeUp.wait(lock, [&]() { return pending == 0 || m_queued > 0; });
+  }
+}
+
+std::vector<WorkerStats> ThreadPoolImpl::workerStats() const {
+  std::vector<WorkerStats> stats;
+  for (const Worker& worker : m_workers) {
+    stats.push_back(WorkerStats{
+      worker.tasksRun,
+      worker.tasksStolen,
+      worker.busyNanoseconds,
+      worker.idleNanoseconds
+    });
+  }
+
+  return stats;
+}
+
+ThreadPoolImpl::~ThreadPoolImpl() {
+  {
+    std::lock_guard lock(m_sleepMutex);
+    m_stop = true;
+  }
+  m_wakeUp.notify_all();
+
+  for (Worker& worker : m_workers) {
+    worker.thread.join();
+  }
+}
+
+}
+
+ThreadPoolPtr createThreadPool(size_t numThreads) {
+  ASSERT_MSG(numThreads > 0, "Thread pool needs at least 1 thread");
+  return std::make_unique<ThreadPoolImpl>(numThreads);
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+  : m_pool(pool)
+  , m_pending(0) {}
+
+void TaskGroup::run(ThreadPool::Task task) {
+  m_pool.submit([this, task = std::move(task)]() {
+    try {
+      task();
+    }
+    catch (...) {
+      std::lock_guard lock(m_mutex);
+      if (!m_exception) {
+        m_exception = std::current_exception();
+      }
+    }
+  }, m_pending);
+}
+
+void TaskGroup::wait() {
+  m_pool.wait(m_pending);
+
+  if (m_exception) {
+    std::exception_ptr exception = m_exception;
+    m_exception = nullptr;
+    std::rethrow_exception(exception);
+  }
+}
+
+TaskGroup::~TaskGroup() {
+  m_pool.wait(m_pending);
+}
+
+void parallelFor(ThreadPool& pool, size_t begin, size_t end,
+  const std::function<void(size_t)>& fn, size_t grainSize) {
+
+  if (end <= begin) {
+    return;
+  }
+
+  const size_t n = end - begin;
+  const size_t numChunks = std::min((n + grainSize - 1) / std::max<size_t>(grainSize, 1),
+    pool.numThreads() * CHUNKS_PER_THREAD);
+
+  auto runChunk = [&](size_t chunk) {
+    for (size_t i = begin + n * chunk / numChunks; i < begin + n * (chunk + 1) / numChunks; ++i) {
+      fn(i);
+    }
+  };
+
+  if (pool.numThreads() == 1 || numChunks <= 1) {
+    for (size_t i = begin; i < end; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  TaskGroup group(pool);
+  for (size_t chunk = 1; chunk < numChunks; ++chunk) {
+    group.run([&runChunk, chunk]() { runChunk(chunk); });
+  }
+  runChunk(0);
+  group.wait();
+}
+
+}
@@ -0,0 +1,361 @@
+#include "richard/winograd.hpp"
+#include "richard/exception.hpp"
+
+namespace richard {
+namespace {
+
+const size_t TILE_W = 4;
+const size_t TILE_SIZE = TILE_W * TILE_W;
+const size_t OUTPUT_W = 2;
+const size_t KERNEL_W = 3;
+
+using Transform1d = void (*)(const netfloat_t*, netfloat_t*);
+
+// G
+void kernelTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0];
+  y[1] = 0.5f * (x[0] + x[1] + x[2]);
+  y[2] = 0.5f * (x[0] - x[1] + x[2]);
+  y[3] = x[2];
+}
+
+// G transpose
+void kernelGradientTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0] + 0.5f * (x[1] + x[2]);
+  y[1] = 0.5f * (x[1] - x[2]);
+  y[2] = 0.5f * (x[1] + x[2]) + x[3];
+}
+
+// B transpose
+void inputTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0] - x[2];
+  y[1] = x[1] + x[2];
+  y[2] = x[2] - x[1];
+  y[3] = x[1] - x[3];
+}
+
+// B
+void inputGradientTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0];
+  y[1] = x[1] - x[2] + x[3];
+  y[2] = x[1] + x[2] - x[0];
+  y[3] = -x[3];
+}
+
+// A transpose
+void outputTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0] + x[1] + x[2];
+  y[1] = x[1] - x[2] - x[3];
+}
+
+// A
+void outputGradientTransform(const netfloat_t* x, netfloat_t* y) {
+  y[0] = x[0];
+  y[1] = x[0] + x[1];
+  y[2] = x[0] - x[1];
+  y[3] = -x[1];
+}
+
+// Computes T X T^t, where X is N x N and T maps N values to M values
+template<size_t N, size_t M, Transform1d T>
+void transform2d(const netfloat_t* X, netfloat_t* result) {
+  netfloat_t tmp[M * N];
+  netfloat_t column[N];
+  netfloat_t transformed[M];
+
+  for (size_t c = 0; c < N; ++c) {
+    for (size_t r = 0; r < N; ++r) {
+      column[r] = X[r * N + c];
+    }
+    T(column, transformed);
+    for (size_t r = 0; r < M; ++r) {
+      tmp[r * N + c] = transformed[r];
+    }
+  }
+
+  for (size_t r = 0; r < M; ++r) {
+    T(tmp + r * N, result + r * M);
+  }
+}
+
+struct TileGrid {
+  TileGrid(size_t outputW, size_t outputH)
+    : tilesX((outputW + OUTPUT_W - 1) / OUTPUT_W)
+    , tilesY((outputH + OUTPUT_W - 1) / OUTPUT_W)
+    , numTiles(tilesX * tilesY) {}
+
+  size_t tilesX;
+  size_t tilesY;
+  size_t numTiles;
+};
+
+// Writes B^t d B for every 4x4 tile d of the image, zero padded at the edges, as one D x numTiles
+// matrix per tile position
+void transformInputTiles(const netfloat_t* image, const Size3& imageShape, const TileGrid& grid,
+  netfloat_t* V) {
+
+  const size_t W = imageShape[0];
+  const size_t H = imageShape[1];
+  const size_t D = imageShape[2];
+  netfloat_t d[TILE_SIZE];
+  netfloat_t v[TILE_SIZE];
+
+  for (size_t z = 0; z < D; ++z) {
+    for (size_t ty = 0; ty < grid.tilesY; ++ty) {
+      for (size_t tx = 0; tx < grid.tilesX; ++tx) {
+        const size_t x0 = tx * OUTPUT_W;
+        const size_t y0 = ty * OUTPUT_W;
+
+        for (size_t j = 0; j < TILE_W; ++j) {
+          for (size_t i = 0; i < TILE_W; ++i) {
+            const size_t x = x0 + i;
+            const size_t y = y0 + j;
+            d[j * TILE_W + i] = x < W && y < H ? image[(z * H + y) * W + x] : 0.f;
+          }
+        }
+
+        transform2d<TILE_W, TILE_W, inputTransform>(d, v);
+
+        const size_t t = ty * grid.tilesX + tx;
+        for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+          V[(pos * D + z) * grid.numTiles + t] = v[pos];
+        }
+      }
+    }
+  }
+}
+
+// Writes A dY A^t for every 2x2 tile dY of delta, zero padded at the edges, as one F x numTiles
+// matrix per tile position
+void transformDeltaTiles(const Array3& delta, const TileGrid& grid, netfloat_t* W) {
+  const size_t F = delta.D();
+  netfloat_t dy[OUTPUT_W * OUTPUT_W];
+  netfloat_t w[TILE_SIZE];
+
+  for (size_t f = 0; f < F; ++f) {
+    for (size_t ty = 0; ty < grid.tilesY; ++ty) {
+      for (size_t tx = 0; tx < grid.tilesX; ++tx) {
+        for (size_t j = 0; j < OUTPUT_W; ++j) {
+          for (size_t i = 0; i < OUTPUT_W; ++i) {
+            const size_t x = tx * OUTPUT_W + i;
+            const size_t y = ty * OUTPUT_W + j;
+            dy[j * OUTPUT_W + i] = x < delta.W() && y < delta.H() ? delta.at(x, y, f) : 0.f;
+          }
+        }
+
+        transform2d<OUTPUT_W, TILE_W, outputGradientTransform>(dy, w);
+
+        const size_t t = ty * grid.tilesX + tx;
+        for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+          W[(pos * F + f) * grid.numTiles + t] = w[pos];
+        }
+      }
+    }
+  }
+}
+
+}
+
+WinogradFilters::WinogradFilters()
+  : m_numFilters(0)
+  , m_depth(0) {}
+
+WinogradFilters::WinogradFilters(size_t numFilters, size_t depth)
+  : m_numFilters(numFilters)
+  , m_depth(depth)
+  , m_data(TILE_SIZE * numFilters * depth) {}
+
+void WinogradFilters::setKernel(size_t index, const Kernel& kernel) {
+  ASSERT_MSG(kernel.W() == KERNEL_W && kernel.H() == KERNEL_W,
+    "Winograd filters require 3x3 kernels");
+  ASSERT(kernel.D() == m_depth);
+  DBG_ASSERT(index < m_numFilters);
+
+  netfloat_t u[TILE_SIZE];
+
+  for (size_t z = 0; z < m_depth; ++z) {
+    transform2d<KERNEL_W, TILE_W, kernelTransform>(kernel.data() + z * KERNEL_W * KERNEL_W, u);
+
+    for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+      m_data[(pos * m_numFilters + index) * m_depth + z] = u[pos];
+    }
+  }
+}
+
+size_t winogradScratchSize(size_t resultW, size_t resultH, size_t depth, size_t numFilters) {
+  const TileGrid grid(resultW, resultH);
+  return TILE_SIZE * (depth + numFilters) * grid.numTiles;
+}
+
+void computeWinogradCrossCorrelation(const Array3& image, const WinogradFilters& filters,
+  Array3& result, ThreadPool* pool, netfloat_t* scratch) {
+
+  ASSERT(image.D() == filters.depth());
+  ASSERT(image.W() >= KERNEL_W && image.H() >= KERNEL_W);
+  DBG_ASSERT(result.W() == image.W() - KERNEL_W + 1);
+  DBG_ASSERT(result.H() == image.H() - KERNEL_W + 1);
+  DBG_ASSERT(result.D() == filters.numFilters());
+
+  computeWinogradCrossCorrelation(image.data(), image.shape(), filters, result.data(), pool,
+    scratch);
+}
+
+void computeWinogradCrossCorrelation(const netfloat_t* image, const Size3& imageShape,
+  const WinogradFilters& filters, netfloat_t* result, ThreadPool* pool, netfloat_t* scratch) {
+
+  const size_t F = filters.numFilters();
+  const size_t D = filters.depth();
+  const size_t resultW = imageShape[0] - KERNEL_W + 1;
+  const size_t resultH = imageShape[1] - KERNEL_W + 1;
+
+  DBG_ASSERT(imageShape[2] == D);
+
+  const TileGrid grid(resultW, resultH);
+  const size_t T = grid.numTiles;
+
+  DataArray ownScratch;
+  if (scratch == nullptr) {
+    ownScratch = DataArray(TILE_SIZE * (D + F) * T, Uninitialised{});
+    scratch = ownScratch.data();
+  }
+
+  netfloat_t* V = scratch;
+  transformInputTiles(image, imageShape, grid, V);
+
+  netfloat_t* M = V + TILE_SIZE * D * T;
+  for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+    computeMatrixProduct(filters.data() + pos * F * D, V + pos * D * T, M + pos * F * T, F, D, T,
+      false, false, false, pool);
+  }
+
+  netfloat_t m[TILE_SIZE];
+  netfloat_t y[OUTPUT_W * OUTPUT_W];
+
+  for (size_t f = 0; f < F; ++f) {
+    for (size_t ty = 0; ty < grid.tilesY; ++ty) {
+      for (size_t tx = 0; tx < grid.tilesX; ++tx) {
+        const size_t t = ty * grid.tilesX + tx;
+        for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+          m[pos] = M[(pos * F + f) * T + t];
+        }
+
+        transform2d<TILE_W, OUTPUT_W, outputTransform>(m, y);
+
+        for (size_t j = 0; j < OUTPUT_W; ++j) {
+          for (size_t i = 0; i < OUTPUT_W; ++i) {
+            const size_t x = tx * OUTPUT_W + i;
+            const size_t yy = ty * OUTPUT_W + j;
+            if (x < resultW && yy < resultH) {
+              result[(f * resultH + yy) * resultW + x] = y[j * OUTPUT_W + i];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void computeWinogradFullConvolution(const Array3& delta, const WinogradFilters& filters,
+  Array3& result, ThreadPool* pool) {
+
+  const size_t F = filters.numFilters();
+  const size_t D = filters.depth();
+
+  ASSERT(delta.D() == F);
+  DBG_ASSERT(result.W() == delta.W() + KERNEL_W - 1);
+  DBG_ASSERT(result.H() == delta.H() + KERNEL_W - 1);
+  DBG_ASSERT(result.D() == D);
+
+  const TileGrid grid(delta.W(), delta.H());
+  const size_t T = grid.numTiles;
+
+  DataArray W(TILE_SIZE * F * T, Uninitialised{});
+  transformDeltaTiles(delta, grid, W.data());
+
+  DataArray dV(TILE_SIZE * D * T, Uninitialised{});
+  for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+    ConstMatrixPtr U = Matrix::createShallow(filters.data() + pos * F * D, D, F);
+    ConstMatrixPtr Wpos = Matrix::createShallow(W.data() + pos * F * T, T, F);
+    MatrixPtr dVpos = Matrix::createShallow(dV.data() + pos * D * T, T, D);
+
+    computeMatrixProduct(*U, *Wpos, *dVpos, true, false, false, pool);
+  }
+
+  result.zero();
+
+  netfloat_t dv[TILE_SIZE];
+  netfloat_t dd[TILE_SIZE];
+
+  // Input tiles overlap, so contributions are accumulated
+  for (size_t z = 0; z < D; ++z) {
+    for (size_t ty = 0; ty < grid.tilesY; ++ty) {
+      for (size_t tx = 0; tx < grid.tilesX; ++tx) {
+        const size_t t = ty * grid.tilesX + tx;
+        for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+          dv[pos] = dV[(pos * D + z) * T + t];
+        }
+
+        transform2d<TILE_W, TILE_W, inputGradientTransform>(dv, dd);
+
+        for (size_t j = 0; j < TILE_W; ++j) {
+          for (size_t i = 0; i < TILE_W; ++i) {
+            const size_t x = tx * OUTPUT_W + i;
+            const size_t y = ty * OUTPUT_W + j;
+            if (x < result.W() && y < result.H()) {
+              result.set(x, y, z, result.at(x, y, z) + dd[j * TILE_W + i]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void computeWinogradKernelGradients(const Array3& image, const Array3& delta,
+  std::vector<Kernel>& gradients, ThreadPool* pool) {
+
+  const size_t F = delta.D();
+  const size_t D = image.D();
+
+  DBG_ASSERT(delta.W() == image.W() - KERNEL_W + 1);
+  DBG_ASSERT(delta.H() == image.H() - KERNEL_W + 1);
+
+  const TileGrid grid(delta.W(), delta.H());
+  const size_t T = grid.numTiles;
+
+  DataArray V(TILE_SIZE * D * T, Uninitialised{});
+  transformInputTiles(image.data(), image.shape(), grid, V.data());
+
+  DataArray W(TILE_SIZE * F * T, Uninitialised{});
+  transformDeltaTiles(delta, grid, W.data());
+
+  DataArray dU(TILE_SIZE * F * D, Uninitialised{});
+  for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+    ConstMatrixPtr Wpos = Matrix::createShallow(W.data() + pos * F * T, T, F);
+    ConstMatrixPtr Vpos = Matrix::createShallow(V.data() + pos * D * T, T, D);
+    MatrixPtr dUpos = Matrix::createShallow(dU.data() + pos * F * D, D, F);
+
+    computeMatrixProduct(*Wpos, *Vpos, *dUpos, false, true, false, pool);
+  }
+
+  gradients.resize(F);
+
+  netfloat_t du[TILE_SIZE];
+
+  for (size_t f = 0; f < F; ++f) {
+    if (gradients[f].W() != KERNEL_W || gradients[f].H() != KERNEL_W || gradients[f].D() != D) {
+      gradients[f] = Kernel(KERNEL_W, KERNEL_W, D);
+    }
+
+    for (size_t z = 0; z < D; ++z) {
+      for (size_t pos = 0; pos < TILE_SIZE; ++pos) {
+        du[pos] = dU[(pos * F + f) * D + z];
+      }
+
+      transform2d<TILE_W, KERNEL_W, kernelGradientTransform>(du,
+        gradients[f].data() + z * KERNEL_W * KERNEL_W);
+    }
+  }
+}
+
+}
@@ -0,0 +1,90 @@
+#include <richard/allocator.hpp>
+#include <richard/math.hpp>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <thread>
+
+using namespace richard;
+
+class AllocatorTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(AllocatorTest, allocationsAreAligned) {
+  for (size_t bytes : { 1, 4, 63, 64, 65, 1000, 4096, 100000, 50000000 }) {
+    void* ptr = memory::allocate(bytes);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % memory::ALIGNMENT, 0) << bytes << " bytes";
+    memory::deallocate(ptr, bytes);
+  }
+}
+
+TEST_F(AllocatorTest, zeroBytesReturnsNull) {
+  ASSERT_EQ(memory::allocate(0), nullptr);
+  memory::deallocate(nullptr, 0);
+}
+
+TEST_F(AllocatorTest, sizeClasses) {
+  ASSERT_EQ(memory::test_sizeClassBytes(1), 64);
+  ASSERT_EQ(memory::test_sizeClassBytes(64), 64);
+  ASSERT_EQ(memory::test_sizeClassBytes(65), 80);
+  ASSERT_EQ(memory::test_sizeClassBytes(128), 128);
+  ASSERT_EQ(memory::test_sizeClassBytes(129), 160);
+  ASSERT_EQ(memory::test_sizeClassBytes(1000), 1024);
+  ASSERT_EQ(memory::test_sizeClassBytes(1025), 1280);
+
+  for (size_t bytes = 1; bytes < 100000; bytes += 37) {
+    size_t classBytes = memory::test_sizeClassBytes(bytes);
+    ASSERT_GE(classBytes, bytes);
+    ASSERT_LE(classBytes, bytes + bytes / 4 + 64);
+  }
+}
+
+TEST_F(AllocatorTest, freedBlocksAreReused) {
+  void* ptr = memory::allocate(1000);
+  memory::deallocate(ptr, 1000);
+
+  // Same size class
+  void* ptr2 = memory::allocate(1010);
+  ASSERT_EQ(ptr2, ptr);
+  memory::deallocate(ptr2, 1010);
+}
+
+TEST_F(AllocatorTest, blocksCanBeFreedOnAnotherThread) {
+  void* ptr = memory::allocate(256);
+
+  std::thread thread([ptr]() {
+    memory::deallocate(ptr, 256);
+  });
+  thread.join();
+
+  void* ptr2 = memory::allocate(256);
+  memory::deallocate(ptr2, 256);
+}
+
+TEST_F(AllocatorTest, dataArrayIsZeroInitialisedByDefault) {
+  {
+    DataArray A(100, Uninitialised{});
+    for (size_t i = 0; i < A.size(); ++i) {
+      A[i] = 1.f;
+    }
+  }
+
+  DataArray B(100);
+  for (size_t i = 0; i < B.size(); ++i) {
+    ASSERT_EQ(B[i], 0.f);
+  }
+}
+
+TEST_F(AllocatorTest, dataArrayCopyAssignmentReusesStorage) {
+  DataArray A(10);
+  DataArray B(10);
+  B[3] = 5.f;
+
+  const netfloat_t* ptr = A.data();
+  A = B;
+
+  ASSERT_EQ(A.data(), ptr);
+  ASSERT_EQ(A[3], 5.f);
+}
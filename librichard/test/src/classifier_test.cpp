@@ -1,11 +1,14 @@
 #include "mock_file_system.hpp"
 #include "mock_logger.hpp"
 #include "mock_platform_paths.hpp"
+#include "mock_data_loader.hpp"
+#include "mock_labelled_data_set.hpp"
 #include <richard/config.hpp>
 #include <richard/classifier.hpp>
 #include <richard/data_details.hpp>
 #include <richard/event_system.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
 
 using namespace richard;
 using testing::NiceMock;
@@ -27,3 +30,97 @@ TEST_F(ClassifierTest, exampleConfig) {
   Classifier classifier{dataDetails, config, *eventSystem, *fileSystem, *platformPaths, logger,
     true};
 }
+
+TEST_F(ClassifierTest, testResultsDontDependOnThreadCount) {
+  const std::string dataDetailsString = ""
+  "{                                      "
+  "  \"normalization\": {                 "
+  "      \"min\": 0,                      "
+  "      \"max\": 1                       "
+  "  },                                   "
+  "  \"classes\": [\"a\", \"b\", \"c\"],       "
+  "  \"shape\": [4, 4, 1]                 "
+  "}                                      ";
+
+  auto configString = [](uint32_t threads) {
+    return std::string() +
+    "{                                      "
+    "  \"network\": {                       "
+    "    \"hyperparams\": {                 "
+    "        \"epochs\": 1,                 "
+    "        \"batchSize\": 16,             "
+    "        \"miniBatchSize\": 4,          "
+    "        \"threads\": " + std::to_string(threads) + "  "
+    "    },                                 "
+    "    \"hiddenLayers\": [                "
+    "        {                              "
+    "            \"type\": \"dense\",       "
+    "            \"size\": 10,              "
+    "            \"learnRate\": 0.1,        "
+    "            \"learnRateDecay\": 1.0,   "
+    "            \"dropoutRate\": 0.0       "
+    "        }                              "
+    "    ],                                 "
+    "    \"outputLayer\": {                 "
+    "        \"size\": 3,                   "
+    "        \"learnRate\": 0.1,            "
+    "        \"learnRateDecay\": 1.0        "
+    "    }                                  "
+    "  }                                    "
+    "}                                      ";
+  };
+
+  auto eventSystem = createEventSystem();
+  NiceMock<MockPlatformPaths> platformPaths;
+  NiceMock<MockFileSystem> fileSystem;
+  NiceMock<MockLogger> logger;
+
+  DataDetails dataDetails{Config::fromJson(dataDetailsString)};
+
+  std::vector<Sample> samples;
+  for (size_t i = 0; i < 37; ++i) {
+    Array3 data(4, 4, 1);
+    data.randomize(1.0);
+    samples.push_back(Sample{dataDetails.classLabels[i % 3], data});
+  }
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader), dataDetails.classLabels);
+
+  std::stringstream stream;
+  {
+    Classifier classifier{dataDetails, Config::fromJson(configString(1)), *eventSystem,
+      fileSystem, platformPaths, logger, false};
+
+    EXPECT_CALL(dataSet, loadSamples)
+      .WillOnce(testing::Return(samples))
+      .WillOnce(testing::Return(std::vector<Sample>{}));
+
+    classifier.train(dataSet);
+    classifier.writeToStream(stream);
+  }
+  const std::string trainedNet = stream.str();
+
+  // Tests the trained network on two batches of the samples
+  auto test = [&](uint32_t threads) {
+    std::stringstream stream(trainedNet);
+    Classifier classifier{dataDetails, Config::fromJson(configString(threads)), stream,
+      *eventSystem, fileSystem, platformPaths, logger, false};
+
+    EXPECT_CALL(dataSet, loadSamples)
+      .WillOnce(testing::Return(samples))
+      .WillOnce(testing::Return(samples))
+      .WillRepeatedly(testing::Return(std::vector<Sample>{}));
+
+    return classifier.test(dataSet);
+  };
+
+  Classifier::Results serial = test(1);
+  Classifier::Results parallel = test(3);
+
+  ASSERT_EQ(serial.good + serial.bad, 74);
+  ASSERT_EQ(parallel.good, serial.good);
+  ASSERT_EQ(parallel.bad, serial.bad);
+  ASSERT_EQ(parallel.guesses, serial.guesses);
+  ASSERT_NEAR(parallel.cost, serial.cost, 0.0001);
+}
@@ -0,0 +1,68 @@
+#include <richard/cpu/activation.hpp>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace richard;
+using namespace richard::cpu;
+
+class CpuActivationTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(CpuActivationTest, fastExpRelativeError) {
+  for (double x = -87.0; x <= 88.0; x += 0.0137) {
+    netfloat_t xf = static_cast<netfloat_t>(x);
+    double expected = std::exp(static_cast<double>(xf));
+
+    ASSERT_NEAR(fastExp(xf) / expected, 1.0, 5e-7) << "x = " << xf;
+  }
+}
+
+TEST_F(CpuActivationTest, fastExpClampsOutOfRangeInputs) {
+  ASSERT_TRUE(std::isfinite(fastExp(1000.f)));
+  ASSERT_GT(fastExp(1000.f), 0.f);
+  ASSERT_GE(fastExp(-1000.f), 0.f);
+  ASSERT_LT(fastExp(-1000.f), 1e-37f);
+}
+
+TEST_F(CpuActivationTest, sigmoid) {
+  for (netfloat_t x : { -100.f, -10.f, -1.f, 0.f, 0.5f, 3.f, 100.f }) {
+    double expected = 1.0 / (1.0 + std::exp(-static_cast<double>(x)));
+    ASSERT_NEAR(Sigmoid{}(x), expected, 1e-6) << "x = " << x;
+    ASSERT_NEAR(SigmoidPrime{}(x), expected * (1.0 - expected), 1e-6) << "x = " << x;
+  }
+}
+
+TEST_F(CpuActivationTest, applyActivation) {
+  Vector v({ -2, -0.5, 0, 1.5 });
+
+  Vector A = v;
+  applyActivation(Activation::relu, A);
+  ASSERT_EQ(A, Vector({ 0, 0, 0, 1.5 }));
+
+  Vector APrime = v;
+  applyActivationPrime(Activation::relu, APrime);
+  ASSERT_EQ(APrime, Vector({ 0, 0, 1, 1 }));
+
+  Vector S = v;
+  applyActivation(Activation::sigmoid, S);
+  for (size_t i = 0; i < v.size(); ++i) {
+    ASSERT_NEAR(S[i], 1.0 / (1.0 + std::exp(-v[i])), 1e-6);
+  }
+}
+
+TEST_F(CpuActivationTest, biasAndSoftmaxIsStableForLargeInputs) {
+  std::vector<netfloat_t> Z{ 1000.f, 999.f, -1000.f };
+  std::vector<netfloat_t> B{ 0.f, 0.f, 1.f };
+  std::vector<netfloat_t> A(3);
+
+  biasAndSoftmax(Z.data(), B.data(), A.data(), Z.size());
+
+  double e = std::exp(-1.0);
+  ASSERT_NEAR(A[0], 1.0 / (1.0 + e), 1e-6);
+  ASSERT_NEAR(A[1], e / (1.0 + e), 1e-6);
+  ASSERT_NEAR(A[2], 0.0, 1e-6);
+  ASSERT_EQ(Z[2], -999.f);
+}
@@ -0,0 +1,259 @@
+#include <richard/config.hpp>
+#include <richard/cpu/batch_norm_layer.hpp>
+#include <richard/cpu/dense_layer.hpp>
+#include <richard/cpu/convolutional_layer.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <cmath>
+
+using namespace richard;
+using namespace richard::cpu;
+
+namespace {
+
+DataArray array(std::initializer_list<netfloat_t> values) {
+  return Vector(values).storage();
+}
+
+}
+
+class CpuBatchNormLayerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+
+    Config batchNormConfig() const {
+      Config config;
+      config.setNumber("learnRate", 0.1);
+      config.setNumber("learnRateDecay", 1.0);
+      return config;
+    }
+};
+
+TEST_F(CpuBatchNormLayerTest, trainForwardNormalisesEachFeatureOverBatch) {
+  BatchNormLayer layer(batchNormConfig(), { 2, 1, 1 });
+  layer.test_setGamma(array({ 2, 1 }));
+  layer.test_setBeta(array({ 0, 3 }));
+
+  // Two features, three samples
+  DataArray X = array({
+    1, 10,
+    2, 10,
+    3, 40
+  });
+
+  layer.trainForward(X, 3);
+  const DataArray& Y = layer.activations();
+
+  const netfloat_t invStd0 = 1.f / std::sqrt(2.f / 3.f + 1e-5f);
+  const netfloat_t invStd1 = 1.f / std::sqrt(200.f + 1e-5f);
+
+  ASSERT_NEAR(Y[0], 2.f * -1.f * invStd0, 1e-5);
+  ASSERT_NEAR(Y[2], 0.f, 1e-5);
+  ASSERT_NEAR(Y[4], 2.f * invStd0, 1e-5);
+  ASSERT_NEAR(Y[1], 3.f - 10.f * invStd1, 1e-4);
+  ASSERT_NEAR(Y[3], 3.f - 10.f * invStd1, 1e-4);
+  ASSERT_NEAR(Y[5], 3.f + 20.f * invStd1, 1e-4);
+
+  // The running averages start at mean 0 and variance 1, with momentum 0.9
+  ASSERT_NEAR(layer.test_mean()[0], 0.1f * 2.f, 1e-5);
+  ASSERT_NEAR(layer.test_mean()[1], 0.1f * 20.f, 1e-5);
+  ASSERT_NEAR(layer.test_variance()[0], 0.9f + 0.1f * 1.f, 1e-5);
+  ASSERT_NEAR(layer.test_variance()[1], 0.9f + 0.1f * 300.f, 1e-4);
+}
+
+TEST_F(CpuBatchNormLayerTest, trainForwardNormalisesFeatureMaps) {
+  BatchNormLayer layer(batchNormConfig(), { 2, 1, 2 });
+
+  // Two channels of two elements each, two samples
+  DataArray X = array({
+    1, 3, 5, 5,
+    1, 3, 7, 7
+  });
+
+  layer.trainForward(X, 2);
+  const DataArray& Y = layer.activations();
+
+  const netfloat_t invStd0 = 1.f / std::sqrt(1.f + 1e-5f);
+  const netfloat_t invStd1 = 1.f / std::sqrt(1.f + 1e-5f);
+
+  DataArray expected = array({
+    -invStd0, invStd0, -invStd1, -invStd1,
+    -invStd0, invStd0, invStd1, invStd1
+  });
+
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_NEAR(Y[i], expected[i], 1e-5);
+  }
+}
+
+TEST_F(CpuBatchNormLayerTest, updateDeltasMatchesNumericalGradient) {
+  const Size3 shape{ 3, 1, 1 };
+  const size_t batchSize = 4;
+
+  DataArray X = array({
+    0.3f, -1.2f, 2.0f,
+    0.9f, 0.4f, -0.5f,
+    -0.7f, 1.1f, 0.6f,
+    0.2f, -0.3f, 1.5f
+  });
+
+  // The loss is sum(w * Y), so dLoss/dY = w
+  DataArray w = array({
+    0.5f, -0.2f, 0.9f,
+    0.1f, 0.7f, -0.4f,
+    -0.8f, 0.3f, 0.2f,
+    0.6f, -0.5f, 0.1f
+  });
+
+  DataArray gamma = array({ 1.5f, 0.7f, -1.1f });
+  DataArray beta = array({ 0.2f, -0.4f, 0.3f });
+
+  auto loss = [&](const DataArray& inputs) {
+    BatchNormLayer layer(batchNormConfig(), shape);
+    layer.test_setGamma(gamma);
+    layer.test_setBeta(beta);
+    layer.trainForward(inputs, batchSize);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      sum += w[i] * layer.activations()[i];
+    }
+    return sum;
+  };
+
+  BatchNormLayer layer(batchNormConfig(), shape);
+  layer.test_setGamma(gamma);
+  layer.test_setBeta(beta);
+  layer.trainForward(X, batchSize);
+  layer.updateDeltas(X, w, batchSize);
+
+  const netfloat_t h = 1e-2f;
+  for (size_t i = 0; i < X.size(); ++i) {
+    DataArray Xp = X;
+    DataArray Xm = X;
+    Xp[i] += h;
+    Xm[i] -= h;
+
+    const double numerical = (loss(Xp) - loss(Xm)) / (2.0 * h);
+    ASSERT_NEAR(layer.inputDelta()[i], numerical, 2e-3);
+  }
+
+  // dLoss/dbeta is the sum of w over each feature
+  ASSERT_NEAR(layer.test_deltaBeta()[0], 0.5f + 0.1f - 0.8f + 0.6f, 1e-5);
+  ASSERT_NEAR(layer.test_deltaBeta()[1], -0.2f + 0.7f + 0.3f - 0.5f, 1e-5);
+  ASSERT_NEAR(layer.test_deltaBeta()[2], 0.9f - 0.4f + 0.2f + 0.1f, 1e-5);
+}
+
+TEST_F(CpuBatchNormLayerTest, evalForwardUsesRunningStatistics) {
+  BatchNormLayer layer(batchNormConfig(), { 2, 1, 1 });
+  layer.test_setGamma(array({ 2, 0.5 }));
+  layer.test_setBeta(array({ 1, -1 }));
+  layer.test_setStatistics(array({ 3, -2 }), array({ 4, 0.25 }));
+
+  DataArray Y = layer.evalForward(array({ 5, -1 }));
+
+  ASSERT_NEAR(Y[0], 2.f * (5.f - 3.f) / std::sqrt(4.f + 1e-5f) + 1.f, 1e-5);
+  ASSERT_NEAR(Y[1], 0.5f * (-1.f + 2.f) / std::sqrt(0.25f + 1e-5f) - 1.f, 1e-5);
+}
+
+TEST_F(CpuBatchNormLayerTest, foldsIntoDenseLayer) {
+  BatchNormLayer batchNorm(batchNormConfig(), { 3, 1, 1 });
+  batchNorm.test_setGamma(array({ 2, 0.5, -1 }));
+  batchNorm.test_setBeta(array({ 1, -1, 0.5 }));
+  batchNorm.test_setStatistics(array({ 3, -2, 0.1 }), array({ 4, 0.25, 2 }));
+
+  Config denseConfig;
+  denseConfig.setNumber("size", 2);
+  denseConfig.setNumber("learnRate", 0.1);
+  denseConfig.setNumber("learnRateDecay", 1.0);
+  denseConfig.setNumber("dropoutRate", 0.0);
+
+  DenseLayer dense(denseConfig, 3);
+  dense.test_setWeights(array({ 0.2, -0.3, 0.4, 0.1, 0.5, -0.6 }));
+  dense.test_setBiases(array({ 0.3, -0.2 }));
+
+  DataArray X = array({ 0.7, -1.5, 2.5 });
+  DataArray expected = dense.evalForward(batchNorm.evalForward(X));
+
+  DataArray scale;
+  DataArray shift;
+  batchNorm.inferenceTransform(scale, shift);
+  ASSERT_TRUE(dense.absorbInputTransform(scale, shift));
+
+  DataArray Y = dense.evalForward(X);
+
+  for (size_t i = 0; i < Y.size(); ++i) {
+    ASSERT_NEAR(Y[i], expected[i], 1e-5);
+  }
+}
+
+TEST_F(CpuBatchNormLayerTest, foldsIntoConvolutionalLayer) {
+  BatchNormLayer batchNorm(batchNormConfig(), { 3, 3, 2 });
+  batchNorm.test_setGamma(array({ 2, -0.5 }));
+  batchNorm.test_setBeta(array({ 1, 0.25 }));
+  batchNorm.test_setStatistics(array({ 0.5, -1 }), array({ 4, 0.25 }));
+
+  Config convConfig;
+  convConfig.setNumber("depth", 2);
+  convConfig.setNumberArray<size_t>("kernelSize", { 2, 2 });
+  convConfig.setNumber("learnRate", 0.1);
+  convConfig.setNumber("learnRateDecay", 1.0);
+  convConfig.setNumber("dropoutRate", 0.0);
+
+  ConvolutionalLayer conv(convConfig, { 3, 3, 2 });
+
+  DataArray X = array({
+    0.1, 0.5, -0.3,
+    0.7, -0.2, 0.4,
+    0.9, 0.0, -0.6,
+
+    -0.5, 0.3, 0.8,
+    0.2, -0.9, 0.1,
+    0.6, 0.4, -0.7
+  });
+
+  DataArray expected = conv.evalForward(batchNorm.evalForward(X));
+
+  DataArray scale;
+  DataArray shift;
+  batchNorm.inferenceTransform(scale, shift);
+  ASSERT_TRUE(conv.absorbInputTransform(scale, shift));
+
+  DataArray Y = conv.evalForward(X);
+
+  ASSERT_EQ(Y.size(), expected.size());
+  for (size_t i = 0; i < Y.size(); ++i) {
+    ASSERT_NEAR(Y[i], expected[i], 1e-5);
+  }
+}
+
+TEST_F(CpuBatchNormLayerTest, convolutionalLayerRejectsPerElementTransform) {
+  Config convConfig;
+  convConfig.setNumber("depth", 1);
+  convConfig.setNumberArray<size_t>("kernelSize", { 2, 1 });
+  convConfig.setNumber("learnRate", 0.1);
+  convConfig.setNumber("learnRateDecay", 1.0);
+  convConfig.setNumber("dropoutRate", 0.0);
+
+  ConvolutionalLayer conv(convConfig, { 3, 1, 1 });
+
+  ASSERT_FALSE(conv.absorbInputTransform(array({ 1, 2, 3 }), array({ 0, 0, 0 })));
+}
+
+TEST_F(CpuBatchNormLayerTest, writeAndReadStream) {
+  BatchNormLayer layer(batchNormConfig(), { 2, 1, 1 });
+  layer.test_setGamma(array({ 2, 0.5 }));
+  layer.test_setBeta(array({ 1, -1 }));
+  layer.test_setStatistics(array({ 3, -2 }), array({ 4, 0.25 }));
+
+  std::stringstream stream;
+  layer.writeToStream(stream);
+
+  BatchNormLayer loaded(batchNormConfig(), stream, { 2, 1, 1 });
+
+  ASSERT_EQ(loaded.test_gamma(), Vector({ 2, 0.5 }));
+  ASSERT_EQ(loaded.test_beta(), Vector({ 1, -1 }));
+  ASSERT_EQ(loaded.test_mean(), Vector({ 3, -2 }));
+  ASSERT_EQ(loaded.test_variance(), Vector({ 4, 0.25 }));
+}
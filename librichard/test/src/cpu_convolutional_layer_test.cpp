@@ -1,15 +1,147 @@
 #include "mock_cpu_layer.hpp"
 #include <richard/config.hpp>
 #include <richard/cpu/convolutional_layer.hpp>
+#include <richard/allocator.hpp>
+#include <richard/utils.hpp>
 #include <gtest/gtest.h>
 
 using namespace richard;
 using namespace richard::cpu;
 
+namespace {
+
+// Reads the input as if surrounded by padding zeros
+netfloat_t paddedAt(const Array3& image, int x, int y, size_t z) {
+  if (x < 0 || y < 0 || x >= static_cast<int>(image.W()) || y >= static_cast<int>(image.H())) {
+    return 0.f;
+  }
+  return image.at(x, y, z);
+}
+
+// A direct implementation of the strided, padded cross-correlation, without biases
+Array3 referenceConvolution(const Array3& image,
+  const std::vector<ConvolutionalLayer::Filter>& filters, size_t stride, size_t padding) {
+
+  const Kernel& K0 = filters[0].K;
+  const size_t fmW = (image.W() + 2 * padding - K0.W()) / stride + 1;
+  const size_t fmH = (image.H() + 2 * padding - K0.H()) / stride + 1;
+
+  Array3 Z(fmW, fmH, filters.size());
+
+  for (size_t d = 0; d < filters.size(); ++d) {
+    const Kernel& K = filters[d].K;
+
+    for (size_t y = 0; y < fmH; ++y) {
+      for (size_t x = 0; x < fmW; ++x) {
+        netfloat_t sum = 0.f;
+
+        for (size_t k = 0; k < K.D(); ++k) {
+          for (size_t j = 0; j < K.H(); ++j) {
+            for (size_t i = 0; i < K.W(); ++i) {
+              const int imX = static_cast<int>(x * stride + i) - static_cast<int>(padding);
+              const int imY = static_cast<int>(y * stride + j) - static_cast<int>(padding);
+              sum += paddedAt(image, imX, imY, k) * K.at(i, j, k);
+            }
+          }
+        }
+
+        Z.set(x, y, d, sum);
+      }
+    }
+  }
+
+  return Z;
+}
+
+}
+
 class CpuConvolutionalLayerTest : public testing::Test {
   public:
     virtual void SetUp() override {}
     virtual void TearDown() override {}
+
+    Config stridedConfig(size_t kW, size_t kH, size_t stride, size_t padding,
+      const std::string& engine) const {
+
+      Config config;
+      config.setNumber("depth", 2);
+      config.setNumberArray<size_t>("kernelSize", { kW, kH });
+      config.setNumber("learnRate", 1.0);
+      config.setNumber("learnRateDecay", 1.0);
+      config.setNumber("dropoutRate", 0.0);
+      config.setNumber("stride", stride);
+      config.setNumber("padding", padding);
+      config.setString("engine", engine);
+      return config;
+    }
+
+    // Checks the layer's forward and backward passes against the reference, treating the outputs
+    // as the loss sum(outputDelta * Z). The biases are large enough that every Z is positive, which
+    // keeps the ReLU out of the way.
+    void checkAgainstReference(const Config& config, const Size3& inputShape, size_t kW, size_t kH,
+      size_t stride, size_t padding) const {
+
+      ConvolutionalLayer layer(config, inputShape);
+
+      std::vector<ConvolutionalLayer::Filter> filters;
+      for (size_t i = 0; i < 2; ++i) {
+        filters.push_back({ Kernel(kW, kH, inputShape[2]), 100.f });
+        filters.back().K.randomize(1.0);
+      }
+      layer.test_setFilters(filters);
+
+      Array3 inputs(inputShape);
+      inputs.randomize(1.0);
+
+      Array3 Z = referenceConvolution(inputs, filters, stride, padding);
+      ASSERT_EQ(layer.outputSize(), Z.shape());
+
+      const size_t batchSize = 2;
+      DataArray batch(2 * inputs.size());
+      std::copy(inputs.data(), inputs.data() + inputs.size(), batch.data());
+      std::copy(inputs.data(), inputs.data() + inputs.size(), batch.data() + inputs.size());
+
+      DataArray Y = layer.evalForward(batch, batchSize);
+      ASSERT_EQ(Y.size(), 2 * Z.size());
+      for (size_t i = 0; i < Y.size(); ++i) {
+        ASSERT_NEAR(Y[i], Z.data()[i % Z.size()] + 100.f, 1e-3);
+      }
+
+      Array3 outputDelta(Z.shape());
+      outputDelta.randomize(1.0);
+
+      layer.trainForward(inputs.storage());
+      layer.updateDeltas(inputs.storage(), outputDelta.storage());
+
+      // dLoss/dX and dLoss/dK by perturbing each element, which is exact for a linear function
+      auto loss = [&](const Array3& X, const std::vector<ConvolutionalLayer::Filter>& F) {
+        Array3 Z = referenceConvolution(X, F, stride, padding);
+        double sum = 0.0;
+        for (size_t i = 0; i < Z.size(); ++i) {
+          sum += Z.data()[i] * outputDelta.data()[i];
+        }
+        return sum;
+      };
+
+      const double base = loss(inputs, filters);
+
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        Array3 X = inputs;
+        X.data()[i] += 1.f;
+        ASSERT_NEAR(layer.inputDelta()[i], loss(X, filters) - base, 1e-3);
+      }
+
+      auto deltas = layer.test_filterDeltas();
+      for (size_t f = 0; f < filters.size(); ++f) {
+        ASSERT_NEAR(deltas[f].b, outputDelta.slice(f)->sum(), 1e-3);
+
+        for (size_t i = 0; i < filters[f].K.size(); ++i) {
+          auto F = filters;
+          F[f].K.data()[i] += 1.f;
+          ASSERT_NEAR(deltas[f].K.data()[i], loss(inputs, F) - base, 1e-3);
+        }
+      }
+    }
 };
 
 TEST_F(CpuConvolutionalLayerTest, forwardPass_depth1) {
@@ -44,7 +176,7 @@ TEST_F(CpuConvolutionalLayerTest, forwardPass_depth1) {
 
   Array3 A(layer.activations(), 2, 2, 1);
 
-  ASSERT_EQ(A, expectedZ.computeTransform(relu));
+  ASSERT_EQ(A, expectedZ.computeTransform(Relu{}));
 }
 
 TEST_F(CpuConvolutionalLayerTest, forwardPass_depth2) {
@@ -89,7 +221,7 @@ TEST_F(CpuConvolutionalLayerTest, forwardPass_depth2) {
 
   Array3 A(layer.activations(), 2, 2, 2);
 
-  ASSERT_EQ(A, expectedZ.computeTransform(relu));
+  ASSERT_EQ(A, expectedZ.computeTransform(Relu{}));
 }
 
 TEST_F(CpuConvolutionalLayerTest, forwardPass_inputDepth2_depth2) {
@@ -150,7 +282,7 @@ TEST_F(CpuConvolutionalLayerTest, forwardPass_inputDepth2_depth2) {
 
   Array3 A(layer.activations(), 2, 2, 2);
 
-  ASSERT_EQ(A, expectedZ.computeTransform(relu));
+  ASSERT_EQ(A, expectedZ.computeTransform(Relu{}));
 }
 
 TEST_F(CpuConvolutionalLayerTest, updateDelta_inputDepth1_depth2) {
@@ -201,7 +333,7 @@ TEST_F(CpuConvolutionalLayerTest, updateDelta_inputDepth1_depth2) {
 
   Array3 A(layer.activations(), 2, 2, 2);
 
-  ASSERT_EQ(A, expectedZ.computeTransform(relu));
+  ASSERT_EQ(A, expectedZ.computeTransform(Relu{}));
 
   Array3 paddedPoolingLayerDelta({
     {
@@ -218,3 +350,377 @@ TEST_F(CpuConvolutionalLayerTest, updateDelta_inputDepth1_depth2) {
   // TODO
 }
 
+
+TEST_F(CpuConvolutionalLayerTest, gemmEngineMatchesDirectEngine) {
+  Config config;
+  config.setNumber("depth", 2);
+  config.setNumberArray<size_t>("kernelSize", { 3, 2 });
+  config.setNumber("learnRate", 1.0);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  ConvolutionalLayer directLayer(config, { 5, 4, 2 });
+
+  config.setString("engine", "gemm");
+  ConvolutionalLayer gemmLayer(config, { 5, 4, 2 });
+
+  ConvolutionalLayer::Filter filter0;
+  filter0.K = Kernel({
+    {
+      { 5, 3, -1 },
+      { 1, 2, 4 }
+    }, {
+      { 8, -4, 2 },
+      { 5, 3, 1 }
+    }
+  });
+  filter0.b = -7;
+
+  ConvolutionalLayer::Filter filter1;
+  filter1.K = Kernel({
+    {
+      { 2, 0, 1 },
+      { -3, 2, 6 }
+    }, {
+      { 1, 4, -2 },
+      { 7, 3, 2 }
+    }
+  });
+  filter1.b = 3;
+
+  directLayer.test_setFilters({ filter0, filter1 });
+  gemmLayer.test_setFilters({ filter0, filter1 });
+
+  Array3 inputs({
+    {
+      { 0, 1, 2, 3, 4 },
+      { 5, 6, 7, 8, 9 },
+      { 8, 7, 6, 5, 4 },
+      { 3, 2, 1, 0, 1 }
+    }, {
+      { 5, 4, 3, 2, 1 },
+      { 2, 1, 0, 1, 2 },
+      { 1, 2, 5, 8, 3 },
+      { 4, 6, 2, 9, 7 }
+    }
+  });
+
+  directLayer.trainForward(inputs.storage());
+  gemmLayer.trainForward(inputs.storage());
+
+  Array3 directA(directLayer.activations(), 3, 3, 2);
+  Array3 gemmA(gemmLayer.activations(), 3, 3, 2);
+
+  ASSERT_EQ(gemmA, directA);
+
+  Array3 directY(directLayer.evalForward(inputs.storage()), 3, 3, 2);
+  Array3 gemmY(gemmLayer.evalForward(inputs.storage()), 3, 3, 2);
+
+  ASSERT_EQ(gemmY, directY);
+}
+
+TEST_F(CpuConvolutionalLayerTest, winogradEngineMatchesDirectEngine) {
+  Config config;
+  config.setNumber("depth", 3);
+  config.setNumberArray<size_t>("kernelSize", { 3, 3 });
+  config.setNumber("learnRate", 1.0);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  // 3x3 layers use the winograd engine by default
+  ConvolutionalLayer winogradLayer(config, { 7, 6, 2 });
+
+  config.setString("engine", "direct");
+  ConvolutionalLayer directLayer(config, { 7, 6, 2 });
+
+  std::vector<ConvolutionalLayer::Filter> filters;
+  for (size_t i = 0; i < 3; ++i) {
+    filters.push_back({ Kernel(3, 3, 2), 0.1f * i });
+    filters.back().K.randomize(1.0);
+  }
+
+  directLayer.test_setFilters(filters);
+  winogradLayer.test_setFilters(filters);
+
+  Array3 inputs(7, 6, 2);
+  inputs.randomize(1.0);
+
+  directLayer.trainForward(inputs.storage());
+  winogradLayer.trainForward(inputs.storage());
+
+  const DataArray& directA = directLayer.activations();
+  const DataArray& winogradA = winogradLayer.activations();
+  ASSERT_EQ(winogradA.size(), directA.size());
+  for (size_t i = 0; i < directA.size(); ++i) {
+    ASSERT_NEAR(winogradA[i], directA[i], 1e-4);
+  }
+
+  Array3 outputDelta(5, 4, 3);
+  outputDelta.randomize(1.0);
+
+  directLayer.updateDeltas(inputs.storage(), outputDelta.storage());
+  winogradLayer.updateDeltas(inputs.storage(), outputDelta.storage());
+
+  const DataArray& directInputDelta = directLayer.inputDelta();
+  const DataArray& winogradInputDelta = winogradLayer.inputDelta();
+  for (size_t i = 0; i < directInputDelta.size(); ++i) {
+    ASSERT_NEAR(winogradInputDelta[i], directInputDelta[i], 1e-4);
+  }
+
+  auto directDeltas = directLayer.test_filterDeltas();
+  auto winogradDeltas = winogradLayer.test_filterDeltas();
+  for (size_t f = 0; f < directDeltas.size(); ++f) {
+    ASSERT_NEAR(winogradDeltas[f].b, directDeltas[f].b, 1e-4);
+    for (size_t i = 0; i < directDeltas[f].K.size(); ++i) {
+      ASSERT_NEAR(winogradDeltas[f].K.data()[i], directDeltas[f].K.data()[i], 1e-4);
+    }
+  }
+}
+
+TEST_F(CpuConvolutionalLayerTest, batchMatchesSingleSamples) {
+  const Size3 inputShape{ 6, 5, 2 };
+  const size_t inputSize = 6 * 5 * 2;
+  const size_t outputSize = 4 * 3 * 2;
+  const size_t batchSize = 3;
+
+  for (std::string engine : { "direct", "gemm", "winograd" }) {
+    Config config;
+    config.setNumber("depth", 2);
+    config.setNumberArray<size_t>("kernelSize", { 3, 3 });
+    config.setNumber("learnRate", 1.0);
+    config.setNumber("learnRateDecay", 1.0);
+    config.setNumber("dropoutRate", 0.0);
+    config.setString("engine", engine);
+
+    ConvolutionalLayer batchLayer(config, inputShape);
+    ConvolutionalLayer sampleLayer(config, inputShape);
+    sampleLayer.test_setFilters(batchLayer.test_filters());
+
+    Vector inputs(batchSize * inputSize);
+    inputs.randomize(1.0);
+    Vector outputDelta(batchSize * outputSize);
+    outputDelta.randomize(1.0);
+
+    batchLayer.trainForward(inputs.storage(), batchSize);
+    batchLayer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+    DataArray Y = batchLayer.evalForward(inputs.storage(), batchSize);
+
+    for (size_t n = 0; n < batchSize; ++n) {
+      DataArray x = Vector(*inputs.subvector(n * inputSize, inputSize)).storage();
+      DataArray deltaA = Vector(*outputDelta.subvector(n * outputSize, outputSize)).storage();
+
+      sampleLayer.trainForward(x);
+      sampleLayer.updateDeltas(x, deltaA);
+      DataArray y = sampleLayer.evalForward(x);
+
+      for (size_t i = 0; i < outputSize; ++i) {
+        ASSERT_NEAR(batchLayer.activations()[n * outputSize + i], sampleLayer.activations()[i],
+          1e-4) << engine;
+        ASSERT_NEAR(Y[n * outputSize + i], y[i], 1e-4) << engine;
+      }
+      for (size_t i = 0; i < inputSize; ++i) {
+        ASSERT_NEAR(batchLayer.inputDelta()[n * inputSize + i], sampleLayer.inputDelta()[i],
+          1e-4) << engine;
+      }
+    }
+
+    auto batchDeltas = batchLayer.test_filterDeltas();
+    auto sampleDeltas = sampleLayer.test_filterDeltas();
+
+    for (size_t f = 0; f < batchDeltas.size(); ++f) {
+      ASSERT_NEAR(batchDeltas[f].b, sampleDeltas[f].b, 1e-3) << engine;
+      for (size_t i = 0; i < batchDeltas[f].K.size(); ++i) {
+        ASSERT_NEAR(batchDeltas[f].K.data()[i], sampleDeltas[f].K.data()[i], 1e-3) << engine;
+      }
+    }
+  }
+}
+
+TEST_F(CpuConvolutionalLayerTest, threadPoolGivesIdenticalResults) {
+  const Size3 inputShape{ 7, 6, 3 };
+  const size_t inputSize = 7 * 6 * 3;
+  const size_t outputSize = 5 * 4 * 4;
+  const size_t batchSize = 2;
+
+  ThreadPoolPtr pool = createThreadPool(4);
+
+  Config config;
+  config.setNumber("depth", 4);
+  config.setNumberArray<size_t>("kernelSize", { 3, 3 });
+  config.setNumber("learnRate", 1.0);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+  config.setString("engine", "direct");
+
+  ConvolutionalLayer serialLayer(config, inputShape);
+  ConvolutionalLayer parallelLayer(config, inputShape);
+  parallelLayer.test_setFilters(serialLayer.test_filters());
+  parallelLayer.setThreadPool(pool.get());
+
+  Vector inputs(batchSize * inputSize);
+  inputs.randomize(1.0);
+  Vector outputDelta(batchSize * outputSize);
+  outputDelta.randomize(1.0);
+
+  for (ConvolutionalLayer* layer : { &serialLayer, &parallelLayer }) {
+    layer->trainForward(inputs.storage(), batchSize);
+    layer->updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+  }
+
+  ASSERT_EQ(Vector(parallelLayer.activations()), Vector(serialLayer.activations()));
+  ASSERT_EQ(Vector(parallelLayer.inputDelta()), Vector(serialLayer.inputDelta()));
+
+  auto serialDeltas = serialLayer.test_filterDeltas();
+  auto parallelDeltas = parallelLayer.test_filterDeltas();
+
+  for (size_t f = 0; f < serialDeltas.size(); ++f) {
+    ASSERT_EQ(parallelDeltas[f].b, serialDeltas[f].b);
+    ASSERT_EQ(parallelDeltas[f].K, serialDeltas[f].K);
+  }
+}
+
+TEST_F(CpuConvolutionalLayerTest, outputSizeWithStrideAndPadding) {
+  ConvolutionalLayer layer(stridedConfig(3, 2, 2, 1, "direct"), { 6, 5, 3 });
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 3, 3, 2 }));
+}
+
+TEST_F(CpuConvolutionalLayerTest, directEngineWithStrideAndPadding) {
+  checkAgainstReference(stridedConfig(3, 2, 2, 1, "direct"), { 6, 5, 2 }, 3, 2, 2, 1);
+}
+
+TEST_F(CpuConvolutionalLayerTest, gemmEngineWithStrideAndPadding) {
+  checkAgainstReference(stridedConfig(3, 2, 2, 1, "gemm"), { 6, 5, 2 }, 3, 2, 2, 1);
+}
+
+TEST_F(CpuConvolutionalLayerTest, gemmEngineWithStride3) {
+  checkAgainstReference(stridedConfig(2, 2, 3, 0, "gemm"), { 7, 6, 2 }, 2, 2, 3, 0);
+}
+
+TEST_F(CpuConvolutionalLayerTest, winogradEngineWithPadding) {
+  checkAgainstReference(stridedConfig(3, 3, 1, 1, "winograd"), { 5, 6, 2 }, 3, 3, 1, 1);
+}
+
+TEST_F(CpuConvolutionalLayerTest, channelLayoutsWithStrideAndPadding) {
+  // A depth of 10 leaves the second block of 8 partly filled with padding channels
+  for (const char* layout : { "nhwc", "nchw8c", "nchw16c" }) {
+    for (size_t inputDepth : { 3, 10 }) {
+      Config config = stridedConfig(3, 2, 2, 1, "direct");
+      config.setString("layout", layout);
+
+      checkAgainstReference(config, { 6, 5, inputDepth }, 3, 2, 2, 1);
+    }
+  }
+}
+
+TEST_F(CpuConvolutionalLayerTest, channelLayoutSelectsDirectEngine) {
+  Config config = stridedConfig(3, 3, 1, 0, "direct");
+  config.setString("layout", "nhwc");
+  checkAgainstReference(config, { 5, 5, 4 }, 3, 3, 1, 0);
+
+  config.setString("engine", "winograd");
+  ASSERT_ANY_THROW(ConvolutionalLayer(config, { 5, 5, 4 }));
+}
+
+TEST_F(CpuConvolutionalLayerTest, channelLayoutEvalIntoReordersIntoScratch) {
+  const Size3 inputShape{ 6, 5, 10 };
+
+  ASSERT_EQ(ConvolutionalLayer(stridedConfig(3, 2, 2, 0, "direct"), inputShape).evalScratchSize(),
+    0);
+
+  Config config = stridedConfig(3, 2, 2, 1, "direct");
+
+  for (const char* layout : { "nhwc", "nchw8c", "nchw16c" }) {
+    config.setString("layout", layout);
+    ConvolutionalLayer layer(config, inputShape);
+
+    Array3 inputs(inputShape);
+    inputs.randomize(1.0);
+
+    DataArray expected = layer.evalForward(inputs.storage());
+
+    // Left over from some other layer, including where the blocked layouts' padding channels go
+    DataArray scratch(layer.evalScratchSize(), Uninitialised{});
+    ASSERT_GT(scratch.size(), 0);
+    std::fill(scratch.data(), scratch.data() + scratch.size(), 7.f);
+
+    DataArray Y(expected.size());
+    layer.evalInto(inputs.data(), Y.data(), 1, scratch.data());
+
+    ASSERT_EQ(Vector(Y), Vector(expected));
+  }
+}
+
+TEST_F(CpuConvolutionalLayerTest, evalIntoWithScratchDoesNotAllocate) {
+  const Size3 inputShape{ 6, 5, 3 };
+
+  for (std::string engine : { "direct", "gemm", "winograd" }) {
+    for (size_t batchSize : { 1, 2 }) {
+      ConvolutionalLayer layer(stridedConfig(3, 3, 1, 1, engine), inputShape);
+
+      Vector inputs(batchSize * calcProduct(inputShape));
+      inputs.randomize(1.0);
+
+      DataArray expected = layer.evalForward(inputs.storage(), batchSize);
+
+      // Left over from some other layer, including where the padding zeros go
+      DataArray scratch(layer.evalScratchSize(batchSize), Uninitialised{});
+      ASSERT_GT(scratch.size(), 0);
+      std::fill(scratch.data(), scratch.data() + scratch.size(), 7.f);
+
+      DataArray Y(expected.size(), Uninitialised{});
+
+      size_t allocations = memory::test_allocationCount();
+      layer.evalInto(inputs.data(), Y.data(), batchSize, scratch.data());
+      ASSERT_EQ(memory::test_allocationCount(), allocations) << engine;
+
+      ASSERT_EQ(Vector(Y), Vector(expected)) << engine;
+    }
+  }
+}
+
+// Every engine runs the same batched backward pass on its filter matrix, which must follow the
+// parameter updates even when the forward pass doesn't use it
+TEST_F(CpuConvolutionalLayerTest, backwardPassFollowsParameterUpdates) {
+  const Size3 inputShape{ 6, 5, 3 };
+  const size_t batchSize = 3;
+
+  for (std::string engine : { "direct", "winograd" }) {
+    Config config = stridedConfig(3, 3, 1, 1, engine);
+    ConvolutionalLayer layer(config, inputShape);
+
+    std::vector<ConvolutionalLayer::Filter> filters;
+    for (size_t i = 0; i < 2; ++i) {
+      filters.push_back({ Kernel(3, 3, 3), 0.1f * i });
+      filters.back().K.randomize(1.0);
+    }
+    layer.test_setFilters(filters);
+
+    Vector inputs(batchSize * calcProduct(inputShape));
+    inputs.randomize(1.0);
+
+    Vector outputDelta(batchSize * calcProduct(layer.outputSize()));
+    outputDelta.randomize(1.0);
+
+    layer.trainForward(inputs.storage(), batchSize);
+    layer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+    layer.updateParams(0);
+
+    config.setString("engine", "gemm");
+    ConvolutionalLayer gemmLayer(config, inputShape);
+    gemmLayer.test_setFilters(layer.test_filters());
+
+    layer.trainForward(inputs.storage(), batchSize);
+    gemmLayer.trainForward(inputs.storage(), batchSize);
+
+    layer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+    gemmLayer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+
+    const DataArray& inputDelta = layer.inputDelta();
+    const DataArray& gemmInputDelta = gemmLayer.inputDelta();
+    ASSERT_EQ(inputDelta.size(), gemmInputDelta.size());
+    for (size_t i = 0; i < inputDelta.size(); ++i) {
+      ASSERT_NEAR(inputDelta[i], gemmInputDelta[i], 1e-4) << engine;
+    }
+  }
+}
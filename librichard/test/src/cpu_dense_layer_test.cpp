@@ -1,7 +1,9 @@
 #include "mock_cpu_layer.hpp"
 #include <richard/config.hpp>
 #include <richard/cpu/dense_layer.hpp>
+#include <richard/thread_pool.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
 
 using namespace richard;
 using namespace richard::cpu;
@@ -19,30 +21,22 @@ TEST_F(CpuDenseLayerTest, evalForward) {
   config.setNumber("learnRateDecay", 1.0);
   config.setNumber("dropoutRate", 0.0);
 
-  ActivationFn activationFn = [](netfloat_t x) {
-    return x * 2.f;
-  };
-
-  ActivationFn activationFnPrime = [](netfloat_t) {
-    return 2.f;
-  };
-
   Matrix W({
     { 2, 1, 3 },
     { 1, 4, 2 }
   });
 
-  Vector B({ 5, 7 });
+  Vector B({ 5, -30 });
 
   DenseLayer layer(config, 3);
   layer.test_setWeights(W.storage());
   layer.test_setBiases(B.storage());
-  layer.test_setActivationFn(activationFn, activationFnPrime);
+  layer.test_setActivation(Activation::relu);
 
   Vector X({ 3, 4, 2 });
   Vector Y(layer.evalForward(X.storage()));
 
-  ASSERT_EQ(Y, Vector({ (3*2+4*1+2*3+5)*2, (3*1+4*4+2*2+7)*2 }));
+  ASSERT_EQ(Y, Vector({ 3*2+4*1+2*3+5, 0 }));
 }
 
 TEST_F(CpuDenseLayerTest, trainForward) {
@@ -52,25 +46,17 @@ TEST_F(CpuDenseLayerTest, trainForward) {
   config.setNumber("learnRateDecay", 1.0);
   config.setNumber("dropoutRate", 0.0);
 
-  ActivationFn activationFn = [](netfloat_t x) {
-    return x * 2.f;
-  };
-
-  ActivationFn activationFnPrime = [](netfloat_t) {
-    return 2.f;
-  };
-
   Matrix W({
     { 2, 1, 3 },
     { 1, 4, 2 }
   });
 
-  Vector B({ 5, 7 });
+  Vector B({ 5, -30 });
 
   DenseLayer layer(config, 3);
   layer.test_setWeights(W.storage());
   layer.test_setBiases(B.storage());
-  layer.test_setActivationFn(activationFn, activationFnPrime);
+  layer.test_setActivation(Activation::relu);
 
   Vector X({ 3, 4, 2 });
   
@@ -79,8 +65,7 @@ TEST_F(CpuDenseLayerTest, trainForward) {
   ConstVectorPtr pA = Vector::createShallow(layer.activations());
   const Vector& A = *pA;
 
-  Vector expectedZ({ 3*2+4*1+2*3+5, 3*1+4*4+2*2+7 });
-  Vector expectedA = expectedZ * 2.0;
+  Vector expectedA({ 3*2+4*1+2*3+5, 0 });
 
   ASSERT_EQ(A, expectedA);
 }
@@ -92,25 +77,17 @@ TEST_F(CpuDenseLayerTest, updateDelta) {
   config.setNumber("learnRateDecay", 1.0);
   config.setNumber("dropoutRate", 0.0);
 
-  ActivationFn activationFn = [](netfloat_t x) {
-    return 0.f * x * x;
-  };
-
-  ActivationFn activationFnPrime = [](netfloat_t x) {
-    return x;
-  };
-
   Matrix W({
     { 2, 1, 3 },
     { 1, 4, 2 }
   });
 
-  Vector B({ 5, 7 });
+  Vector B({ 5, -30 });
 
   DenseLayer layer(config, 3);
   layer.test_setWeights(W.storage());
   layer.test_setBiases(B.storage());
-  layer.test_setActivationFn(activationFn, activationFnPrime);
+  layer.test_setActivation(Activation::relu);
 
   Vector X({ 3, 4, 2 });
 
@@ -118,8 +95,8 @@ TEST_F(CpuDenseLayerTest, updateDelta) {
 
   Vector dA({ 2, 3 });
 
-  Vector expectedZ({ 3*2+4*1+2*3+5, 3*1+4*4+2*2+7 });
-  Vector expectedDelta = dA.hadamard(expectedZ.computeTransform(activationFnPrime));
+  Vector expectedZ({ 3*2+4*1+2*3+5, 3*1+4*4+2*2-30 });
+  Vector expectedDelta = dA.hadamard(expectedZ.computeTransform(ReluPrime{}));
   Vector expectedDeltaInputs = W.transposeMultiply(expectedDelta);
 
   layer.updateDeltas(X.storage(), dA.storage());
@@ -128,3 +105,234 @@ TEST_F(CpuDenseLayerTest, updateDelta) {
 
   ASSERT_EQ(*dInputs, expectedDeltaInputs);
 }
+
+TEST_F(CpuDenseLayerTest, evalForwardReducedPrecision) {
+  Config config;
+  config.setNumber("size", 2);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  Matrix W({
+    { 0.2f, 0.1f, 0.3f },
+    { 0.1f, 0.4f, 0.2f }
+  });
+
+  Vector B({ 0.5f, -3.f });
+  Vector X({ 3, 4, 2 });
+
+  for (std::string storageType : { "bf16", "fp16" }) {
+    config.setString("storageType", storageType);
+
+    DenseLayer layer(config, 3);
+    layer.test_setWeights(W.storage());
+    layer.test_setBiases(B.storage());
+    layer.test_setActivation(Activation::relu);
+
+    Vector Y(layer.evalForward(X.storage()));
+
+    ASSERT_NEAR(Y[0], 3*0.2f+4*0.1f+2*0.3f+0.5f, 0.01f) << storageType;
+    ASSERT_EQ(Y[1], 0.f) << storageType;
+
+    // Full precision weights are kept for training
+    ASSERT_EQ(layer.test_W(), W);
+  }
+}
+
+TEST_F(CpuDenseLayerTest, writeAndReadReducedPrecision) {
+  Config config;
+  config.setNumber("size", 2);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+  config.setString("storageType", "bf16");
+
+  Matrix W({
+    { 2, 1, 3 },
+    { 1, 4, 2 }
+  });
+
+  Vector B({ 5, -30 });
+
+  DenseLayer layer(config, 3);
+  layer.test_setWeights(W.storage());
+  layer.test_setBiases(B.storage());
+
+  std::stringstream stream;
+  layer.writeToStream(stream);
+
+  ASSERT_EQ(stream.str().size(), 2 * sizeof(netfloat_t) + 6 * sizeof(uint16_t));
+
+  DenseLayer loaded(config, stream, 3);
+
+  ASSERT_EQ(loaded.test_W(), W);
+  ASSERT_EQ(loaded.test_B(), B);
+}
+
+TEST_F(CpuDenseLayerTest, batchMatchesSingleSamples) {
+  const size_t inputSize = 7;
+  const size_t size = 5;
+  const size_t batchSize = 4;
+
+  Config config;
+  config.setNumber("size", size);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  DenseLayer batchLayer(config, inputSize);
+  DenseLayer sampleLayer(config, inputSize);
+  sampleLayer.test_setWeights(batchLayer.test_W().storage());
+
+  Vector B(size);
+  B.randomize(1.0);
+  batchLayer.test_setBiases(B.storage());
+  sampleLayer.test_setBiases(B.storage());
+
+  Vector inputs(batchSize * inputSize);
+  inputs.randomize(1.0);
+  Vector outputDelta(batchSize * size);
+  outputDelta.randomize(1.0);
+
+  batchLayer.trainForward(inputs.storage(), batchSize);
+  batchLayer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+  DataArray Y = batchLayer.evalForward(inputs.storage(), batchSize);
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    DataArray x = Vector(*inputs.subvector(n * inputSize, inputSize)).storage();
+    DataArray deltaA = Vector(*outputDelta.subvector(n * size, size)).storage();
+
+    sampleLayer.trainForward(x);
+    sampleLayer.updateDeltas(x, deltaA);
+    DataArray y = sampleLayer.evalForward(x);
+
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_NEAR(batchLayer.activations()[n * size + i], sampleLayer.activations()[i], 1e-5);
+      ASSERT_NEAR(Y[n * size + i], y[i], 1e-5);
+    }
+    for (size_t i = 0; i < inputSize; ++i) {
+      ASSERT_NEAR(batchLayer.inputDelta()[n * inputSize + i], sampleLayer.inputDelta()[i], 1e-5);
+    }
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_NEAR(batchLayer.test_deltaB()[i], sampleLayer.test_deltaB()[i], 1e-5);
+  }
+  for (size_t i = 0; i < inputSize * size; ++i) {
+    ASSERT_NEAR(batchLayer.test_deltaW().data()[i], sampleLayer.test_deltaW().data()[i], 1e-5);
+  }
+}
+
+TEST_F(CpuDenseLayerTest, threadPoolGivesIdenticalResults) {
+  // Large enough for the batched matrix products to be split across the pool
+  const size_t inputSize = 96;
+  const size_t size = 96;
+  const size_t batchSize = 64;
+
+  ThreadPoolPtr pool = createThreadPool(4);
+
+  Config config;
+  config.setNumber("size", size);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  DenseLayer serialLayer(config, inputSize);
+  DenseLayer parallelLayer(config, inputSize);
+  parallelLayer.test_setWeights(serialLayer.test_W().storage());
+  parallelLayer.setThreadPool(pool.get());
+
+  Vector inputs(batchSize * inputSize);
+  inputs.randomize(1.0);
+  Vector outputDelta(batchSize * size);
+  outputDelta.randomize(1.0);
+
+  for (DenseLayer* layer : { &serialLayer, &parallelLayer }) {
+    layer->trainForward(inputs.storage(), batchSize);
+    layer->updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+  }
+
+  ASSERT_EQ(Vector(parallelLayer.activations()), Vector(serialLayer.activations()));
+  ASSERT_EQ(Vector(parallelLayer.inputDelta()), Vector(serialLayer.inputDelta()));
+  ASSERT_EQ(parallelLayer.test_deltaW(), serialLayer.test_deltaW());
+  ASSERT_EQ(parallelLayer.test_deltaB(), serialLayer.test_deltaB());
+}
+
+TEST_F(CpuDenseLayerTest, sharedParamsAreTrainedInPlace) {
+  const size_t inputSize = 6;
+  const size_t size = 4;
+
+  Config config;
+  config.setNumber("size", size);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  DenseLayer owner(config, inputSize);
+  DenseLayer replica(config, inputSize);
+  DenseLayer reference(config, inputSize);
+  reference.test_setWeights(owner.test_W().storage());
+
+  Matrix replicaW = replica.test_W();
+  replica.shareParams(owner);
+
+  Vector inputs(inputSize);
+  inputs.randomize(1.0);
+  Vector outputDelta(size);
+  outputDelta.randomize(1.0);
+
+  replica.trainForward(inputs.storage());
+  replica.updateDeltas(inputs.storage(), outputDelta.storage());
+  replica.updateParams(0);
+
+  reference.trainForward(inputs.storage());
+  reference.updateDeltas(inputs.storage(), outputDelta.storage());
+  reference.updateParams(0);
+
+  ASSERT_EQ(owner.test_W(), reference.test_W());
+  ASSERT_EQ(owner.test_B(), reference.test_B());
+  ASSERT_EQ(replica.test_W(), replicaW);
+}
+
+TEST_F(CpuDenseLayerTest, optimizerStateIsSerialised) {
+  const size_t inputSize = 3;
+  const size_t size = 2;
+
+  Config optimizer;
+  optimizer.setString("type", "adam");
+
+  Config config;
+  config.setNumber("size", size);
+  config.setNumber("learnRate", 0.1);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+  config.setObject("optimizer", optimizer);
+
+  DenseLayer layer(config, inputSize);
+
+  Vector inputs({ 0.2f, 0.4f, 0.6f });
+  Vector outputDelta({ 0.5f, -0.5f });
+
+  layer.trainForward(inputs.storage());
+  layer.updateDeltas(inputs.storage(), outputDelta.storage());
+  layer.updateParams(0);
+
+  std::stringstream stream;
+  layer.writeToStream(stream);
+
+  // Parameters, then step count and two moments for each of B and W
+  const size_t numParams = size + inputSize * size;
+  ASSERT_EQ(stream.str().size(),
+    numParams * sizeof(netfloat_t) + 2 * sizeof(uint32_t) + 2 * numParams * sizeof(netfloat_t));
+
+  DenseLayer loaded(config, stream, inputSize);
+
+  for (DenseLayer* l : { &layer, &loaded }) {
+    l->trainForward(inputs.storage());
+    l->updateDeltas(inputs.storage(), outputDelta.storage());
+    l->updateParams(0);
+  }
+
+  ASSERT_EQ(loaded.test_W(), layer.test_W());
+  ASSERT_EQ(loaded.test_B(), layer.test_B());
+}
@@ -0,0 +1,279 @@
+#include <richard/cpu/depthwise_separable_layer.hpp>
+#include <richard/config.hpp>
+#include <richard/utils.hpp>
+#include <richard/allocator.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace richard;
+using namespace richard::cpu;
+
+namespace {
+
+// Reads the input as if surrounded by padding zeros
+netfloat_t paddedAt(const Array3& image, int x, int y, size_t z) {
+  if (x < 0 || y < 0 || x >= static_cast<int>(image.W()) || y >= static_cast<int>(image.H())) {
+    return 0.f;
+  }
+  return image.at(x, y, z);
+}
+
+// A depthwise convolution of each channel with its kernel slice, then a 1x1 convolution with
+// ReLU, computed directly from the definitions
+Array3 referenceForward(const Array3& image, const Kernel& depthwise,
+  const std::vector<ConvolutionalLayer::Filter>& pointwise, size_t stride, size_t padding) {
+
+  const size_t fmW = (image.W() + 2 * padding - depthwise.W()) / stride + 1;
+  const size_t fmH = (image.H() + 2 * padding - depthwise.H()) / stride + 1;
+
+  Array3 Z(fmW, fmH, image.D());
+  for (size_t z = 0; z < image.D(); ++z) {
+    for (size_t y = 0; y < fmH; ++y) {
+      for (size_t x = 0; x < fmW; ++x) {
+        netfloat_t sum = 0.f;
+        for (size_t j = 0; j < depthwise.H(); ++j) {
+          for (size_t i = 0; i < depthwise.W(); ++i) {
+            const int px = static_cast<int>(x * stride + i) - static_cast<int>(padding);
+            const int py = static_cast<int>(y * stride + j) - static_cast<int>(padding);
+            sum += paddedAt(image, px, py, z) * depthwise.at(i, j, z);
+          }
+        }
+        Z.set(x, y, z, sum);
+      }
+    }
+  }
+
+  Array3 A(fmW, fmH, pointwise.size());
+  for (size_t f = 0; f < pointwise.size(); ++f) {
+    for (size_t y = 0; y < fmH; ++y) {
+      for (size_t x = 0; x < fmW; ++x) {
+        netfloat_t sum = pointwise[f].b;
+        for (size_t z = 0; z < image.D(); ++z) {
+          sum += Z.at(x, y, z) * pointwise[f].K.at(0, 0, z);
+        }
+        A.set(x, y, f, std::max(sum, 0.f));
+      }
+    }
+  }
+
+  return A;
+}
+
+}
+
+class CpuDepthwiseSeparableLayerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+
+    Config layerConfig(size_t stride, size_t padding) const {
+      Config config;
+      config.setNumber("depth", 4);
+      config.setNumberArray<size_t>("kernelSize", { 3, 3 });
+      config.setNumber("learnRate", 0.1);
+      config.setNumber("learnRateDecay", 1.0);
+      config.setNumber("dropoutRate", 0.0);
+      config.setNumber("stride", stride);
+      config.setNumber("padding", padding);
+      return config;
+    }
+
+    // Biases large enough to keep every ReLU active, so the layer is linear in its inputs
+    std::vector<ConvolutionalLayer::Filter> pointwiseFilters(size_t inputDepth,
+      netfloat_t bias) const {
+
+      std::vector<ConvolutionalLayer::Filter> filters;
+      for (size_t i = 0; i < 4; ++i) {
+        filters.push_back({ Kernel(1, 1, inputDepth), bias });
+        filters.back().K.randomize(1.0);
+      }
+      return filters;
+    }
+};
+
+TEST_F(CpuDepthwiseSeparableLayerTest, evalForwardMatchesReference) {
+  const Size3 inputShape{ 6, 5, 3 };
+
+  for (size_t stride : { 1, 2 }) {
+    for (size_t padding : { 0, 1 }) {
+      DepthwiseSeparableLayer layer(layerConfig(stride, padding), inputShape);
+
+      Kernel depthwise(3, 3, 3);
+      depthwise.randomize(1.0);
+      auto pointwise = pointwiseFilters(3, 0.1f);
+
+      layer.test_setDepthwiseKernels(depthwise.storage());
+      layer.test_pointwise().test_setFilters(pointwise);
+
+      Array3 image(inputShape);
+      image.randomize(1.0);
+
+      Array3 expected = referenceForward(image, depthwise, pointwise, stride, padding);
+      ASSERT_EQ(layer.outputSize(), expected.shape());
+
+      DataArray A = layer.evalForward(image.storage());
+
+      ASSERT_EQ(A.size(), expected.size());
+      for (size_t i = 0; i < A.size(); ++i) {
+        ASSERT_NEAR(A[i], expected.data()[i], 1e-4);
+      }
+    }
+  }
+}
+
+TEST_F(CpuDepthwiseSeparableLayerTest, convolutionOnlyOptionsDoNotReachPointwiseStage) {
+  const Size3 inputShape{ 6, 5, 3 };
+
+  Config config = layerConfig(1, 1);
+  config.setString("layout", "nhwc");
+  config.setString("engine", "direct");
+
+  DepthwiseSeparableLayer layer(config, inputShape);
+
+  Kernel depthwise(3, 3, 3);
+  depthwise.randomize(1.0);
+  auto pointwise = pointwiseFilters(3, 0.1f);
+
+  layer.test_setDepthwiseKernels(depthwise.storage());
+  layer.test_pointwise().test_setFilters(pointwise);
+
+  Array3 image(inputShape);
+  image.randomize(1.0);
+
+  Array3 expected = referenceForward(image, depthwise, pointwise, 1, 1);
+  DataArray A = layer.evalForward(image.storage());
+
+  ASSERT_EQ(A.size(), expected.size());
+  for (size_t i = 0; i < A.size(); ++i) {
+    ASSERT_NEAR(A[i], expected.data()[i], 1e-4);
+  }
+}
+
+TEST_F(CpuDepthwiseSeparableLayerTest, trainForwardMatchesEvalForwardOverBatch) {
+  const Size3 inputShape{ 5, 5, 2 };
+  const size_t batchSize = 3;
+
+  DepthwiseSeparableLayer layer(layerConfig(2, 1), inputShape);
+
+  Vector inputs(batchSize * calcProduct(inputShape));
+  inputs.randomize(1.0);
+
+  layer.trainForward(inputs.storage(), batchSize);
+  DataArray A = layer.evalForward(inputs.storage(), batchSize);
+
+  ASSERT_EQ(layer.activations().size(), A.size());
+  for (size_t i = 0; i < A.size(); ++i) {
+    ASSERT_NEAR(layer.activations()[i], A[i], 1e-6);
+  }
+}
+
+// The pointwise stage is a convolutional layer, whose working memory is exempt
+TEST_F(CpuDepthwiseSeparableLayerTest, evalIntoWithScratchDoesNotAllocate) {
+  const Size3 inputShape{ 6, 5, 3 };
+
+  for (size_t padding : { 0, 1 }) {
+    DepthwiseSeparableLayer layer(layerConfig(1, padding), inputShape);
+
+    Array3 image(inputShape);
+    image.randomize(1.0);
+
+    DataArray expected = layer.evalForward(image.storage());
+
+    // Left over from some other layer
+    DataArray scratch(layer.evalScratchSize(), Uninitialised{});
+    std::fill(scratch.data(), scratch.data() + scratch.size(), 7.f);
+
+    DataArray A(expected.size());
+
+    size_t allocations = memory::test_allocationCount();
+    layer.evalInto(image.data(), A.data(), 1, scratch.data());
+    ASSERT_EQ(memory::test_allocationCount(), allocations);
+
+    ASSERT_EQ(Vector(A), Vector(expected));
+  }
+}
+
+TEST_F(CpuDepthwiseSeparableLayerTest, updateDeltasMatchesNumericalGradient) {
+  const Size3 inputShape{ 5, 4, 2 };
+  const size_t batchSize = 2;
+  const Config config = layerConfig(2, 1);
+
+  Kernel depthwise(3, 3, 2);
+  depthwise.randomize(0.3);
+  auto pointwise = pointwiseFilters(2, 10.f);
+
+  auto makeLayer = [&](const Kernel& K) {
+    auto layer = std::make_unique<DepthwiseSeparableLayer>(config, inputShape);
+    layer->test_setDepthwiseKernels(K.storage());
+    layer->test_pointwise().test_setFilters(pointwise);
+    return layer;
+  };
+
+  Vector X(batchSize * calcProduct(inputShape));
+  X.randomize(1.0);
+
+  auto layer = makeLayer(depthwise);
+
+  // The loss is sum(w * A), so dLoss/dA = w
+  Vector w(batchSize * calcProduct(layer->outputSize()));
+  w.randomize(1.0);
+
+  auto loss = [&](const Kernel& K, const Vector& inputs) {
+    DataArray A = makeLayer(K)->evalForward(inputs.storage(), batchSize);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < A.size(); ++i) {
+      EXPECT_GT(A[i], 0.f);
+      sum += w[i] * A[i];
+    }
+    return sum;
+  };
+
+  layer->trainForward(X.storage(), batchSize);
+  layer->updateDeltas(X.storage(), w.storage(), batchSize);
+
+  const netfloat_t h = 1e-2f;
+
+  for (size_t i = 0; i < X.size(); ++i) {
+    Vector Xp = X;
+    Vector Xm = X;
+    Xp[i] += h;
+    Xm[i] -= h;
+
+    const double numerical = (loss(depthwise, Xp) - loss(depthwise, Xm)) / (2.0 * h);
+    ASSERT_NEAR(layer->inputDelta()[i], numerical, 2e-3);
+  }
+
+  for (size_t i = 0; i < depthwise.size(); ++i) {
+    Kernel Kp = depthwise;
+    Kernel Km = depthwise;
+    Kp.data()[i] += h;
+    Km.data()[i] -= h;
+
+    const double numerical = (loss(Kp, X) - loss(Km, X)) / (2.0 * h);
+    ASSERT_NEAR(layer->test_depthwiseDeltas().data()[i], numerical, 2e-3);
+  }
+}
+
+TEST_F(CpuDepthwiseSeparableLayerTest, writeAndReadStream) {
+  const Size3 inputShape{ 5, 5, 2 };
+  const Config config = layerConfig(1, 1);
+
+  DepthwiseSeparableLayer layer(config, inputShape);
+
+  std::stringstream stream;
+  layer.writeToStream(stream);
+
+  DepthwiseSeparableLayer loaded(config, stream, inputShape);
+
+  ASSERT_EQ(loaded.test_depthwiseKernels(), layer.test_depthwiseKernels());
+
+  auto filters = layer.test_pointwise().test_filters();
+  auto loadedFilters = loaded.test_pointwise().test_filters();
+
+  ASSERT_EQ(loadedFilters.size(), filters.size());
+  for (size_t i = 0; i < filters.size(); ++i) {
+    ASSERT_EQ(loadedFilters[i].K, filters[i].K);
+    ASSERT_EQ(loadedFilters[i].b, filters[i].b);
+  }
+}
@@ -0,0 +1,126 @@
+#include <richard/cpu/dropout.hpp>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace richard;
+using namespace richard::cpu;
+
+class CpuDropoutTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(CpuDropoutTest, zeroRateKeepsEverything) {
+  Dropout dropout(0.0);
+  dropout.generateMask(100);
+
+  std::vector<netfloat_t> Z(100, 1.f);
+  std::vector<netfloat_t> A(100);
+  dropout.forward(Relu{}, Z.data(), 0.5f, A.data(), Z.size());
+
+  for (size_t i = 0; i < Z.size(); ++i) {
+    ASSERT_EQ(Z[i], 1.5f);
+    ASSERT_EQ(A[i], 1.5f);
+  }
+}
+
+TEST_F(CpuDropoutTest, fullRateDropsEverything) {
+  Dropout dropout(1.0);
+  dropout.generateMask(100);
+
+  for (size_t i = 0; i < 100; ++i) {
+    ASSERT_EQ(dropout.multiplier(i), 0.f);
+  }
+}
+
+TEST_F(CpuDropoutTest, keptActivationsAreScaled) {
+  const size_t n = 10000;
+
+  Dropout dropout(0.25);
+  dropout.generateMask(n);
+
+  std::vector<netfloat_t> Z(n, 3.f);
+  std::vector<netfloat_t> bias(n, 1.f);
+  std::vector<netfloat_t> A(n);
+  dropout.forward(Relu{}, Z.data(), bias.data(), A.data(), n);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT_EQ(Z[i], 4.f);
+    if (A[i] != 0.f) {
+      ASSERT_FLOAT_EQ(A[i], 4.f / 0.75f);
+      ++kept;
+    }
+  }
+
+  ASSERT_NEAR(static_cast<double>(kept) / n, 0.75, 0.02);
+}
+
+TEST_F(CpuDropoutTest, backwardUsesForwardMask) {
+  const size_t n = 200;
+  const size_t offset = 50;
+
+  Dropout dropout(0.5);
+  dropout.generateMask(offset + n);
+
+  std::vector<netfloat_t> Z(n, 2.f);
+  std::vector<netfloat_t> A(n);
+  dropout.forward(Relu{}, Z.data(), 0.f, A.data(), n, offset);
+
+  std::vector<netfloat_t> deltaA(n, 1.f);
+  std::vector<netfloat_t> delta(n);
+  dropout.backward(ReluPrime{}, Z.data(), deltaA.data(), delta.data(), n, offset);
+
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT_EQ(A[i] == 0.f, delta[i] == 0.f);
+    ASSERT_EQ(delta[i], dropout.multiplier(offset + i));
+  }
+}
+
+TEST_F(CpuDropoutTest, masksDifferBetweenPasses) {
+  Dropout dropout(0.5);
+
+  dropout.generateMask(64);
+  std::vector<netfloat_t> first;
+  for (size_t i = 0; i < 64; ++i) {
+    first.push_back(dropout.multiplier(i));
+  }
+
+  dropout.generateMask(64);
+  std::vector<netfloat_t> second;
+  for (size_t i = 0; i < 64; ++i) {
+    second.push_back(dropout.multiplier(i));
+  }
+
+  ASSERT_NE(first, second);
+}
+
+TEST_F(CpuDropoutTest, masksDependOnlyOnStream) {
+  auto masks = [](const Dropout& dropout) {
+    std::vector<netfloat_t> mask;
+    for (size_t i = 0; i < 64; ++i) {
+      mask.push_back(dropout.multiplier(i));
+    }
+    return mask;
+  };
+
+  Dropout a(0.5, Dropout::streamKey(7, 1, 0));
+  // Constructing other Dropouts in between doesn't change which masks a stream gives
+  Dropout unused;
+  Dropout other(0.5, Dropout::streamKey(7, 1, 1));
+  Dropout b(0.5, Dropout::streamKey(7, 1, 0));
+
+  a.generateMask(64);
+  b.generateMask(64);
+  other.generateMask(64);
+
+  ASSERT_EQ(masks(a), masks(b));
+  ASSERT_NE(masks(a), masks(other));
+}
+
+TEST_F(CpuDropoutTest, streamKeysAreDistinct) {
+  ASSERT_NE(Dropout::streamKey(0, 1, 0), Dropout::streamKey(0, 0, 1));
+  ASSERT_NE(Dropout::streamKey(0, 1, 0), Dropout::streamKey(1, 1, 0));
+  ASSERT_NE(Dropout::streamKey(0, 0, 0), Dropout::streamKey(1, 0, 0));
+}
@@ -0,0 +1,62 @@
+#include <richard/cpu/global_average_pooling_layer.hpp>
+#include <richard/config.hpp>
+#include <gtest/gtest.h>
+
+using namespace richard;
+using namespace richard::cpu;
+
+class CpuGlobalAveragePoolingLayerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(CpuGlobalAveragePoolingLayerTest, outputSize) {
+  GlobalAveragePoolingLayer layer(Config{}, { 4, 3, 5 });
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 1, 1, 5 }));
+}
+
+TEST_F(CpuGlobalAveragePoolingLayerTest, trainForwardAveragesEachSlice) {
+  GlobalAveragePoolingLayer layer(Config{}, { 2, 2, 2 });
+
+  // Two samples
+  Array3 inputs({
+    {
+      { 1, 2 },
+      { 3, 4 }
+    }, {
+      { -1, 0 },
+      { 5, 0 }
+    }, {
+      { 0, 0 },
+      { 0, 8 }
+    }, {
+      { 2, 2 },
+      { 2, 2 }
+    }
+  });
+
+  layer.trainForward(inputs.storage(), 2);
+
+  ASSERT_EQ(Vector(layer.activations()), Vector({ 2.5, 1, 2, 2 }));
+  ASSERT_EQ(Vector(layer.evalForward(inputs.storage(), 2)), Vector({ 2.5, 1, 2, 2 }));
+}
+
+TEST_F(CpuGlobalAveragePoolingLayerTest, updateDeltasSpreadsDeltaEvenly) {
+  GlobalAveragePoolingLayer layer(Config{}, { 2, 2, 2 });
+
+  Array3 inputs(2, 2, 2);
+  layer.trainForward(inputs.storage());
+  layer.updateDeltas(inputs.storage(), Vector({ 4, -2 }).storage());
+
+  ASSERT_EQ(Array3(layer.inputDelta(), 2, 2, 2), Array3({
+    {
+      { 1, 1 },
+      { 1, 1 }
+    }, {
+      { -0.5, -0.5 },
+      { -0.5, -0.5 }
+    }
+  }));
+}
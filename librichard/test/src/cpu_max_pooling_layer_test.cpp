@@ -102,15 +102,13 @@ TEST_F(CpuMaxPoolingLayerTest, trainForward_1x1_depth1) {
     { 2, 3, 4, 5 }
   }));
 
-  Array3 mask = layer.test_mask();
+  std::vector<uint32_t> argmax = layer.test_argmax();
 
-  ASSERT_EQ(mask, Array3({
-    {
-      { 1, 1, 1, 1 },
-      { 1, 1, 1, 1 },
-      { 1, 1, 1, 1 },
-      { 1, 1, 1, 1 }
-    }
+  ASSERT_EQ(argmax, std::vector<uint32_t>({
+    0, 1, 2, 3,
+    4, 5, 6, 7,
+    8, 9, 10, 11,
+    12, 13, 14, 15
   }));
 }
 
@@ -140,15 +138,12 @@ TEST_F(CpuMaxPoolingLayerTest, trainForward_depth1) {
     { 9, 5 }
   }));
 
-  Array3 mask = layer.test_mask();
+  std::vector<uint32_t> argmax = layer.test_argmax();
 
-  ASSERT_EQ(mask, Array3({
-    {
-      { 0, 0, 0, 0 },
-      { 0, 1, 0, 1 },
-      { 0, 1, 0, 0 },
-      { 0, 0, 0, 1 }
-    }
+  // Offsets within the input slice
+  ASSERT_EQ(argmax, std::vector<uint32_t>({
+    5, 7,
+    9, 15
   }));
 }
 
@@ -190,20 +185,15 @@ TEST_F(CpuMaxPoolingLayerTest, trainForward_depth2) {
     }
   }));
 
-  Array3 mask = layer.test_mask();
+  std::vector<uint32_t> argmax = layer.test_argmax();
 
-  ASSERT_EQ(mask, Array3({
-    {
-      { 0, 0, 0, 0 },
-      { 0, 1, 0, 1 },
-      { 0, 1, 0, 0 },
-      { 0, 0, 0, 1 }
-    }, {
-      { 0, 1, 0, 1 },
-      { 0, 0, 0, 0 },
-      { 0, 0, 0, 1 },
-      { 0, 1, 0, 0 }
-    }
+  // Offsets within each input slice
+  ASSERT_EQ(argmax, std::vector<uint32_t>({
+    5, 7,
+    9, 15,
+
+    1, 3,
+    13, 11
   }));
 }
 
@@ -222,14 +212,12 @@ TEST_F(CpuMaxPoolingLayerTest, updateDeltas_depth1) {
     { 7, 6 }
   }});
 
-  Array3 mask({{
-    { 0, 0, 0, 1 },
-    { 1, 0, 0, 0 },
-    { 0, 1, 0, 0 },
-    { 0, 0, 0, 1 }
-  }});
+  std::vector<uint32_t> argmax{
+    4, 3,
+    9, 15
+  };
 
-  layer.test_setMask(mask);
+  layer.test_setArgmax(argmax);
   layer.updateDeltas(DataArray(), delta.storage());
 
   const DataArray& paddedDelta = layer.inputDelta();
@@ -264,21 +252,15 @@ TEST_F(CpuMaxPoolingLayerTest, updateDeltas_depth2) {
     }
   });
 
-  Array3 mask({
-    {
-      { 0, 0, 0, 1 },
-      { 1, 0, 0, 0 },
-      { 0, 1, 0, 0 },
-      { 0, 0, 0, 1 }
-    }, {
-      { 1, 0, 0, 0 },
-      { 0, 0, 1, 0 },
-      { 0, 0, 0, 0 },
-      { 0, 1, 1, 0 }
-    }  
-  });
+  std::vector<uint32_t> argmax{
+    4, 3,
+    9, 15,
+
+    0, 6,
+    13, 14
+  };
 
-  layer.test_setMask(mask);
+  layer.test_setArgmax(argmax);
   layer.updateDeltas(DataArray(), delta.storage());
 
   const DataArray& paddedDelta = layer.inputDelta();
@@ -299,3 +281,129 @@ TEST_F(CpuMaxPoolingLayerTest, updateDeltas_depth2) {
     }
   }));
 }
+
+TEST_F(CpuMaxPoolingLayerTest, batchMatchesSingleSamples) {
+  const size_t inputSize = 4 * 6 * 2;
+  const size_t outputSize = 2 * 3 * 2;
+  const size_t batchSize = 3;
+
+  Config config;
+  config.setNumberArray<size_t>("regionSize", { 2, 2 });
+
+  MaxPoolingLayer batchLayer(config, { 4, 6, 2 });
+  MaxPoolingLayer sampleLayer(config, { 4, 6, 2 });
+
+  Vector inputs(batchSize * inputSize);
+  inputs.randomize(1.0);
+  Vector outputDelta(batchSize * outputSize);
+  outputDelta.randomize(1.0);
+
+  batchLayer.trainForward(inputs.storage(), batchSize);
+  batchLayer.updateDeltas(inputs.storage(), outputDelta.storage(), batchSize);
+  DataArray Y = batchLayer.evalForward(inputs.storage(), batchSize);
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    DataArray x = Vector(*inputs.subvector(n * inputSize, inputSize)).storage();
+    DataArray deltaA = Vector(*outputDelta.subvector(n * outputSize, outputSize)).storage();
+
+    sampleLayer.trainForward(x);
+    sampleLayer.updateDeltas(x, deltaA);
+    DataArray y = sampleLayer.evalForward(x);
+
+    for (size_t i = 0; i < outputSize; ++i) {
+      ASSERT_EQ(batchLayer.activations()[n * outputSize + i], sampleLayer.activations()[i]);
+      ASSERT_EQ(Y[n * outputSize + i], y[i]);
+    }
+    for (size_t i = 0; i < inputSize; ++i) {
+      ASSERT_EQ(batchLayer.inputDelta()[n * inputSize + i], sampleLayer.inputDelta()[i]);
+    }
+  }
+}
+
+TEST_F(CpuMaxPoolingLayerTest, evalForward_overlappingRegions) {
+  Config config;
+  config.setNumberArray<size_t>("regionSize", { 3, 3 });
+  config.setNumberArray<size_t>("stride", { 2, 2 });
+
+  MaxPoolingLayer layer(config, { 5, 5, 1 });
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 2, 2, 1 }));
+
+  Array2 inputs({
+    { 0, 1, 2, 3, 4 },
+    { 4, 5, 6, 7, 8 },
+    { 8, 9, 9, 1, 2 },
+    { 2, 3, 4, 5, 6 },
+    { 1, 0, 3, 2, 7 }
+  });
+
+  Array2 A(layer.evalForward(inputs.storage()), 2, 2);
+
+  ASSERT_EQ(A, Array2({
+    { 9, 9 },
+    { 9, 9 }
+  }));
+}
+
+TEST_F(CpuMaxPoolingLayerTest, updateDeltas_overlappingRegionsSumDeltas) {
+  Config config;
+  config.setNumberArray<size_t>("regionSize", { 3, 1 });
+  config.setNumberArray<size_t>("stride", { 1, 1 });
+
+  MaxPoolingLayer layer(config, { 5, 1, 1 });
+
+  DataArray inputs = Array2({{ 1, 2, 9, 3, 4 }}).storage();
+
+  layer.trainForward(inputs);
+
+  Array2 A(layer.activations(), 3, 1);
+  ASSERT_EQ(A, Array2({{ 9, 9, 9 }}));
+
+  // The 9 wins all three regions
+  Array2 delta({{ 1, 2, 4 }});
+  layer.updateDeltas(inputs, delta.storage());
+
+  Array2 inputDelta(layer.inputDelta(), 5, 1);
+  ASSERT_EQ(inputDelta, Array2({{ 0, 0, 7, 0, 0 }}));
+}
+
+TEST_F(CpuMaxPoolingLayerTest, updateDeltas_gapsBetweenRegions) {
+  Config config;
+  config.setNumberArray<size_t>("regionSize", { 2, 2 });
+  config.setNumberArray<size_t>("stride", { 3, 3 });
+
+  MaxPoolingLayer layer(config, { 5, 5, 1 });
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 2, 2, 1 }));
+
+  Array2 inputs({
+    { 0, 1, 9, 3, 4 },
+    { 4, 5, 9, 7, 8 },
+    { 9, 9, 9, 9, 9 },
+    { 2, 3, 9, 5, 6 },
+    { 1, 0, 9, 2, 7 }
+  });
+
+  layer.trainForward(inputs.storage());
+
+  Array2 A(layer.activations(), 2, 2);
+  ASSERT_EQ(A, Array2({
+    { 5, 8 },
+    { 3, 7 }
+  }));
+
+  Array2 delta({
+    { 1, 2 },
+    { 3, 4 }
+  });
+  layer.updateDeltas(inputs.storage(), delta.storage());
+
+  Array2 inputDelta(layer.inputDelta(), 5, 5);
+  ASSERT_EQ(inputDelta, Array2({
+    { 0, 0, 0, 0, 0 },
+    { 0, 1, 0, 0, 2 },
+    { 0, 0, 0, 0, 0 },
+    { 0, 3, 0, 0, 0 },
+    { 0, 0, 0, 0, 4 }
+  }));
+}
@@ -4,9 +4,14 @@
 #include <richard/cpu/dense_layer.hpp>
 #include <richard/cpu/output_layer.hpp>
 #include <richard/cpu/convolutional_layer.hpp>
+#include <richard/cpu/batch_norm_layer.hpp>
 #include <richard/event_system.hpp>
+#include <richard/allocator.hpp>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <mutex>
+#include <set>
+#include <thread>
 
 using namespace richard;
 using namespace richard::cpu;
@@ -298,3 +303,770 @@ TEST_F(CpuNeuralNetTest, evaluateConv) {
   // TODO: Add some assertions
 }
 
+TEST_F(CpuNeuralNetTest, miniBatchMatchesSingleSamples) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 1,                 "
+  "      \"batchSize\": 4,              "
+  "      \"miniBatchSize\": 4           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.5f, 0.3f, 0.7f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.4f, 0.6f, 0.8f }}})},
+    Sample{"a", Array3({{{ 0.9f, 0.2f, 0.3f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  auto& netHidden = dynamic_cast<DenseLayer&>(net->test_getLayer(0));
+  auto& netOutput = dynamic_cast<OutputLayer&>(net->test_getLayer(1));
+
+  // Train copies of the layers one sample at a time
+  DenseLayer hidden(config.getObjectArray("hiddenLayers")[0], 3);
+  OutputLayer output(config.getObject("outputLayer"), 4);
+  hidden.test_setWeights(netHidden.test_W().storage());
+  output.test_setWeights(netOutput.test_W().storage());
+
+  for (const Sample& sample : samples) {
+    const DataArray& x = sample.data.storage();
+    const DataArray& y = dataSet.classOutputVector(sample.label).storage();
+
+    hidden.trainForward(x);
+    output.trainForward(hidden.activations());
+    output.updateDeltas(hidden.activations(), y);
+    hidden.updateDeltas(x, output.inputDelta());
+  }
+  hidden.updateParams(0);
+  output.updateParams(0);
+
+  net->train(dataSet);
+
+  for (size_t i = 0; i < hidden.test_W().size(); ++i) {
+    ASSERT_NEAR(netHidden.test_W().data()[i], hidden.test_W().data()[i], 1e-6);
+  }
+  for (size_t i = 0; i < output.test_W().size(); ++i) {
+    ASSERT_NEAR(netOutput.test_W().data()[i], output.test_W().data()[i], 1e-6);
+  }
+  ASSERT_NEAR(netHidden.test_B()[0], hidden.test_B()[0], 1e-6);
+  ASSERT_NEAR(netOutput.test_B()[1], output.test_B()[1], 1e-6);
+}
+
+TEST_F(CpuNeuralNetTest, dataParallelTrainingMatchesSingleThread) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 2,                 "
+  "      \"batchSize\": 10,             "
+  "      \"miniBatchSize\": 4           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.5f, 0.3f, 0.7f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.4f, 0.6f, 0.8f }}})},
+    Sample{"a", Array3({{{ 0.9f, 0.2f, 0.3f }}})},
+    Sample{"a", Array3({{{ 0.2f, 0.1f, 0.6f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  std::vector<CpuNeuralNetPtr> nets;
+  for (uint32_t threads : { 1, 3, 3 }) {
+    Config config = Config::fromJson(configString);
+    Config hyperparams = config.getObject("hyperparams");
+    hyperparams.setNumber("threads", threads);
+    config.setObject("hyperparams", hyperparams);
+
+    nets.push_back(createNeuralNet(inputShape, config, *eventSystem));
+  }
+
+  auto hiddenLayer = [&](size_t net) -> DenseLayer& {
+    return dynamic_cast<DenseLayer&>(nets[net]->test_getLayer(0));
+  };
+  auto outputLayer = [&](size_t net) -> OutputLayer& {
+    return dynamic_cast<OutputLayer&>(nets[net]->test_getLayer(1));
+  };
+
+  for (size_t i = 1; i < nets.size(); ++i) {
+    hiddenLayer(i).test_setWeights(hiddenLayer(0).test_W().storage());
+    outputLayer(i).test_setWeights(outputLayer(0).test_W().storage());
+  }
+
+  for (auto& net : nets) {
+    net->train(dataSet);
+  }
+
+  // Summing the gradients in a different order only introduces rounding differences
+  for (size_t i = 0; i < hiddenLayer(0).test_W().size(); ++i) {
+    ASSERT_NEAR(hiddenLayer(1).test_W().data()[i], hiddenLayer(0).test_W().data()[i], 1e-5);
+  }
+  for (size_t i = 0; i < outputLayer(0).test_W().size(); ++i) {
+    ASSERT_NEAR(outputLayer(1).test_W().data()[i], outputLayer(0).test_W().data()[i], 1e-5);
+  }
+  ASSERT_NEAR(hiddenLayer(1).test_B()[2], hiddenLayer(0).test_B()[2], 1e-5);
+  ASSERT_NEAR(outputLayer(1).test_B()[0], outputLayer(0).test_B()[0], 1e-5);
+
+  // For a fixed thread count the results are identical
+  ASSERT_EQ(hiddenLayer(1).test_W(), hiddenLayer(2).test_W());
+  ASSERT_EQ(outputLayer(1).test_W(), outputLayer(2).test_W());
+  ASSERT_EQ(hiddenLayer(1).test_B(), hiddenLayer(2).test_B());
+  ASSERT_EQ(outputLayer(1).test_B(), outputLayer(2).test_B());
+}
+
+TEST_F(CpuNeuralNetTest, dropoutMasksDependOnlyOnSeed) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 2,                 "
+  "      \"batchSize\": 10,             "
+  "      \"miniBatchSize\": 4,          "
+  "      \"threads\": 2                 "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 8,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.5       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.5f, 0.3f, 0.7f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.4f, 0.6f, 0.8f }}})},
+    Sample{"a", Array3({{{ 0.9f, 0.2f, 0.3f }}})},
+    Sample{"a", Array3({{{ 0.2f, 0.1f, 0.6f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  // Nets constructed one after another in the same process, the last with a different seed
+  std::vector<CpuNeuralNetPtr> nets;
+  for (uint32_t seed : { 0, 0, 1 }) {
+    Config config = Config::fromJson(configString);
+    Config hyperparams = config.getObject("hyperparams");
+    hyperparams.setNumber("seed", seed);
+    config.setObject("hyperparams", hyperparams);
+
+    nets.push_back(createNeuralNet(inputShape, config, *eventSystem));
+  }
+
+  auto hiddenLayer = [&](size_t net) -> DenseLayer& {
+    return dynamic_cast<DenseLayer&>(nets[net]->test_getLayer(0));
+  };
+  auto outputLayer = [&](size_t net) -> OutputLayer& {
+    return dynamic_cast<OutputLayer&>(nets[net]->test_getLayer(1));
+  };
+
+  for (size_t i = 1; i < nets.size(); ++i) {
+    hiddenLayer(i).test_setWeights(hiddenLayer(0).test_W().storage());
+    outputLayer(i).test_setWeights(outputLayer(0).test_W().storage());
+  }
+
+  for (auto& net : nets) {
+    net->train(dataSet);
+  }
+
+  ASSERT_EQ(hiddenLayer(0).test_W(), hiddenLayer(1).test_W());
+  ASSERT_EQ(outputLayer(0).test_W(), outputLayer(1).test_W());
+  ASSERT_NE(hiddenLayer(0).test_W(), hiddenLayer(2).test_W());
+}
+
+TEST_F(CpuNeuralNetTest, dataParallelBatchNormMatchesSingleThread) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 2,                 "
+  "      \"batchSize\": 10,             "
+  "      \"miniBatchSize\": 4           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      },                             "
+  "      {                              "
+  "          \"type\": \"batchNorm\",   "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"momentum\": 0.5          "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.5f, 0.3f, 0.7f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.4f, 0.6f, 0.8f }}})},
+    Sample{"a", Array3({{{ 0.9f, 0.2f, 0.3f }}})},
+    Sample{"a", Array3({{{ 0.2f, 0.1f, 0.6f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  std::vector<CpuNeuralNetPtr> nets;
+  for (uint32_t threads : { 1, 3 }) {
+    Config config = Config::fromJson(configString);
+    Config hyperparams = config.getObject("hyperparams");
+    hyperparams.setNumber("threads", threads);
+    config.setObject("hyperparams", hyperparams);
+
+    nets.push_back(createNeuralNet(inputShape, config, *eventSystem));
+  }
+
+  auto hiddenLayer = [&](size_t net) -> DenseLayer& {
+    return dynamic_cast<DenseLayer&>(nets[net]->test_getLayer(0));
+  };
+  auto batchNormLayer = [&](size_t net) -> BatchNormLayer& {
+    return dynamic_cast<BatchNormLayer&>(nets[net]->test_getLayer(1));
+  };
+  auto outputLayer = [&](size_t net) -> OutputLayer& {
+    return dynamic_cast<OutputLayer&>(nets[net]->test_getLayer(2));
+  };
+
+  hiddenLayer(1).test_setWeights(hiddenLayer(0).test_W().storage());
+  outputLayer(1).test_setWeights(outputLayer(0).test_W().storage());
+
+  for (auto& net : nets) {
+    net->train(dataSet);
+  }
+
+  // Each shard is normalised with the statistics of the whole mini-batch, so only the order in
+  // which sums are taken differs
+  for (size_t i = 0; i < hiddenLayer(0).test_W().size(); ++i) {
+    ASSERT_NEAR(hiddenLayer(1).test_W().data()[i], hiddenLayer(0).test_W().data()[i], 1e-5);
+  }
+  for (size_t i = 0; i < outputLayer(0).test_W().size(); ++i) {
+    ASSERT_NEAR(outputLayer(1).test_W().data()[i], outputLayer(0).test_W().data()[i], 1e-5);
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_NEAR(batchNormLayer(1).test_gamma()[i], batchNormLayer(0).test_gamma()[i], 1e-5);
+    ASSERT_NEAR(batchNormLayer(1).test_beta()[i], batchNormLayer(0).test_beta()[i], 1e-5);
+    ASSERT_NEAR(batchNormLayer(1).test_mean()[i], batchNormLayer(0).test_mean()[i], 1e-5);
+    ASSERT_NEAR(batchNormLayer(1).test_variance()[i], batchNormLayer(0).test_variance()[i],
+      1e-5);
+  }
+}
+
+TEST_F(CpuNeuralNetTest, hogwildWithOneThreadMatchesSynchronous) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 2,                 "
+  "      \"batchSize\": 8,              "
+  "      \"miniBatchSize\": 2           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.5f, 0.3f, 0.7f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.4f, 0.6f, 0.8f }}})},
+    Sample{"a", Array3({{{ 0.9f, 0.2f, 0.3f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  std::vector<CpuNeuralNetPtr> nets;
+  for (const char* mode : { "synchronous", "hogwild" }) {
+    Config config = Config::fromJson(configString);
+    Config hyperparams = config.getObject("hyperparams");
+    hyperparams.setString("trainingMode", mode);
+    config.setObject("hyperparams", hyperparams);
+
+    nets.push_back(createNeuralNet(inputShape, config, *eventSystem));
+  }
+
+  auto& syncHidden = dynamic_cast<DenseLayer&>(nets[0]->test_getLayer(0));
+  auto& syncOutput = dynamic_cast<OutputLayer&>(nets[0]->test_getLayer(1));
+  auto& hogwildHidden = dynamic_cast<DenseLayer&>(nets[1]->test_getLayer(0));
+  auto& hogwildOutput = dynamic_cast<OutputLayer&>(nets[1]->test_getLayer(1));
+
+  hogwildHidden.test_setWeights(syncHidden.test_W().storage());
+  hogwildOutput.test_setWeights(syncOutput.test_W().storage());
+
+  for (auto& net : nets) {
+    net->train(dataSet);
+  }
+
+  // A single worker takes the mini-batches in order, just like synchronous training. Each load
+  // returns a whole number of mini-batches, so the batch boundaries are the same too.
+  ASSERT_EQ(hogwildHidden.test_W(), syncHidden.test_W());
+  ASSERT_EQ(hogwildOutput.test_W(), syncOutput.test_W());
+  ASSERT_EQ(hogwildHidden.test_B(), syncHidden.test_B());
+  ASSERT_EQ(hogwildOutput.test_B(), syncOutput.test_B());
+}
+
+TEST_F(CpuNeuralNetTest, hogwildTrainingReducesCost) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 20,                "
+  "      \"batchSize\": 40,             "
+  "      \"miniBatchSize\": 2,          "
+  "      \"threads\": 4,                "
+  "      \"trainingMode\": \"hogwild\"  "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.5,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.5,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<netfloat_t> costs;
+  auto handle = eventSystem->listen(EEpochCompleted::name, [&](const Event& event) {
+    costs.push_back(dynamic_cast<const EEpochCompleted&>(event).cost);
+  });
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.9f, 0.1f, 0.8f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.2f, 0.8f, 0.1f }}})},
+    Sample{"a", Array3({{{ 0.8f, 0.2f, 0.9f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  net->train(dataSet);
+
+  ASSERT_EQ(costs.size(), 20);
+  ASSERT_LT(costs.back(), costs.front());
+}
+
+TEST_F(CpuNeuralNetTest, evaluateDoesNotAllocate) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 1,                 "
+  "      \"batchSize\": 1,              "
+  "      \"miniBatchSize\": 1           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 20,              "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      },                             "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 6,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 3,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 8, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  Array3 x(8, 1, 1);
+  x.randomize(1.0);
+
+  // The same as running each layer's evalForward in turn
+  DataArray expected = x.storage();
+  for (size_t i = 0; i < 3; ++i) {
+    expected = net->test_getLayer(i).evalForward(expected);
+  }
+
+  size_t allocations = memory::test_allocationCount();
+  Vector y = net->evaluate(x);
+
+  // Only the returned vector
+  ASSERT_EQ(memory::test_allocationCount() - allocations, 1);
+
+  ASSERT_EQ(y, Vector(expected));
+}
+
+TEST_F(CpuNeuralNetTest, convolutionalEvaluateDoesNotAllocate) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 1,                 "
+  "      \"batchSize\": 1,              "
+  "      \"miniBatchSize\": 1           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"convolutional\", "
+  "          \"depth\": 4,                "
+  "          \"kernelSize\": [3, 3],      "
+  "          \"padding\": 1,              "
+  "          \"learnRate\": 0.1,          "
+  "          \"learnRateDecay\": 1.0,     "
+  "          \"dropoutRate\": 0.0         "
+  "      },                             "
+  "      {                              "
+  "          \"type\": \"convolutional\", "
+  "          \"depth\": 2,                "
+  "          \"kernelSize\": [3, 3],      "
+  "          \"engine\": \"gemm\",        "
+  "          \"learnRate\": 0.1,          "
+  "          \"learnRateDecay\": 1.0,     "
+  "          \"dropoutRate\": 0.0         "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 3,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 8, 8, 2 });
+
+  auto eventSystem = createEventSystem();
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  Array3 x(inputShape);
+  x.randomize(1.0);
+
+  DataArray expected = x.storage();
+  for (size_t i = 0; i < 3; ++i) {
+    expected = net->test_getLayer(i).evalForward(expected);
+  }
+
+  size_t allocations = memory::test_allocationCount();
+  Vector y = net->evaluate(x);
+
+  // Only the returned vector
+  ASSERT_EQ(memory::test_allocationCount() - allocations, 1);
+
+  ASSERT_EQ(y, Vector(expected));
+}
+
+TEST_F(CpuNeuralNetTest, parallelEvaluateRunsOnTheNetsThreads) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 1,                 "
+  "      \"batchSize\": 1,              "
+  "      \"miniBatchSize\": 1,          "
+  "      \"threads\": 3                 "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 6,               "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 3,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 8, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  std::vector<Array3> inputs;
+  for (size_t i = 0; i < 24; ++i) {
+    inputs.emplace_back(8, 1, 1);
+    inputs.back().randomize(1.0);
+  }
+
+  std::vector<Vector> outputs(inputs.size());
+  std::mutex mutex;
+  std::set<std::thread::id> threadIds;
+
+  net->parallelEvaluate(inputs.size(), [&](size_t i) {
+    outputs[i] = net->evaluate(inputs[i]);
+
+    std::lock_guard lock(mutex);
+    threadIds.insert(std::this_thread::get_id());
+  });
+
+  // The calling thread and the net's two workers
+  ASSERT_LE(threadIds.size(), 3);
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(outputs[i], net->evaluate(inputs[i]));
+  }
+}
+
+TEST_F(CpuNeuralNetTest, crossEntropyTrainingReducesCost) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 20,                "
+  "      \"batchSize\": 4,              "
+  "      \"miniBatchSize\": 2           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.5,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.5,            "
+  "      \"learnRateDecay\": 1.0,       "
+  "      \"cost\": \"crossEntropy\"     "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<netfloat_t> costs;
+  auto handle = eventSystem->listen(EEpochCompleted::name, [&](const Event& event) {
+    costs.push_back(dynamic_cast<const EEpochCompleted&>(event).cost);
+  });
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.9f, 0.1f, 0.8f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.2f, 0.8f, 0.1f }}})},
+    Sample{"a", Array3({{{ 0.8f, 0.2f, 0.9f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  net->train(dataSet);
+
+  ASSERT_EQ(costs.size(), 20);
+  ASSERT_LT(costs.back(), costs.front());
+
+  // Softmax outputs are a probability distribution
+  Vector y = net->evaluate(samples[0].data);
+  ASSERT_NEAR(y[0] + y[1], 1.0, 1e-6);
+  ASSERT_GT(y[0], y[1]);
+
+  NeuralNet::CostFn cost = net->costFn();
+  ASSERT_NEAR(cost(Vector({ 0.25, 0.75 }), Vector({ 0, 1 })), -std::log(0.75), 1e-6);
+}
+
+TEST_F(CpuNeuralNetTest, batchNormIsFoldedForEvaluation) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 10,                "
+  "      \"batchSize\": 4,              "
+  "      \"miniBatchSize\": 4           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"dense\",       "
+  "          \"size\": 4,               "
+  "          \"learnRate\": 0.5,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"dropoutRate\": 0.0       "
+  "      },                             "
+  "      {                              "
+  "          \"type\": \"batchNorm\",   "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0,   "
+  "          \"momentum\": 0.5          "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.5,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  Size3 inputShape({ 3, 1, 1 });
+
+  auto eventSystem = createEventSystem();
+
+  std::vector<netfloat_t> costs;
+  auto handle = eventSystem->listen(EEpochCompleted::name, [&](const Event& event) {
+    costs.push_back(dynamic_cast<const EEpochCompleted&>(event).cost);
+  });
+
+  Config config = Config::fromJson(configString);
+  CpuNeuralNetPtr net = createNeuralNet(inputShape, config, *eventSystem);
+
+  std::vector<Sample> samples{
+    Sample{"a", Array3({{{ 0.9f, 0.1f, 0.8f }}})},
+    Sample{"b", Array3({{{ 0.1f, 0.9f, 0.2f }}})},
+    Sample{"b", Array3({{{ 0.2f, 0.8f, 0.1f }}})},
+    Sample{"a", Array3({{{ 0.8f, 0.2f, 0.9f }}})}
+  };
+
+  DataLoaderPtr dataLoader = std::make_unique<MockDataLoader>();
+  testing::NiceMock<MockLabelledDataSet> dataSet(std::move(dataLoader),
+    std::vector<std::string>({ "a", "b" }));
+
+  ON_CALL(dataSet, loadSamples).WillByDefault(testing::Return(samples));
+
+  net->train(dataSet);
+
+  ASSERT_EQ(costs.size(), 10);
+  ASSERT_LT(costs.back(), costs.front());
+
+  for (const Sample& sample : samples) {
+    DataArray A = sample.data.storage();
+    for (size_t i = 0; i < 3; ++i) {
+      A = net->test_getLayer(i).evalForward(A);
+    }
+
+    Vector y = net->evaluate(sample.data);
+
+    ASSERT_EQ(y.size(), A.size());
+    for (size_t i = 0; i < y.size(); ++i) {
+      ASSERT_NEAR(y[i], A[i], 1e-5);
+    }
+  }
+}
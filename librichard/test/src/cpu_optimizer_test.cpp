@@ -0,0 +1,174 @@
+#include <richard/cpu/optimizer.hpp>
+#include <richard/config.hpp>
+#include <richard/exception.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <cmath>
+#include <vector>
+
+using namespace richard;
+using namespace richard::cpu;
+
+class CpuOptimizerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+namespace {
+
+OptimizerParams optimizerParams(const std::string& type) {
+  Config config;
+  config.setString("type", type);
+  return OptimizerParams(config);
+}
+
+}
+
+TEST_F(CpuOptimizerTest, sgdSubtractsScaledGradient) {
+  Optimizer optimizer(optimizerParams("sgd"), 3);
+
+  std::vector<netfloat_t> params{ 1.f, 2.f, 3.f };
+  std::vector<netfloat_t> gradients{ 0.5f, -1.f, 2.f };
+
+  optimizer.nextStep(0.1f);
+  optimizer.update(params.data(), gradients.data(), params.size());
+
+  ASSERT_FLOAT_EQ(params[0], 0.95f);
+  ASSERT_FLOAT_EQ(params[1], 2.1f);
+  ASSERT_FLOAT_EQ(params[2], 2.8f);
+
+  for (netfloat_t g : gradients) {
+    ASSERT_EQ(g, 0.f);
+  }
+}
+
+TEST_F(CpuOptimizerTest, momentumAccumulatesVelocity) {
+  OptimizerParams params = optimizerParams("momentum");
+  params.beta1 = 0.5;
+  Optimizer optimizer(params, 1);
+
+  netfloat_t w = 0.f;
+  netfloat_t g = 1.f;
+
+  optimizer.nextStep(0.1f);
+  optimizer.update(&w, &g, 1);
+  // v = 1
+  ASSERT_FLOAT_EQ(w, -0.1f);
+
+  g = 1.f;
+  optimizer.nextStep(0.1f);
+  optimizer.update(&w, &g, 1);
+  // v = 0.5 * 1 + 1 = 1.5
+  ASSERT_FLOAT_EQ(w, -0.25f);
+}
+
+TEST_F(CpuOptimizerTest, nesterovLooksAhead) {
+  OptimizerParams params = optimizerParams("nesterov");
+  params.beta1 = 0.5;
+  Optimizer optimizer(params, 1);
+
+  netfloat_t w = 0.f;
+  netfloat_t g = 1.f;
+
+  optimizer.nextStep(0.1f);
+  optimizer.update(&w, &g, 1);
+  // v = 1, step = 1 + 0.5 * 1
+  ASSERT_FLOAT_EQ(w, -0.15f);
+}
+
+TEST_F(CpuOptimizerTest, rmsPropNormalisesGradient) {
+  OptimizerParams params = optimizerParams("rmsProp");
+  params.beta2 = 0.75;
+  params.epsilon = 0.0;
+  Optimizer optimizer(params, 1);
+
+  netfloat_t w = 0.f;
+  netfloat_t g = 4.f;
+
+  optimizer.nextStep(0.1f);
+  optimizer.update(&w, &g, 1);
+  // s = 0.25 * 16 = 4
+  ASSERT_FLOAT_EQ(w, -0.2f);
+}
+
+TEST_F(CpuOptimizerTest, adamFirstStepIsLearnRateTimesSign) {
+  Optimizer optimizer(optimizerParams("adam"), 2);
+
+  std::vector<netfloat_t> params{ 0.f, 0.f };
+  std::vector<netfloat_t> gradients{ 123.f, -0.001f };
+
+  optimizer.nextStep(0.01f);
+  optimizer.update(params.data(), gradients.data(), params.size());
+
+  // With bias correction, m_hat = g and v_hat = g^2
+  ASSERT_NEAR(params[0], -0.01f, 1e-6);
+  ASSERT_NEAR(params[1], 0.01f, 1e-5);
+}
+
+TEST_F(CpuOptimizerTest, updatingInPiecesMatchesWholeArray) {
+  Optimizer whole(optimizerParams("adam"), 6);
+  Optimizer pieces(optimizerParams("adam"), 6);
+
+  std::vector<netfloat_t> paramsA{ 1.f, 2.f, 3.f, 4.f, 5.f, 6.f };
+  std::vector<netfloat_t> paramsB = paramsA;
+
+  for (int step = 0; step < 3; ++step) {
+    std::vector<netfloat_t> gradientsA{ 0.1f, -0.2f, 0.3f, 0.4f, -0.5f, 0.6f };
+    std::vector<netfloat_t> gradientsB = gradientsA;
+
+    whole.nextStep(0.1f);
+    whole.update(paramsA.data(), gradientsA.data(), 6);
+
+    pieces.nextStep(0.1f);
+    pieces.update(paramsB.data(), gradientsB.data(), 2, 0);
+    pieces.update(paramsB.data() + 2, gradientsB.data() + 2, 4, 2);
+  }
+
+  ASSERT_EQ(paramsA, paramsB);
+}
+
+TEST_F(CpuOptimizerTest, stateSurvivesWriteAndRead) {
+  Optimizer optimizer(optimizerParams("adam"), 2);
+
+  std::vector<netfloat_t> params{ 1.f, 2.f };
+  std::vector<netfloat_t> gradients{ 0.5f, -0.5f };
+  optimizer.nextStep(0.1f);
+  optimizer.update(params.data(), gradients.data(), 2);
+
+  std::stringstream stream;
+  optimizer.write(stream);
+
+  ASSERT_EQ(stream.str().size(), sizeof(uint32_t) + 4 * sizeof(netfloat_t));
+
+  Optimizer loaded(optimizerParams("adam"), 2);
+  loaded.read(stream);
+
+  std::vector<netfloat_t> paramsA = params;
+  std::vector<netfloat_t> paramsB = params;
+  std::vector<netfloat_t> gradientsA{ 0.25f, 0.75f };
+  std::vector<netfloat_t> gradientsB = gradientsA;
+
+  optimizer.nextStep(0.1f);
+  optimizer.update(paramsA.data(), gradientsA.data(), 2);
+  loaded.nextStep(0.1f);
+  loaded.update(paramsB.data(), gradientsB.data(), 2);
+
+  ASSERT_EQ(paramsA, paramsB);
+}
+
+TEST_F(CpuOptimizerTest, sgdWritesNothing) {
+  Optimizer optimizer(OptimizerParams(), 10);
+
+  std::stringstream stream;
+  optimizer.write(stream);
+
+  ASSERT_TRUE(stream.str().empty());
+}
+
+TEST_F(CpuOptimizerTest, unrecognisedTypeThrows) {
+  Config config;
+  config.setString("type", "adagrad");
+
+  ASSERT_THROW(OptimizerParams{config}, Exception);
+}
@@ -1,6 +1,7 @@
 #include <richard/cpu/output_layer.hpp>
 #include <richard/config.hpp>
 #include <gtest/gtest.h>
+#include <cmath>
 
 using namespace richard;
 using namespace richard::cpu;
@@ -17,32 +18,122 @@ TEST_F(CpuOutputLayerTest, evalForward) {
   config.setNumber("learnRate", 0.5);
   config.setNumber("learnRateDecay", 1.0);
 
-  ActivationFn activationFn = [](netfloat_t x) {
-    return x * 2.f;
-  };
-
-  ActivationFn activationFnPrime = [](netfloat_t) {
-    return 2.f;
-  };
-
   Matrix W({
     { 2, 1, 3 },
     { 1, 4, 2 }
   });
 
-  Vector B({ 5, 7 });
+  Vector B({ 5, -30 });
 
   OutputLayer layer(config, 3);
   layer.test_setWeights(W.storage());
   layer.test_setBiases(B.storage());
-  layer.test_setActivationFn(activationFn, activationFnPrime);
+  layer.test_setActivation(Activation::relu);
 
   Vector X({ 3, 4, 2 });
   Vector Y(layer.evalForward(X.storage()));
 
-  ASSERT_EQ(Y, Vector({ (3*2+4*1+2*3+5)*2, (3*1+4*4+2*2+7)*2 }));
+  ASSERT_EQ(Y, Vector({ 3*2+4*1+2*3+5, 0 }));
 }
 
 TEST_F(CpuOutputLayerTest, trainForward) {
   // TODO
 }
+
+TEST_F(CpuOutputLayerTest, batchMatchesSingleSamples) {
+  const size_t inputSize = 6;
+  const size_t size = 3;
+  const size_t batchSize = 5;
+
+  Config config;
+  config.setNumber("size", size);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+
+  OutputLayer batchLayer(config, inputSize);
+  OutputLayer sampleLayer(config, inputSize);
+  sampleLayer.test_setWeights(batchLayer.test_W().storage());
+
+  Vector inputs(batchSize * inputSize);
+  inputs.randomize(1.0);
+  Vector outputs(batchSize * size);
+  outputs.randomize(1.0);
+
+  batchLayer.trainForward(inputs.storage(), batchSize);
+  batchLayer.updateDeltas(inputs.storage(), outputs.storage(), batchSize);
+
+  for (size_t n = 0; n < batchSize; ++n) {
+    DataArray x = Vector(*inputs.subvector(n * inputSize, inputSize)).storage();
+    DataArray y = Vector(*outputs.subvector(n * size, size)).storage();
+
+    sampleLayer.trainForward(x);
+    sampleLayer.updateDeltas(x, y);
+
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_NEAR(batchLayer.activations()[n * size + i], sampleLayer.activations()[i], 1e-5);
+    }
+    for (size_t i = 0; i < inputSize; ++i) {
+      ASSERT_NEAR(batchLayer.inputDelta()[n * inputSize + i], sampleLayer.inputDelta()[i], 1e-5);
+    }
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_NEAR(batchLayer.test_deltaB()[i], sampleLayer.test_deltaB()[i], 1e-5);
+  }
+  for (size_t i = 0; i < inputSize * size; ++i) {
+    ASSERT_NEAR(batchLayer.test_deltaW().data()[i], sampleLayer.test_deltaW().data()[i], 1e-5);
+  }
+}
+
+TEST_F(CpuOutputLayerTest, crossEntropyUsesSoftmax) {
+  Config config;
+  config.setNumber("size", 3);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setString("cost", "crossEntropy");
+
+  Matrix W({
+    { 1, 0 },
+    { 0, 1 },
+    { 1, 1 }
+  });
+
+  Vector B({ 0, 0, -1 });
+
+  OutputLayer layer(config, 2);
+  layer.test_setWeights(W.storage());
+  layer.test_setBiases(B.storage());
+
+  Vector X({ 1, 2 });
+  Vector Y(layer.evalForward(X.storage()));
+
+  // Weighted inputs are 1, 2 and 2
+  double sum = std::exp(1.0) + 2.0 * std::exp(2.0);
+  ASSERT_NEAR(Y[0], std::exp(1.0) / sum, 1e-6);
+  ASSERT_NEAR(Y[1], std::exp(2.0) / sum, 1e-6);
+  ASSERT_NEAR(Y[2], std::exp(2.0) / sum, 1e-6);
+}
+
+TEST_F(CpuOutputLayerTest, crossEntropyDeltaIsActivationsMinusExpected) {
+  Config config;
+  config.setNumber("size", 3);
+  config.setNumber("learnRate", 0.5);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setString("cost", "crossEntropy");
+
+  OutputLayer layer(config, 4);
+
+  Vector X({ 0.1f, 0.2f, 0.3f, 0.4f });
+  Vector Y({ 0, 1, 0 });
+
+  layer.trainForward(X.storage());
+  layer.updateDeltas(X.storage(), Y.storage());
+
+  Vector A(layer.activations());
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_NEAR(layer.test_deltaB()[i], A[i] - Y[i], 1e-6);
+    for (size_t j = 0; j < 4; ++j) {
+      ASSERT_NEAR(layer.test_deltaW().at(j, i), (A[i] - Y[i]) * X[j], 1e-6);
+    }
+  }
+}
@@ -2,6 +2,7 @@
 #include "mock_gpu_layer.hpp"
 #include "mock_cpu_layer.hpp"
 #include <richard/cpu/convolutional_layer.hpp>
+#include <richard/cpu/optimizer.hpp>
 #include <richard/gpu/convolutional_layer.hpp>
 #include <richard/gpu/gpu.hpp>
 #include <richard/file_system.hpp>
@@ -139,6 +140,111 @@ TEST_F(GpuConvolutionalLayerTest, trainForward) {
   }
 }
 
+TEST_F(GpuConvolutionalLayerTest, trainForwardWithStrideAndPadding) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  Array3 inputs({
+    {
+      { 0.f, 1.f, 2.f, 3.f },
+      { 5.f, 6.f, 7.f, 8.f },
+      { 8.f, 7.f, 6.f, 5.f },
+      { 1.f, 3.f, 5.f, 7.f }
+    }, {
+      { 5.f, 4.f, 3.f, 2.f },
+      { 2.f, 1.f, 0.f, 1.f },
+      { 1.f, 2.f, 5.f, 8.f },
+      { 9.f, 6.f, 3.f, 0.f }
+    }
+  });
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(inputs.size() * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  Config config;
+  config.setNumber("depth", 2);
+  config.setNumberArray<size_t>("kernelSize", { 2, 2 });
+  config.setNumber("learnRate", 1.0);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+  config.setNumber("stride", 2);
+  config.setNumber("padding", 1);
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::ConvolutionalLayer layer(*gpu, *fileSystem, *platformPaths, config, { 4, 4, 2 }, true);
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 3, 3, 2 }));
+
+  cpu::ConvolutionalLayer::Filter filter0;
+  filter0.K = Kernel({
+    {
+      { 5.f, 3.f },
+      { 1.f, 2.f }
+    }, {
+      { 8.f, 4.f },
+      { 5.f, 3.f }
+    }
+  });
+  filter0.b = 7.f;
+
+  cpu::ConvolutionalLayer::Filter filter1;
+  filter1.K = Kernel({
+    {
+      { 2.f, 4.f },
+      { 5.f, 6.f }
+    }, {
+      { 4.f, 1.f },
+      { 2.f, 9.f }
+    }
+  });
+  filter1.b = 3.f;
+
+  DataArray kernelData = DataArray::concat({ filter0.K.storage(), filter1.K.storage() });
+  Vector biasData{ filter0.b, filter1.b };
+
+  layer.test_setKernels(kernelData);
+  layer.test_setBiases(biasData.storage());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(0));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
+
+  layer.trainForward();
+  gpu->flushQueue();
+
+  Array3 A(layer.outputSize());
+  gpu->retrieveBuffer(layer.outputBuffer(), A.data());
+
+  Array3 expectedA(cpuConvolutionalLayerTrainForward(config, { filter0, filter1 }, inputs),
+    layer.outputSize());
+
+  for (size_t k = 0; k < expectedA.D(); ++k) {
+    for (size_t j = 0; j < expectedA.H(); ++j) {
+      for (size_t i = 0; i < expectedA.W(); ++i) {
+        EXPECT_NEAR(A.at(i, j, k), expectedA.at(i, j, k), FLOAT_TOLERANCE);
+      }
+    }
+  }
+}
+
 void cpuConvolutionalLayerBackprop(const Config& config,
   const std::vector<cpu::ConvolutionalLayer::Filter>& filters, const Array3& inputs,
   const Vector& dA, std::vector<Kernel>& deltaK, Vector& deltaB) {
@@ -423,3 +529,101 @@ TEST_F(GpuConvolutionalLayerTest, updateParams) {
     EXPECT_NEAR(actualB[i], expectedB[i], FLOAT_TOLERANCE);
   }
 }
+
+TEST_F(GpuConvolutionalLayerTest, updateParamsWithOptimizersMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 1;
+  status.sampleIndex = 0;
+
+  size_t layerDepth = 2;
+  netfloat_t learnRate = 0.47f;
+  netfloat_t learnRateDecay = 0.9f;
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  Vector K({
+    0.5f, 0.3f, 0.1f, 0.2f, 0.8f, 0.4f, 0.5f, 0.3f,
+    0.2f, 0.4f, 0.5f, 0.6f, 0.4f, 0.1f, 0.2f, 0.9f
+  });
+
+  Vector B{ 9.f, 5.f };
+
+  Vector deltaK({
+    0.1f, -0.2f, 0.6f, 0.4f, 0.8f, 0.7f, -0.5f, 0.8f,
+    0.1f, 0.5f, 0.9f, -0.7f, 0.3f, 0.2f, 0.3f, 0.6f
+  });
+
+  Vector deltaB{ 6.f, -2.f };
+
+  for (std::string type : { "momentum", "nesterov", "rmsProp", "adam" }) {
+    Config optimizerConfig;
+    optimizerConfig.setString("type", type);
+
+    Config config;
+    config.setNumber("depth", layerDepth);
+    config.setNumberArray<size_t>("kernelSize", { 2, 2 });
+    config.setNumber("learnRate", learnRate);
+    config.setNumber("learnRateDecay", learnRateDecay);
+    config.setNumber("dropoutRate", 0.0);
+    config.setObject("optimizer", optimizerConfig);
+
+    gpu::ConvolutionalLayer layer(*gpu, *fileSystem, *platformPaths, config, { 3, 3, 2 },
+      true);
+
+    layer.test_setKernels(K.storage());
+    layer.test_setBiases(B.storage());
+
+    testing::NiceMock<MockGpuLayer> nextLayer;
+
+    layer.allocateGpuBuffers();
+    layer.createGpuShaders(0, statusBuffer.handle, &nextLayer, 0);
+
+    OptimizerParams params(optimizerConfig);
+    cpu::Optimizer optimizerK(params, K.size());
+    cpu::Optimizer optimizerB(params, B.size());
+
+    Vector expectedK = K;
+    Vector expectedB = B;
+
+    // Two steps, so the moments carried between updates are exercised too
+    for (size_t step = 0; step < 2; ++step) {
+      gpu->submitBufferData(layer.test_deltaKBuffer(), deltaK.data());
+      gpu->submitBufferData(layer.test_deltaBBuffer(), deltaB.data());
+
+      layer.updateParams();
+      gpu->flushQueue();
+
+      Vector gradK = deltaK;
+      Vector gradB = deltaB;
+
+      optimizerK.nextStep(learnRate * learnRateDecay);
+      optimizerK.update(expectedK.data(), gradK.data(), gradK.size());
+      optimizerB.nextStep(learnRate * learnRateDecay);
+      optimizerB.update(expectedB.data(), gradB.data(), gradB.size());
+    }
+
+    layer.retrieveBuffers();
+
+    const DataArray& actualK = layer.test_kernels();
+    const Vector& actualB = layer.test_biases();
+
+    ASSERT_EQ(expectedK.size(), actualK.size());
+
+    for (size_t i = 0; i < expectedK.size(); ++i) {
+      EXPECT_NEAR(actualK[i], expectedK[i], FLOAT_TOLERANCE) << type;
+    }
+
+    for (size_t i = 0; i < expectedB.size(); ++i) {
+      EXPECT_NEAR(actualB[i], expectedB[i], FLOAT_TOLERANCE) << type;
+    }
+  }
+}
@@ -2,11 +2,13 @@
 #include "mock_gpu_layer.hpp"
 #include "mock_cpu_layer.hpp"
 #include <richard/cpu/dense_layer.hpp>
+#include <richard/cpu/optimizer.hpp>
 #include <richard/gpu/dense_layer.hpp>
 #include <richard/gpu/gpu.hpp>
 #include <richard/file_system.hpp>
 #include <richard/platform_paths.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
 
 using namespace richard;
 
@@ -88,8 +90,7 @@ TEST_F(GpuDenseLayerTest, trainForward) {
   layer.test_setBiases(B.storage());
 
   testing::NiceMock<MockGpuLayer> nextLayer;
-  ON_CALL(nextLayer, weightsBuffer).WillByDefault(testing::Return(0));
-  ON_CALL(nextLayer, deltaBuffer).WillByDefault(testing::Return(0));
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(0));
 
   layer.allocateGpuBuffers();
   layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
@@ -107,6 +108,70 @@ TEST_F(GpuDenseLayerTest, trainForward) {
   }
 }
 
+TEST_F(GpuDenseLayerTest, evalForward) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  const size_t layerSize = 2;
+  const size_t layerInputSize = 4;
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(layerInputSize * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  Vector inputs{ 0.5f, -0.4f, 0.3f, 0.2f };
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  Config config;
+  config.setNumber("size", layerSize);
+  config.setNumber("learnRate", 0.1);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setNumber("dropoutRate", 0.0);
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::DenseLayer layer(*gpu, *fileSystem, *platformPaths, config, layerInputSize, true);
+
+  Matrix W({
+    { 0.1f, 0.2f, 0.3f, 0.4f },
+    { -0.5f, 0.4f, 0.3f, 0.2f }
+  });
+
+  Vector B({ 0.7f, -0.8f });
+
+  layer.test_setWeights(W.storage());
+  layer.test_setBiases(B.storage());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
+
+  layer.evalForward();
+  gpu->flushQueue();
+
+  Vector A(layerSize);
+  gpu->retrieveBuffer(layer.outputBuffer(), A.data());
+
+  cpu::DenseLayer cpuLayer(config, layerInputSize);
+  cpuLayer.test_setWeights(W.storage());
+  cpuLayer.test_setBiases(B.storage());
+
+  DataArray expectedA = cpuLayer.evalForward(inputs.storage());
+
+  for (size_t i = 0; i < A.size(); ++i) {
+    EXPECT_NEAR(A[i], expectedA[i], FLOAT_TOLERANCE);
+  }
+}
+
 void cpuDenseLayerBackprop(const Config& config, const Matrix& W, const Vector& B,
   const Vector& inputs, const Vector& dA, Matrix& deltaW, Vector& deltaB) {
 
@@ -158,11 +223,10 @@ TEST_F(GpuDenseLayerTest, backprop) {
 
   GpuBufferFlags bufferFlags = GpuBufferFlags::large | GpuBufferFlags::hostWriteAccess;
 
-  GpuBuffer nextBufferW = gpu->allocateBuffer(nextW.size() * sizeof(netfloat_t), bufferFlags);
-  GpuBuffer nextBufferD = gpu->allocateBuffer(nextDelta.size() * sizeof(netfloat_t), bufferFlags);
+  GpuBuffer nextBufferInputDelta = gpu->allocateBuffer(dA.size() * sizeof(netfloat_t),
+    bufferFlags);
 
-  gpu->submitBufferData(nextBufferW.handle, nextW.data());
-  gpu->submitBufferData(nextBufferD.handle, nextDelta.data());
+  gpu->submitBufferData(nextBufferInputDelta.handle, dA.data());
 
   Config config;
   config.setNumber("size", layerSize);
@@ -183,9 +247,8 @@ TEST_F(GpuDenseLayerTest, backprop) {
   Vector B({ 0.7f, 0.8f });
 
   testing::NiceMock<MockGpuLayer> nextLayer;
-  ON_CALL(nextLayer, weightsBuffer).WillByDefault(testing::Return(nextBufferW.handle));
-  ON_CALL(nextLayer, deltaBuffer).WillByDefault(testing::Return(nextBufferD.handle));
-  ON_CALL(nextLayer, size).WillByDefault(testing::Return(nextDelta.size()));
+  ON_CALL(nextLayer, inputDeltaBuffer)
+    .WillByDefault(testing::Return(nextBufferInputDelta.handle));
 
   layer.test_setWeights(W.storage());
   layer.test_setBiases(B.storage());
@@ -311,3 +374,144 @@ TEST_F(GpuDenseLayerTest, updateParams) {
     EXPECT_NEAR(actualB[i], expectedB[i], FLOAT_TOLERANCE);
   }
 }
+
+TEST_F(GpuDenseLayerTest, updateParamsWithOptimizersMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 1;
+  status.sampleIndex = 0;
+
+  const size_t layerInputSize = 4;
+  const size_t layerSize = 2;
+  const netfloat_t learnRate = 0.1f;
+  const netfloat_t learnRateDecay = 0.9f;
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  Matrix W({
+    { 0.1f, 0.2f, 0.3f, 0.4f },
+    { 0.5f, 0.4f, 0.3f, 0.2f }
+  });
+
+  Vector B({ 0.7f, 0.8f });
+
+  Matrix deltaW({
+    { 0.5f, -0.3f, 0.7f, 0.1f },
+    { 0.8f, 0.6f, -0.2f, 0.9f }
+  });
+
+  Vector deltaB({ 0.5f, -0.1f });
+
+  for (std::string type : { "momentum", "nesterov", "rmsProp", "adam" }) {
+    Config optimizerConfig;
+    optimizerConfig.setString("type", type);
+
+    Config config;
+    config.setNumber("size", layerSize);
+    config.setNumber("learnRate", learnRate);
+    config.setNumber("learnRateDecay", learnRateDecay);
+    config.setNumber("dropoutRate", 0.0);
+    config.setObject("optimizer", optimizerConfig);
+
+    gpu::DenseLayer layer(*gpu, *fileSystem, *platformPaths, config, layerInputSize, true);
+
+    layer.test_setWeights(W.storage());
+    layer.test_setBiases(B.storage());
+
+    testing::NiceMock<MockGpuLayer> nextLayer;
+
+    layer.allocateGpuBuffers();
+    layer.createGpuShaders(0, statusBuffer.handle, &nextLayer, 0);
+
+    OptimizerParams params(optimizerConfig);
+    cpu::Optimizer optimizerW(params, W.size());
+    cpu::Optimizer optimizerB(params, B.size());
+
+    Matrix expectedW = W;
+    Vector expectedB = B;
+
+    // Two steps, so the moments carried between updates are exercised too
+    for (size_t step = 0; step < 2; ++step) {
+      gpu->submitBufferData(layer.test_deltaWBuffer(), deltaW.data());
+      gpu->submitBufferData(layer.test_deltaBBuffer(), deltaB.data());
+
+      layer.updateParams();
+      gpu->flushQueue();
+
+      Matrix gradW = deltaW;
+      Vector gradB = deltaB;
+
+      optimizerW.nextStep(learnRate * learnRateDecay);
+      optimizerW.update(expectedW.data(), gradW.data(), gradW.size());
+      optimizerB.nextStep(learnRate * learnRateDecay);
+      optimizerB.update(expectedB.data(), gradB.data(), gradB.size());
+    }
+
+    layer.retrieveBuffers();
+
+    const Matrix& actualW = layer.test_W();
+    const Vector& actualB = layer.test_B();
+
+    for (size_t j = 0; j < expectedW.rows(); ++j) {
+      for (size_t i = 0; i < expectedW.cols(); ++i) {
+        EXPECT_NEAR(actualW.at(i, j), expectedW.at(i, j), FLOAT_TOLERANCE) << type;
+      }
+    }
+
+    for (size_t i = 0; i < expectedB.size(); ++i) {
+      EXPECT_NEAR(actualB[i], expectedB[i], FLOAT_TOLERANCE) << type;
+    }
+  }
+}
+
+TEST_F(GpuDenseLayerTest, packedWeightsRoundTripThroughCpuFormat) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  Matrix W({
+    { 0.2f, 0.3f, 0.4f, 0.123456f },
+    { 0.5f, 0.4f, 0.3f, 0.654321f }
+  });
+
+  Vector B({ 0.7f, 0.8f });
+
+  for (std::string storageType : { "fp32", "bf16", "fp16" }) {
+    Config config;
+    config.setNumber("size", 2);
+    config.setNumber("learnRate", 0.1);
+    config.setNumber("learnRateDecay", 1.0);
+    config.setNumber("dropoutRate", 0.0);
+    config.setString("storageType", storageType);
+
+    cpu::DenseLayer cpuLayer(config, 4);
+    cpuLayer.test_setWeights(W.storage());
+    cpuLayer.test_setBiases(B.storage());
+
+    std::stringstream cpuStream;
+    cpuLayer.writeToStream(cpuStream);
+
+    gpu::DenseLayer gpuLayer(*gpu, *fileSystem, *platformPaths, config, cpuStream, 4, false);
+
+    // The weights are widened from the storage format, as the CPU layer does
+    cpuStream.seekg(0);
+    cpu::DenseLayer reloaded(config, cpuStream, 4);
+    ASSERT_EQ(gpuLayer.test_W(), reloaded.test_W()) << storageType;
+    ASSERT_EQ(gpuLayer.test_B(), B) << storageType;
+
+    std::stringstream gpuStream;
+    gpuLayer.writeToStream(gpuStream);
+
+    ASSERT_EQ(gpuStream.str(), cpuStream.str()) << storageType;
+  }
+}
@@ -0,0 +1,276 @@
+#include "mock_logger.hpp"
+#include "mock_gpu_layer.hpp"
+#include <richard/cpu/depthwise_separable_layer.hpp>
+#include <richard/cpu/optimizer.hpp>
+#include <richard/gpu/depthwise_separable_layer.hpp>
+#include <richard/gpu/gpu.hpp>
+#include <richard/file_system.hpp>
+#include <richard/platform_paths.hpp>
+#include <richard/config.hpp>
+#include <richard/utils.hpp>
+#include <gtest/gtest.h>
+
+using namespace richard;
+
+using richard::gpu::GpuPtr;
+using richard::gpu::GpuBuffer;
+using richard::gpu::GpuBufferFlags;
+
+const double FLOAT_TOLERANCE = 0.0001;
+
+struct StatusBuffer {
+  uint32_t epoch;
+  uint32_t sampleIndex;
+};
+
+class GpuDepthwiseSeparableLayerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+
+    Config layerConfig() const {
+      Config config;
+      config.setNumber("depth", 3);
+      config.setNumberArray<size_t>("kernelSize", { 3, 3 });
+      config.setNumber("learnRate", 0.1);
+      config.setNumber("learnRateDecay", 1.0);
+      config.setNumber("dropoutRate", 0.0);
+      config.setNumber("stride", 2);
+      config.setNumber("padding", 1);
+      return config;
+    }
+
+    // Biases large enough to keep every ReLU active
+    std::vector<cpu::ConvolutionalLayer::Filter> pointwiseFilters(size_t inputDepth) const {
+      std::vector<cpu::ConvolutionalLayer::Filter> filters;
+      for (size_t i = 0; i < 3; ++i) {
+        filters.push_back({ Kernel(1, 1, inputDepth), 10.f });
+        filters.back().K.randomize(1.0);
+      }
+      return filters;
+    }
+
+    DataArray kernelData(const std::vector<cpu::ConvolutionalLayer::Filter>& filters) const {
+      const size_t kernelSize = filters.front().K.size();
+
+      DataArray kernels(filters.size() * kernelSize);
+      for (size_t i = 0; i < filters.size(); ++i) {
+        std::copy(filters[i].K.data(), filters[i].K.data() + kernelSize,
+          kernels.data() + i * kernelSize);
+      }
+      return kernels;
+    }
+
+    Vector biasData(const std::vector<cpu::ConvolutionalLayer::Filter>& filters) const {
+      Vector biases(filters.size());
+      for (size_t i = 0; i < filters.size(); ++i) {
+        biases[i] = filters[i].b;
+      }
+      return biases;
+    }
+};
+
+TEST_F(GpuDepthwiseSeparableLayerTest, evalForwardMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  Array3 inputs(5, 4, 2);
+  inputs.randomize(1.0);
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(inputs.size() * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  Kernel depthwise(3, 3, 2);
+  depthwise.randomize(1.0);
+  auto pointwise = pointwiseFilters(2);
+
+  Config config = layerConfig();
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::DepthwiseSeparableLayer layer(*gpu, *fileSystem, *platformPaths, config, inputs.shape(),
+    false);
+  layer.test_setDepthwiseKernels(depthwise.storage());
+  layer.test_pointwise().test_setKernels(kernelData(pointwise));
+  layer.test_pointwise().test_setBiases(biasData(pointwise).storage());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(0));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
+
+  layer.evalForward();
+  gpu->flushQueue();
+
+  Vector Y(layer.size());
+  gpu->retrieveBuffer(layer.outputBuffer(), Y.data());
+
+  cpu::DepthwiseSeparableLayer cpuLayer(config, inputs.shape());
+  cpuLayer.test_setDepthwiseKernels(depthwise.storage());
+  cpuLayer.test_pointwise().test_setFilters(pointwise);
+
+  DataArray expected = cpuLayer.evalForward(inputs.storage());
+
+  ASSERT_EQ(Y.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(Y[i], expected[i], FLOAT_TOLERANCE);
+  }
+}
+
+TEST_F(GpuDepthwiseSeparableLayerTest, backpropMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  Array3 inputs(5, 4, 2);
+  inputs.randomize(1.0);
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(inputs.size() * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  Kernel depthwise(3, 3, 2);
+  depthwise.randomize(1.0);
+  auto pointwise = pointwiseFilters(2);
+
+  Config config = layerConfig();
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::DepthwiseSeparableLayer layer(*gpu, *fileSystem, *platformPaths, config, inputs.shape(),
+    true);
+  layer.test_setDepthwiseKernels(depthwise.storage());
+  layer.test_pointwise().test_setKernels(kernelData(pointwise));
+  layer.test_pointwise().test_setBiases(biasData(pointwise).storage());
+
+  Vector dA(calcProduct(layer.outputSize()));
+  dA.randomize(1.0);
+
+  GpuBuffer bufferDeltaA = gpu->allocateBuffer(dA.size() * sizeof(netfloat_t), inputBufferFlags);
+  gpu->submitBufferData(bufferDeltaA.handle, dA.data());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(bufferDeltaA.handle));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
+
+  layer.trainForward();
+  layer.backprop();
+  gpu->flushQueue();
+
+  Vector inputDelta(inputs.size());
+  gpu->retrieveBuffer(layer.inputDeltaBuffer(), inputDelta.data());
+
+  Vector deltaK(depthwise.size());
+  gpu->retrieveBuffer(layer.test_deltaKBuffer(), deltaK.data());
+
+  cpu::DepthwiseSeparableLayer cpuLayer(config, inputs.shape());
+  cpuLayer.test_setDepthwiseKernels(depthwise.storage());
+  cpuLayer.test_pointwise().test_setFilters(pointwise);
+
+  cpuLayer.trainForward(inputs.storage());
+  cpuLayer.updateDeltas(inputs.storage(), dA.storage());
+
+  for (size_t i = 0; i < inputDelta.size(); ++i) {
+    EXPECT_NEAR(inputDelta[i], cpuLayer.inputDelta()[i], FLOAT_TOLERANCE);
+  }
+
+  for (size_t i = 0; i < deltaK.size(); ++i) {
+    EXPECT_NEAR(deltaK[i], cpuLayer.test_depthwiseDeltas().data()[i], FLOAT_TOLERANCE);
+  }
+}
+
+TEST_F(GpuDepthwiseSeparableLayerTest, updateParamsMatchesCpuOptimizer) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  const Size3 inputShape{ 5, 4, 2 };
+
+  Kernel depthwise(3, 3, 2);
+  depthwise.randomize(1.0);
+  Kernel deltaK(3, 3, 2);
+  deltaK.randomize(1.0);
+  auto pointwise = pointwiseFilters(2);
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  for (std::string type : { "sgd", "adam" }) {
+    Config optimizerConfig;
+    optimizerConfig.setString("type", type);
+
+    Config config = layerConfig();
+    config.setObject("optimizer", optimizerConfig);
+
+    gpu::DepthwiseSeparableLayer layer(*gpu, *fileSystem, *platformPaths, config, inputShape,
+      true);
+    layer.test_setDepthwiseKernels(depthwise.storage());
+    layer.test_pointwise().test_setKernels(kernelData(pointwise));
+    layer.test_pointwise().test_setBiases(biasData(pointwise).storage());
+
+    testing::NiceMock<MockGpuLayer> nextLayer;
+
+    layer.allocateGpuBuffers();
+    layer.createGpuShaders(0, statusBuffer.handle, &nextLayer, 0);
+
+    cpu::Optimizer optimizer(OptimizerParams(optimizerConfig), depthwise.size());
+    Kernel expectedK = depthwise;
+
+    // Two steps, so the moments carried between updates are exercised too
+    for (size_t step = 0; step < 2; ++step) {
+      gpu->submitBufferData(layer.test_deltaKBuffer(), deltaK.data());
+
+      layer.updateParams();
+      gpu->flushQueue();
+
+      Kernel gradK = deltaK;
+      optimizer.nextStep(0.1f);
+      optimizer.update(expectedK.data(), gradK.data(), gradK.size());
+    }
+
+    layer.retrieveBuffers();
+
+    const Vector& actualK = layer.test_depthwiseKernels();
+
+    ASSERT_EQ(actualK.size(), expectedK.size());
+
+    for (size_t i = 0; i < expectedK.size(); ++i) {
+      EXPECT_NEAR(actualK[i], expectedK.data()[i], FLOAT_TOLERANCE) << type;
+    }
+  }
+}
@@ -0,0 +1,109 @@
+#include "mock_logger.hpp"
+#include "mock_gpu_layer.hpp"
+#include <richard/cpu/global_average_pooling_layer.hpp>
+#include <richard/gpu/global_average_pooling_layer.hpp>
+#include <richard/gpu/gpu.hpp>
+#include <richard/file_system.hpp>
+#include <richard/platform_paths.hpp>
+#include <richard/config.hpp>
+#include <gtest/gtest.h>
+
+using namespace richard;
+
+using richard::gpu::GpuPtr;
+using richard::gpu::GpuBuffer;
+using richard::gpu::GpuBufferFlags;
+
+const double FLOAT_TOLERANCE = 0.0001;
+
+class GpuGlobalAveragePoolingLayerTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(GpuGlobalAveragePoolingLayerTest, evalForwardMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  Array3 inputs({
+    {
+      { 0.5f, -0.2f, 0.3f },
+      { 0.1f, 0.9f, -0.4f }
+    }, {
+      { -0.7f, 0.3f, 0.6f },
+      { 0.4f, -0.6f, 0.8f }
+    }
+  });
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(inputs.size() * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::GlobalAveragePoolingLayer layer(*gpu, *fileSystem, *platformPaths, Config{},
+    inputs.shape());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(0));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, 0, &nextLayer, 0);
+
+  layer.evalForward();
+  gpu->flushQueue();
+
+  Vector A(2);
+  gpu->retrieveBuffer(layer.outputBuffer(), A.data());
+
+  cpu::GlobalAveragePoolingLayer cpuLayer(Config{}, inputs.shape());
+  DataArray expected = cpuLayer.evalForward(inputs.storage());
+
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(A[i], expected[i], FLOAT_TOLERANCE);
+  }
+}
+
+TEST_F(GpuGlobalAveragePoolingLayerTest, backpropMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  Vector deltaA({ 3.f, -1.5f });
+
+  GpuBuffer deltaABuffer = gpu->allocateBuffer(deltaA.size() * sizeof(netfloat_t),
+    GpuBufferFlags::large | GpuBufferFlags::hostWriteAccess);
+
+  gpu->submitBufferData(deltaABuffer.handle, deltaA.data());
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::GlobalAveragePoolingLayer layer(*gpu, *fileSystem, *platformPaths, Config{}, { 3, 2, 2 });
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, inputDeltaBuffer).WillByDefault(testing::Return(deltaABuffer.handle));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(0, 0, &nextLayer, 0);
+
+  layer.backprop();
+  gpu->flushQueue();
+
+  Array3 inputDelta(3, 2, 2);
+  gpu->retrieveBuffer(layer.inputDeltaBuffer(), inputDelta.data());
+
+  Array3 inputs(3, 2, 2);
+  cpu::GlobalAveragePoolingLayer cpuLayer(Config{}, { 3, 2, 2 });
+  cpuLayer.trainForward(inputs.storage());
+  cpuLayer.updateDeltas(inputs.storage(), deltaA.storage());
+
+  for (size_t i = 0; i < inputDelta.size(); ++i) {
+    EXPECT_NEAR(inputDelta.data()[i], cpuLayer.inputDelta()[i], FLOAT_TOLERANCE);
+  }
+}
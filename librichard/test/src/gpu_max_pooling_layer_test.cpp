@@ -28,13 +28,13 @@ class GpuMaxPoolingLayerTest : public testing::Test {
 };
 
 void cpuMaxPoolingLayerTrainForward(const Config& config, const Array3& inputs,
-  Array3& activations, Array3& mask) {
+  Array3& activations, std::vector<uint32_t>& argmax) {
 
   cpu::MaxPoolingLayer layer(config, inputs.shape());
 
   layer.trainForward(inputs.storage());
 
-  mask = layer.test_mask();
+  argmax = layer.test_argmax();
   activations = Array3(layer.activations(), { 2, 2, 2 });
 }
 
@@ -94,12 +94,12 @@ TEST_F(GpuMaxPoolingLayerTest, trainForward) {
   Array3 A(2, 2, 2);
   gpu->retrieveBuffer(layer.outputBuffer(), A.data());
 
-  Array3 mask(4, 4, 2);
-  gpu->retrieveBuffer(layer.test_maskBuffer(), mask.data());
+  std::vector<uint32_t> argmax(A.size());
+  gpu->retrieveBuffer(layer.test_argmaxBuffer(), argmax.data());
 
   Array3 expectedA;
-  Array3 expectedMask;
-  cpuMaxPoolingLayerTrainForward(config, inputs, expectedA, expectedMask);
+  std::vector<uint32_t> expectedArgmax;
+  cpuMaxPoolingLayerTrainForward(config, inputs, expectedA, expectedArgmax);
 
   EXPECT_EQ(A.shape(), expectedA.shape());
 
@@ -111,23 +111,99 @@ TEST_F(GpuMaxPoolingLayerTest, trainForward) {
     }
   }
 
-  EXPECT_EQ(mask.shape(), expectedMask.shape());
+  EXPECT_EQ(argmax, expectedArgmax);
+}
 
-  for (size_t k = 0; k < mask.D(); ++k) {
-    for (size_t j = 0; j < mask.H(); ++j) {
-      for (size_t i = 0; i < mask.W(); ++i) {
-        EXPECT_NEAR(mask.at(i, j, k), expectedMask.at(i, j, k), FLOAT_TOLERANCE);
-      }
+TEST_F(GpuMaxPoolingLayerTest, evalAndTrainForwardWithOverlappingStrideMatchCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  Array3 inputs({
+    {
+      { 6.f, 0.f, 1.f, 2.f, 4.f },
+      { 5.f, 5.f, 6.f, 7.f, 1.f },
+      { 3.f, 8.f, 7.f, 6.f, 9.f },
+      { 2.f, 6.f, 3.f, 1.f, 0.f },
+      { 1.f, 4.f, 5.f, 2.f, 3.f }
+    }, {
+      { 9.f, 5.f, 4.f, 3.f, 2.f },
+      { 7.f, 2.f, 1.f, 0.f, 8.f },
+      { 4.f, 1.f, 2.f, 5.f, 3.f },
+      { 2.f, 8.f, 4.f, 6.f, 1.f },
+      { 0.f, 3.f, 7.f, 5.f, 6.f }
     }
+  });
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(inputs.size() * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  // 3x3 regions two apart overlap by a row and a column
+  Config config;
+  config.setNumberArray<size_t>("regionSize", { 3, 3 });
+  config.setNumberArray<size_t>("stride", { 2, 2 });
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::MaxPoolingLayer layer(*gpu, *fileSystem, *platformPaths, config, inputs.shape());
+
+  testing::NiceMock<MockGpuLayer> nextLayer;
+  ON_CALL(nextLayer, deltaBuffer).WillByDefault(testing::Return(0));
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, &nextLayer, 0);
+
+  ASSERT_EQ(layer.outputSize(), Size3({ 2, 2, 2 }));
+
+  cpu::MaxPoolingLayer cpuLayer(config, inputs.shape());
+
+  layer.evalForward();
+  gpu->flushQueue();
+
+  Vector evalA(8);
+  gpu->retrieveBuffer(layer.outputBuffer(), evalA.data());
+
+  DataArray expectedEvalA = cpuLayer.evalForward(inputs.storage());
+
+  layer.trainForward();
+  gpu->flushQueue();
+
+  Vector trainA(8);
+  gpu->retrieveBuffer(layer.outputBuffer(), trainA.data());
+
+  std::vector<uint32_t> argmax(8);
+  gpu->retrieveBuffer(layer.test_argmaxBuffer(), argmax.data());
+
+  cpuLayer.trainForward(inputs.storage());
+
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_NEAR(evalA[i], expectedEvalA[i], FLOAT_TOLERANCE);
+    EXPECT_NEAR(trainA[i], cpuLayer.activations()[i], FLOAT_TOLERANCE);
   }
+
+  EXPECT_EQ(argmax, cpuLayer.test_argmax());
 }
 
-void cpuMaxPoolingLayerBackprop(const Config& config, const Array3& mask,
+void cpuMaxPoolingLayerBackprop(const Config& config, const std::vector<uint32_t>& argmax,
   const Array3& outputDelta, Array3& inputDelta) {
 
   cpu::MaxPoolingLayer layer(config, { 4, 4, 2 });
 
-  layer.test_setMask(mask);
+  layer.test_setArgmax(argmax);
   layer.updateDeltas(DataArray(), outputDelta.storage());
   
   inputDelta = Array3(layer.inputDelta(), 4, 4, 2);
@@ -137,19 +213,14 @@ TEST_F(GpuMaxPoolingLayerTest, backprop) {
   testing::NiceMock<MockLogger> logger;
   GpuPtr gpu = gpu::createGpu(logger);
 
-  Array3 mask({
-    {
-      { 0.f, 0.f, 0.f, 1.f },
-      { 1.f, 0.f, 0.f, 0.f },
-      { 0.f, 1.f, 0.f, 0.f },
-      { 0.f, 0.f, 0.f, 1.f }
-    },{
-      { 0.f, 1.f, 0.f, 0.f },
-      { 0.f, 0.f, 1.f, 0.f },
-      { 0.f, 0.f, 0.f, 1.f },
-      { 1.f, 0.f, 0.f, 0.f }
-    }
-  });
+  // Offsets within each input slice
+  std::vector<uint32_t> argmax{
+    4, 3,
+    9, 15,
+
+    1, 6,
+    12, 11
+  };
 
   Array3 deltaA({
     {
@@ -179,7 +250,7 @@ TEST_F(GpuMaxPoolingLayerTest, backprop) {
 
   layer.allocateGpuBuffers();
 
-  gpu->submitBufferData(layer.test_maskBuffer(), mask.data());
+  gpu->submitBufferData(layer.test_argmaxBuffer(), argmax.data());
 
   layer.createGpuShaders(0, 0, &nextLayer, 0);
 
@@ -190,7 +261,7 @@ TEST_F(GpuMaxPoolingLayerTest, backprop) {
   gpu->retrieveBuffer(layer.inputDeltaBuffer(), inputDelta.data());
 
   Array3 expectedInputDelta;
-  cpuMaxPoolingLayerBackprop(config, mask, deltaA, expectedInputDelta);
+  cpuMaxPoolingLayerBackprop(config, argmax, deltaA, expectedInputDelta);
 
   EXPECT_EQ(inputDelta.shape(), expectedInputDelta.shape());
 
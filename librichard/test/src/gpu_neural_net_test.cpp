@@ -11,6 +11,10 @@
 #include <richard/gpu/max_pooling_layer.hpp>
 #include <richard/gpu/output_layer.hpp>
 #include <richard/gpu/gpu.hpp>
+#include <richard/gpu/gpu_neural_net.hpp>
+#include <richard/event_system.hpp>
+#include <richard/config.hpp>
+#include <richard/exception.hpp>
 #include <gtest/gtest.h>
 
 using namespace richard;
@@ -552,3 +556,35 @@ TEST_F(GpuNeuralNetTest, simpleConvNetwork) {
     EXPECT_NEAR(actualB2[i], expectedB2[i], FLOAT_TOLERANCE);
   }
 }
+
+TEST_F(GpuNeuralNetTest, batchNormIsRejected) {
+  const std::string configString =     ""
+  "{                                    "
+  "  \"hyperparams\": {                 "
+  "      \"epochs\": 1,                 "
+  "      \"batchSize\": 1,              "
+  "      \"miniBatchSize\": 1           "
+  "  },                                 "
+  "  \"hiddenLayers\": [                "
+  "      {                              "
+  "          \"type\": \"batchNorm\",   "
+  "          \"learnRate\": 0.1,        "
+  "          \"learnRateDecay\": 1.0    "
+  "      }                              "
+  "  ],                                 "
+  "  \"outputLayer\": {                 "
+  "      \"size\": 2,                   "
+  "      \"learnRate\": 0.1,            "
+  "      \"learnRateDecay\": 1.0        "
+  "  }                                  "
+  "}                                    ";
+
+  testing::NiceMock<MockLogger> logger;
+  EventSystemPtr eventSystem = createEventSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  Config config = Config::fromJson(configString);
+
+  ASSERT_THROW(gpu::createNeuralNet({ 4, 1, 1 }, config, *eventSystem, *m_fileSystem,
+    *platformPaths, logger), Exception);
+}
@@ -210,3 +210,178 @@ TEST_F(GpuOutputLayerTest, backprop) {
     EXPECT_NEAR(deltaB[i], expectedDeltaB[i], FLOAT_TOLERANCE);
   }
 }
+
+TEST_F(GpuOutputLayerTest, crossEntropyForwardMatchesCpu) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  const size_t layerInputSize = 4;
+  const size_t outputSize = 3;
+
+  GpuBufferFlags bufferYFlags = GpuBufferFlags::frequentHostAccess
+                              | GpuBufferFlags::large
+                              | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer bufferY = gpu->allocateBuffer(outputSize * sizeof(netfloat_t), bufferYFlags);
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(layerInputSize * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  Vector inputs{ 0.5f, 0.4f, 0.3f, 0.2f };
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  Config config;
+  config.setNumber("size", outputSize);
+  config.setNumber("learnRate", 0.1);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setString("cost", "crossEntropy");
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::OutputLayer layer(*gpu, *fileSystem, *platformPaths, config, layerInputSize);
+
+  Matrix W({
+    { 0.1f, 0.2f, 0.3f, 0.4f },
+    { 0.5f, 0.4f, 0.3f, 0.2f },
+    { -0.6f, 0.9f, -0.1f, 0.3f }
+  });
+
+  Vector B({ 0.7f, 0.8f, -0.2f });
+
+  layer.test_setWeights(W.storage());
+  layer.test_setBiases(B.storage());
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, nullptr, bufferY.handle);
+
+  cpu::OutputLayer cpuLayer(config, layerInputSize);
+  cpuLayer.test_setWeights(W.storage());
+  cpuLayer.test_setBiases(B.storage());
+
+  layer.evalForward();
+  gpu->flushQueue();
+
+  Vector evalA(outputSize);
+  gpu->retrieveBuffer(layer.outputBuffer(), evalA.data());
+
+  DataArray expectedEvalA = cpuLayer.evalForward(inputs.storage());
+
+  layer.trainForward();
+  gpu->flushQueue();
+
+  Vector trainA(outputSize);
+  gpu->retrieveBuffer(layer.outputBuffer(), trainA.data());
+
+  cpuLayer.trainForward(inputs.storage());
+  const DataArray& expectedTrainA = cpuLayer.activations();
+
+  netfloat_t sum = 0.f;
+  for (size_t i = 0; i < outputSize; ++i) {
+    EXPECT_NEAR(evalA[i], expectedEvalA[i], FLOAT_TOLERANCE);
+    EXPECT_NEAR(trainA[i], expectedTrainA[i], FLOAT_TOLERANCE);
+    sum += trainA[i];
+  }
+
+  EXPECT_NEAR(sum, 1.0, FLOAT_TOLERANCE);
+}
+
+TEST_F(GpuOutputLayerTest, crossEntropyBackprop) {
+  testing::NiceMock<MockLogger> logger;
+  GpuPtr gpu = gpu::createGpu(logger);
+
+  GpuBufferFlags statusBufferFlags = GpuBufferFlags::frequentHostAccess
+                                   | GpuBufferFlags::hostReadAccess
+                                   | GpuBufferFlags::hostWriteAccess;
+  GpuBuffer statusBuffer = gpu->allocateBuffer(sizeof(StatusBuffer), statusBufferFlags);
+
+  const size_t layerInputSize = 4;
+  const size_t outputSize = 3;
+
+  Vector Y({ 0.f, 0.f, 1.f });
+
+  GpuBufferFlags bufferYFlags = GpuBufferFlags::frequentHostAccess
+                              | GpuBufferFlags::large
+                              | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer bufferY = gpu->allocateBuffer(Y.size() * sizeof(netfloat_t), bufferYFlags);
+  ASSERT_NE(bufferY.data, nullptr);
+
+  memcpy(bufferY.data, Y.data(), Y.size() * sizeof(netfloat_t));
+
+  GpuBufferFlags inputBufferFlags = GpuBufferFlags::large
+                                  | GpuBufferFlags::hostWriteAccess;
+
+  GpuBuffer inputBuffer = gpu->allocateBuffer(layerInputSize * sizeof(netfloat_t),
+    inputBufferFlags);
+
+  Vector inputs{ 0.5f, 0.4f, 0.3f, 0.2f };
+  gpu->submitBufferData(inputBuffer.handle, inputs.data());
+
+  StatusBuffer& status = *reinterpret_cast<StatusBuffer*>(statusBuffer.data);
+  status.epoch = 0;
+  status.sampleIndex = 0;
+
+  Config config;
+  config.setNumber("size", outputSize);
+  config.setNumber("learnRate", 0.1);
+  config.setNumber("learnRateDecay", 1.0);
+  config.setString("cost", "crossEntropy");
+
+  FileSystemPtr fileSystem = createFileSystem();
+  PlatformPathsPtr platformPaths = createPlatformPaths();
+
+  gpu::OutputLayer layer(*gpu, *fileSystem, *platformPaths, config, layerInputSize);
+
+  Matrix W({
+    { 0.1f, 0.2f, 0.3f, 0.4f },
+    { 0.5f, 0.4f, 0.3f, 0.2f },
+    { -0.6f, 0.9f, -0.1f, 0.3f }
+  });
+
+  Vector B({ 0.7f, 0.8f, -0.2f });
+
+  layer.test_setWeights(W.storage());
+  layer.test_setBiases(B.storage());
+
+  layer.allocateGpuBuffers();
+  layer.createGpuShaders(inputBuffer.handle, statusBuffer.handle, nullptr, bufferY.handle);
+
+  layer.trainForward();
+  layer.backprop();
+
+  gpu->flushQueue();
+
+  Matrix deltaW(W.cols(), W.rows());
+  Vector deltaB(B.size());
+
+  gpu->retrieveBuffer(layer.test_deltaWBuffer(), deltaW.data());
+  gpu->retrieveBuffer(layer.test_deltaBBuffer(), deltaB.data());
+
+  Matrix expectedDeltaW;
+  Vector expectedDeltaB;
+
+  cpuOutputLayerBackprop(config, W, B, inputs, Y, expectedDeltaW, expectedDeltaB);
+
+  for (size_t j = 0; j < deltaW.rows(); ++j) {
+    for (size_t i = 0; i < deltaW.cols(); ++i) {
+      EXPECT_NEAR(deltaW.at(i, j), expectedDeltaW.at(i, j), FLOAT_TOLERANCE);
+    }
+  }
+
+  for (size_t i = 0; i < deltaB.size(); ++i) {
+    EXPECT_NEAR(deltaB[i], expectedDeltaB[i], FLOAT_TOLERANCE);
+  }
+}
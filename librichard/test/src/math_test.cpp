@@ -1,4 +1,5 @@
 #include <richard/math.hpp>
+#include <richard/thread_pool.hpp>
 #include <gtest/gtest.h>
 
 using namespace richard;
@@ -803,6 +804,129 @@ TEST_F(MathTest, vectorMinusEqualsVectorMultiply) {
   ASSERT_EQ(a, Vector({ -5, -6, -7 }));
 }
 
+TEST_F(MathTest, vectorExpressionIntoShallowVector) {
+  DataArray data(3);
+  VectorPtr pV = Vector::createShallow(data);
+  Vector a{ 1, 2, 3 };
+  Vector b{ 4, 5, 6 };
+
+  *pV = (a + b) * 2.0 - 1.0;
+
+  ASSERT_EQ(*pV, Vector({ 9, 13, 17 }));
+  ASSERT_EQ(data[2], 17);
+}
+
+TEST_F(MathTest, vectorExpressionResizesDeepVector) {
+  Vector a{ 1, 2, 3 };
+  Vector v;
+
+  v = a / 2.0 + a;
+
+  ASSERT_EQ(v, Vector({ 1.5, 3, 4.5 }));
+}
+
+TEST_F(MathTest, vectorExpressionHoldsTemporaries) {
+  Matrix M({
+    { 1, 2 },
+    { 3, 4 }
+  });
+  Vector x{ 1, 1 };
+  Vector b{ 1, 2 };
+
+  auto e = M * x + b;
+  Vector y = e;
+
+  ASSERT_EQ(y, Vector({ 4, 9 }));
+  ASSERT_EQ(e.squareMagnitude(), 97);
+}
+
+TEST_F(MathTest, matrixMinusEqualsExpression) {
+  Matrix W({
+    { 1, 2 },
+    { 3, 4 }
+  });
+  Matrix dW({
+    { 2, 4 },
+    { 6, 8 }
+  });
+
+  W -= dW * 0.5;
+
+  ASSERT_EQ(W, Matrix({
+    { 0, 0 },
+    { 0, 0 }
+  }));
+}
+
+TEST_F(MathTest, kernelFromShape) {
+  Kernel K(Size3{ 4, 3, 2 });
+
+  ASSERT_EQ(K.W(), 4);
+  ASSERT_EQ(K.H(), 3);
+  ASSERT_EQ(K.D(), 2);
+}
+
+TEST_F(MathTest, kernelFromDataAndShape) {
+  DataArray data(24);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<netfloat_t>(i);
+  }
+
+  const Kernel K(static_cast<const DataArray&>(data), Size3{ 4, 3, 2 });
+
+  ASSERT_EQ(K.W(), 4);
+  ASSERT_EQ(K.H(), 3);
+  ASSERT_EQ(K.D(), 2);
+  ASSERT_EQ(K.at(3, 2, 1), 23.f);
+  ASSERT_EQ(K.at(1, 2, 0), 9.f);
+
+  Kernel fromMutable(data, Size3{ 4, 3, 2 });
+
+  ASSERT_EQ(fromMutable.W(), 4);
+  ASSERT_EQ(fromMutable.H(), 3);
+  ASSERT_EQ(fromMutable.D(), 2);
+  ASSERT_EQ(fromMutable.at(3, 0, 1), 15.f);
+}
+
+TEST_F(MathTest, nonCubicKernelExpression) {
+  Kernel A(4, 3, 2);
+  A.randomize(1.0);
+
+  Kernel B = A * 2.0;
+
+  ASSERT_EQ(B.shape(), A.shape());
+  for (size_t i = 0; i < A.size(); ++i) {
+    ASSERT_EQ(B.data()[i], A.data()[i] * 2.f);
+  }
+}
+
+TEST_F(MathTest, kernelExpression) {
+  Kernel A({
+    {
+      { 1, 2 },
+      { 3, 4 }
+    },
+    {
+      { 5, 6 },
+      { 7, 8 }
+    }
+  });
+
+  Kernel B = A - A * 2.0;
+  B += A + 1.0;
+
+  ASSERT_EQ(B, Kernel({
+    {
+      { 1, 1 },
+      { 1, 1 }
+    },
+    {
+      { 1, 1 },
+      { 1, 1 }
+    }
+  }));
+}
+
 TEST_F(MathTest, constSliceArray2) {
   const Array2 arr2({
     { 1, 2, 3 },
@@ -1018,3 +1142,296 @@ TEST_F(MathTest, fullConvolutionIsCommutative) {
 
   ASSERT_EQ(convResult1, convResult2);
 }
+
+TEST_F(MathTest, matrixMatrixMultiply) {
+  Matrix A({
+    { 1, 2, 3 },
+    { 4, 5, 6 }
+  });
+
+  Matrix B({
+    { 7, 8 },
+    { 9, 10 },
+    { 11, 12 }
+  });
+
+  Matrix C = A * B;
+
+  ASSERT_EQ(C, Matrix({
+    { 58, 64 },
+    { 139, 154 }
+  }));
+}
+
+TEST_F(MathTest, computeMatrixProductTransposed) {
+  Matrix A({
+    { 1, 4 },
+    { 2, 5 },
+    { 3, 6 }
+  });
+
+  Matrix B({
+    { 7, 9, 11 },
+    { 8, 10, 12 }
+  });
+
+  Matrix C(2, 2);
+  computeMatrixProduct(A, B, C, true, true);
+
+  ASSERT_EQ(C, Matrix({
+    { 58, 64 },
+    { 139, 154 }
+  }));
+}
+
+TEST_F(MathTest, computeMatrixProductAccumulate) {
+  Matrix A({
+    { 1, 2 },
+    { 3, 4 }
+  });
+
+  Matrix B({
+    { 1, 0 },
+    { 0, 1 }
+  });
+
+  Matrix C({
+    { 10, 20 },
+    { 30, 40 }
+  });
+
+  computeMatrixProduct(A, B, C, false, false, true);
+
+  ASSERT_EQ(C, Matrix({
+    { 11, 22 },
+    { 33, 44 }
+  }));
+}
+
+TEST_F(MathTest, computeMatrixProductLargeMultithreaded) {
+  const size_t M = 131;
+  const size_t K = 300;
+  const size_t N = 75;
+
+  Matrix A(K, M);
+  Matrix B(K, N);
+  A.randomize(1.0);
+  B.randomize(1.0);
+
+  ThreadPoolPtr pool = createThreadPool(4);
+
+  Matrix C(N, M);
+  computeMatrixProduct(A, B, C, false, true, false, pool.get());
+
+  // Each part covers whole elements of C, so splitting doesn't change the result
+  Matrix serialC(N, M);
+  computeMatrixProduct(A, B, serialC, false, true, false);
+  ASSERT_EQ(C, serialC);
+
+  for (size_t i = 0; i < M; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      double expected = 0.0;
+      for (size_t p = 0; p < K; ++p) {
+        expected += A.at(p, i) * B.at(p, j);
+      }
+      ASSERT_NEAR(C.at(j, i), expected, 1e-3);
+    }
+  }
+}
+
+TEST_F(MathTest, accumulateOuterProduct) {
+  Vector A({ 1, 2, 3 });
+  Vector B({ 4, 5 });
+  Matrix M({
+    { 1, 1 },
+    { 1, 1 },
+    { 1, 1 }
+  });
+
+  accumulateOuterProduct(A, B, M, 0.5);
+
+  ASSERT_EQ(M, Matrix({
+    { 3, 3.5 },
+    { 5, 6 },
+    { 7, 8.5 }
+  }));
+}
+
+TEST_F(MathTest, accumulateOuterProductMultithreaded) {
+  Vector A(301);
+  Vector B(517);
+  A.randomize(1.0);
+  B.randomize(1.0);
+
+  Matrix M(517, 301);
+  M.randomize(1.0);
+  Matrix expected = M + outerProduct(A, B);
+
+  ThreadPoolPtr pool = createThreadPool(4);
+  accumulateOuterProduct(A, B, M, 1.0, pool.get());
+
+  for (size_t i = 0; i < M.size(); ++i) {
+    ASSERT_NEAR(M.data()[i], expected.data()[i], 1e-5);
+  }
+}
+
+TEST_F(MathTest, im2col) {
+  Array3 image({
+    {
+      { 1, 2, 3 },
+      { 4, 5, 6 },
+      { 7, 8, 9 }
+    }, {
+      { 9, 8, 7 },
+      { 6, 5, 4 },
+      { 3, 2, 1 }
+    }
+  });
+
+  Kernel kernel({
+    {
+      { 1, 2 },
+      { 3, 4 }
+    }, {
+      { 5, 6 },
+      { 7, 8 }
+    }
+  });
+
+  Matrix columns(4, 8);
+  im2col(image, 2, 2, columns);
+
+  ASSERT_EQ(columns, Matrix({
+    { 1, 2, 4, 5 },
+    { 2, 3, 5, 6 },
+    { 4, 5, 7, 8 },
+    { 5, 6, 8, 9 },
+    { 9, 8, 6, 5 },
+    { 8, 7, 5, 4 },
+    { 6, 5, 3, 2 },
+    { 5, 4, 2, 1 }
+  }));
+
+  Matrix flattenedKernel(kernel.storage(), 8, 1);
+  Matrix product = flattenedKernel * columns;
+
+  Array2 expected(2, 2);
+  computeCrossCorrelation(image, kernel, expected);
+
+  ASSERT_EQ(Array2(product.storage(), 2, 2), expected);
+}
+
+// col2im is the adjoint of im2col, i.e. <im2col(x), C> = <x, col2im(C)>
+TEST_F(MathTest, col2imIsAdjointOfIm2col) {
+  const Size3 shape{ 5, 4, 2 };
+  const size_t batchSize = 2;
+  const size_t kW = 3;
+  const size_t kH = 2;
+  const size_t stride = 2;
+  const size_t padding = 1;
+
+  const size_t fmW = (shape[0] + 2 * padding - kW) / stride + 1;
+  const size_t fmH = (shape[1] + 2 * padding - kH) / stride + 1;
+
+  Vector images(batchSize * shape[0] * shape[1] * shape[2]);
+  images.randomize(1.0);
+
+  Matrix C(batchSize * fmW * fmH, kW * kH * shape[2]);
+  C.randomize(1.0);
+
+  Matrix columns(C.cols(), C.rows());
+  im2col(images.data(), shape, batchSize, kW, kH, columns, stride, padding);
+
+  Vector adjoint(images.size());
+  col2im(C, shape, batchSize, kW, kH, adjoint.data(), stride, padding);
+
+  double lhs = 0.0;
+  for (size_t i = 0; i < C.size(); ++i) {
+    lhs += columns.data()[i] * C.data()[i];
+  }
+
+  double rhs = 0.0;
+  for (size_t i = 0; i < images.size(); ++i) {
+    rhs += images[i] * adjoint[i];
+  }
+
+  ASSERT_NEAR(lhs, rhs, 1e-4);
+}
+
+TEST_F(MathTest, reorderRoundTripsThroughEachLayout) {
+  const Size3 shape{ 3, 2, 10 };
+
+  Array3 A(shape);
+  A.randomize(1.0);
+
+  for (Layout layout : { Layout::nchw, Layout::nhwc, Layout::nchw8c, Layout::nchw16c }) {
+    DataArray reordered(layoutSize(layout, shape));
+    std::fill(reordered.data(), reordered.data() + reordered.size(), 1.f);
+    reorder(A.data(), Layout::nchw, reordered.data(), layout, shape);
+
+    double sum = 0.0;
+    for (size_t z = 0; z < shape[2]; ++z) {
+      for (size_t y = 0; y < shape[1]; ++y) {
+        for (size_t x = 0; x < shape[0]; ++x) {
+          ASSERT_EQ(reordered[layoutIndex(layout, shape, x, y, z)], A.at(x, y, z));
+          sum += A.at(x, y, z);
+        }
+      }
+    }
+
+    // Anything else is a padding channel, which must be zero
+    double reorderedSum = 0.0;
+    for (size_t i = 0; i < reordered.size(); ++i) {
+      reorderedSum += reordered[i];
+    }
+    ASSERT_NEAR(reorderedSum, sum, 1e-4);
+
+    Array3 B(shape);
+    reorder(reordered.data(), layout, B.data(), Layout::nchw, shape);
+    ASSERT_EQ(B, A);
+  }
+}
+
+TEST_F(MathTest, layoutSizePadsToWholeBlocks) {
+  const Size3 shape{ 3, 2, 10 };
+
+  ASSERT_EQ(layoutSize(Layout::nchw, shape), 60);
+  ASSERT_EQ(layoutSize(Layout::nhwc, shape), 60);
+  ASSERT_EQ(layoutSize(Layout::nchw8c, shape), 96);
+  ASSERT_EQ(layoutSize(Layout::nchw16c, shape), 96);
+}
+
+TEST_F(MathTest, specialisedCrossCorrelationMatchesGeneric) {
+  const std::array<size_t, 2> kernelSizes[] = { { 1, 1 }, { 3, 3 }, { 5, 5 }, { 3, 2 } };
+
+  for (auto [kW, kH] : kernelSizes) {
+    for (size_t stride : { 1, 2 }) {
+      for (bool flip : { false, true }) {
+        // Widths that are and aren't a multiple of the output block
+        for (size_t imW : { kW + 7, kW + 10 }) {
+          const size_t imH = kH + 3;
+          const size_t D = 3;
+
+          Array3 image(imW, imH, D);
+          image.randomize(1.0);
+
+          Kernel kernel(kW, kH, D);
+          kernel.randomize(1.0);
+
+          const size_t fmW = (imW - kW) / stride + 1;
+          const size_t fmH = (imH - kH) / stride + 1;
+
+          Array2 expected(fmW, fmH);
+          test_computeCrossCorrelationGeneric(image, kernel, expected, flip, stride);
+
+          Array2 result(fmW, fmH);
+          computeCrossCorrelation(image, kernel, result, flip, stride);
+
+          for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_NEAR(result.data()[i], expected.data()[i], 1e-5);
+          }
+        }
+      }
+    }
+  }
+}
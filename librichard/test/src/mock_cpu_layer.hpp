@@ -11,11 +11,17 @@ class MockCpuLayer : public cpu::Layer {
     MOCK_METHOD(Size3, outputSize, (), (const, override));
     MOCK_METHOD(const DataArray&, activations, (), (const, override));
     MOCK_METHOD(const DataArray&, inputDelta, (), (const, override));
-    MOCK_METHOD(void, trainForward, (const DataArray& inputs), (override));
-    MOCK_METHOD(DataArray, evalForward, (const DataArray& inputs), (const, override));
-    MOCK_METHOD(void, updateDeltas, (const DataArray& inputs, const DataArray& outputDelta),
-      (override));
+    MOCK_METHOD(void, trainForward, (const DataArray& inputs, size_t batchSize), (override));
+    MOCK_METHOD(DataArray, evalForward, (const DataArray& inputs, size_t batchSize),
+      (const, override));
+    MOCK_METHOD(void, evalInto, (const netfloat_t* inputs, netfloat_t* outputs, size_t batchSize,
+      netfloat_t* scratch), (const, override));
+    MOCK_METHOD(void, updateDeltas, (const DataArray& inputs, const DataArray& outputDelta,
+      size_t batchSize), (override));
     MOCK_METHOD(void, updateParams, (size_t epoch), (override));
     MOCK_METHOD(void, writeToStream, (std::ostream& stream), (const, override));
+    MOCK_METHOD(void, mergeDeltas, (Layer& replica), (override));
+    MOCK_METHOD(void, copyParams, (const Layer& source), (override));
+    MOCK_METHOD(void, shareParams, (Layer& owner), (override));
 };
 
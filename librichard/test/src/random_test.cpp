@@ -0,0 +1,35 @@
+#include <richard/random.hpp>
+#include <gtest/gtest.h>
+
+using namespace richard;
+
+class RandomTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+// Known answers from the Random123 reference implementation
+TEST_F(RandomTest, philoxKnownAnswers) {
+  ASSERT_EQ(Philox::generate({ 0, 0, 0, 0 }, { 0, 0 }),
+    Philox::Block({ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }));
+
+  ASSERT_EQ(Philox::generate({ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+    { 0xffffffff, 0xffffffff }),
+    Philox::Block({ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd }));
+
+  ASSERT_EQ(Philox::generate({ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+    { 0xa4093822, 0x299f31d0 }),
+    Philox::Block({ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }));
+}
+
+TEST_F(RandomTest, philoxStreamsAreIndependent) {
+  Philox A(1);
+  Philox B(2);
+  Philox C(1);
+
+  Philox::Block a = A.next();
+  ASSERT_NE(a, B.next());
+  ASSERT_EQ(a, C.next());
+  ASSERT_NE(a, C.next());
+}
@@ -0,0 +1,279 @@
+#include <richard/simd.hpp>
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace richard;
+
+namespace {
+
+std::vector<netfloat_t> randomArray(size_t n, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<netfloat_t> dist(-1.0, 1.0);
+  std::vector<netfloat_t> v(n);
+  for (auto& x : v) {
+    x = dist(gen);
+  }
+  return v;
+}
+
+const std::vector<size_t> sizes{ 1, 3, 7, 8, 15, 16, 17, 31, 33, 64, 67, 100, 785 };
+
+netfloat_t fromBits(uint32_t bits) {
+  netfloat_t x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Converts a single value, padded out so the vector loops are exercised
+template<class F>
+uint16_t convertOne(F convert, netfloat_t x) {
+  std::vector<netfloat_t> src(17, x);
+  std::vector<uint16_t> dst(17);
+  convert(src.data(), dst.data(), src.size());
+  return dst[3];
+}
+
+}
+
+class SimdTest : public testing::TestWithParam<simd::InstructionSet> {
+  public:
+    virtual void SetUp() override {
+      m_previous = simd::instructionSet();
+
+      if (!simd::isSupported(GetParam())) {
+        GTEST_SKIP() << simd::instructionSetName(GetParam()) << " not supported";
+      }
+      simd::test_setInstructionSet(GetParam());
+    }
+
+    virtual void TearDown() override {
+      simd::test_setInstructionSet(m_previous);
+    }
+
+  private:
+    simd::InstructionSet m_previous;
+};
+
+TEST_P(SimdTest, dot) {
+  for (size_t n : sizes) {
+    auto A = randomArray(n, 1);
+    auto B = randomArray(n, 2);
+
+    double expected = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      expected += A[i] * B[i];
+    }
+
+    ASSERT_NEAR(simd::dot(A.data(), B.data(), n), expected, 1e-4) << "n = " << n;
+  }
+}
+
+TEST_P(SimdTest, squareSumAndSum) {
+  for (size_t n : sizes) {
+    auto A = randomArray(n, 3);
+
+    double expectedSquareSum = 0.0;
+    double expectedSum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      expectedSquareSum += A[i] * A[i];
+      expectedSum += A[i];
+    }
+
+    ASSERT_NEAR(simd::squareSum(A.data(), n), expectedSquareSum, 1e-4) << "n = " << n;
+    ASSERT_NEAR(simd::sum(A.data(), n), expectedSum, 1e-4) << "n = " << n;
+  }
+}
+
+TEST_P(SimdTest, elementWiseInPlace) {
+  for (size_t n : sizes) {
+    auto A = randomArray(n, 4);
+    auto B = randomArray(n, 5);
+
+    auto sum = A;
+    simd::add(sum.data(), B.data(), sum.data(), n);
+    auto diff = A;
+    simd::subtract(diff.data(), B.data(), diff.data(), n);
+    std::vector<netfloat_t> product(n);
+    simd::multiply(A.data(), B.data(), product.data(), n);
+    auto axpy = B;
+    simd::axpy(0.5f, A.data(), axpy.data(), n);
+
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(sum[i], A[i] + B[i]);
+      ASSERT_EQ(diff[i], A[i] - B[i]);
+      ASSERT_EQ(product[i], A[i] * B[i]);
+      ASSERT_NEAR(axpy[i], B[i] + 0.5f * A[i], 1e-6);
+    }
+  }
+}
+
+TEST_P(SimdTest, matrixVectorMultiply) {
+  for (size_t rows : { 1, 3, 4, 9 }) {
+    for (size_t cols : sizes) {
+      auto M = randomArray(rows * cols, 6);
+      auto V = randomArray(cols, 7);
+      std::vector<netfloat_t> result(rows);
+
+      simd::matrixVectorMultiply(M.data(), V.data(), result.data(), cols, rows);
+
+      for (size_t r = 0; r < rows; ++r) {
+        double expected = 0.0;
+        for (size_t c = 0; c < cols; ++c) {
+          expected += M[r * cols + c] * V[c];
+        }
+        ASSERT_NEAR(result[r], expected, 1e-4) << rows << "x" << cols;
+      }
+    }
+  }
+}
+
+TEST_P(SimdTest, transposeMatrixVectorMultiply) {
+  for (size_t rows : { 1, 3, 4, 9 }) {
+    for (size_t cols : sizes) {
+      auto M = randomArray(rows * cols, 8);
+      auto V = randomArray(rows, 9);
+      std::vector<netfloat_t> result(cols, 123.f);
+
+      simd::transposeMatrixVectorMultiply(M.data(), V.data(), result.data(), cols, rows);
+
+      for (size_t c = 0; c < cols; ++c) {
+        double expected = 0.0;
+        for (size_t r = 0; r < rows; ++r) {
+          expected += M[r * cols + c] * V[r];
+        }
+        ASSERT_NEAR(result[c], expected, 1e-4) << rows << "x" << cols;
+      }
+    }
+  }
+}
+
+TEST_P(SimdTest, gemmMicroKernel) {
+  const simd::GemmTile tile = simd::gemmTile();
+  const size_t k = 13;
+  const size_t ldc = tile.cols + 3;
+
+  auto packedA = randomArray(k * tile.rows, 10);
+  auto packedB = randomArray(k * tile.cols, 11);
+
+  for (size_t rows : { tile.rows, tile.rows - 1 }) {
+    for (size_t cols : { tile.cols, tile.cols - 3 }) {
+      for (bool accumulate : { false, true }) {
+        std::vector<netfloat_t> C(tile.rows * ldc, 1.f);
+
+        simd::gemmMicroKernel(k, packedA.data(), packedB.data(), C.data(), ldc, rows, cols,
+          accumulate);
+
+        for (size_t i = 0; i < tile.rows; ++i) {
+          for (size_t j = 0; j < ldc; ++j) {
+            double expected = 1.0;
+            if (i < rows && j < cols) {
+              expected = accumulate ? 1.0 : 0.0;
+              for (size_t p = 0; p < k; ++p) {
+                expected += packedA[p * tile.rows + i] * packedB[p * tile.cols + j];
+              }
+            }
+            ASSERT_NEAR(C[i * ldc + j], expected, 1e-4);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_P(SimdTest, bf16KnownValues) {
+  ASSERT_EQ(convertOne(simd::floatToBf16, 1.f), 0x3f80);
+  ASSERT_EQ(convertOne(simd::floatToBf16, -2.f), 0xc000);
+  ASSERT_EQ(convertOne(simd::floatToBf16, 0.f), 0x0000);
+  ASSERT_EQ(convertOne(simd::floatToBf16, std::numeric_limits<float>::infinity()), 0x7f80);
+  // Ties round to even
+  ASSERT_EQ(convertOne(simd::floatToBf16, fromBits(0x3f808000)), 0x3f80);
+  ASSERT_EQ(convertOne(simd::floatToBf16, fromBits(0x3f818000)), 0x3f82);
+  ASSERT_EQ(convertOne(simd::floatToBf16, fromBits(0x3f808001)), 0x3f81);
+
+  uint16_t nan = convertOne(simd::floatToBf16, std::numeric_limits<float>::quiet_NaN());
+  ASSERT_EQ(nan & 0x7f80, 0x7f80);
+  ASSERT_NE(nan & 0x007f, 0);
+}
+
+TEST_P(SimdTest, halfKnownValues) {
+  ASSERT_EQ(convertOne(simd::floatToHalf, 1.f), 0x3c00);
+  ASSERT_EQ(convertOne(simd::floatToHalf, -2.f), 0xc000);
+  ASSERT_EQ(convertOne(simd::floatToHalf, 65504.f), 0x7bff);
+  ASSERT_EQ(convertOne(simd::floatToHalf, 1e6f), 0x7c00);
+  ASSERT_EQ(convertOne(simd::floatToHalf, std::ldexp(1.f, -24)), 0x0001);
+  // Ties round to even
+  ASSERT_EQ(convertOne(simd::floatToHalf, 1.f + std::ldexp(1.f, -11)), 0x3c00);
+  ASSERT_EQ(convertOne(simd::floatToHalf, 1.f + 3.f * std::ldexp(1.f, -11)), 0x3c02);
+
+  std::vector<uint16_t> src{ 0x3c00, 0x0001, 0x7c00, 0xfbff, 0x3555, 0x7e00, 0x8000, 0x0400, 0x0 };
+  std::vector<netfloat_t> dst(src.size());
+  simd::halfToFloat(src.data(), dst.data(), src.size());
+
+  ASSERT_EQ(dst[0], 1.f);
+  ASSERT_EQ(dst[1], std::ldexp(1.f, -24));
+  ASSERT_EQ(dst[2], std::numeric_limits<float>::infinity());
+  ASSERT_EQ(dst[3], -65504.f);
+  ASSERT_NEAR(dst[4], 1.f / 3.f, 1e-4);
+  ASSERT_TRUE(std::isnan(dst[5]));
+  ASSERT_TRUE(std::signbit(dst[6]));
+  ASSERT_EQ(dst[7], std::ldexp(1.f, -14));
+}
+
+TEST_P(SimdTest, reducedPrecisionRoundTrip) {
+  for (size_t n : sizes) {
+    auto A = randomArray(n, 12);
+    std::vector<uint16_t> packed(n);
+    std::vector<netfloat_t> unpacked(n);
+
+    simd::floatToBf16(A.data(), packed.data(), n);
+    simd::bf16ToFloat(packed.data(), unpacked.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_LE(std::fabs(unpacked[i] - A[i]), std::fabs(A[i]) * std::ldexp(1.f, -8));
+    }
+
+    simd::floatToHalf(A.data(), packed.data(), n);
+    simd::halfToFloat(packed.data(), unpacked.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_LE(std::fabs(unpacked[i] - A[i]), std::fabs(A[i]) * std::ldexp(1.f, -11) + 1e-7);
+    }
+  }
+}
+
+TEST_P(SimdTest, reducedPrecisionMatrixVectorMultiply) {
+  for (StorageType storageType : { StorageType::bf16, StorageType::fp16 }) {
+    auto toPacked = storageType == StorageType::bf16 ? simd::floatToBf16 : simd::floatToHalf;
+    auto toFloat = storageType == StorageType::bf16 ? simd::bf16ToFloat : simd::halfToFloat;
+
+    for (size_t rows : { 1, 3, 9 }) {
+      for (size_t cols : { 1, 17, 255, 256, 257, 785 }) {
+        auto M = randomArray(rows * cols, 13);
+        auto V = randomArray(cols, 14);
+
+        std::vector<uint16_t> packed(M.size());
+        toPacked(M.data(), packed.data(), M.size());
+        toFloat(packed.data(), M.data(), M.size());
+
+        std::vector<netfloat_t> result(rows);
+        simd::matrixVectorMultiply(packed.data(), storageType, V.data(), result.data(), cols, rows);
+
+        for (size_t r = 0; r < rows; ++r) {
+          double expected = 0.0;
+          for (size_t c = 0; c < cols; ++c) {
+            expected += M[r * cols + c] * V[c];
+          }
+          ASSERT_NEAR(result[r], expected, 1e-4) << rows << "x" << cols;
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(InstructionSets, SimdTest, testing::Values(
+  simd::InstructionSet::scalar,
+  simd::InstructionSet::avx2,
+  simd::InstructionSet::avx512
+));
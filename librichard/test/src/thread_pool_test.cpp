@@ -0,0 +1,138 @@
+#include <richard/thread_pool.hpp>
+#include <richard/exception.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <set>
+#include <mutex>
+
+using namespace richard;
+
+class ThreadPoolTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+TEST_F(ThreadPoolTest, parallelForVisitsEachIndexOnce) {
+  ThreadPoolPtr pool = createThreadPool(4);
+
+  std::vector<std::atomic<int>> visits(1000);
+  parallelFor(*pool, 0, visits.size(), [&](size_t i) {
+    ++visits[i];
+  });
+
+  for (size_t i = 0; i < visits.size(); ++i) {
+    ASSERT_EQ(visits[i], 1) << "index " << i;
+  }
+}
+
+TEST_F(ThreadPoolTest, parallelForWithOffsetRange) {
+  ThreadPoolPtr pool = createThreadPool(3);
+
+  std::atomic<size_t> sum = 0;
+  parallelFor(*pool, 10, 20, [&](size_t i) {
+    sum += i;
+  });
+
+  ASSERT_EQ(sum, 145);
+}
+
+TEST_F(ThreadPoolTest, singleThreadRunsOnCaller) {
+  ThreadPoolPtr pool = createThreadPool(1);
+
+  std::thread::id caller = std::this_thread::get_id();
+  parallelFor(*pool, 0, 50, [&](size_t) {
+    ASSERT_EQ(std::this_thread::get_id(), caller);
+  });
+
+  ASSERT_TRUE(pool->workerStats().empty());
+}
+
+TEST_F(ThreadPoolTest, nestedParallelForCompletes) {
+  ThreadPoolPtr pool = createThreadPool(4);
+
+  std::atomic<size_t> count = 0;
+  parallelFor(*pool, 0, 16, [&](size_t) {
+    parallelFor(*pool, 0, 16, [&](size_t) {
+      parallelFor(*pool, 0, 4, [&](size_t) {
+        ++count;
+      });
+    });
+  });
+
+  ASSERT_EQ(count, 16 * 16 * 4);
+}
+
+TEST_F(ThreadPoolTest, neverRunsMoreThanNumThreadsAtOnce) {
+  const size_t numThreads = 3;
+  ThreadPoolPtr pool = createThreadPool(numThreads);
+
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  std::atomic<size_t> running = 0;
+  std::atomic<size_t> maxRunning = 0;
+
+  parallelFor(*pool, 0, 8, [&](size_t) {
+    parallelFor(*pool, 0, 8, [&](size_t) {
+      size_t n = ++running;
+      size_t prevMax = maxRunning;
+      while (n > prevMax && !maxRunning.compare_exchange_weak(prevMax, n)) {}
+
+      {
+        std::lock_guard lock(mutex);
+        threads.insert(std::this_thread::get_id());
+      }
+
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      --running;
+    });
+  });
+
+  ASSERT_LE(maxRunning, numThreads);
+  ASSERT_LE(threads.size(), numThreads);
+}
+
+TEST_F(ThreadPoolTest, taskGroupRethrowsException) {
+  ThreadPoolPtr pool = createThreadPool(2);
+
+  TaskGroup group(*pool);
+  std::atomic<int> completed = 0;
+  for (int i = 0; i < 10; ++i) {
+    group.run([&, i]() {
+      if (i == 5) {
+        EXCEPTION("Task failed");
+      }
+      ++completed;
+    });
+  }
+
+  ASSERT_THROW(group.wait(), Exception);
+  ASSERT_EQ(completed, 9);
+}
+
+TEST_F(ThreadPoolTest, workerStatsCountTasks) {
+  ThreadPoolPtr pool = createThreadPool(3);
+
+  TaskGroup group(*pool);
+  for (int i = 0; i < 100; ++i) {
+    group.run([]() {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    });
+  }
+  group.wait();
+
+  std::vector<WorkerStats> stats = pool->workerStats();
+  ASSERT_EQ(stats.size(), 2);
+
+  uint64_t tasksRun = 0;
+  for (const WorkerStats& worker : stats) {
+    tasksRun += worker.tasksRun;
+    // Every task submitted from outside the pool is stolen from the shared queue
+    ASSERT_EQ(worker.tasksStolen, worker.tasksRun);
+    ASSERT_GE(worker.busyNanoseconds, worker.tasksRun * 50000);
+  }
+
+  // The rest ran on this thread while it waited
+  ASSERT_LE(tasksRun, 100);
+}
@@ -0,0 +1,120 @@
+#include <richard/winograd.hpp>
+#include <gtest/gtest.h>
+
+using namespace richard;
+
+class WinogradTest : public testing::Test {
+  public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+namespace {
+
+void assertNear(const Array3& A, const Array3& B) {
+  ASSERT_EQ(A.W(), B.W());
+  ASSERT_EQ(A.H(), B.H());
+  ASSERT_EQ(A.D(), B.D());
+
+  for (size_t i = 0; i < A.size(); ++i) {
+    ASSERT_NEAR(A.data()[i], B.data()[i], 1e-4) << "at index " << i;
+  }
+}
+
+std::vector<Kernel> randomKernels(size_t numKernels, size_t depth) {
+  std::vector<Kernel> kernels;
+  for (size_t i = 0; i < numKernels; ++i) {
+    kernels.push_back(Kernel(3, 3, depth));
+    kernels.back().randomize(1.0);
+  }
+  return kernels;
+}
+
+WinogradFilters transformKernels(const std::vector<Kernel>& kernels) {
+  WinogradFilters filters(kernels.size(), kernels[0].D());
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    filters.setKernel(i, kernels[i]);
+  }
+  return filters;
+}
+
+}
+
+TEST_F(WinogradTest, crossCorrelationMatchesReference) {
+  for (size_t W : { 3, 4, 7, 8 }) {
+    for (size_t H : { 3, 5, 6 }) {
+      const size_t D = 2;
+      const size_t F = 3;
+
+      Array3 image(W, H, D);
+      image.randomize(1.0);
+      auto kernels = randomKernels(F, D);
+
+      Array3 expected(W - 2, H - 2, F);
+      for (size_t f = 0; f < F; ++f) {
+        computeCrossCorrelation(image, kernels[f], *expected.slice(f));
+      }
+
+      Array3 result(W - 2, H - 2, F);
+      computeWinogradCrossCorrelation(image, transformKernels(kernels), result);
+
+      assertNear(result, expected);
+    }
+  }
+}
+
+TEST_F(WinogradTest, fullConvolutionMatchesReference) {
+  for (size_t W : { 1, 2, 5 }) {
+    for (size_t H : { 1, 4 }) {
+      const size_t D = 3;
+      const size_t F = 2;
+
+      Array3 delta(W, H, F);
+      delta.randomize(1.0);
+      auto kernels = randomKernels(F, D);
+
+      Array3 expected(W + 2, H + 2, D);
+      Array2 tmp(W + 2, H + 2);
+      for (size_t z = 0; z < D; ++z) {
+        Array2Ptr slice = expected.slice(z);
+        for (size_t f = 0; f < F; ++f) {
+          computeFullConvolution(*kernels[f].slice(z), *delta.slice(f), tmp);
+          *slice += tmp;
+        }
+      }
+
+      Array3 result(W + 2, H + 2, D);
+      computeWinogradFullConvolution(delta, transformKernels(kernels), result);
+
+      assertNear(result, expected);
+    }
+  }
+}
+
+TEST_F(WinogradTest, kernelGradientsMatchReference) {
+  for (size_t W : { 3, 6, 7 }) {
+    for (size_t H : { 4, 5 }) {
+      const size_t D = 2;
+      const size_t F = 3;
+
+      Array3 image(W, H, D);
+      image.randomize(1.0);
+      Array3 delta(W - 2, H - 2, F);
+      delta.randomize(1.0);
+
+      std::vector<Kernel> gradients;
+      computeWinogradKernelGradients(image, delta, gradients);
+
+      ASSERT_EQ(gradients.size(), F);
+
+      for (size_t f = 0; f < F; ++f) {
+        Kernel expected(3, 3, D);
+        for (size_t z = 0; z < D; ++z) {
+          computeCrossCorrelation(*image.slice(z), *delta.slice(f), *expected.slice(z));
+        }
+
+        assertNear(gradients[f], expected);
+      }
+    }
+  }
+}